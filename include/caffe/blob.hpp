@@ -278,6 +278,15 @@ class Blob {
    * shared_ptr calls its destructor when reset with the "=" operator.
    */
   void ShareDiff(const Blob& other);
+  /**
+   * @brief Set the data_ shared_ptr to a scratch SyncedMemory owned by a
+   *        Workspace, which may be larger than this Blob.
+   *
+   * The Blob's capacity grows to the size of the workspace, so later calls
+   * to Reshape that fit within it keep using the shared memory. The diff_ is
+   * replaced by a lazily allocated SyncedMemory of the same capacity.
+   */
+  void ShareWorkspace(const shared_ptr<SyncedMemory>& workspace);
 
   bool ShapeEquals(const BlobProto& other);
 
@@ -93,6 +93,8 @@ using std::string;
 using std::stringstream;
 using std::vector;
 
+class ThreadPool;
+
 // A global initialization function that you should call in your main function.
 // Currently it initializes google flags and google logging.
 void GlobalInit(int* pargc, char*** pargv);
@@ -163,6 +165,14 @@ class Caffe {
   inline static void set_solver_count(int val) { Get().solver_count_ = val; }
   inline static bool root_solver() { return Get().root_solver_; }
   inline static void set_root_solver(bool val) { Get().root_solver_ = val; }
+  // Sets the number of threads the CPU math functions and layers may use
+  // for a single operation. Unlike the settings above, the pool is shared by
+  // every thread of the process. 1, the default, runs everything on the
+  // calling thread and leaves any parallelism to the BLAS library.
+  static void set_cpu_threads(const int num_threads);
+  static int cpu_threads();
+  // Returns the shared CPU pool, or NULL when cpu_threads() is 1.
+  static shared_ptr<ThreadPool> cpu_thread_pool();
 
  protected:
 #ifndef CPU_ONLY
@@ -8,7 +8,9 @@
 #include "caffe/common.hpp"
 #include "caffe/internal_thread.hpp"
 #include "caffe/util/blocking_queue.hpp"
+#include "caffe/util/datum_view.hpp"
 #include "caffe/util/db.hpp"
+#include "caffe/util/spsc_queue.hpp"
 
 namespace caffe {
 
@@ -19,28 +21,44 @@ namespace caffe {
  * databases are read sequentially, and that each solver accesses a different
  * subset of the database. Data is distributed to solvers in a round-robin
  * way to keep parallel training deterministic.
+ *
+ * With DataParameter.shuffle, every epoch reads the records in a new random
+ * order instead. The records are permuted at the start of each epoch, and
+ * the next read_ahead records of the permutation are fetched in the order
+ * of the database on disk. Databases that seek to a record by position, as
+ * sharded ones do, are permuted by position; for the others the keys are
+ * read once and permuted, as they are stored in key order.
+ *
+ * With DataParameter.shard_count, only the shard_index-th of shard_count
+ * contiguous ranges of records is read, in order or shuffled, so that
+ * separate training processes split the database between them.
+ *
+ * Records are handed out as DatumView%s. When the database keeps values
+ * mapped for as long as the cursor lives, as LMDB does, they point into
+ * the database itself, so no record is copied or fully parsed.
  */
 class DataReader {
  public:
   explicit DataReader(const LayerParameter& param);
   ~DataReader();
 
-  inline BlockingQueue<Datum*>& free() const {
+  inline SPSCQueue<DatumView*>& free() const {
     return queue_pair_->free_;
   }
-  inline BlockingQueue<Datum*>& full() const {
+  inline SPSCQueue<DatumView*>& full() const {
     return queue_pair_->full_;
   }
 
  protected:
-  // Queue pairs are shared between a body and its readers
+  // Queue pairs are shared between a body and its readers. The body is the
+  // only consumer of free_ and producer of full_, the reader the other way.
   class QueuePair {
    public:
     explicit QueuePair(int size);
     ~QueuePair();
 
-    BlockingQueue<Datum*> free_;
-    BlockingQueue<Datum*> full_;
+    SPSCQueue<DatumView*> free_;
+    SPSCQueue<DatumView*> full_;
 
   DISABLE_COPY_AND_ASSIGN(QueuePair);
   };
@@ -54,9 +72,28 @@ class DataReader {
    protected:
     void InternalThreadEntry();
     void read_one(db::Cursor* cursor, QueuePair* qp);
+    // Fetches the next records of the shuffled order into window_,
+    // shuffling the records again at the end of each epoch.
+    void read_ahead(db::Cursor* cursor);
 
     const LayerParameter param_;
+    // The range of records of this shard, and the position of the cursor
+    // in it when reading in order.
+    size_t shard_begin_;
+    size_t shard_end_;
+    size_t record_;
     BlockingQueue<shared_ptr<QueuePair> > new_queue_pairs_;
+    // In shuffle mode, the positions of the records of this shard in their
+    // order for this epoch, or their keys if the cursor has no random
+    // access, and the index of the next one to fetch, and the values
+    // fetched ahead, copied when the cursor does not keep them valid.
+    bool shuffle_;
+    vector<size_t> records_;
+    vector<string> keys_;
+    size_t next_shuffled_;
+    vector<std::pair<const char*, size_t> > window_;
+    vector<string> window_copies_;
+    size_t next_value_;
 
     friend class DataReader;
 
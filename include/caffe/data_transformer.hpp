@@ -6,6 +6,7 @@
 #include "caffe/blob.hpp"
 #include "caffe/common.hpp"
 #include "caffe/proto/caffe.pb.h"
+#include "caffe/util/datum_view.hpp"
 
 namespace caffe {
 
@@ -37,6 +38,17 @@ class DataTransformer {
    */
   void Transform(const Datum& datum, Blob<Dtype>* transformed_blob);
 
+  /**
+   * @brief Applies the transformation to a Datum read in place, without
+   *    copying its pixels or encoded image first.
+   *
+   * @param datum
+   *    DatumView of the serialized Datum to be transformed.
+   * @param transformed_blob
+   *    This is destination blob. See data_layer.cpp for an example.
+   */
+  void Transform(const DatumView& datum, Blob<Dtype>* transformed_blob);
+
   /**
    * @brief Applies the transformation defined in the data layer's
    * transform_param block to a vector of Datum.
@@ -98,6 +110,7 @@ class DataTransformer {
    *    Datum containing the data to be transformed.
    */
   vector<int> InferBlobShape(const Datum& datum);
+  vector<int> InferBlobShape(const DatumView& datum);
   /**
    * @brief Infers the shape of transformed_blob will have when
    *    the transformation is applied to the data.
@@ -139,6 +152,19 @@ class DataTransformer {
   virtual int Rand(int n);
 
   void Transform(const Datum& datum, Dtype* transformed_data);
+  // Transforms the values of a datum, given as bytes or, if bytes is NULL,
+  // as floats.
+  void TransformValues(const char* bytes, const float* floats,
+      const int datum_channels, const int datum_height, const int datum_width,
+      Dtype* transformed_data);
+  // Checks that a datum of the given shape transforms into the blob.
+  void CheckTransformedShape(const int datum_channels, const int datum_height,
+      const int datum_width, const Blob<Dtype>* transformed_blob);
+  vector<int> InferBlobShape(const int datum_channels, const int datum_height,
+      const int datum_width);
+  // Gets the factor the data of each channel is multiplied by once the mean
+  // is subtracted, i.e. the scale divided by the std_value of the channel.
+  void ChannelScales(const int channels, vector<Dtype>* scales);
   // Tranformation parameters
   TransformationParameter param_;
 
@@ -147,6 +173,7 @@ class DataTransformer {
   Phase phase_;
   Blob<Dtype> data_mean_;
   vector<Dtype> mean_values_;
+  vector<Dtype> std_values_;
 };
 
 }  // namespace caffe
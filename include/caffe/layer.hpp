@@ -19,6 +19,8 @@ namespace boost { class mutex; }
 
 namespace caffe {
 
+class Workspace;
+
 /**
  * @brief An interface for the units of computation which can be composed into a
  *        Net.
@@ -294,6 +296,27 @@ class Layer {
     return true;
   }
 
+  /**
+   * @brief Returns whether Forward draws from the random number generator of
+   *        the calling thread (Caffe::rng_stream).
+   *
+   * A net running its layers concurrently runs these layers on the calling
+   * thread, in order, so that they draw the numbers they would draw
+   * sequentially.
+   */
+  virtual inline bool DrawsRandomNumbers() const { return false; }
+
+  /**
+   * @brief Registers the internal buffers that carry no state from one call
+   *        to the next with the Net's Workspace, so that they can share memory
+   *        with the buffers of other layers. Called after Reshape.
+   *
+   * @param forward_only
+   *     true if Backward will not be called, in which case buffers that
+   *     Forward only fills for Backward are scratch as well.
+   */
+  virtual void AppendWorkspace(bool forward_only, Workspace* workspace) {}
+
   /**
    * @brief Specifies whether the layer should compute gradients w.r.t. a
    *        parameter at a particular index given by param_id.
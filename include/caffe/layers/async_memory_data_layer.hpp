@@ -0,0 +1,92 @@
+#ifndef CAFFE_ASYNC_MEMORY_DATA_LAYER_HPP_
+#define CAFFE_ASYNC_MEMORY_DATA_LAYER_HPP_
+
+#include <vector>
+
+#include "caffe/blob.hpp"
+#include "caffe/layer.hpp"
+#include "caffe/proto/caffe.pb.h"
+
+#include "caffe/layers/base_data_layer.hpp"
+#include "caffe/util/blocking_queue.hpp"
+
+namespace caffe {
+
+/**
+ * @brief Provides data to the Net from memory pushed by other threads.
+ *
+ * Unlike MemoryDataLayer, which transforms added data on the calling thread
+ * and then hands out its memory, any number of producer threads push
+ * batches of Datum%s, cv::Mat%s or arrays, which the prefetch thread
+ * transforms into the prefetched batches while the net runs. Forward then
+ * only shares the data of the next prepared batch with the tops, so it
+ * never waits on the producers unless no batch is ready.
+ *
+ * Each push holds one batch of MemoryDataParameter.batch_size items, and
+ * blocks while MemoryDataParameter.queue_size pushed batches are waiting to
+ * be transformed. As for MemoryDataLayer, channels, height and width give
+ * the shape of the transformed items.
+ */
+template <typename Dtype>
+class AsyncMemoryDataLayer : public BasePrefetchingDataLayer<Dtype> {
+ public:
+  explicit AsyncMemoryDataLayer(const LayerParameter& param)
+      : BasePrefetchingDataLayer<Dtype>(param), current_(NULL) {}
+  virtual ~AsyncMemoryDataLayer();
+  virtual void DataLayerSetUp(const vector<Blob<Dtype>*>& bottom,
+      const vector<Blob<Dtype>*>& top);
+
+  virtual inline const char* type() const { return "AsyncMemoryData"; }
+  virtual inline int ExactNumBottomBlobs() const { return 0; }
+  virtual inline int ExactNumTopBlobs() const { return 2; }
+
+  // The push methods may be called from any thread.
+  void PushDatumVector(const vector<Datum>& datum_vector);
+#ifdef USE_OPENCV
+  void PushMatVector(const vector<cv::Mat>& mat_vector,
+      const vector<int>& labels);
+#endif  // USE_OPENCV
+  /// @brief Copies batch_size items, already transformed, and their labels.
+  void PushArrays(const Dtype* data, const Dtype* labels);
+
+  int batch_size() { return batch_size_; }
+  int channels() { return channels_; }
+  int height() { return height_; }
+  int width() { return width_; }
+
+  // A batch pushed by a producer, as one of its members.
+  struct Input {
+    vector<Datum> datums;
+#ifdef USE_OPENCV
+    vector<cv::Mat> mats;
+#endif  // USE_OPENCV
+    vector<int> labels;
+    vector<Dtype> data;
+    vector<Dtype> data_labels;
+  };
+
+ protected:
+  virtual void Forward_cpu(const vector<Blob<Dtype>*>& bottom,
+      const vector<Blob<Dtype>*>& top);
+  virtual void Forward_gpu(const vector<Blob<Dtype>*>& bottom,
+      const vector<Blob<Dtype>*>& top) {
+    Forward_cpu(bottom, top);
+  }
+  virtual void load_batch(Batch<Dtype>* batch);
+  // Waits for a free input, cleared for the caller to fill and push to
+  // full_inputs_.
+  Input* PopFreeInput();
+
+  int batch_size_, channels_, height_, width_;
+  // The inputs free to be filled by producers, and those waiting to be
+  // transformed.
+  vector<shared_ptr<Input> > inputs_;
+  BlockingQueue<Input*> free_inputs_;
+  BlockingQueue<Input*> full_inputs_;
+  // The batch whose data the tops share since the last Forward.
+  Batch<Dtype>* current_;
+};
+
+}  // namespace caffe
+
+#endif  // CAFFE_ASYNC_MEMORY_DATA_LAYER_HPP_
@@ -23,6 +23,7 @@ class BaseConvolutionLayer : public Layer<Dtype> {
       const vector<Blob<Dtype>*>& top);
   virtual void Reshape(const vector<Blob<Dtype>*>& bottom,
       const vector<Blob<Dtype>*>& top);
+  virtual void AppendWorkspace(bool forward_only, Workspace* workspace);
 
   virtual inline int MinBottomBlobs() const { return 1; }
   virtual inline int MinTopBlobs() const { return 1; }
@@ -35,6 +36,10 @@ class BaseConvolutionLayer : public Layer<Dtype> {
   void forward_cpu_gemm(const Dtype* input, const Dtype* weights,
       Dtype* output, bool skip_im2col = false);
   void forward_cpu_bias(Dtype* output, const Dtype* bias);
+  // Like forward_cpu_gemm, but for num_images (at most cpu_batch_size_)
+  // consecutive images at once.
+  void forward_cpu_gemm_batch(const Dtype* input, const int num_images,
+      const Dtype* weights, Dtype* output);
   void backward_cpu_gemm(const Dtype* input, const Dtype* weights,
       Dtype* output);
   void weight_cpu_gemm(const Dtype* input, const Dtype* output, Dtype*
@@ -92,6 +97,8 @@ class BaseConvolutionLayer : public Layer<Dtype> {
   bool bias_term_;
   bool is_1x1_;
   bool force_nd_im2col_;
+  /// @brief The number of images forward_cpu_gemm_batch may handle at once.
+  int cpu_batch_size_;
 
  private:
   // wrap im2col/col2im so we don't have to remember the (long) argument lists
@@ -167,6 +174,9 @@ class BaseConvolutionLayer : public Layer<Dtype> {
 
   Blob<Dtype> col_buffer_;
   Blob<Dtype> bias_multiplier_;
+  // Columns and channel-major outputs of cpu_batch_size_ images.
+  Blob<Dtype> batch_col_buffer_;
+  Blob<Dtype> batch_output_buffer_;
 };
 
 }  // namespace caffe
@@ -1,6 +1,7 @@
 #ifndef CAFFE_DATA_LAYERS_HPP_
 #define CAFFE_DATA_LAYERS_HPP_
 
+#include <boost/function.hpp>
 #include <vector>
 
 #include "caffe/blob.hpp"
@@ -8,7 +9,8 @@
 #include "caffe/internal_thread.hpp"
 #include "caffe/layer.hpp"
 #include "caffe/proto/caffe.pb.h"
-#include "caffe/util/blocking_queue.hpp"
+#include "caffe/util/spsc_queue.hpp"
+#include "caffe/util/thread_pool.hpp"
 
 namespace caffe {
 
@@ -49,6 +51,8 @@ template <typename Dtype>
 class Batch {
  public:
   Blob<Dtype> data_, label_;
+  // The tops after data and label, for layers with more than two.
+  vector<shared_ptr<Blob<Dtype> > > extra_;
 };
 
 template <typename Dtype>
@@ -71,14 +75,31 @@ class BasePrefetchingDataLayer :
   static const int PREFETCH_COUNT = 3;
 
  protected:
+  // Transforms the item_id-th item of a batch with the given transformer,
+  // writing it through a blob shaped like transformed_data_.
+  typedef boost::function<void(int, DataTransformer<Dtype>*, Blob<Dtype>*)>
+      TransformFunction;
+
   virtual void InternalThreadEntry();
   virtual void load_batch(Batch<Dtype>* batch) = 0;
+  // Sets up one transformer per transform thread, the first being
+  // data_transformer_, and a pool to run them if there are several.
+  void SetUpTransformThreads(const int transform_threads);
+  // Runs transform on the batch_size items of a batch, on the transform
+  // threads set up for the layer.
+  void TransformBatch(const int batch_size, const TransformFunction& transform);
+  // Runs transform with the transformers of [begin, end), i.e. on items
+  // i, i + transformers_.size(), ... for each i.
+  void TransformItems(const int batch_size, const TransformFunction& transform,
+      const int begin, const int end);
 
   Batch<Dtype> prefetch_[PREFETCH_COUNT];
-  BlockingQueue<Batch<Dtype>*> prefetch_free_;
-  BlockingQueue<Batch<Dtype>*> prefetch_full_;
+  SPSCQueue<Batch<Dtype>*> prefetch_free_;
+  SPSCQueue<Batch<Dtype>*> prefetch_full_;
 
   Blob<Dtype> transformed_data_;
+  vector<shared_ptr<DataTransformer<Dtype> > > transformers_;
+  shared_ptr<ThreadPool> transform_pool_;
 };
 
 }  // namespace caffe
@@ -58,8 +58,11 @@ class ConvolutionLayer : public BaseConvolutionLayer<Dtype> {
    *  first group and input channels 3-4 and output channels 5-8 into the second
    *  group.
    *  - bias_term (\b optional, default true). Whether to have a bias.
-   *  - engine: convolution has CAFFE (matrix multiplication) and CUDNN (library
-   *    kernels + stream parallelism) engines.
+   *  - fuse_relu (\b optional, default false). Whether to apply a ReLU to
+   *  the output, e.g. after NetParameter.fuse_layers folded one in.
+   *  - engine: convolution has CAFFE (matrix multiplication), CUDNN (library
+   *    kernels + stream parallelism), DIRECT (CPU direct convolution) and
+   *    WINOGRAD (CPU Winograd convolution for 3x3 filters) engines.
    */
   explicit ConvolutionLayer(const LayerParameter& param)
       : BaseConvolutionLayer<Dtype>(param) {}
@@ -77,6 +80,18 @@ class ConvolutionLayer : public BaseConvolutionLayer<Dtype> {
       const vector<bool>& propagate_down, const vector<Blob<Dtype>*>& bottom);
   virtual inline bool reverse_dimensions() { return false; }
   virtual void compute_output_shape();
+
+  inline bool fuse_relu() const {
+    return this->layer_param_.convolution_param().fuse_relu();
+  }
+  // Applies the fused ReLU to count outputs.
+  void forward_cpu_relu(Dtype* output, const int count);
+  // Zeroes the diff of the outputs the fused ReLU clipped.
+  void backward_cpu_relu(const Dtype* output, Dtype* diff, const int count);
+#ifndef CPU_ONLY
+  void forward_gpu_relu(Dtype* output, const int count);
+  void backward_gpu_relu(const Dtype* output, Dtype* diff, const int count);
+#endif
 };
 
 }  // namespace caffe
@@ -30,6 +30,11 @@ class DataLayer : public BasePrefetchingDataLayer<Dtype> {
 
  protected:
   virtual void load_batch(Batch<Dtype>* batch);
+  // Transforms the item_id-th datum of the batch into top_data and copies
+  // its label.
+  void TransformItem(const vector<DatumView*>& datums, Dtype* top_data,
+      Dtype* top_label, const int item_id, DataTransformer<Dtype>* transformer,
+      Blob<Dtype>* transformed_data);
 
   DataReader reader_;
 };
@@ -0,0 +1,52 @@
+#ifndef CAFFE_DIRECT_CONV_LAYER_HPP_
+#define CAFFE_DIRECT_CONV_LAYER_HPP_
+
+#include <vector>
+
+#include "caffe/blob.hpp"
+#include "caffe/layer.hpp"
+#include "caffe/proto/caffe.pb.h"
+
+#include "caffe/layers/conv_layer.hpp"
+
+namespace caffe {
+
+/**
+ * @brief CPU implementation of ConvolutionLayer that convolves the input
+ *        directly instead of through im2col, so it never fills the column
+ *        buffer in the forward pass.
+ *
+ * The direct kernel is used for 2D 3x3 stride 1 convolution, depthwise
+ * convolution (group == channels) and 1x1 convolution with stride or
+ * padding; plain 1x1 convolution is a single GEMM on the input blob, as in
+ * ConvolutionLayer. Every other shape, the backward pass and GPU mode fall
+ * back to ConvolutionLayer.
+ *
+ * The innermost loop runs along an output row with a unit input stride in
+ * the 3x3 case, so that the compiler can vectorize it. Output channels of
+ * all images are split across the CPU thread pool.
+ */
+template <typename Dtype>
+class DirectConvolutionLayer : public ConvolutionLayer<Dtype> {
+ public:
+  explicit DirectConvolutionLayer(const LayerParameter& param)
+      : ConvolutionLayer<Dtype>(param) {}
+  virtual void Reshape(const vector<Blob<Dtype>*>& bottom,
+      const vector<Blob<Dtype>*>& top);
+
+ protected:
+  virtual void Forward_cpu(const vector<Blob<Dtype>*>& bottom,
+      const vector<Blob<Dtype>*>& top);
+
+  // Computes output channels [begin, end) of the flattened num_ x num_output_
+  // output planes of top_data.
+  void forward_cpu_direct(const Dtype* bottom_data, Dtype* top_data,
+      const int begin, const int end);
+
+  /// @brief Whether Forward_cpu uses the direct kernel for this shape.
+  bool use_direct_;
+};
+
+}  // namespace caffe
+
+#endif  // CAFFE_DIRECT_CONV_LAYER_HPP_
@@ -1,6 +1,7 @@
 #ifndef CAFFE_DUMMY_DATA_LAYER_HPP_
 #define CAFFE_DUMMY_DATA_LAYER_HPP_
 
+#include <algorithm>
 #include <vector>
 
 #include "caffe/blob.hpp"
@@ -31,6 +32,10 @@ class DummyDataLayer : public Layer<Dtype> {
   virtual inline const char* type() const { return "DummyData"; }
   virtual inline int ExactNumBottomBlobs() const { return 0; }
   virtual inline int MinTopBlobs() const { return 1; }
+  // Only the tops filled by constant fillers are not refilled.
+  virtual inline bool DrawsRandomNumbers() const {
+    return std::find(refill_.begin(), refill_.end(), true) != refill_.end();
+  }
 
  protected:
   virtual void Forward_cpu(const vector<Blob<Dtype>*>& bottom,
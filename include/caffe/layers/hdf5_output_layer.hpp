@@ -7,8 +7,11 @@
 #include <vector>
 
 #include "caffe/blob.hpp"
+#include "caffe/internal_thread.hpp"
 #include "caffe/layer.hpp"
+#include "caffe/layers/base_data_layer.hpp"
 #include "caffe/proto/caffe.pb.h"
+#include "caffe/util/spsc_queue.hpp"
 
 namespace caffe {
 
@@ -18,13 +21,22 @@ namespace caffe {
 /**
  * @brief Write blobs to disk as HDF5 files.
  *
- * TODO(dox): thorough documentation for Forward and proto params.
+ * By default, the data and label bottoms of a single forward pass are
+ * written to the datasets HDF5_DATA_DATASET_NAME and HDF5_DATA_LABEL_NAME.
+ *
+ * With HDF5OutputParameter.append, the bottoms of every forward pass are
+ * appended to extendable, chunked datasets instead. Forward only copies the
+ * bottoms to one of queue_size buffers, which a background thread writes,
+ * so that inference is not held back by the disk unless it keeps falling
+ * behind. The queued batches are written before the file is closed when
+ * the layer is destroyed.
  */
 template <typename Dtype>
-class HDF5OutputLayer : public Layer<Dtype> {
+class HDF5OutputLayer : public Layer<Dtype>, public InternalThread {
  public:
   explicit HDF5OutputLayer(const LayerParameter& param)
-      : Layer<Dtype>(param), file_opened_(false) {}
+      : Layer<Dtype>(param), file_opened_(false), data_dataset_(-1),
+        label_dataset_(-1) {}
   virtual ~HDF5OutputLayer();
   virtual void LayerSetUp(const vector<Blob<Dtype>*>& bottom,
       const vector<Blob<Dtype>*>& top);
@@ -51,12 +63,23 @@ class HDF5OutputLayer : public Layer<Dtype> {
   virtual void Backward_gpu(const vector<Blob<Dtype>*>& top,
       const vector<bool>& propagate_down, const vector<Blob<Dtype>*>& bottom);
   virtual void SaveBlobs();
+  // Writes the queued batches in append mode.
+  virtual void InternalThreadEntry();
+  // Appends a batch to the datasets, creating them on the first batch.
+  void AppendBatch(const Batch<Dtype>& batch);
 
   bool file_opened_;
   std::string file_name_;
   hid_t file_id_;
   Blob<Dtype> data_blob_;
   Blob<Dtype> label_blob_;
+  // In append mode, the buffers of the batches waiting to be written and of
+  // those free to be filled, and the datasets appended to.
+  vector<shared_ptr<Batch<Dtype> > > batches_;
+  shared_ptr<SPSCQueue<Batch<Dtype>*> > free_;
+  shared_ptr<SPSCQueue<Batch<Dtype>*> > full_;
+  hid_t data_dataset_;
+  hid_t label_dataset_;
 };
 
 }  // namespace caffe
@@ -0,0 +1,66 @@
+#ifndef CAFFE_HDF5_STREAM_DATA_LAYER_HPP_
+#define CAFFE_HDF5_STREAM_DATA_LAYER_HPP_
+
+#include "hdf5.h"
+
+#include <string>
+#include <vector>
+
+#include "caffe/blob.hpp"
+#include "caffe/layer.hpp"
+#include "caffe/proto/caffe.pb.h"
+
+#include "caffe/layers/base_data_layer.hpp"
+
+namespace caffe {
+
+/**
+ * @brief Provides data to the Net from HDF5 files, reading them a chunk of
+ *        rows at a time on a prefetch thread.
+ *
+ * This is the HDF5Data layer with HDF5DataParameter.stream set. Unlike
+ * HDF5DataLayer, it never holds more than one chunk of batch_size rows of
+ * each dataset in memory, and it moves on to the next file while the net
+ * trains on the batches already prefetched.
+ */
+template <typename Dtype>
+class HDF5StreamDataLayer : public BasePrefetchingDataLayer<Dtype> {
+ public:
+  explicit HDF5StreamDataLayer(const LayerParameter& param)
+      : BasePrefetchingDataLayer<Dtype>(param), file_id_(-1) {}
+  virtual ~HDF5StreamDataLayer();
+  virtual void DataLayerSetUp(const vector<Blob<Dtype>*>& bottom,
+      const vector<Blob<Dtype>*>& top);
+
+  virtual inline const char* type() const { return "HDF5Data"; }
+  virtual inline int ExactNumBottomBlobs() const { return 0; }
+  virtual inline int MinTopBlobs() const { return 1; }
+
+ protected:
+  virtual void load_batch(Batch<Dtype>* batch);
+  // Opens the next file, shuffling the files again after the last one.
+  virtual void NextFile();
+  // Reads the next chunk of rows of the current file into chunk_.
+  virtual void NextChunk();
+  void CloseFile();
+
+  vector<string> hdf_filenames_;
+  vector<unsigned int> file_permutation_;
+  unsigned int current_file_;
+  // The open file, its datasets, one per top, and its number of rows.
+  hid_t file_id_;
+  vector<hid_t> datasets_;
+  hsize_t file_rows_;
+  // The first rows of the chunks of the current file, in reading order.
+  vector<hsize_t> chunks_;
+  unsigned int next_chunk_;
+  // The rows of the current chunk of each dataset, and the order in which
+  // they are handed out.
+  vector<shared_ptr<Blob<Dtype> > > chunk_;
+  vector<unsigned int> chunk_permutation_;
+  unsigned int chunk_row_;
+};
+
+}  // namespace caffe
+
+#endif  // CAFFE_HDF5_STREAM_DATA_LAYER_HPP_
@@ -14,6 +14,8 @@
 
 namespace caffe {
 
+class ImageCache;
+
 /**
  * @brief Provides data to the Net from image files.
  *
@@ -36,9 +38,16 @@ class ImageDataLayer : public BasePrefetchingDataLayer<Dtype> {
   shared_ptr<Caffe::RNG> prefetch_rng_;
   virtual void ShuffleImages();
   virtual void load_batch(Batch<Dtype>* batch);
+  // Decodes the item_id-th image of the batch and transforms it into
+  // top_data.
+  void LoadItem(const vector<std::pair<std::string, int> >& items,
+      Dtype* top_data, Dtype* top_label, const int item_id,
+      DataTransformer<Dtype>* transformer, Blob<Dtype>* transformed_data);
 
   vector<std::pair<std::string, int> > lines_;
   int lines_id_;
+  // The decoded images, if ImageDataParameter.cache is set.
+  shared_ptr<ImageCache> cache_;
 };
 
 
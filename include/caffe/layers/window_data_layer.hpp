@@ -11,13 +11,22 @@
 #include "caffe/layer.hpp"
 #include "caffe/layers/base_data_layer.hpp"
 #include "caffe/proto/caffe.pb.h"
+#include "caffe/util/thread_pool.hpp"
 
 namespace caffe {
 
+class ImageCache;
+
 /**
  * @brief Provides data to the Net from windows of images files, specified
  *        by a window data file.
  *
+ * The windows of a batch are sampled on the prefetch thread, then read,
+ * cropped and warped on WindowDataParameter.decode_threads threads. With
+ * cache_images, the encoded image files are kept in a cache shared by all
+ * the WindowData layers of the process, e.g. those of the nets of several
+ * solvers, bounded by cache_size_mb.
+ *
  * TODO(dox): thorough documentation for Forward and proto params.
  */
 template <typename Dtype>
@@ -36,6 +45,10 @@ class WindowDataLayer : public BasePrefetchingDataLayer<Dtype> {
  protected:
   virtual unsigned int PrefetchRand();
   virtual void load_batch(Batch<Dtype>* batch);
+  // Reads, crops and warps the sampled windows [begin, end) of the batch.
+  void LoadWindows(const vector<const vector<float>*>& windows,
+      const vector<bool>& mirrors, Dtype* top_data, Dtype* top_label,
+      const int begin, const int end);
 
   shared_ptr<Caffe::RNG> prefetch_rng_;
   vector<std::pair<std::string, vector<int> > > image_database_;
@@ -47,7 +60,9 @@ class WindowDataLayer : public BasePrefetchingDataLayer<Dtype> {
   bool has_mean_file_;
   bool has_mean_values_;
   bool cache_images_;
-  vector<std::pair<std::string, Datum > > image_database_cache_;
+  // The encoded images, if cache_images is set.
+  shared_ptr<ImageCache> cache_;
+  shared_ptr<ThreadPool> decode_pool_;
 };
 
 }  // namespace caffe
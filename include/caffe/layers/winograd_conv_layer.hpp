@@ -0,0 +1,75 @@
+#ifndef CAFFE_WINOGRAD_CONV_LAYER_HPP_
+#define CAFFE_WINOGRAD_CONV_LAYER_HPP_
+
+#include <vector>
+
+#include "caffe/blob.hpp"
+#include "caffe/layer.hpp"
+#include "caffe/proto/caffe.pb.h"
+
+#include "caffe/layers/conv_layer.hpp"
+
+namespace caffe {
+
+/**
+ * @brief CPU implementation of ConvolutionLayer for 3x3 stride 1 filters
+ *        based on the Winograd minimal filtering algorithm F(m x m, 3 x 3)
+ *        of Lavin & Gray, "Fast Algorithms for Convolutional Neural
+ *        Networks" (2015).
+ *
+ * Each input channel is cut into overlapping (m + 2) x (m + 2) tiles that
+ * are transformed to the Winograd domain, where the convolution becomes
+ * (m + 2)^2 independent GEMMs between the transformed filters and tiles.
+ * The transformed filters are computed at Reshape time and cached; they are
+ * only recomputed when the weights were replaced or written through their
+ * mutable accessors since, e.g. after loading a model or a solver update.
+ *
+ * Other filter shapes, the backward pass and GPU mode fall back to
+ * ConvolutionLayer.
+ */
+template <typename Dtype>
+class WinogradConvolutionLayer : public ConvolutionLayer<Dtype> {
+ public:
+  explicit WinogradConvolutionLayer(const LayerParameter& param)
+      : ConvolutionLayer<Dtype>(param) {}
+  virtual void Reshape(const vector<Blob<Dtype>*>& bottom,
+      const vector<Blob<Dtype>*>& top);
+  virtual void AppendWorkspace(bool forward_only, Workspace* workspace);
+
+ protected:
+  virtual void Forward_cpu(const vector<Blob<Dtype>*>& bottom,
+      const vector<Blob<Dtype>*>& top);
+
+  // Fills transformed_weights_ from blobs_[0] and remembers their version.
+  void transform_weights();
+  // Transforms the tiles of input channels [begin, end) of one image.
+  void transform_input(const Dtype* input, Dtype* transformed_input,
+      const int begin, const int end);
+  // Transforms output channels [begin, end) of one image back from the
+  // Winograd domain and adds the bias.
+  void transform_output(const Dtype* transformed_output, const Dtype* bias,
+      Dtype* output, const int begin, const int end);
+
+  /// @brief Whether Forward_cpu uses the Winograd algorithm for this shape.
+  bool use_winograd_;
+  /// @brief The output tile size m and the input tile size m + 2.
+  int tile_size_;
+  int tile_dim_;
+  int tiles_h_;
+  int tiles_w_;
+
+  /// @brief (m + 2)^2 x num_output x (channels / group) filter transforms.
+  Blob<Dtype> transformed_weights_;
+  /// @brief The weight memory transformed_weights_ was computed from, and
+  ///        its version then.
+  shared_ptr<SyncedMemory> transformed_memory_;
+  unsigned int transformed_version_;
+  /// @brief (m + 2)^2 x channels x tiles transforms of one image.
+  Blob<Dtype> transformed_input_;
+  /// @brief (m + 2)^2 x num_output x tiles products for one image.
+  Blob<Dtype> transformed_output_;
+};
+
+}  // namespace caffe
+
+#endif  // CAFFE_WINOGRAD_CONV_LAYER_HPP_
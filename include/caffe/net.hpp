@@ -14,6 +14,8 @@
 
 namespace caffe {
 
+class Workspace;
+
 /**
  * @brief Connects Layer%s together into a directed acyclic graph (DAG)
  *        specified by a NetParameter.
@@ -49,7 +51,9 @@ class Net {
    * networks, note that (1) computing from one layer to another might entail
    * extra computation on unrelated branches, and (2) computation starting in
    * the middle may be incorrect if all of the layers of a fan-in are not
-   * included.
+   * included. With concurrent_layers set, the layers of the range run on the
+   * CPU thread pool as soon as the layers of the range they depend on are
+   * done.
    */
   Dtype ForwardFromTo(int start, int end);
   Dtype ForwardFrom(int start);
@@ -98,10 +102,28 @@ class Net {
    * called manually.
    */
   void ShareWeights();
+  /**
+   * @brief Backs the scratch buffers of all layers by a single Workspace.
+   *
+   * Note: this is called by Net::Init and Net::Reshape when the NetParameter
+   * sets share_workspace, and thus should normally not be called manually.
+   */
+  void ShareWorkspace();
+  /**
+   * @brief Backs activations whose live ranges do not overlap by the same
+   *        memory.
+   *
+   * Note: this is called by Net::Init and Net::Reshape when the NetParameter
+   * sets reuse_activations, and thus should normally not be called manually.
+   */
+  void ShareActivations();
 
   /**
    * @brief For an already initialized net, implicitly copies (i.e., using no
    *        additional memory) the pre-trained layers from another Net.
+   *
+   * Layers folded by NetParameter.fuse_layers get folded copies of the source
+   * blobs instead, which are only updated by sharing again.
    */
   void ShareTrainedLayersWith(const Net* other);
   // For an already initialized net, CopyTrainedLayersFrom() copies the already
@@ -191,6 +213,8 @@ class Net {
     return param_names_index_;
   }
   inline const vector<int>& param_owners() const { return param_owners_; }
+  /// @brief returns the Workspace shared by the layers, or NULL if unshared
+  inline const Workspace* workspace() const { return workspace_.get(); }
   inline const vector<string>& param_display_names() const {
     return param_display_names_;
   }
@@ -241,6 +265,21 @@ class Net {
   void AppendParam(const NetParameter& param, const int layer_id,
                    const int param_id);
 
+  /// @brief Maps each blob to the id of the first blob sharing its data.
+  void FindBlobAliases(vector<int>* blob_alias_ids) const;
+  /// @brief Finds the activations that may share memory, and when they live.
+  void PlanActivations(const NetParameter& param);
+  /// @brief Finds the layers each layer waits for in Forward and Backward.
+  void InitLayerDependencies();
+  /// @brief Whether Forward and Backward run independent layers concurrently.
+  bool RunsLayersConcurrently() const;
+  /// @brief Folds the blobs of the source layers the way Init folded the
+  ///        layers of this net, and copies them into the fused layers.
+  void CopyFoldedLayersFrom(const NetParameter& source);
+  /// @brief Helpers for running one layer of a concurrent pass.
+  void ForwardLayer(const int layer_id, vector<Dtype>* losses);
+  void BackwardLayer(const int layer_id);
+
   /// @brief Helper for displaying debug info in Forward.
   void ForwardDebugInfo(const int layer_id);
   /// @brief Helper for displaying debug info in Backward.
@@ -303,6 +342,28 @@ class Net {
   vector<bool> has_params_decay_;
   /// The bytes of memory used by this net
   size_t memory_used_;
+  /// The scratch memory shared by the layers
+  shared_ptr<Workspace> workspace_;
+  /// The activation backing each blob when reusing activations, or -1 for
+  /// blobs with memory of their own
+  vector<int> blob_activation_ids_;
+  /// The first and last layer using each activation
+  vector<pair<int, int> > activation_live_ranges_;
+  vector<shared_ptr<SyncedMemory> > activation_buffers_;
+  /// Whether layers were folded into the convolutions preceding them
+  bool fuse_layers_;
+  /// The fused convolutions and the layers folded into them, before folding
+  /// and without blobs, and their names
+  NetParameter folded_param_;
+  set<string> folded_layer_names_;
+  /// The source blob data last folded by ShareTrainedLayersWith, and its
+  /// versions then
+  vector<pair<shared_ptr<SyncedMemory>, unsigned int> > folded_source_data_;
+  /// Whether independent layers run concurrently on the CPU thread pool
+  bool concurrent_layers_;
+  /// The layers each layer waits for in Forward and in Backward
+  vector<vector<int> > layer_dependencies_;
+  vector<vector<int> > layer_backward_dependencies_;
   /// Whether to compute and display debug info for the net.
   bool debug_info_;
   /// The root net that actually holds the shared layers in data parallelism
@@ -0,0 +1,64 @@
+#ifndef CAFFE_UTIL_DATUM_VIEW_HPP_
+#define CAFFE_UTIL_DATUM_VIEW_HPP_
+
+#include <string>
+
+#include "caffe/common.hpp"
+#include "caffe/proto/caffe.pb.h"
+
+namespace caffe {
+
+/**
+ * @brief A read-only Datum that refers to its serialized bytes instead of
+ *        copying them, e.g. to the pages a database maps into memory.
+ *
+ * Parsing only decodes the scalar fields and locates the data field, so a
+ * DataTransformer can read the pixels, or decode the image, where they lie.
+ * Datums holding float_data are still read through ToDatum.
+ */
+class DatumView {
+ public:
+  DatumView() { Clear(); }
+
+  /// @brief Parses the serialized Datum in [bytes, bytes + size), which
+  ///        must outlive the view. Returns false if it is malformed.
+  bool Parse(const char* bytes, size_t size);
+  /// @brief Copies the bytes into the view before parsing them, for sources
+  ///        whose buffers do not outlive the view.
+  bool ParseCopy(const char* bytes, size_t size);
+
+  /// @brief Parses the whole serialized Datum into datum.
+  void ToDatum(Datum* datum) const;
+
+  inline int channels() const { return channels_; }
+  inline int height() const { return height_; }
+  inline int width() const { return width_; }
+  inline int label() const { return label_; }
+  inline bool encoded() const { return encoded_; }
+  /// @brief The bytes of the data field, pixels or an encoded image.
+  inline const char* data() const { return data_; }
+  inline size_t data_size() const { return data_size_; }
+  inline int float_data_size() const { return float_data_size_; }
+
+ protected:
+  void Clear();
+
+  const char* bytes_;
+  size_t size_;
+  // Holds the bytes given to ParseCopy.
+  string buffer_;
+  int channels_;
+  int height_;
+  int width_;
+  int label_;
+  bool encoded_;
+  const char* data_;
+  size_t data_size_;
+  int float_data_size_;
+
+DISABLE_COPY_AND_ASSIGN(DatumView);
+};
+
+}  // namespace caffe
+
+#endif  // CAFFE_UTIL_DATUM_VIEW_HPP_
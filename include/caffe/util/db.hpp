@@ -16,9 +16,26 @@ class Cursor {
   virtual ~Cursor() { }
   virtual void SeekToFirst() = 0;
   virtual void Next() = 0;
+  // Moves to the record stored under key, e.g. to read the records in a
+  // shuffled order. valid() is false if there is no such record.
+  virtual void Seek(const string& key) = 0;
   virtual string key() = 0;
   virtual string value() = 0;
+  // Points *data at the bytes of value() without copying them. They stay
+  // valid until the cursor moves, or as long as the cursor lives if
+  // stable_values() is true.
+  virtual void value_view(const char** data, size_t* size) = 0;
+  virtual bool stable_values() { return false; }
   virtual bool valid() = 0;
+  // Returns the number of records, counting them one by one unless the
+  // backend keeps track of it. Counting moves the cursor.
+  virtual size_t size();
+  // Moves to the record-th record in cursor order, stepping there from the
+  // first record unless the backend can seek to it directly.
+  virtual void SeekToRecord(size_t record);
+  // Whether SeekToRecord moves to any record directly, so that records are
+  // better read by position than by key.
+  virtual bool random_access() { return false; }
 
   DISABLE_COPY_AND_ASSIGN(Cursor);
 };
@@ -28,6 +45,11 @@ class Transaction {
   Transaction() { }
   virtual ~Transaction() { }
   virtual void Put(const string& key, const string& value) = 0;
+  // Puts a record whose key sorts after every key of the db, e.g. when
+  // writing records in key order, which some backends store faster.
+  virtual void Append(const string& key, const string& value) {
+    Put(key, value);
+  }
   virtual void Commit() = 0;
 
   DISABLE_COPY_AND_ASSIGN(Transaction);
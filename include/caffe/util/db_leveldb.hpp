@@ -14,16 +14,32 @@ namespace caffe { namespace db {
 class LevelDBCursor : public Cursor {
  public:
   explicit LevelDBCursor(leveldb::Iterator* iter)
-    : iter_(iter) { SeekToFirst(); }
+    : iter_(iter), valid_key_(true) { SeekToFirst(); }
   ~LevelDBCursor() { delete iter_; }
-  virtual void SeekToFirst() { iter_->SeekToFirst(); }
-  virtual void Next() { iter_->Next(); }
+  virtual void SeekToFirst() {
+    iter_->SeekToFirst();
+    valid_key_ = true;
+  }
+  virtual void Next() {
+    iter_->Next();
+    valid_key_ = true;
+  }
+  virtual void Seek(const string& key) {
+    iter_->Seek(key);
+    valid_key_ = iter_->Valid() && iter_->key() == key;
+  }
   virtual string key() { return iter_->key().ToString(); }
   virtual string value() { return iter_->value().ToString(); }
-  virtual bool valid() { return iter_->Valid(); }
+  virtual void value_view(const char** data, size_t* size) {
+    *data = iter_->value().data();
+    *size = iter_->value().size();
+  }
+  virtual bool valid() { return iter_->Valid() && valid_key_; }
 
  private:
   leveldb::Iterator* iter_;
+  // False after seeking to a missing key, which lands on the next one.
+  bool valid_key_;
 };
 
 class LevelDBTransaction : public Transaction {
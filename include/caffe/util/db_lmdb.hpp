@@ -26,6 +26,11 @@ class LMDBCursor : public Cursor {
   }
   virtual void SeekToFirst() { Seek(MDB_FIRST); }
   virtual void Next() { Seek(MDB_NEXT); }
+  virtual void Seek(const string& key) {
+    mdb_key_.mv_data = const_cast<char*>(key.data());
+    mdb_key_.mv_size = key.size();
+    Seek(MDB_SET_KEY);
+  }
   virtual string key() {
     return string(static_cast<const char*>(mdb_key_.mv_data), mdb_key_.mv_size);
   }
@@ -33,7 +38,20 @@ class LMDBCursor : public Cursor {
     return string(static_cast<const char*>(mdb_value_.mv_data),
         mdb_value_.mv_size);
   }
+  virtual void value_view(const char** data, size_t* size) {
+    *data = static_cast<const char*>(mdb_value_.mv_data);
+    *size = mdb_value_.mv_size;
+  }
+  // The pages of a read transaction stay mapped until it ends, and the
+  // cursor keeps its transaction open.
+  virtual bool stable_values() { return true; }
   virtual bool valid() { return valid_; }
+  // The database keeps count of its records.
+  virtual size_t size() {
+    MDB_stat stat;
+    MDB_CHECK(mdb_stat(mdb_txn_, mdb_cursor_dbi(mdb_cursor_), &stat));
+    return stat.ms_entries;
+  }
 
  private:
   void Seek(MDB_cursor_op op) {
@@ -56,10 +74,18 @@ class LMDBTransaction : public Transaction {
  public:
   explicit LMDBTransaction(MDB_dbi* mdb_dbi, MDB_txn* mdb_txn)
     : mdb_dbi_(mdb_dbi), mdb_txn_(mdb_txn) { }
-  virtual void Put(const string& key, const string& value);
+  virtual void Put(const string& key, const string& value) {
+    Put(key, value, 0);
+  }
+  // Appends to the last page instead of searching the tree for the key.
+  virtual void Append(const string& key, const string& value) {
+    Put(key, value, MDB_APPEND);
+  }
   virtual void Commit() { MDB_CHECK(mdb_txn_commit(mdb_txn_)); }
 
  private:
+  void Put(const string& key, const string& value, unsigned int flags);
+
   MDB_dbi* mdb_dbi_;
   MDB_txn* mdb_txn_;
 
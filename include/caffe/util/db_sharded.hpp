@@ -0,0 +1,127 @@
+#ifndef CAFFE_UTIL_DB_SHARDED_HPP
+#define CAFFE_UTIL_DB_SHARDED_HPP
+
+#include <stdint.h>
+
+#include <fstream>  // NOLINT(readability/streams)
+#include <string>
+#include <vector>
+
+#include "caffe/util/db.hpp"
+
+namespace caffe { namespace db {
+
+// The index entry of a record, whose key starts at offset in the records
+// file of its shard and is immediately followed by its value.
+struct ShardedRecord {
+  uint64_t offset;
+  uint32_t key_size;
+  uint32_t value_size;
+};
+
+// The memory-mapped shards of a ShardedDB.
+class ShardedReader;
+
+class ShardedCursor : public Cursor {
+ public:
+  explicit ShardedCursor(const shared_ptr<const ShardedReader>& reader);
+  virtual void SeekToFirst() { SeekToRecord(0); }
+  virtual void Next() { SeekToRecord(record_ + 1); }
+  // Steps through the records from the first one, as they are not stored
+  // in key order; read them by position instead. Keys need not be unique,
+  // e.g. across shards appended by different sessions; Seek moves to the
+  // first record written with the key.
+  virtual void Seek(const string& key);
+  virtual string key() { return string(key_, key_size_); }
+  virtual string value() { return string(value_, value_size_); }
+  virtual void value_view(const char** data, size_t* size) {
+    *data = value_;
+    *size = value_size_;
+  }
+  // The shards stay mapped as long as a cursor over them lives.
+  virtual bool stable_values() { return true; }
+  virtual bool valid() { return record_ < size_; }
+
+  /// @brief Moves to the record-th record written to the database.
+  virtual void SeekToRecord(size_t record);
+  /// @brief Returns the number of records in the database.
+  virtual size_t size() { return size_; }
+  virtual bool random_access() { return true; }
+
+ private:
+  shared_ptr<const ShardedReader> reader_;
+  size_t size_;
+  size_t record_;
+  const char* key_;
+  size_t key_size_;
+  const char* value_;
+  size_t value_size_;
+};
+
+class ShardedDB;
+
+class ShardedTransaction : public Transaction {
+ public:
+  explicit ShardedTransaction(ShardedDB* db) : db_(db) { CHECK_NOTNULL(db_); }
+  virtual void Put(const string& key, const string& value);
+  virtual void Commit();
+
+ private:
+  ShardedDB* db_;
+  // The keys and values put since the last commit, and their index
+  // relative to the start of records_.
+  string records_;
+  vector<ShardedRecord> index_;
+
+  DISABLE_COPY_AND_ASSIGN(ShardedTransaction);
+};
+
+/**
+ * A ShardedDB is a directory of append-only shards. Shard i is made of a
+ * records file, shard_<i>.dat, holding the keys and values, and an index
+ * file, shard_<i>.idx, holding one ShardedRecord per record in the host's
+ * byte order. Both files are memory-mapped for reading, so any number of
+ * processes can read a database, even while it is appended to, and the
+ * fixed-size index finds the n-th record in constant time, e.g. to read the
+ * records in a shuffled order. Readers skip a partly written last index
+ * entry.
+ */
+class ShardedDB : public DB {
+ public:
+  ShardedDB() : mode_(READ), shard_size_(kDefaultShardSize), num_shards_(0),
+      shard_bytes_(0) { }
+  virtual ~ShardedDB() { Close(); }
+  virtual void Open(const string& source, Mode mode);
+  virtual void Close();
+  virtual ShardedCursor* NewCursor();
+  virtual ShardedTransaction* NewTransaction() {
+    return new ShardedTransaction(this);
+  }
+
+  /// @brief Starts a new shard once the current one holds this many bytes
+  ///        of records. A commit is never split across shards.
+  void set_shard_size(uint64_t shard_size) { shard_size_ = shard_size; }
+  /// @brief Returns the number of shards in the database.
+  int num_shards() const { return num_shards_; }
+
+  static const uint64_t kDefaultShardSize = 1ULL << 30;
+
+ protected:
+  friend class ShardedTransaction;
+  // Appends the committed records and their index to the current shard.
+  void Append(const string& records, const vector<ShardedRecord>& index);
+
+  string source_;
+  Mode mode_;
+  uint64_t shard_size_;
+  int num_shards_;
+  // The shard being written, if any, and the bytes of records it holds.
+  std::ofstream records_file_;
+  std::ofstream index_file_;
+  uint64_t shard_bytes_;
+};
+
+}  // namespace db
+}  // namespace caffe
+
+#endif  // CAFFE_UTIL_DB_SHARDED_HPP
@@ -0,0 +1,26 @@
+#ifndef _CAFFE_UTIL_FUSE_LAYERS_HPP_
+#define _CAFFE_UTIL_FUSE_LAYERS_HPP_
+
+#include <string>
+#include <vector>
+
+#include "caffe/proto/caffe.pb.h"
+
+namespace caffe {
+
+// Copy NetParameters with the BatchNorm and Scale layers that directly follow
+// a Convolution folded into its weights and bias, and a directly following
+// ReLU fused into its output (ConvolutionParameter.fuse_relu). The fused
+// Convolution keeps its name and takes the top of the last folded layer.
+// Layers that come with blobs, as in a .caffemodel, get folded blobs; a
+// Convolution is left unfolded if only some of the layers to fold into it
+// have blobs.
+// Returns the number of layers folded away. folded_names, if given, gets the
+// names of the Convolutions whose weights and bias are folded and of the
+// BatchNorm and Scale layers folded into them.
+int FuseLayers(const NetParameter& param, NetParameter* param_fused,
+    std::vector<std::string>* folded_names = NULL);
+
+}  // namespace caffe
+
+#endif  // _CAFFE_UTIL_FUSE_LAYERS_HPP_
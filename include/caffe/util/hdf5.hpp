@@ -2,6 +2,7 @@
 #define CAFFE_UTIL_HDF5_H_
 
 #include <string>
+#include <vector>
 
 #include "hdf5.h"
 #include "hdf5_hl.h"
@@ -10,6 +11,22 @@
 
 namespace caffe {
 
+/**
+ * @brief Holds the process-wide lock on libhdf5 while in scope.
+ *
+ * Stock builds of libhdf5 are not thread-safe, and HDF5 layers use it from
+ * their prefetch and writer threads, so every call into the library must
+ * hold this lock. It is recursive: the hdf5_* helpers below take it too.
+ */
+class HDF5Lock {
+ public:
+  HDF5Lock();
+  ~HDF5Lock();
+
+ private:
+  DISABLE_COPY_AND_ASSIGN(HDF5Lock);
+};
+
 template <typename Dtype>
 void hdf5_load_nd_dataset_helper(
     hid_t file_id, const char* dataset_name_, int min_dim, int max_dim,
@@ -25,6 +42,21 @@ void hdf5_save_nd_dataset(
     const hid_t file_id, const string& dataset_name, const Blob<Dtype>& blob,
     bool write_diff = false);
 
+// The HDF5 memory type of Dtype.
+template <typename Dtype>
+hid_t hdf5_native_type();
+
+// Creates a dataset of 0 rows of row_shape that can be extended to any
+// number of rows, stored in chunks of chunk_rows rows. The chunks are
+// compressed with gzip at gzip_level, 1 to 9, if positive, after the
+// shuffle filter, if shuffle.
+hid_t hdf5_create_extendable_dataset(hid_t file_id,
+    const string& dataset_name, hid_t type, const vector<int>& row_shape,
+    hsize_t chunk_rows, int gzip_level, bool shuffle);
+// Extends an extendable dataset by rows rows, written from data.
+void hdf5_append_rows(hid_t dataset, hid_t type, hsize_t rows,
+    const void* data);
+
 int hdf5_load_int(hid_t loc_id, const string& dataset_name);
 void hdf5_save_int(hid_t loc_id, const string& dataset_name, int i);
 string hdf5_load_string(hid_t loc_id, const string& dataset_name);
@@ -16,6 +16,20 @@ void im2col_cpu(const Dtype* data_im, const int channels,
     const int stride_w, const int dilation_h, const int dilation_w,
     Dtype* data_col);
 
+/**
+ * @brief Unrolls num contiguous images into a single column buffer of
+ *        (channels * kernel_h * kernel_w) rows, where image n owns columns
+ *        [n * output_h * output_w, (n + 1) * output_h * output_w) of each row.
+ *        With num == 1 this is exactly im2col_cpu.
+ */
+template <typename Dtype>
+void im2col_batch_cpu(const Dtype* data_im, const int num,
+    const int channels, const int height, const int width,
+    const int kernel_h, const int kernel_w, const int pad_h, const int pad_w,
+    const int stride_h, const int stride_w,
+    const int dilation_h, const int dilation_w,
+    Dtype* data_col);
+
 template <typename Dtype>
 void col2im_nd_cpu(const Dtype* data_col, const int num_spatial_axes,
     const int* im_shape, const int* col_shape,
@@ -0,0 +1,71 @@
+#ifdef USE_OPENCV
+#ifndef CAFFE_UTIL_IMAGE_CACHE_HPP_
+#define CAFFE_UTIL_IMAGE_CACHE_HPP_
+
+#include <opencv2/core/core.hpp>
+
+#include <list>
+#include <map>
+#include <string>
+#include <utility>
+
+#include "caffe/common.hpp"
+
+namespace caffe {
+
+/**
+ * @brief A memory-bounded cache of decoded images, so that image data layers
+ *        read and decode each file once rather than every epoch.
+ *
+ * Once the pixels of the cached images take more than capacity bytes, the
+ * least recently used images are evicted. A capacity of 0 keeps every image,
+ * e.g. a whole dataset that fits in memory. The cache may be used from
+ * several threads at once. Cached images share their pixels with the cache,
+ * so they must not be modified.
+ */
+class ImageCache {
+ public:
+  explicit ImageCache(size_t capacity);
+
+  /// @brief Points image at the pixels cached under key, if any.
+  bool Get(const string& key, cv::Mat* image);
+  /// @brief Caches image under key, unless it is larger than the capacity.
+  void Put(const string& key, const cv::Mat& image);
+
+  inline size_t capacity() const { return capacity_; }
+  /// @brief The bytes of pixels cached.
+  size_t bytes() const;
+  /// @brief The number of images cached.
+  size_t size() const;
+  /// @brief The number of calls to Get that found their image, or not.
+  size_t hits() const;
+  size_t misses() const;
+
+ protected:
+  /**
+   Move synchronization fields out instead of including boost/thread.hpp
+   to avoid a boost/NVCC issues (#1009, #1010) on OSX. Also fails on
+   Linux CUDA 7.0.18.
+   */
+  class sync;
+  // The cached images, most recently used first.
+  typedef std::list<std::pair<string, cv::Mat> > ImageList;
+
+  // Drops least recently used images until the cache fits its capacity.
+  void Evict();
+
+  const size_t capacity_;
+  size_t bytes_;
+  size_t hits_;
+  size_t misses_;
+  ImageList images_;
+  std::map<string, ImageList::iterator> index_;
+  shared_ptr<sync> sync_;
+
+DISABLE_COPY_AND_ASSIGN(ImageCache);
+};
+
+}  // namespace caffe
+
+#endif  // CAFFE_UTIL_IMAGE_CACHE_HPP_
+#endif  // USE_OPENCV
@@ -10,6 +10,7 @@
 
 #include "caffe/common.hpp"
 #include "caffe/proto/caffe.pb.h"
+#include "caffe/util/datum_view.hpp"
 #include "caffe/util/format.hpp"
 
 #ifndef CAFFE_TMP_DIR_RETRIES
@@ -143,6 +144,19 @@ cv::Mat ReadImageToCVMat(const string& filename);
 
 cv::Mat DecodeDatumToCVMatNative(const Datum& datum);
 cv::Mat DecodeDatumToCVMat(const Datum& datum, bool is_color);
+cv::Mat DecodeDatumToCVMatNative(const DatumView& datum);
+cv::Mat DecodeDatumToCVMat(const DatumView& datum, bool is_color);
+
+// Decode and resize to height x width. JPEG images are decoded at a reduced
+// size when it still covers height x width, as ReadImageToCVMat does.
+cv::Mat DecodeDatumToCVMatNative(const Datum& datum, const int height,
+    const int width);
+cv::Mat DecodeDatumToCVMat(const Datum& datum, const int height,
+    const int width, bool is_color);
+cv::Mat DecodeDatumToCVMatNative(const DatumView& datum, const int height,
+    const int width);
+cv::Mat DecodeDatumToCVMat(const DatumView& datum, const int height,
+    const int width, bool is_color);
 
 void CVMatToDatum(const cv::Mat& cv_img, Datum* datum);
 #endif  // USE_OPENCV
@@ -0,0 +1,62 @@
+#ifndef CAFFE_UTIL_SPSC_QUEUE_HPP_
+#define CAFFE_UTIL_SPSC_QUEUE_HPP_
+
+#include <string>
+#include <vector>
+
+#include "caffe/common.hpp"
+
+namespace caffe {
+
+/**
+ * @brief A bounded queue between one producer and one consumer thread.
+ *
+ * Items move through a ring buffer whose indices are atomics, so neither
+ * side takes a lock while the queue is neither empty nor full. A side that
+ * has to wait spins for a while, adapting how long to how often spinning
+ * paid off, then blocks on a condition variable, which keeps it an
+ * interruption point for InternalThread.
+ *
+ * push is called from the producer thread only, and the other methods,
+ * except size, from the consumer thread only. Handing either role to
+ * another thread needs a happens-before edge, e.g. a lock or starting it.
+ */
+template<typename T>
+class SPSCQueue {
+ public:
+  explicit SPSCQueue(const int capacity);
+
+  // Waits while the queue is full.
+  void push(const T& t);
+
+  bool try_pop(T* t);
+
+  // This logs a message if the threads needs to be blocked
+  // useful for detecting e.g. when data feeding is too slow
+  T pop(const string& log_on_wait = "");
+
+  bool try_peek(T* t);
+
+  // Return element without removing it
+  T peek();
+
+  size_t size() const;
+
+  inline int capacity() const { return buffer_.size(); }
+
+ protected:
+  /**
+   Move synchronization fields out instead of including boost/thread.hpp
+   and boost/atomic.hpp to avoid boost/NVCC issues (#1009, #1010).
+   */
+  class sync;
+
+  vector<T> buffer_;
+  shared_ptr<sync> sync_;
+
+DISABLE_COPY_AND_ASSIGN(SPSCQueue);
+};
+
+}  // namespace caffe
+
+#endif  // CAFFE_UTIL_SPSC_QUEUE_HPP_
@@ -0,0 +1,71 @@
+#ifndef CAFFE_UTIL_THREAD_POOL_HPP_
+#define CAFFE_UTIL_THREAD_POOL_HPP_
+
+#include <boost/function.hpp>
+
+#include "caffe/common.hpp"
+
+namespace caffe {
+
+/**
+ * @brief A fixed-size pool of worker threads used for intra-op parallelism
+ *        on the CPU.
+ *
+ * ParallelFor splits [0, n) into contiguous ranges and runs the given
+ * function on each of them. The calling thread works on its own ranges
+ * too, always including the first one, so a pool of num_threads - 1
+ * workers keeps num_threads cores busy, and nested or concurrent calls
+ * (e.g. from several solver threads) cannot deadlock the pool.
+ */
+class ThreadPool {
+ public:
+  // Called with a [begin, end) range of the iteration space.
+  typedef boost::function<void(int, int)> RangeFunction;
+
+  explicit ThreadPool(const int num_threads);
+  ~ThreadPool();
+
+  /// @brief The number of threads, including the calling one, sharing work.
+  inline int num_threads() const { return num_threads_; }
+
+  /**
+   * @brief Runs fn over [0, n), handing each thread at least grain
+   *        iterations. Returns once every range has been processed.
+   */
+  void ParallelFor(const int n, const int grain, const RangeFunction& fn);
+
+ protected:
+  /**
+   Move synchronization fields out instead of including boost/thread.hpp
+   to avoid a boost/NVCC issues (#1009, #1010) on OSX. Also fails on
+   Linux CUDA 7.0.18.
+   */
+  class sync;
+  struct Job;
+
+  void WorkerEntry();
+  // Runs the first range and the unclaimed ones of job on the calling
+  // thread.
+  void RunJob(Job* job);
+
+  const int num_threads_;
+  shared_ptr<sync> sync_;
+
+DISABLE_COPY_AND_ASSIGN(ThreadPool);
+};
+
+// Element-wise loops shorter than this run on the calling thread, since
+// waking the pool would cost more than the loop itself.
+const int kCPUParallelGrain = 32768;
+
+/**
+ * @brief Runs fn over [0, n) on the pool configured with
+ *        Caffe::set_cpu_threads, or directly on the calling thread when the
+ *        pool is disabled or n is below grain.
+ */
+void caffe_cpu_parallel_for(const int n, const ThreadPool::RangeFunction& fn,
+    const int grain = kCPUParallelGrain);
+
+}  // namespace caffe
+
+#endif  // CAFFE_UTIL_THREAD_POOL_HPP_
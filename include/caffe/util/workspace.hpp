@@ -0,0 +1,72 @@
+#ifndef CAFFE_UTIL_WORKSPACE_HPP_
+#define CAFFE_UTIL_WORKSPACE_HPP_
+
+#include <boost/bind.hpp>
+#include <boost/function.hpp>
+#include <vector>
+
+#include "caffe/blob.hpp"
+#include "caffe/common.hpp"
+#include "caffe/syncedmem.hpp"
+
+namespace caffe {
+
+/**
+ * @brief Pools the scratch buffers of the layers of a Net.
+ *
+ * The layers of a Net run one after another, so whatever a layer only needs
+ * while it runs (im2col columns, transformed tiles, ...) is dead by the time
+ * the next layer starts. Layers register such Blob%s through
+ * Layer::AppendWorkspace; the i-th largest buffer of every layer is then
+ * backed by the same SyncedMemory slot, sized for the largest of them. The
+ * memory held becomes the largest per-layer workspace rather than the sum of
+ * all of them.
+ */
+class Workspace {
+ public:
+  Workspace() : unshared_bytes_(0) {}
+
+  /// @brief Starts the list of buffers of the next layer.
+  void BeginLayer() { layers_.push_back(vector<Buffer>()); }
+
+  /// @brief Registers a scratch Blob of the current layer.
+  template <typename T>
+  void Add(Blob<T>* blob) {
+    CHECK(!layers_.empty()) << "Call BeginLayer before Add.";
+    if (blob->count() == 0) { return; }
+    Buffer buffer;
+    buffer.bytes = blob->count() * sizeof(T);
+    buffer.share = boost::bind(&Blob<T>::ShareWorkspace, blob, _1);
+    layers_.back().push_back(buffer);
+  }
+
+  /**
+   * @brief Backs every Blob registered since the last call by its slot, and
+   *        clears the registrations. Slots only grow, so calling this again
+   *        after a Reshape reallocates just the slots that became too small.
+   */
+  void Share();
+
+  /// @brief The bytes the registered Blob%s would take on their own.
+  inline size_t unshared_bytes() const { return unshared_bytes_; }
+  /// @brief The bytes of the slots backing them.
+  size_t shared_bytes() const;
+
+ protected:
+  struct Buffer {
+    size_t bytes;
+    boost::function<void(const shared_ptr<SyncedMemory>&)> share;
+    // Sorts larger buffers first.
+    bool operator<(const Buffer& other) const { return bytes > other.bytes; }
+  };
+
+  vector<vector<Buffer> > layers_;
+  vector<shared_ptr<SyncedMemory> > slots_;
+  size_t unshared_bytes_;
+
+DISABLE_COPY_AND_ASSIGN(Workspace);
+};
+
+}  // namespace caffe
+
+#endif  // CAFFE_UTIL_WORKSPACE_HPP_
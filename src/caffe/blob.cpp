@@ -144,6 +144,14 @@ void Blob<Dtype>::ShareDiff(const Blob& other) {
   diff_ = other.diff();
 }
 
+template <typename Dtype>
+void Blob<Dtype>::ShareWorkspace(const shared_ptr<SyncedMemory>& workspace) {
+  CHECK_GE(workspace->size(), count_ * sizeof(Dtype));
+  capacity_ = workspace->size() / sizeof(Dtype);
+  data_ = workspace;
+  diff_.reset(new SyncedMemory(capacity_ * sizeof(Dtype)));
+}
+
 // The "update" method is used for parameter blobs in a Net, which are stored
 // as Blob<float> or Blob<double> -- hence we do not define it for
 // Blob<int> or Blob<unsigned int>.
@@ -6,6 +6,7 @@
 
 #include "caffe/common.hpp"
 #include "caffe/util/rng.hpp"
+#include "caffe/util/thread_pool.hpp"
 
 //port for Win32
 #ifdef _MSC_VER
@@ -58,6 +59,34 @@ void GlobalInit(int* pargc, char*** pargv) {
 #endif
 }
 
+// The CPU thread pool is process-wide rather than thread local, so that all
+// solver threads share the same cores instead of oversubscribing them.
+static boost::mutex cpu_thread_pool_mutex_;
+static shared_ptr<ThreadPool> cpu_thread_pool_;
+
+void Caffe::set_cpu_threads(const int num_threads) {
+  CHECK_GE(num_threads, 1) << "At least one CPU thread is required.";
+  boost::mutex::scoped_lock lock(cpu_thread_pool_mutex_);
+  if (cpu_thread_pool_ && cpu_thread_pool_->num_threads() == num_threads) {
+    return;
+  }
+  // Calls still running on the old pool keep it alive until they finish.
+  cpu_thread_pool_.reset();
+  if (num_threads > 1) {
+    cpu_thread_pool_.reset(new ThreadPool(num_threads));
+  }
+}
+
+int Caffe::cpu_threads() {
+  boost::mutex::scoped_lock lock(cpu_thread_pool_mutex_);
+  return cpu_thread_pool_ ? cpu_thread_pool_->num_threads() : 1;
+}
+
+shared_ptr<ThreadPool> Caffe::cpu_thread_pool() {
+  boost::mutex::scoped_lock lock(cpu_thread_pool_mutex_);
+  return cpu_thread_pool_;
+}
+
 #ifdef CPU_ONLY  // CPU-only Caffe.
 
 Caffe::Caffe()
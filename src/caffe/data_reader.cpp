@@ -1,12 +1,15 @@
 #include <boost/thread.hpp>
+#include <algorithm>
 #include <map>
 #include <string>
+#include <utility>
 #include <vector>
 
 #include "caffe/common.hpp"
 #include "caffe/data_reader.hpp"
 #include "caffe/layers/data_layer.hpp"
 #include "caffe/proto/caffe.pb.h"
+#include "caffe/util/rng.hpp"
 
 namespace caffe {
 
@@ -41,15 +44,16 @@ DataReader::~DataReader() {
 
 //
 
-DataReader::QueuePair::QueuePair(int size) {
+DataReader::QueuePair::QueuePair(int size)
+    : free_(size), full_(size) {
   // Initialize the free queue with requested number of datums
   for (int i = 0; i < size; ++i) {
-    free_.push(new Datum());
+    free_.push(new DatumView());
   }
 }
 
 DataReader::QueuePair::~QueuePair() {
-  Datum* datum;
+  DatumView* datum;
   while (free_.try_pop(&datum)) {
     delete datum;
   }
@@ -62,7 +66,13 @@ DataReader::QueuePair::~QueuePair() {
 
 DataReader::Body::Body(const LayerParameter& param)
     : param_(param),
-      new_queue_pairs_() {
+      shard_begin_(0),
+      shard_end_(0),
+      record_(0),
+      new_queue_pairs_(),
+      shuffle_(param.data_param().shuffle()),
+      next_shuffled_(0),
+      next_value_(0) {
   StartInternalThread();
 }
 
@@ -75,6 +85,42 @@ void DataReader::Body::InternalThreadEntry() {
   db->Open(param_.data_param().source(), db::READ);
   shared_ptr<db::Cursor> cursor(db->NewCursor());
   vector<shared_ptr<QueuePair> > qps;
+  const int shard_count = param_.data_param().shard_count();
+  const int shard_index = param_.data_param().shard_index();
+  CHECK_GT(shard_count, 0);
+  CHECK_LT(shard_index, shard_count);
+  if (shard_count > 1) {
+    const size_t size = cursor->size();
+    CHECK_GE(size, static_cast<size_t>(shard_count))
+        << "Fewer records than shards.";
+    shard_begin_ = size * shard_index / shard_count;
+    shard_end_ = size * (shard_index + 1) / shard_count;
+    LOG(INFO) << "Reading records " << shard_begin_ << " to " << shard_end_
+        << " of " << size << ", shard " << shard_index << " of "
+        << shard_count << ".";
+    cursor->SeekToRecord(shard_begin_);
+    record_ = shard_begin_;
+  }
+  if (shuffle_) {
+    CHECK_GT(param_.data_param().read_ahead(), 0);
+    if (cursor->random_access()) {
+      const size_t end = shard_count > 1 ? shard_end_ : cursor->size();
+      for (size_t i = shard_begin_; i < end; ++i) {
+        records_.push_back(i);
+      }
+    } else {
+      // The cursor starts at the first record of the shard.
+      for (size_t i = shard_begin_; cursor->valid() &&
+          (shard_count == 1 || i < shard_end_); cursor->Next(), ++i) {
+        keys_.push_back(cursor->key());
+      }
+    }
+    const size_t count = records_.size() + keys_.size();
+    CHECK_GT(count, 0) << "The database is empty.";
+    LOG(INFO) << "Shuffling " << count << " records every epoch.";
+    // The first epoch is shuffled too.
+    next_shuffled_ = count;
+  }
   try {
     int solver_count = param_.phase() == TRAIN ? Caffe::solver_count() : 1;
 
@@ -103,17 +149,106 @@ void DataReader::Body::InternalThreadEntry() {
 }
 
 void DataReader::Body::read_one(db::Cursor* cursor, QueuePair* qp) {
-  Datum* datum = qp->free_.pop();
-  // TODO deserialize in-place instead of copy?
-  datum->ParseFromString(cursor->value());
+  DatumView* datum = qp->free_.pop();
+  const char* data;
+  size_t size;
+  if (!shuffle_) {
+    cursor->value_view(&data, &size);
+  } else {
+    if (next_value_ == window_.size()) {
+      read_ahead(cursor);
+    }
+    data = window_[next_value_].first;
+    size = window_[next_value_].second;
+    ++next_value_;
+  }
+  // Values in window_copies_ only last until the next read ahead, so they
+  // are copied again like the values of the cursor itself.
+  if (cursor->stable_values()) {
+    CHECK(datum->Parse(data, size)) << "Could not parse datum";
+  } else {
+    CHECK(datum->ParseCopy(data, size)) << "Could not parse datum";
+  }
   qp->full_.push(datum);
 
-  // go to the next iter
-  cursor->Next();
-  if (!cursor->valid()) {
-    DLOG(INFO) << "Restarting data prefetching from start.";
-    cursor->SeekToFirst();
+  if (!shuffle_) {
+    // go to the next iter
+    cursor->Next();
+    ++record_;
+    if (!cursor->valid() || record_ == shard_end_) {
+      DLOG(INFO) << "Restarting data prefetching from start.";
+      if (shard_begin_ > 0) {
+        cursor->SeekToRecord(shard_begin_);
+      } else {
+        cursor->SeekToFirst();
+      }
+      record_ = shard_begin_;
+    }
+  }
+}
+
+namespace {
+
+// Orders indices into a range of record positions or keys by the values
+// they index.
+template <typename T>
+class IndexOrder {
+ public:
+  explicit IndexOrder(const T* values) : values_(values) {}
+  bool operator()(int a, int b) const { return values_[a] < values_[b]; }
+
+ private:
+  const T* values_;
+};
+
+}  // namespace
+
+void DataReader::Body::read_ahead(db::Cursor* cursor) {
+  const bool by_position = !records_.empty();
+  const size_t num_records = by_position ? records_.size() : keys_.size();
+  if (next_shuffled_ == num_records) {
+    DLOG(INFO) << "Shuffling data for a new epoch.";
+    if (by_position) {
+      shuffle(records_.begin(), records_.end());
+    } else {
+      shuffle(keys_.begin(), keys_.end());
+    }
+    next_shuffled_ = 0;
+  }
+  const int count = std::min<size_t>(param_.data_param().read_ahead(),
+      num_records - next_shuffled_);
+  vector<int> order(count);
+  for (int i = 0; i < count; ++i) {
+    order[i] = i;
+  }
+  if (by_position) {
+    std::sort(order.begin(), order.end(),
+        IndexOrder<size_t>(&records_[next_shuffled_]));
+  } else {
+    std::sort(order.begin(), order.end(),
+        IndexOrder<string>(&keys_[next_shuffled_]));
+  }
+  window_.resize(count);
+  window_copies_.resize(cursor->stable_values() ? 0 : count);
+  for (int i = 0; i < count; ++i) {
+    const int j = order[i];
+    if (by_position) {
+      cursor->SeekToRecord(records_[next_shuffled_ + j]);
+      CHECK(cursor->valid()) << "Could not find record "
+          << records_[next_shuffled_ + j];
+    } else {
+      cursor->Seek(keys_[next_shuffled_ + j]);
+      CHECK(cursor->valid()) << "Could not find record "
+          << keys_[next_shuffled_ + j];
+    }
+    cursor->value_view(&window_[j].first, &window_[j].second);
+    if (!cursor->stable_values()) {
+      window_copies_[j].assign(window_[j].first, window_[j].second);
+      window_[j].first = window_copies_[j].data();
+    }
   }
+  next_shuffled_ += count;
+  next_value_ = 0;
 }
 
 }  // namespace caffe
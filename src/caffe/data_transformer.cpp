@@ -12,6 +12,83 @@
 
 namespace caffe {
 
+// Writes (src[w] - mean) * scale for the width values of a row into dst, in
+// reverse order if Mirror. The loop has no branches, so that the compiler
+// can vectorize it.
+template <bool Mirror, typename Src, typename Dtype>
+static inline void TransformRow(const Src* src, const Dtype mean,
+    const Dtype scale, const int width, Dtype* dst) {
+  if (Mirror) {
+    dst += width - 1;
+    for (int w = 0; w < width; ++w) {
+      dst[-w] = (static_cast<Dtype>(src[w]) - mean) * scale;
+    }
+  } else {
+    for (int w = 0; w < width; ++w) {
+      dst[w] = (static_cast<Dtype>(src[w]) - mean) * scale;
+    }
+  }
+}
+
+// Likewise, subtracting the values of a row of the mean image.
+template <bool Mirror, typename Src, typename Dtype>
+static inline void TransformRow(const Src* src, const Dtype* mean,
+    const Dtype scale, const int width, Dtype* dst) {
+  if (Mirror) {
+    dst += width - 1;
+    for (int w = 0; w < width; ++w) {
+      dst[-w] = (static_cast<Dtype>(src[w]) - mean[w]) * scale;
+    }
+  } else {
+    for (int w = 0; w < width; ++w) {
+      dst[w] = (static_cast<Dtype>(src[w]) - mean[w]) * scale;
+    }
+  }
+}
+
+// Crops the height x width window at (h_off, w_off) out of the channels of
+// src, subtracts the mean image, if any, or else the mean values, if any,
+// and scales the result into dst, mirroring it if Mirror. Instantiated for
+// each source type and mirroring so that the rows run without branches.
+template <bool Mirror, typename Src, typename Dtype>
+static void TransformChannels(const Src* src, const int channels,
+    const int src_height, const int src_width, const int h_off,
+    const int w_off, const int height, const int width, const Dtype* mean,
+    const Dtype* mean_values, const Dtype* scales, Dtype* dst) {
+  for (int c = 0; c < channels; ++c) {
+    for (int h = 0; h < height; ++h) {
+      const int src_index = (c * src_height + h_off + h) * src_width + w_off;
+      Dtype* dst_row = dst + (c * height + h) * width;
+      if (mean) {
+        TransformRow<Mirror>(src + src_index, mean + src_index, scales[c],
+            width, dst_row);
+      } else {
+        TransformRow<Mirror>(src + src_index,
+            mean_values ? mean_values[c] : Dtype(0), scales[c], width,
+            dst_row);
+      }
+    }
+  }
+}
+
+#ifdef USE_OPENCV
+// Decodes an encoded Datum or DatumView, resizing it to new_height x
+// new_width if set.
+template <typename DatumT>
+static cv::Mat DecodeDatum(const TransformationParameter& param,
+    const DatumT& datum) {
+  CHECK(!(param.force_color() && param.force_gray()))
+      << "cannot set both force_color and force_gray";
+  // If force_color then decode in color otherwise decode in gray.
+  if (param.force_color() || param.force_gray()) {
+    return DecodeDatumToCVMat(datum, param.new_height(), param.new_width(),
+        param.force_color());
+  }
+  return DecodeDatumToCVMatNative(datum, param.new_height(),
+      param.new_width());
+}
+#endif  // USE_OPENCV
+
 template<typename Dtype>
 DataTransformer<Dtype>::DataTransformer(const TransformationParameter& param,
     Phase phase)
@@ -36,26 +113,52 @@ DataTransformer<Dtype>::DataTransformer(const TransformationParameter& param,
       mean_values_.push_back(param_.mean_value(c));
     }
   }
+  for (int c = 0; c < param_.std_value_size(); ++c) {
+    CHECK_GT(param_.std_value(c), 0) << "std_value must be positive";
+    std_values_.push_back(param_.std_value(c));
+  }
+  CHECK((param_.new_height() > 0) == (param_.new_width() > 0))
+      << "Current implementation requires new_height and new_width to be set"
+      << " at the same time.";
+}
+
+template<typename Dtype>
+void DataTransformer<Dtype>::ChannelScales(const int channels,
+    vector<Dtype>* scales) {
+  scales->assign(channels, param_.scale());
+  if (std_values_.size() > 0) {
+    CHECK(std_values_.size() == 1 || std_values_.size() == channels) <<
+     "Specify either 1 std_value or as many as channels: " << channels;
+    for (int c = 0; c < channels; ++c) {
+      (*scales)[c] /= std_values_[std_values_.size() == 1 ? 0 : c];
+    }
+  }
 }
 
 template<typename Dtype>
 void DataTransformer<Dtype>::Transform(const Datum& datum,
                                        Dtype* transformed_data) {
   const string& data = datum.data();
-  const int datum_channels = datum.channels();
-  const int datum_height = datum.height();
-  const int datum_width = datum.width();
+  TransformValues(data.size() > 0 ? data.data() : NULL,
+      datum.float_data().data(), datum.channels(), datum.height(),
+      datum.width(), transformed_data);
+}
 
+template<typename Dtype>
+void DataTransformer<Dtype>::TransformValues(const char* bytes,
+    const float* floats, const int datum_channels, const int datum_height,
+    const int datum_width, Dtype* transformed_data) {
   const int crop_size = param_.crop_size();
-  const Dtype scale = param_.scale();
   const bool do_mirror = param_.mirror() && Rand(2);
   const bool has_mean_file = param_.has_mean_file();
-  const bool has_uint8 = data.size() > 0;
+  const bool has_uint8 = bytes != NULL;
   const bool has_mean_values = mean_values_.size() > 0;
 
   CHECK_GT(datum_channels, 0);
   CHECK_GE(datum_height, crop_size);
   CHECK_GE(datum_width, crop_size);
+  vector<Dtype> scales;
+  ChannelScales(datum_channels, &scales);
 
   Dtype* mean = NULL;
   if (has_mean_file) {
@@ -93,36 +196,24 @@ void DataTransformer<Dtype>::Transform(const Datum& datum,
     }
   }
 
-  Dtype datum_element;
-  int top_index, data_index;
-  for (int c = 0; c < datum_channels; ++c) {
-    for (int h = 0; h < height; ++h) {
-      for (int w = 0; w < width; ++w) {
-        data_index = (c * datum_height + h_off + h) * datum_width + w_off + w;
-        if (do_mirror) {
-          top_index = (c * height + h) * width + (width - 1 - w);
-        } else {
-          top_index = (c * height + h) * width + w;
-        }
-        if (has_uint8) {
-          datum_element =
-            static_cast<Dtype>(static_cast<uint8_t>(data[data_index]));
-        } else {
-          datum_element = datum.float_data(data_index);
-        }
-        if (has_mean_file) {
-          transformed_data[top_index] =
-            (datum_element - mean[data_index]) * scale;
-        } else {
-          if (has_mean_values) {
-            transformed_data[top_index] =
-              (datum_element - mean_values_[c]) * scale;
-          } else {
-            transformed_data[top_index] = datum_element * scale;
-          }
-        }
-      }
-    }
+  const Dtype* mean_values = has_mean_values ? &mean_values_[0] : NULL;
+  const uint8_t* uint8s = reinterpret_cast<const uint8_t*>(bytes);
+  if (has_uint8 && do_mirror) {
+    TransformChannels<true>(uint8s, datum_channels, datum_height, datum_width,
+        h_off, w_off, height, width, mean, mean_values, &scales[0],
+        transformed_data);
+  } else if (has_uint8) {
+    TransformChannels<false>(uint8s, datum_channels, datum_height,
+        datum_width, h_off, w_off, height, width, mean, mean_values,
+        &scales[0], transformed_data);
+  } else if (do_mirror) {
+    TransformChannels<true>(floats, datum_channels, datum_height, datum_width,
+        h_off, w_off, height, width, mean, mean_values, &scales[0],
+        transformed_data);
+  } else {
+    TransformChannels<false>(floats, datum_channels, datum_height,
+        datum_width, h_off, w_off, height, width, mean, mean_values,
+        &scales[0], transformed_data);
   }
 }
 
@@ -133,15 +224,7 @@ void DataTransformer<Dtype>::Transform(const Datum& datum,
   // If datum is encoded, decoded and transform the cv::image.
   if (datum.encoded()) {
 #ifdef USE_OPENCV
-    CHECK(!(param_.force_color() && param_.force_gray()))
-        << "cannot set both force_color and force_gray";
-    cv::Mat cv_img;
-    if (param_.force_color() || param_.force_gray()) {
-    // If force_color then decode in color otherwise decode in gray.
-      cv_img = DecodeDatumToCVMat(datum, param_.force_color());
-    } else {
-      cv_img = DecodeDatumToCVMatNative(datum);
-    }
+    const cv::Mat cv_img = DecodeDatum(param_, datum);
     // Transform the cv::image into blob.
     return Transform(cv_img, transformed_blob);
 #else
@@ -151,12 +234,51 @@ void DataTransformer<Dtype>::Transform(const Datum& datum,
     if (param_.force_color() || param_.force_gray()) {
       LOG(ERROR) << "force_color and force_gray only for encoded datum";
     }
+    if (param_.new_height() > 0) {
+      LOG(ERROR) << "new_height and new_width only for encoded datum";
+    }
   }
 
+  CheckTransformedShape(datum.channels(), datum.height(), datum.width(),
+      transformed_blob);
+  Dtype* transformed_data = transformed_blob->mutable_cpu_data();
+  Transform(datum, transformed_data);
+}
+
+template<typename Dtype>
+void DataTransformer<Dtype>::Transform(const DatumView& datum,
+                                       Blob<Dtype>* transformed_blob) {
+  if (datum.encoded()) {
+#ifdef USE_OPENCV
+    const cv::Mat cv_img = DecodeDatum(param_, datum);
+    return Transform(cv_img, transformed_blob);
+#else
+    LOG(FATAL) << "Encoded datum requires OpenCV; compile with USE_OPENCV.";
+#endif  // USE_OPENCV
+  }
+  if (datum.data_size() == 0 && datum.float_data_size() > 0) {
+    // Float data may not be aligned in the serialized bytes.
+    Datum float_datum;
+    datum.ToDatum(&float_datum);
+    return Transform(float_datum, transformed_blob);
+  }
+  if (param_.force_color() || param_.force_gray()) {
+    LOG(ERROR) << "force_color and force_gray only for encoded datum";
+  }
+  if (param_.new_height() > 0) {
+    LOG(ERROR) << "new_height and new_width only for encoded datum";
+  }
+  CheckTransformedShape(datum.channels(), datum.height(), datum.width(),
+      transformed_blob);
+  TransformValues(datum.data(), NULL, datum.channels(), datum.height(),
+      datum.width(), transformed_blob->mutable_cpu_data());
+}
+
+template<typename Dtype>
+void DataTransformer<Dtype>::CheckTransformedShape(const int datum_channels,
+    const int datum_height, const int datum_width,
+    const Blob<Dtype>* transformed_blob) {
   const int crop_size = param_.crop_size();
-  const int datum_channels = datum.channels();
-  const int datum_height = datum.height();
-  const int datum_width = datum.width();
 
   // Check dimensions.
   const int channels = transformed_blob->channels();
@@ -176,9 +298,6 @@ void DataTransformer<Dtype>::Transform(const Datum& datum,
     CHECK_EQ(datum_height, height);
     CHECK_EQ(datum_width, width);
   }
-
-  Dtype* transformed_data = transformed_blob->mutable_cpu_data();
-  Transform(datum, transformed_data);
 }
 
 template<typename Dtype>
@@ -243,7 +362,6 @@ void DataTransformer<Dtype>::Transform(const cv::Mat& cv_img,
 
   CHECK(cv_img.depth() == CV_8U) << "Image data type must be unsigned byte";
 
-  const Dtype scale = param_.scale();
   const bool do_mirror = param_.mirror() && Rand(2);
   const bool has_mean_file = param_.has_mean_file();
   const bool has_mean_values = mean_values_.size() > 0;
@@ -251,6 +369,8 @@ void DataTransformer<Dtype>::Transform(const cv::Mat& cv_img,
   CHECK_GT(img_channels, 0);
   CHECK_GE(img_height, crop_size);
   CHECK_GE(img_width, crop_size);
+  vector<Dtype> scales;
+  ChannelScales(img_channels, &scales);
 
   Dtype* mean = NULL;
   if (has_mean_file) {
@@ -310,13 +430,13 @@ void DataTransformer<Dtype>::Transform(const cv::Mat& cv_img,
         if (has_mean_file) {
           int mean_index = (c * img_height + h_off + h) * img_width + w_off + w;
           transformed_data[top_index] =
-            (pixel - mean[mean_index]) * scale;
+            (pixel - mean[mean_index]) * scales[c];
         } else {
           if (has_mean_values) {
             transformed_data[top_index] =
-              (pixel - mean_values_[c]) * scale;
+              (pixel - mean_values_[c]) * scales[c];
           } else {
-            transformed_data[top_index] = pixel * scale;
+            transformed_data[top_index] = pixel * scales[c];
           }
         }
       }
@@ -432,7 +552,16 @@ void DataTransformer<Dtype>::Transform(Blob<Dtype>* input_blob,
       }
     }
   }
-  if (scale != Dtype(1)) {
+  if (std_values_.size() > 0) {
+    vector<Dtype> scales;
+    ChannelScales(channels, &scales);
+    for (int n = 0; n < input_num; ++n) {
+      for (int c = 0; c < channels; ++c) {
+        caffe_scal(height * width, scales[c],
+            transformed_data + transformed_blob->offset(n, c));
+      }
+    }
+  } else if (scale != Dtype(1)) {
     DLOG(INFO) << "Scale: " << scale;
     caffe_scal(size, scale, transformed_data);
   }
@@ -442,25 +571,33 @@ template<typename Dtype>
 vector<int> DataTransformer<Dtype>::InferBlobShape(const Datum& datum) {
   if (datum.encoded()) {
 #ifdef USE_OPENCV
-    CHECK(!(param_.force_color() && param_.force_gray()))
-        << "cannot set both force_color and force_gray";
-    cv::Mat cv_img;
-    if (param_.force_color() || param_.force_gray()) {
-    // If force_color then decode in color otherwise decode in gray.
-      cv_img = DecodeDatumToCVMat(datum, param_.force_color());
-    } else {
-      cv_img = DecodeDatumToCVMatNative(datum);
-    }
+    const cv::Mat cv_img = DecodeDatum(param_, datum);
     // InferBlobShape using the cv::image.
     return InferBlobShape(cv_img);
 #else
     LOG(FATAL) << "Encoded datum requires OpenCV; compile with USE_OPENCV.";
 #endif  // USE_OPENCV
   }
+  return InferBlobShape(datum.channels(), datum.height(), datum.width());
+}
+
+template<typename Dtype>
+vector<int> DataTransformer<Dtype>::InferBlobShape(const DatumView& datum) {
+  if (datum.encoded()) {
+#ifdef USE_OPENCV
+    const cv::Mat cv_img = DecodeDatum(param_, datum);
+    return InferBlobShape(cv_img);
+#else
+    LOG(FATAL) << "Encoded datum requires OpenCV; compile with USE_OPENCV.";
+#endif  // USE_OPENCV
+  }
+  return InferBlobShape(datum.channels(), datum.height(), datum.width());
+}
+
+template<typename Dtype>
+vector<int> DataTransformer<Dtype>::InferBlobShape(const int datum_channels,
+    const int datum_height, const int datum_width) {
   const int crop_size = param_.crop_size();
-  const int datum_channels = datum.channels();
-  const int datum_height = datum.height();
-  const int datum_width = datum.width();
   // Check dimensions.
   CHECK_GT(datum_channels, 0);
   CHECK_GE(datum_height, crop_size);
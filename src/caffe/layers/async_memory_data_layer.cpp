@@ -0,0 +1,134 @@
+#ifdef USE_OPENCV
+#include <opencv2/core/core.hpp>
+#endif  // USE_OPENCV
+
+#include <vector>
+
+#include "caffe/layers/async_memory_data_layer.hpp"
+#include "caffe/util/math_functions.hpp"
+
+namespace caffe {
+
+template <typename Dtype>
+AsyncMemoryDataLayer<Dtype>::~AsyncMemoryDataLayer() {
+  this->StopInternalThread();
+}
+
+template <typename Dtype>
+void AsyncMemoryDataLayer<Dtype>::DataLayerSetUp(
+    const vector<Blob<Dtype>*>& bottom, const vector<Blob<Dtype>*>& top) {
+  const MemoryDataParameter& param = this->layer_param_.memory_data_param();
+  batch_size_ = param.batch_size();
+  channels_ = param.channels();
+  height_ = param.height();
+  width_ = param.width();
+  CHECK_GT(batch_size_ * channels_ * height_ * width_, 0) <<
+      "batch_size, channels, height, and width must be specified and"
+      " positive in memory_data_param";
+  CHECK_GT(param.queue_size(), 0);
+  vector<int> label_shape(1, batch_size_);
+  top[0]->Reshape(batch_size_, channels_, height_, width_);
+  top[1]->Reshape(label_shape);
+  for (int i = 0; i < this->PREFETCH_COUNT; ++i) {
+    this->prefetch_[i].data_.Reshape(batch_size_, channels_, height_, width_);
+    this->prefetch_[i].label_.Reshape(label_shape);
+  }
+  for (int i = 0; i < param.queue_size(); ++i) {
+    inputs_.push_back(shared_ptr<Input>(new Input()));
+    free_inputs_.push(inputs_[i].get());
+  }
+}
+
+template <typename Dtype>
+typename AsyncMemoryDataLayer<Dtype>::Input*
+AsyncMemoryDataLayer<Dtype>::PopFreeInput() {
+  Input* input = free_inputs_.pop("Waiting for pushed data to be consumed");
+  input->datums.clear();
+#ifdef USE_OPENCV
+  input->mats.clear();
+#endif  // USE_OPENCV
+  input->labels.clear();
+  input->data.clear();
+  input->data_labels.clear();
+  return input;
+}
+
+template <typename Dtype>
+void AsyncMemoryDataLayer<Dtype>::PushDatumVector(
+    const vector<Datum>& datum_vector) {
+  CHECK_EQ(datum_vector.size(), batch_size_) <<
+      "Push exactly one batch of data at a time.";
+  Input* input = PopFreeInput();
+  input->datums = datum_vector;
+  full_inputs_.push(input);
+}
+
+#ifdef USE_OPENCV
+template <typename Dtype>
+void AsyncMemoryDataLayer<Dtype>::PushMatVector(
+    const vector<cv::Mat>& mat_vector, const vector<int>& labels) {
+  CHECK_EQ(mat_vector.size(), batch_size_) <<
+      "Push exactly one batch of data at a time.";
+  CHECK_EQ(labels.size(), batch_size_);
+  Input* input = PopFreeInput();
+  input->mats = mat_vector;
+  input->labels = labels;
+  full_inputs_.push(input);
+}
+#endif  // USE_OPENCV
+
+template <typename Dtype>
+void AsyncMemoryDataLayer<Dtype>::PushArrays(const Dtype* data,
+    const Dtype* labels) {
+  CHECK(data);
+  CHECK(labels);
+  Input* input = PopFreeInput();
+  input->data.assign(data, data + batch_size_ * channels_ * height_ * width_);
+  input->data_labels.assign(labels, labels + batch_size_);
+  full_inputs_.push(input);
+}
+
+// This function is called on prefetch thread
+template <typename Dtype>
+void AsyncMemoryDataLayer<Dtype>::load_batch(Batch<Dtype>* batch) {
+  Input* input = full_inputs_.pop("Waiting for pushed data");
+  Dtype* top_label = batch->label_.mutable_cpu_data();
+  if (!input->datums.empty()) {
+    // Apply data transformations (mirror, scale, crop...)
+    this->data_transformer_->Transform(input->datums, &batch->data_);
+    for (int item_id = 0; item_id < batch_size_; ++item_id) {
+      top_label[item_id] = input->datums[item_id].label();
+    }
+#ifdef USE_OPENCV
+  } else if (!input->mats.empty()) {
+    this->data_transformer_->Transform(input->mats, &batch->data_);
+    for (int item_id = 0; item_id < batch_size_; ++item_id) {
+      top_label[item_id] = input->labels[item_id];
+    }
+#endif  // USE_OPENCV
+  } else {
+    caffe_copy(batch->data_.count(), &input->data[0],
+        batch->data_.mutable_cpu_data());
+    caffe_copy(batch_size_, &input->data_labels[0], top_label);
+  }
+  free_inputs_.push(input);
+}
+
+template <typename Dtype>
+void AsyncMemoryDataLayer<Dtype>::Forward_cpu(
+    const vector<Blob<Dtype>*>& bottom, const vector<Blob<Dtype>*>& top) {
+  // The tops are done with the previous batch.
+  if (current_) {
+    this->prefetch_free_.push(current_);
+  }
+  current_ = this->prefetch_full_.pop("Waiting for pushed data");
+  top[0]->ReshapeLike(current_->data_);
+  top[0]->ShareData(current_->data_);
+  top[1]->ReshapeLike(current_->label_);
+  top[1]->ShareData(current_->label_);
+}
+
+INSTANTIATE_CLASS(AsyncMemoryDataLayer);
+REGISTER_LAYER_CLASS(AsyncMemoryData);
+
+}  // namespace caffe
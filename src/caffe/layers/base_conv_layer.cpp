@@ -5,6 +5,7 @@
 #include "caffe/layers/base_conv_layer.hpp"
 #include "caffe/util/im2col.hpp"
 #include "caffe/util/math_functions.hpp"
+#include "caffe/util/workspace.hpp"
 
 namespace caffe {
 
@@ -241,6 +242,22 @@ void BaseConvolutionLayer<Dtype>::Reshape(const vector<Blob<Dtype>*>& bottom,
   col_buffer_.Reshape(col_buffer_shape_);
   bottom_dim_ = bottom[0]->count(channel_axis_);
   top_dim_ = top[0]->count(channel_axis_);
+  // Batched unrolling is only implemented by the 2D im2col, and only
+  // applies to the forward pass of convolution proper.
+  cpu_batch_size_ = 1;
+  if (!force_nd_im2col_ && num_spatial_axes_ == 2 && !reverse_dimensions()) {
+    cpu_batch_size_ = std::max(1, std::min(num_,
+        static_cast<int>(
+        this->layer_param_.convolution_param().cpu_batch_size())));
+  }
+  if (cpu_batch_size_ > 1) {
+    vector<int> batch_buffer_shape(2);
+    batch_buffer_shape[0] = kernel_dim_ * group_;
+    batch_buffer_shape[1] = cpu_batch_size_ * conv_out_spatial_dim_;
+    batch_col_buffer_.Reshape(batch_buffer_shape);
+    batch_buffer_shape[0] = conv_out_channels_;
+    batch_output_buffer_.Reshape(batch_buffer_shape);
+  }
   num_kernels_im2col_ = conv_in_channels_ * conv_out_spatial_dim_;
   num_kernels_col2im_ = reverse_dimensions() ? top_dim_ : bottom_dim_;
   // Set up the all ones "bias multiplier" for adding biases by BLAS
@@ -253,6 +270,19 @@ void BaseConvolutionLayer<Dtype>::Reshape(const vector<Blob<Dtype>*>& bottom,
   }
 }
 
+template <typename Dtype>
+void BaseConvolutionLayer<Dtype>::AppendWorkspace(bool forward_only,
+    Workspace* workspace) {
+  // The columns are recomputed from the input by every Forward and Backward.
+  if (!is_1x1_) {
+    workspace->Add(&col_buffer_);
+  }
+  if (cpu_batch_size_ > 1) {
+    workspace->Add(&batch_col_buffer_);
+    workspace->Add(&batch_output_buffer_);
+  }
+}
+
 template <typename Dtype>
 void BaseConvolutionLayer<Dtype>::forward_cpu_gemm(const Dtype* input,
     const Dtype* weights, Dtype* output, bool skip_im2col) {
@@ -271,6 +301,37 @@ void BaseConvolutionLayer<Dtype>::forward_cpu_gemm(const Dtype* input,
   }
 }
 
+template <typename Dtype>
+void BaseConvolutionLayer<Dtype>::forward_cpu_gemm_batch(const Dtype* input,
+    const int num_images, const Dtype* weights, Dtype* output) {
+  CHECK_LE(num_images, cpu_batch_size_);
+  Dtype* col_buff = batch_col_buffer_.mutable_cpu_data();
+  im2col_batch_cpu(input, num_images, conv_in_channels_,
+      conv_input_shape_.cpu_data()[1], conv_input_shape_.cpu_data()[2],
+      kernel_shape_.cpu_data()[0], kernel_shape_.cpu_data()[1],
+      pad_.cpu_data()[0], pad_.cpu_data()[1],
+      stride_.cpu_data()[0], stride_.cpu_data()[1],
+      dilation_.cpu_data()[0], dilation_.cpu_data()[1], col_buff);
+  const int batch_spatial_dim = num_images * conv_out_spatial_dim_;
+  Dtype* batch_output = batch_output_buffer_.mutable_cpu_data();
+  for (int g = 0; g < group_; ++g) {
+    caffe_cpu_gemm<Dtype>(CblasNoTrans, CblasNoTrans, conv_out_channels_ /
+        group_, batch_spatial_dim, kernel_dim_,
+        (Dtype)1., weights + weight_offset_ * g,
+        col_buff + kernel_dim_ * batch_spatial_dim * g,
+        (Dtype)0., batch_output + output_offset_ * num_images * g);
+  }
+  // The GEMM output is channels x images x spatial; scatter it back into
+  // the images x channels x spatial layout of the top blob.
+  for (int c = 0; c < conv_out_channels_; ++c) {
+    for (int n = 0; n < num_images; ++n) {
+      caffe_copy(conv_out_spatial_dim_,
+          batch_output + (c * num_images + n) * conv_out_spatial_dim_,
+          output + n * top_dim_ + c * conv_out_spatial_dim_);
+    }
+  }
+}
+
 template <typename Dtype>
 void BaseConvolutionLayer<Dtype>::forward_cpu_bias(Dtype* output,
     const Dtype* bias) {
@@ -1,3 +1,4 @@
+#include <boost/bind.hpp>
 #include <boost/thread.hpp>
 #include <vector>
 
@@ -7,7 +8,8 @@
 #include "caffe/layer.hpp"
 #include "caffe/layers/base_data_layer.hpp"
 #include "caffe/proto/caffe.pb.h"
-#include "caffe/util/blocking_queue.hpp"
+#include "caffe/util/spsc_queue.hpp"
+#include "caffe/util/thread_pool.hpp"
 
 namespace caffe {
 
@@ -36,7 +38,7 @@ template <typename Dtype>
 BasePrefetchingDataLayer<Dtype>::BasePrefetchingDataLayer(
     const LayerParameter& param)
     : BaseDataLayer<Dtype>(param),
-      prefetch_free_(), prefetch_full_() {
+      prefetch_free_(PREFETCH_COUNT), prefetch_full_(PREFETCH_COUNT) {
   for (int i = 0; i < PREFETCH_COUNT; ++i) {
     prefetch_free_.push(&prefetch_[i]);
   }
@@ -55,6 +57,9 @@ void BasePrefetchingDataLayer<Dtype>::LayerSetUp(
     if (this->output_labels_) {
       prefetch_[i].label_.mutable_cpu_data();
     }
+    for (int j = 0; j < prefetch_[i].extra_.size(); ++j) {
+      prefetch_[i].extra_[j]->mutable_cpu_data();
+    }
   }
 #ifndef CPU_ONLY
   if (Caffe::mode() == Caffe::GPU) {
@@ -63,6 +68,9 @@ void BasePrefetchingDataLayer<Dtype>::LayerSetUp(
       if (this->output_labels_) {
         prefetch_[i].label_.mutable_gpu_data();
       }
+      for (int j = 0; j < prefetch_[i].extra_.size(); ++j) {
+        prefetch_[i].extra_[j]->mutable_gpu_data();
+      }
     }
   }
 #endif
@@ -104,6 +112,49 @@ void BasePrefetchingDataLayer<Dtype>::InternalThreadEntry() {
 #endif
 }
 
+template <typename Dtype>
+void BasePrefetchingDataLayer<Dtype>::SetUpTransformThreads(
+    const int transform_threads) {
+  CHECK_GT(transform_threads, 0);
+  transformers_.assign(1, this->data_transformer_);
+  for (int i = 1; i < transform_threads; ++i) {
+    transformers_.push_back(shared_ptr<DataTransformer<Dtype> >(
+        new DataTransformer<Dtype>(this->transform_param_, this->phase_)));
+    transformers_.back()->InitRand();
+  }
+  if (transform_threads > 1) {
+    transform_pool_.reset(new ThreadPool(transform_threads));
+  } else {
+    transform_pool_.reset();
+  }
+}
+
+template <typename Dtype>
+void BasePrefetchingDataLayer<Dtype>::TransformBatch(const int batch_size,
+    const TransformFunction& transform) {
+  if (transform_pool_) {
+    transform_pool_->ParallelFor(transformers_.size(), 1,
+        boost::bind(&BasePrefetchingDataLayer<Dtype>::TransformItems, this,
+            batch_size, boost::cref(transform), _1, _2));
+  } else {
+    TransformItems(batch_size, transform, 0, transformers_.size());
+  }
+}
+
+// This function is called on the transform threads
+template <typename Dtype>
+void BasePrefetchingDataLayer<Dtype>::TransformItems(const int batch_size,
+    const TransformFunction& transform, const int begin, const int end) {
+  // Each thread writes its items through a blob of its own.
+  Blob<Dtype> transformed_data(transformed_data_.shape());
+  for (int i = begin; i < end; ++i) {
+    for (int item_id = i; item_id < batch_size;
+         item_id += transformers_.size()) {
+      transform(item_id, transformers_[i].get(), &transformed_data);
+    }
+  }
+}
+
 template <typename Dtype>
 void BasePrefetchingDataLayer<Dtype>::Forward_cpu(
     const vector<Blob<Dtype>*>& bottom, const vector<Blob<Dtype>*>& top) {
@@ -121,6 +172,11 @@ void BasePrefetchingDataLayer<Dtype>::Forward_cpu(
     caffe_copy(batch->label_.count(), batch->label_.cpu_data(),
         top[1]->mutable_cpu_data());
   }
+  for (int i = 0; i < batch->extra_.size(); ++i) {
+    top[i + 2]->ReshapeLike(*batch->extra_[i]);
+    caffe_copy(batch->extra_[i]->count(), batch->extra_[i]->cpu_data(),
+        top[i + 2]->mutable_cpu_data());
+  }
 
   prefetch_free_.push(batch);
 }
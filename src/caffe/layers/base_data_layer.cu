@@ -20,6 +20,11 @@ void BasePrefetchingDataLayer<Dtype>::Forward_gpu(
     caffe_copy(batch->label_.count(), batch->label_.gpu_data(),
         top[1]->mutable_gpu_data());
   }
+  for (int i = 0; i < batch->extra_.size(); ++i) {
+    top[i + 2]->ReshapeLike(*batch->extra_[i]);
+    caffe_copy(batch->extra_[i]->count(), batch->extra_[i]->gpu_data(),
+        top[i + 2]->mutable_gpu_data());
+  }
   // Ensure the copy is synchronous wrt the host, so that the next batch isn't
   // copied in meanwhile.
   CUDA_CHECK(cudaStreamSynchronize(cudaStreamDefault));
@@ -1,3 +1,4 @@
+#include <algorithm>
 #include <vector>
 
 #include "caffe/layers/conv_layer.hpp"
@@ -28,12 +29,25 @@ void ConvolutionLayer<Dtype>::Forward_cpu(const vector<Blob<Dtype>*>& bottom,
   for (int i = 0; i < bottom.size(); ++i) {
     const Dtype* bottom_data = bottom[i]->cpu_data();
     Dtype* top_data = top[i]->mutable_cpu_data();
-    for (int n = 0; n < this->num_; ++n) {
-      this->forward_cpu_gemm(bottom_data + n * this->bottom_dim_, weight,
-          top_data + n * this->top_dim_);
+    for (int n = 0; n < this->num_; n += this->cpu_batch_size_) {
+      const int num_images = std::min(this->cpu_batch_size_, this->num_ - n);
+      if (num_images > 1) {
+        this->forward_cpu_gemm_batch(bottom_data + n * this->bottom_dim_,
+            num_images, weight, top_data + n * this->top_dim_);
+      } else {
+        this->forward_cpu_gemm(bottom_data + n * this->bottom_dim_, weight,
+            top_data + n * this->top_dim_);
+      }
       if (this->bias_term_) {
         const Dtype* bias = this->blobs_[1]->cpu_data();
-        this->forward_cpu_bias(top_data + n * this->top_dim_, bias);
+        for (int image = n; image < n + num_images; ++image) {
+          this->forward_cpu_bias(top_data + image * this->top_dim_, bias);
+        }
+      }
+      // While the outputs of these images are still in cache.
+      if (fuse_relu()) {
+        forward_cpu_relu(top_data + n * this->top_dim_,
+            num_images * this->top_dim_);
       }
     }
   }
@@ -45,6 +59,10 @@ void ConvolutionLayer<Dtype>::Backward_cpu(const vector<Blob<Dtype>*>& top,
   const Dtype* weight = this->blobs_[0]->cpu_data();
   Dtype* weight_diff = this->blobs_[0]->mutable_cpu_diff();
   for (int i = 0; i < top.size(); ++i) {
+    if (fuse_relu()) {
+      backward_cpu_relu(top[i]->cpu_data(), top[i]->mutable_cpu_diff(),
+          top[i]->count());
+    }
     const Dtype* top_diff = top[i]->cpu_diff();
     const Dtype* bottom_data = bottom[i]->cpu_data();
     Dtype* bottom_diff = bottom[i]->mutable_cpu_diff();
@@ -72,6 +90,22 @@ void ConvolutionLayer<Dtype>::Backward_cpu(const vector<Blob<Dtype>*>& top,
   }
 }
 
+template <typename Dtype>
+void ConvolutionLayer<Dtype>::forward_cpu_relu(Dtype* output,
+    const int count) {
+  for (int i = 0; i < count; ++i) {
+    output[i] = std::max(output[i], Dtype(0));
+  }
+}
+
+template <typename Dtype>
+void ConvolutionLayer<Dtype>::backward_cpu_relu(const Dtype* output,
+    Dtype* diff, const int count) {
+  for (int i = 0; i < count; ++i) {
+    diff[i] = output[i] > 0 ? diff[i] : Dtype(0);
+  }
+}
+
 #ifdef CPU_ONLY
 STUB_GPU(ConvolutionLayer);
 #endif
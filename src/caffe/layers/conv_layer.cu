@@ -4,6 +4,39 @@
 
 namespace caffe {
 
+template <typename Dtype>
+__global__ void FusedReLUForward(const int n, Dtype* out) {
+  CUDA_KERNEL_LOOP(index, n) {
+    out[index] = out[index] > 0 ? out[index] : 0;
+  }
+}
+
+template <typename Dtype>
+__global__ void FusedReLUBackward(const int n, const Dtype* out,
+    Dtype* diff) {
+  CUDA_KERNEL_LOOP(index, n) {
+    diff[index] = out[index] > 0 ? diff[index] : 0;
+  }
+}
+
+template <typename Dtype>
+void ConvolutionLayer<Dtype>::forward_gpu_relu(Dtype* output,
+    const int count) {
+  // NOLINT_NEXT_LINE(whitespace/operators)
+  FusedReLUForward<Dtype><<<CAFFE_GET_BLOCKS(count), CAFFE_CUDA_NUM_THREADS>>>(
+      count, output);
+  CUDA_POST_KERNEL_CHECK;
+}
+
+template <typename Dtype>
+void ConvolutionLayer<Dtype>::backward_gpu_relu(const Dtype* output,
+    Dtype* diff, const int count) {
+  // NOLINT_NEXT_LINE(whitespace/operators)
+  FusedReLUBackward<Dtype><<<CAFFE_GET_BLOCKS(count), CAFFE_CUDA_NUM_THREADS>>>(
+      count, output, diff);
+  CUDA_POST_KERNEL_CHECK;
+}
+
 template <typename Dtype>
 void ConvolutionLayer<Dtype>::Forward_gpu(const vector<Blob<Dtype>*>& bottom,
       const vector<Blob<Dtype>*>& top) {
@@ -19,6 +52,9 @@ void ConvolutionLayer<Dtype>::Forward_gpu(const vector<Blob<Dtype>*>& bottom,
         this->forward_gpu_bias(top_data + n * this->top_dim_, bias);
       }
     }
+    if (fuse_relu()) {
+      forward_gpu_relu(top_data, top[i]->count());
+    }
   }
 }
 
@@ -28,6 +64,10 @@ void ConvolutionLayer<Dtype>::Backward_gpu(const vector<Blob<Dtype>*>& top,
   const Dtype* weight = this->blobs_[0]->gpu_data();
   Dtype* weight_diff = this->blobs_[0]->mutable_gpu_diff();
   for (int i = 0; i < top.size(); ++i) {
+    if (fuse_relu()) {
+      backward_gpu_relu(top[i]->gpu_data(), top[i]->mutable_gpu_diff(),
+          top[i]->count());
+    }
     const Dtype* top_diff = top[i]->gpu_diff();
     // Bias gradient, if necessary.
     if (this->bias_term_ && this->param_propagate_down_[1]) {
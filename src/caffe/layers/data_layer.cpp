@@ -3,6 +3,7 @@
 #endif  // USE_OPENCV
 #include <stdint.h>
 
+#include <boost/bind.hpp>
 #include <vector>
 
 #include "caffe/data_transformer.hpp"
@@ -27,7 +28,7 @@ void DataLayer<Dtype>::DataLayerSetUp(const vector<Blob<Dtype>*>& bottom,
       const vector<Blob<Dtype>*>& top) {
   const int batch_size = this->layer_param_.data_param().batch_size();
   // Read a data point, and use it to initialize the top blob.
-  Datum& datum = *(reader_.full().peek());
+  DatumView& datum = *(reader_.full().peek());
 
   // Use data_transformer to infer the expected blob shape from datum.
   vector<int> top_shape = this->data_transformer_->InferBlobShape(datum);
@@ -49,6 +50,8 @@ void DataLayer<Dtype>::DataLayerSetUp(const vector<Blob<Dtype>*>& bottom,
       this->prefetch_[i].label_.Reshape(label_shape);
     }
   }
+  this->SetUpTransformThreads(
+      this->layer_param_.data_param().transform_threads());
 }
 
 // This function is called on prefetch thread
@@ -65,7 +68,7 @@ void DataLayer<Dtype>::load_batch(Batch<Dtype>* batch) {
   // Reshape according to the first datum of each batch
   // on single input batches allows for inputs of varying dimension.
   const int batch_size = this->layer_param_.data_param().batch_size();
-  Datum& datum = *(reader_.full().peek());
+  DatumView& datum = *(reader_.full().peek());
   // Use data_transformer to infer the expected blob shape from datum.
   vector<int> top_shape = this->data_transformer_->InferBlobShape(datum);
   this->transformed_data_.Reshape(top_shape);
@@ -79,23 +82,20 @@ void DataLayer<Dtype>::load_batch(Batch<Dtype>* batch) {
   if (this->output_labels_) {
     top_label = batch->label_.mutable_cpu_data();
   }
+  timer.Start();
+  vector<DatumView*> datums(batch_size);
   for (int item_id = 0; item_id < batch_size; ++item_id) {
-    timer.Start();
     // get a datum
-    Datum& datum = *(reader_.full().pop("Waiting for data"));
-    read_time += timer.MicroSeconds();
-    timer.Start();
-    // Apply data transformations (mirror, scale, crop...)
-    int offset = batch->data_.offset(item_id);
-    this->transformed_data_.set_cpu_data(top_data + offset);
-    this->data_transformer_->Transform(datum, &(this->transformed_data_));
-    // Copy label.
-    if (this->output_labels_) {
-      top_label[item_id] = datum.label();
-    }
-    trans_time += timer.MicroSeconds();
-
-    reader_.free().push(const_cast<Datum*>(&datum));
+    datums[item_id] = reader_.full().pop("Waiting for data");
+  }
+  read_time += timer.MicroSeconds();
+  timer.Start();
+  this->TransformBatch(batch_size,
+      boost::bind(&DataLayer<Dtype>::TransformItem, this,
+          boost::cref(datums), top_data, top_label, _1, _2, _3));
+  trans_time += timer.MicroSeconds();
+  for (int item_id = 0; item_id < batch_size; ++item_id) {
+    reader_.free().push(datums[item_id]);
   }
   timer.Stop();
   batch_timer.Stop();
@@ -104,6 +104,22 @@ void DataLayer<Dtype>::load_batch(Batch<Dtype>* batch) {
   DLOG(INFO) << "Transform time: " << trans_time / 1000 << " ms.";
 }
 
+// This function is called on the transform threads
+template<typename Dtype>
+void DataLayer<Dtype>::TransformItem(const vector<DatumView*>& datums,
+    Dtype* top_data, Dtype* top_label, const int item_id,
+    DataTransformer<Dtype>* transformer, Blob<Dtype>* transformed_data) {
+  const DatumView& datum = *datums[item_id];
+  // Apply data transformations (mirror, scale, crop...)
+  transformed_data->set_cpu_data(
+      top_data + item_id * transformed_data->count());
+  transformer->Transform(datum, transformed_data);
+  // Copy label.
+  if (top_label) {
+    top_label[item_id] = datum.label();
+  }
+}
+
 INSTANTIATE_CLASS(DataLayer);
 REGISTER_LAYER_CLASS(Data);
 
@@ -0,0 +1,127 @@
+#include <boost/bind.hpp>
+#include <algorithm>
+#include <vector>
+
+#include "caffe/layers/direct_conv_layer.hpp"
+#include "caffe/util/math_functions.hpp"
+#include "caffe/util/thread_pool.hpp"
+
+namespace caffe {
+
+// Returns in [*begin, *end) the outputs o for which the input index
+// o * stride + offset lies in [0, size).
+inline void direct_conv_valid_range(const int output_size, const int size,
+    const int stride, const int offset, int* begin, int* end) {
+  *begin = offset < 0 ? (stride - 1 - offset) / stride : 0;
+  *end = size > offset ? std::min(output_size,
+      (size - 1 - offset) / stride + 1) : 0;
+  *begin = std::min(*begin, *end);
+}
+
+template <typename Dtype>
+void DirectConvolutionLayer<Dtype>::Reshape(
+    const vector<Blob<Dtype>*>& bottom, const vector<Blob<Dtype>*>& top) {
+  ConvolutionLayer<Dtype>::Reshape(bottom, top);
+  use_direct_ = false;
+  if (this->num_spatial_axes_ != 2 || this->force_nd_im2col_ ||
+      this->is_1x1_) {
+    return;
+  }
+  const int* kernel_shape = this->kernel_shape_.cpu_data();
+  const int* stride = this->stride_.cpu_data();
+  const int* dilation = this->dilation_.cpu_data();
+  const bool is_3x3_s1 = kernel_shape[0] == 3 && kernel_shape[1] == 3 &&
+      stride[0] == 1 && stride[1] == 1 &&
+      dilation[0] == 1 && dilation[1] == 1;
+  const bool is_depthwise = this->group_ == this->channels_;
+  const bool is_1x1 = kernel_shape[0] == 1 && kernel_shape[1] == 1;
+  use_direct_ = is_3x3_s1 || is_depthwise || is_1x1;
+}
+
+template <typename Dtype>
+void DirectConvolutionLayer<Dtype>::forward_cpu_direct(
+    const Dtype* bottom_data, Dtype* top_data, const int begin,
+    const int end) {
+  const int height = this->input_shape(1);
+  const int width = this->input_shape(2);
+  const int output_h = this->output_shape_[0];
+  const int output_w = this->output_shape_[1];
+  const int kernel_h = this->kernel_shape_.cpu_data()[0];
+  const int kernel_w = this->kernel_shape_.cpu_data()[1];
+  const int pad_h = this->pad_.cpu_data()[0];
+  const int pad_w = this->pad_.cpu_data()[1];
+  const int stride_h = this->stride_.cpu_data()[0];
+  const int stride_w = this->stride_.cpu_data()[1];
+  const int dilation_h = this->dilation_.cpu_data()[0];
+  const int dilation_w = this->dilation_.cpu_data()[1];
+  const int channels_per_group = this->channels_ / this->group_;
+  const int outputs_per_group = this->num_output_ / this->group_;
+  const int kernel_size = kernel_h * kernel_w;
+  const Dtype* weight = this->blobs_[0]->cpu_data();
+  const Dtype* bias = this->bias_term_ ? this->blobs_[1]->cpu_data() : NULL;
+  for (int plane = begin; plane < end; ++plane) {
+    const int n = plane / this->num_output_;
+    const int o = plane % this->num_output_;
+    Dtype* output = top_data + plane * this->out_spatial_dim_;
+    caffe_set(this->out_spatial_dim_, bias ? bias[o] : Dtype(0), output);
+    const int first_channel = (o / outputs_per_group) * channels_per_group;
+    for (int k = 0; k < channels_per_group; ++k) {
+      const Dtype* input = bottom_data + n * this->bottom_dim_ +
+          (first_channel + k) * height * width;
+      const Dtype* filter = weight + (o * channels_per_group + k) *
+          kernel_size;
+      for (int p = 0; p < kernel_h; ++p) {
+        const int offset_h = p * dilation_h - pad_h;
+        int y_begin, y_end;
+        direct_conv_valid_range(output_h, height, stride_h, offset_h,
+            &y_begin, &y_end);
+        for (int q = 0; q < kernel_w; ++q) {
+          const int offset_w = q * dilation_w - pad_w;
+          int x_begin, x_end;
+          direct_conv_valid_range(output_w, width, stride_w, offset_w,
+              &x_begin, &x_end);
+          const Dtype w = filter[p * kernel_w + q];
+          for (int y = y_begin; y < y_end; ++y) {
+            const Dtype* input_row =
+                input + (y * stride_h + offset_h) * width + offset_w;
+            Dtype* output_row = output + y * output_w;
+            if (stride_w == 1) {
+              for (int x = x_begin; x < x_end; ++x) {
+                output_row[x] += w * input_row[x];
+              }
+            } else {
+              for (int x = x_begin; x < x_end; ++x) {
+                output_row[x] += w * input_row[x * stride_w];
+              }
+            }
+          }
+        }
+      }
+    }
+    if (this->fuse_relu()) {
+      this->forward_cpu_relu(output, this->out_spatial_dim_);
+    }
+  }
+}
+
+template <typename Dtype>
+void DirectConvolutionLayer<Dtype>::Forward_cpu(
+    const vector<Blob<Dtype>*>& bottom, const vector<Blob<Dtype>*>& top) {
+  if (!use_direct_) {
+    ConvolutionLayer<Dtype>::Forward_cpu(bottom, top);
+    return;
+  }
+  // Every output plane costs out_spatial_dim_ * kernel_dim multiply-adds.
+  const int plane_work = this->out_spatial_dim_ *
+      this->blobs_[0]->count(1);
+  const int grain = std::max(1, kCPUParallelGrain / std::max(1, plane_work));
+  for (int i = 0; i < bottom.size(); ++i) {
+    caffe_cpu_parallel_for(this->num_ * this->num_output_,
+        boost::bind(&DirectConvolutionLayer<Dtype>::forward_cpu_direct, this,
+        bottom[i]->cpu_data(), top[i]->mutable_cpu_data(), _1, _2), grain);
+  }
+}
+
+INSTANTIATE_CLASS(DirectConvolutionLayer);
+
+}  // namespace caffe
@@ -1,11 +1,53 @@
+#include <boost/bind.hpp>
 #include <cfloat>
 #include <vector>
 
 #include "caffe/layers/eltwise_layer.hpp"
 #include "caffe/util/math_functions.hpp"
+#include "caffe/util/thread_pool.hpp"
 
 namespace caffe {
 
+template <typename Dtype>
+static void eltwise_max_forward_range(const Dtype* bottom_data_a,
+    const Dtype* bottom_data_b, Dtype* top_data, int* mask,
+    const int begin, const int end) {
+  for (int idx = begin; idx < end; ++idx) {
+    if (bottom_data_a[idx] > bottom_data_b[idx]) {
+      top_data[idx] = bottom_data_a[idx];  // maxval
+      mask[idx] = 0;  // maxid
+    } else {
+      top_data[idx] = bottom_data_b[idx];  // maxval
+      mask[idx] = 1;  // maxid
+    }
+  }
+}
+
+template <typename Dtype>
+static void eltwise_max_update_range(const Dtype* bottom_data_b,
+    const int blob_idx, Dtype* top_data, int* mask,
+    const int begin, const int end) {
+  for (int idx = begin; idx < end; ++idx) {
+    if (bottom_data_b[idx] > top_data[idx]) {
+      top_data[idx] = bottom_data_b[idx];  // maxval
+      mask[idx] = blob_idx;  // maxid
+    }
+  }
+}
+
+template <typename Dtype>
+static void eltwise_max_backward_range(const int* mask, const int blob_idx,
+    const Dtype* top_diff, Dtype* bottom_diff, const int begin,
+    const int end) {
+  for (int index = begin; index < end; ++index) {
+    Dtype gradient = 0;
+    if (mask[index] == blob_idx) {
+      gradient += top_diff[index];
+    }
+    bottom_diff[index] = gradient;
+  }
+}
+
 template <typename Dtype>
 void EltwiseLayer<Dtype>::LayerSetUp(const vector<Blob<Dtype>*>& bottom,
       const vector<Blob<Dtype>*>& top) {
@@ -71,24 +113,15 @@ void EltwiseLayer<Dtype>::Forward_cpu(
     // bottom 0 & 1
     bottom_data_a = bottom[0]->cpu_data();
     bottom_data_b = bottom[1]->cpu_data();
-    for (int idx = 0; idx < count; ++idx) {
-      if (bottom_data_a[idx] > bottom_data_b[idx]) {
-        top_data[idx] = bottom_data_a[idx];  // maxval
-        mask[idx] = 0;  // maxid
-      } else {
-        top_data[idx] = bottom_data_b[idx];  // maxval
-        mask[idx] = 1;  // maxid
-      }
-    }
+    caffe_cpu_parallel_for(count,
+        boost::bind(&eltwise_max_forward_range<Dtype>, bottom_data_a,
+        bottom_data_b, top_data, mask, _1, _2));
     // bottom 2++
     for (int blob_idx = 2; blob_idx < bottom.size(); ++blob_idx) {
       bottom_data_b = bottom[blob_idx]->cpu_data();
-      for (int idx = 0; idx < count; ++idx) {
-        if (bottom_data_b[idx] > top_data[idx]) {
-          top_data[idx] = bottom_data_b[idx];  // maxval
-          mask[idx] = blob_idx;  // maxid
-        }
-      }
+      caffe_cpu_parallel_for(count,
+          boost::bind(&eltwise_max_update_range<Dtype>, bottom_data_b,
+          blob_idx, top_data, mask, _1, _2));
     }
     break;
   default:
@@ -135,13 +168,9 @@ void EltwiseLayer<Dtype>::Backward_cpu(const vector<Blob<Dtype>*>& top,
         break;
       case EltwiseParameter_EltwiseOp_MAX:
         mask = max_idx_.cpu_data();
-        for (int index = 0; index < count; ++index) {
-          Dtype gradient = 0;
-          if (mask[index] == i) {
-            gradient += top_diff[index];
-          }
-          bottom_diff[index] = gradient;
-        }
+        caffe_cpu_parallel_for(count,
+            boost::bind(&eltwise_max_backward_range<Dtype>, mask, i,
+            top_diff, bottom_diff, _1, _2));
         break;
       default:
         LOG(FATAL) << "Unknown elementwise operation.";
@@ -1,3 +1,5 @@
+#include <boost/thread.hpp>
+#include <algorithm>
 #include <vector>
 
 #include "hdf5.h"
@@ -5,33 +7,105 @@
 
 #include "caffe/layers/hdf5_output_layer.hpp"
 #include "caffe/util/hdf5.hpp"
+#include "caffe/util/math_functions.hpp"
 
 namespace caffe {
 
+// Whether the rows of two blobs, along their first axis, have one shape.
+template <typename Dtype>
+static bool SameRowShape(const Blob<Dtype>& a, const Blob<Dtype>& b) {
+  return a.num_axes() == b.num_axes() &&
+      std::equal(a.shape().begin() + 1, a.shape().end(), b.shape().begin() + 1);
+}
+
 template <typename Dtype>
 void HDF5OutputLayer<Dtype>::LayerSetUp(const vector<Blob<Dtype>*>& bottom,
     const vector<Blob<Dtype>*>& top) {
   file_name_ = this->layer_param_.hdf5_output_param().file_name();
-  file_id_ = H5Fcreate(file_name_.c_str(), H5F_ACC_TRUNC, H5P_DEFAULT,
-                       H5P_DEFAULT);
+  {
+    HDF5Lock lock;
+    file_id_ = H5Fcreate(file_name_.c_str(), H5F_ACC_TRUNC, H5P_DEFAULT,
+                         H5P_DEFAULT);
+  }
   CHECK_GE(file_id_, 0) << "Failed to open HDF5 file" << file_name_;
   file_opened_ = true;
+  if (this->layer_param_.hdf5_output_param().append()) {
+    const int queue_size = this->layer_param_.hdf5_output_param().queue_size();
+    CHECK_GT(queue_size, 0);
+    free_.reset(new SPSCQueue<Batch<Dtype>*>(queue_size));
+    full_.reset(new SPSCQueue<Batch<Dtype>*>(queue_size));
+    for (int i = 0; i < queue_size; ++i) {
+      batches_.push_back(shared_ptr<Batch<Dtype> >(new Batch<Dtype>()));
+      free_->push(batches_[i].get());
+    }
+    DLOG(INFO) << "Initializing HDF5 writer thread";
+    StartInternalThread();
+  }
 }
 
 template <typename Dtype>
 HDF5OutputLayer<Dtype>::~HDF5OutputLayer<Dtype>() {
+  if (is_started()) {
+    // Every buffer is free again once the queued batches are written.
+    for (int i = 0; i < batches_.size(); ++i) {
+      free_->pop("Waiting for HDF5 writes");
+    }
+    StopInternalThread();
+  }
+  HDF5Lock lock;
+  if (data_dataset_ >= 0) {
+    H5Dclose(data_dataset_);
+    H5Dclose(label_dataset_);
+  }
   if (file_opened_) {
     herr_t status = H5Fclose(file_id_);
     CHECK_GE(status, 0) << "Failed to close HDF5 file " << file_name_;
   }
 }
 
+template <typename Dtype>
+void HDF5OutputLayer<Dtype>::InternalThreadEntry() {
+  try {
+    while (!must_stop()) {
+      Batch<Dtype>* batch = full_->pop();
+      AppendBatch(*batch);
+      free_->push(batch);
+    }
+  } catch (boost::thread_interrupted&) {
+    // Interrupted exception is expected on shutdown
+  }
+}
+
+template <typename Dtype>
+void HDF5OutputLayer<Dtype>::AppendBatch(const Batch<Dtype>& batch) {
+  // Called on the writer thread, which shares libhdf5 with the others.
+  HDF5Lock lock;
+  const HDF5OutputParameter& param = this->layer_param_.hdf5_output_param();
+  const Blob<Dtype>* blobs[] = {&batch.data_, &batch.label_};
+  hid_t* datasets[] = {&data_dataset_, &label_dataset_};
+  const char* names[] = {HDF5_DATA_DATASET_NAME, HDF5_DATA_LABEL_NAME};
+  for (int i = 0; i < 2; ++i) {
+    const vector<int>& shape = blobs[i]->shape();
+    const vector<int> row_shape(shape.begin() + 1, shape.end());
+    if (*datasets[i] < 0) {
+      const int chunk_rows = param.chunk_rows() ? param.chunk_rows() :
+          std::max(shape[0], 1);
+      *datasets[i] = hdf5_create_extendable_dataset(file_id_, names[i],
+          hdf5_native_type<Dtype>(), row_shape, chunk_rows,
+          param.gzip_level(), param.shuffle());
+    }
+    hdf5_append_rows(*datasets[i], hdf5_native_type<Dtype>(), shape[0],
+        blobs[i]->cpu_data());
+  }
+}
+
 template <typename Dtype>
 void HDF5OutputLayer<Dtype>::SaveBlobs() {
   // TODO: no limit on the number of blobs
   LOG(INFO) << "Saving HDF5 file " << file_name_;
   CHECK_EQ(data_blob_.num(), label_blob_.num()) <<
       "data blob and label blob must have the same batch size";
+  HDF5Lock lock;
   hdf5_save_nd_dataset(file_id_, HDF5_DATA_DATASET_NAME, data_blob_);
   hdf5_save_nd_dataset(file_id_, HDF5_DATA_LABEL_NAME, label_blob_);
   LOG(INFO) << "Successfully saved " << data_blob_.num() << " rows";
@@ -42,6 +116,26 @@ void HDF5OutputLayer<Dtype>::Forward_cpu(const vector<Blob<Dtype>*>& bottom,
       const vector<Blob<Dtype>*>& top) {
   CHECK_GE(bottom.size(), 2);
   CHECK_EQ(bottom[0]->num(), bottom[1]->num());
+  if (this->layer_param_.hdf5_output_param().append()) {
+    // The rows of every batch must have the shape of the datasets, which
+    // data_blob_ and label_blob_ keep.
+    if (data_blob_.num_axes() == 0) {
+      data_blob_.ReshapeLike(*bottom[0]);
+      label_blob_.ReshapeLike(*bottom[1]);
+    }
+    CHECK(SameRowShape(data_blob_, *bottom[0]) &&
+        SameRowShape(label_blob_, *bottom[1]))
+        << "Bottoms differ in shape from the first batch";
+    Batch<Dtype>* batch = free_->pop("Waiting for HDF5 writes");
+    batch->data_.ReshapeLike(*bottom[0]);
+    batch->label_.ReshapeLike(*bottom[1]);
+    caffe_copy(bottom[0]->count(), bottom[0]->cpu_data(),
+        batch->data_.mutable_cpu_data());
+    caffe_copy(bottom[1]->count(), bottom[1]->cpu_data(),
+        batch->label_.mutable_cpu_data());
+    full_->push(batch);
+    return;
+  }
   data_blob_.Reshape(bottom[0]->num(), bottom[0]->channels(),
                      bottom[0]->height(), bottom[0]->width());
   label_blob_.Reshape(bottom[1]->num(), bottom[1]->channels(),
@@ -0,0 +1,235 @@
+#include <algorithm>
+#include <fstream>  // NOLINT(readability/streams)
+#include <string>
+#include <vector>
+
+#include "hdf5.h"
+
+#include "caffe/layers/hdf5_stream_data_layer.hpp"
+#include "caffe/util/hdf5.hpp"
+#include "caffe/util/math_functions.hpp"
+#include "caffe/util/rng.hpp"
+
+namespace caffe {
+
+// Opens the named dataset of the file and gets its dimensions. These
+// helpers are called with the HDF5Lock held.
+static hid_t hdf5_open_dataset(hid_t file_id, const string& name,
+    vector<hsize_t>* dims) {
+  hid_t dataset = H5Dopen2(file_id, name.c_str(), H5P_DEFAULT);
+  CHECK_GE(dataset, 0) << "Failed to find HDF5 dataset " << name;
+  hid_t space = H5Dget_space(dataset);
+  const int ndims = H5Sget_simple_extent_ndims(space);
+  CHECK_GE(ndims, 1) << "Input must have at least 1 axis.";
+  dims->resize(ndims);
+  H5Sget_simple_extent_dims(space, &(*dims)[0], NULL);
+  H5Sclose(space);
+  return dataset;
+}
+
+// Reads rows [first, first + rows) of the dataset into data.
+static void hdf5_read_rows(hid_t dataset, hid_t type, hsize_t first,
+    hsize_t rows, void* data) {
+  hid_t file_space = H5Dget_space(dataset);
+  const int ndims = H5Sget_simple_extent_ndims(file_space);
+  vector<hsize_t> start(ndims, 0);
+  vector<hsize_t> count(ndims);
+  H5Sget_simple_extent_dims(file_space, &count[0], NULL);
+  start[0] = first;
+  count[0] = rows;
+  herr_t status = H5Sselect_hyperslab(file_space, H5S_SELECT_SET, &start[0],
+      NULL, &count[0], NULL);
+  CHECK_GE(status, 0) << "Failed to select HDF5 rows";
+  hid_t mem_space = H5Screate_simple(ndims, &count[0], NULL);
+  status = H5Dread(dataset, type, mem_space, file_space, H5P_DEFAULT, data);
+  CHECK_GE(status, 0) << "Failed to read HDF5 rows " << first << " to "
+      << first + rows;
+  H5Sclose(mem_space);
+  H5Sclose(file_space);
+}
+
+template <typename Dtype>
+HDF5StreamDataLayer<Dtype>::~HDF5StreamDataLayer<Dtype>() {
+  this->StopInternalThread();
+  CloseFile();
+}
+
+template <typename Dtype>
+void HDF5StreamDataLayer<Dtype>::DataLayerSetUp(
+    const vector<Blob<Dtype>*>& bottom, const vector<Blob<Dtype>*>& top) {
+  // Refuse transformation parameters since HDF5 is totally generic.
+  CHECK(!this->layer_param_.has_transform_param()) <<
+      this->type() << " does not transform data.";
+  // Read the source to parse the filenames.
+  const string& source = this->layer_param_.hdf5_data_param().source();
+  LOG(INFO) << "Streaming list of HDF5 filenames from: " << source;
+  hdf_filenames_.clear();
+  std::ifstream source_file(source.c_str());
+  if (source_file.is_open()) {
+    std::string line;
+    while (source_file >> line) {
+      hdf_filenames_.push_back(line);
+    }
+  } else {
+    LOG(FATAL) << "Failed to open source file: " << source;
+  }
+  source_file.close();
+  const int num_files = hdf_filenames_.size();
+  LOG(INFO) << "Number of HDF5 files: " << num_files;
+  CHECK_GE(num_files, 1) << "Must have at least 1 HDF5 filename listed in "
+    << source;
+  file_permutation_.resize(num_files);
+  for (int i = 0; i < num_files; ++i) {
+    file_permutation_[i] = i;
+  }
+  // The prefetch thread starts with the first file, in a shuffled order
+  // if need be.
+  current_file_ = num_files;
+  chunks_.clear();
+  next_chunk_ = 0;
+  chunk_permutation_.clear();
+  chunk_row_ = 0;
+
+  // Shape the tops like the rows of the datasets of the first file.
+  HDF5Lock lock;
+  hid_t file_id = H5Fopen(hdf_filenames_[0].c_str(), H5F_ACC_RDONLY,
+      H5P_DEFAULT);
+  CHECK_GE(file_id, 0) << "Failed opening HDF5 file: " << hdf_filenames_[0];
+  const int batch_size = this->layer_param_.hdf5_data_param().batch_size();
+  const int top_size = this->layer_param_.top_size();
+  chunk_.resize(top_size);
+  for (int i = 0; i < this->PREFETCH_COUNT; ++i) {
+    this->prefetch_[i].extra_.resize(std::max(top_size - 2, 0));
+  }
+  for (int i = 0; i < top_size; ++i) {
+    vector<hsize_t> dims;
+    H5Dclose(hdf5_open_dataset(file_id, this->layer_param_.top(i), &dims));
+    vector<int> top_shape(dims.size());
+    top_shape[0] = batch_size;
+    for (int j = 1; j < dims.size(); ++j) {
+      top_shape[j] = dims[j];
+    }
+    top[i]->Reshape(top_shape);
+    chunk_[i].reset(new Blob<Dtype>(top_shape));
+    for (int j = 0; j < this->PREFETCH_COUNT; ++j) {
+      Batch<Dtype>& batch = this->prefetch_[j];
+      if (i == 0) {
+        batch.data_.Reshape(top_shape);
+      } else if (i == 1) {
+        batch.label_.Reshape(top_shape);
+      } else {
+        batch.extra_[i - 2].reset(new Blob<Dtype>(top_shape));
+      }
+    }
+  }
+  herr_t status = H5Fclose(file_id);
+  CHECK_GE(status, 0) << "Failed to close HDF5 file: " << hdf_filenames_[0];
+}
+
+template <typename Dtype>
+void HDF5StreamDataLayer<Dtype>::CloseFile() {
+  HDF5Lock lock;
+  for (int i = 0; i < datasets_.size(); ++i) {
+    H5Dclose(datasets_[i]);
+  }
+  datasets_.clear();
+  if (file_id_ >= 0) {
+    herr_t status = H5Fclose(file_id_);
+    CHECK_GE(status, 0) << "Failed to close HDF5 file";
+    file_id_ = -1;
+  }
+}
+
+template <typename Dtype>
+void HDF5StreamDataLayer<Dtype>::NextFile() {
+  CloseFile();
+  const bool shuffle = this->layer_param_.hdf5_data_param().shuffle();
+  if (++current_file_ >= hdf_filenames_.size()) {
+    current_file_ = 0;
+    if (shuffle) {
+      caffe::shuffle(file_permutation_.begin(), file_permutation_.end());
+    }
+    DLOG(INFO) << "Looping around to first file.";
+  }
+  const string& filename = hdf_filenames_[file_permutation_[current_file_]];
+  DLOG(INFO) << "Streaming HDF5 file: " << filename;
+  HDF5Lock lock;
+  file_id_ = H5Fopen(filename.c_str(), H5F_ACC_RDONLY, H5P_DEFAULT);
+  CHECK_GE(file_id_, 0) << "Failed opening HDF5 file: " << filename;
+  for (int i = 0; i < chunk_.size(); ++i) {
+    vector<hsize_t> dims;
+    datasets_.push_back(
+        hdf5_open_dataset(file_id_, this->layer_param_.top(i), &dims));
+    CHECK_EQ(dims.size(), chunk_[i]->num_axes())
+        << "Dataset " << this->layer_param_.top(i) << " of " << filename
+        << " differs in shape from the first file";
+    for (int j = 1; j < dims.size(); ++j) {
+      CHECK_EQ(dims[j], chunk_[i]->shape(j))
+          << "Dataset " << this->layer_param_.top(i) << " of " << filename
+          << " differs in shape from the first file";
+    }
+    if (i == 0) {
+      file_rows_ = dims[0];
+    } else {
+      CHECK_EQ(dims[0], file_rows_);
+    }
+  }
+  CHECK_GT(file_rows_, 0) << "No rows in HDF5 file: " << filename;
+  const int batch_size = this->layer_param_.hdf5_data_param().batch_size();
+  chunks_.clear();
+  for (hsize_t row = 0; row < file_rows_; row += batch_size) {
+    chunks_.push_back(row);
+  }
+  if (shuffle) {
+    caffe::shuffle(chunks_.begin(), chunks_.end());
+  }
+  next_chunk_ = 0;
+}
+
+template <typename Dtype>
+void HDF5StreamDataLayer<Dtype>::NextChunk() {
+  if (next_chunk_ == chunks_.size()) {
+    NextFile();
+  }
+  const int batch_size = this->layer_param_.hdf5_data_param().batch_size();
+  const hsize_t first = chunks_[next_chunk_++];
+  const hsize_t rows = std::min<hsize_t>(batch_size, file_rows_ - first);
+  {
+    HDF5Lock lock;
+    for (int i = 0; i < chunk_.size(); ++i) {
+      hdf5_read_rows(datasets_[i], hdf5_native_type<Dtype>(), first, rows,
+          chunk_[i]->mutable_cpu_data());
+    }
+  }
+  chunk_permutation_.resize(rows);
+  for (int i = 0; i < rows; ++i) {
+    chunk_permutation_[i] = i;
+  }
+  if (this->layer_param_.hdf5_data_param().shuffle()) {
+    caffe::shuffle(chunk_permutation_.begin(), chunk_permutation_.end());
+  }
+  chunk_row_ = 0;
+}
+
+// This function is called on prefetch thread
+template <typename Dtype>
+void HDF5StreamDataLayer<Dtype>::load_batch(Batch<Dtype>* batch) {
+  const int batch_size = this->layer_param_.hdf5_data_param().batch_size();
+  for (int i = 0; i < batch_size; ++i, ++chunk_row_) {
+    if (chunk_row_ == chunk_permutation_.size()) {
+      NextChunk();
+    }
+    const int row = chunk_permutation_[chunk_row_];
+    for (int j = 0; j < chunk_.size(); ++j) {
+      Blob<Dtype>* blob = j == 0 ? &batch->data_ :
+          j == 1 ? &batch->label_ : batch->extra_[j - 2].get();
+      const int row_dim = blob->count(1);
+      caffe_copy(row_dim, chunk_[j]->cpu_data() + row * row_dim,
+          blob->mutable_cpu_data() + i * row_dim);
+    }
+  }
+}
+
+INSTANTIATE_CLASS(HDF5StreamDataLayer);
+
+}  // namespace caffe
@@ -1,6 +1,7 @@
 #ifdef USE_OPENCV
 #include <opencv2/core/core.hpp>
 
+#include <boost/bind.hpp>
 #include <fstream>  // NOLINT(readability/streams)
 #include <iostream>  // NOLINT(readability/streams)
 #include <string>
@@ -11,12 +12,30 @@
 #include "caffe/layers/base_data_layer.hpp"
 #include "caffe/layers/image_data_layer.hpp"
 #include "caffe/util/benchmark.hpp"
+#include "caffe/util/image_cache.hpp"
 #include "caffe/util/io.hpp"
 #include "caffe/util/math_functions.hpp"
 #include "caffe/util/rng.hpp"
 
 namespace caffe {
 
+// Reads the image at path as the layer parameters say, from the cache if
+// it holds the image already.
+static cv::Mat ReadCachedImage(ImageCache* cache, const string& path,
+    const ImageDataParameter& param) {
+  cv::Mat cv_img;
+  if (cache && cache->Get(path, &cv_img)) {
+    return cv_img;
+  }
+  cv_img = ReadImageToCVMat(path, param.new_height(), param.new_width(),
+      param.is_color());
+  CHECK(cv_img.data) << "Could not load " << path;
+  if (cache) {
+    cache->Put(path, cv_img);
+  }
+  return cv_img;
+}
+
 template <typename Dtype>
 ImageDataLayer<Dtype>::~ImageDataLayer<Dtype>() {
   this->StopInternalThread();
@@ -25,10 +44,11 @@ ImageDataLayer<Dtype>::~ImageDataLayer<Dtype>() {
 template <typename Dtype>
 void ImageDataLayer<Dtype>::DataLayerSetUp(const vector<Blob<Dtype>*>& bottom,
       const vector<Blob<Dtype>*>& top) {
-  const int new_height = this->layer_param_.image_data_param().new_height();
-  const int new_width  = this->layer_param_.image_data_param().new_width();
-  const bool is_color  = this->layer_param_.image_data_param().is_color();
-  string root_folder = this->layer_param_.image_data_param().root_folder();
+  const ImageDataParameter& image_data_param =
+      this->layer_param_.image_data_param();
+  const int new_height = image_data_param.new_height();
+  const int new_width  = image_data_param.new_width();
+  string root_folder = image_data_param.root_folder();
 
   CHECK((new_height == 0 && new_width == 0) ||
       (new_height > 0 && new_width > 0)) << "Current implementation requires "
@@ -61,10 +81,21 @@ void ImageDataLayer<Dtype>::DataLayerSetUp(const vector<Blob<Dtype>*>& bottom,
     CHECK_GT(lines_.size(), skip) << "Not enough points to skip";
     lines_id_ = skip;
   }
+  switch (image_data_param.cache()) {
+  case ImageDataParameter_Cache_LRU:
+    CHECK_GT(image_data_param.cache_size_mb(), 0);
+    cache_.reset(new ImageCache(
+        static_cast<size_t>(image_data_param.cache_size_mb()) << 20));
+    break;
+  case ImageDataParameter_Cache_ALL:
+    cache_.reset(new ImageCache(0));
+    break;
+  default:
+    cache_.reset();
+  }
   // Read an image, and use it to initialize the top blob.
-  cv::Mat cv_img = ReadImageToCVMat(root_folder + lines_[lines_id_].first,
-                                    new_height, new_width, is_color);
-  CHECK(cv_img.data) << "Could not load " << lines_[lines_id_].first;
+  cv::Mat cv_img = ReadCachedImage(cache_.get(),
+      root_folder + lines_[lines_id_].first, image_data_param);
   // Use data_transformer to infer the expected blob shape from a cv_image.
   vector<int> top_shape = this->data_transformer_->InferBlobShape(cv_img);
   this->transformed_data_.Reshape(top_shape);
@@ -86,6 +117,7 @@ void ImageDataLayer<Dtype>::DataLayerSetUp(const vector<Blob<Dtype>*>& bottom,
   for (int i = 0; i < this->PREFETCH_COUNT; ++i) {
     this->prefetch_[i].label_.Reshape(label_shape);
   }
+  this->SetUpTransformThreads(image_data_param.decode_threads());
 }
 
 template <typename Dtype>
@@ -105,18 +137,17 @@ void ImageDataLayer<Dtype>::load_batch(Batch<Dtype>* batch) {
   CPUTimer timer;
   CHECK(batch->data_.count());
   CHECK(this->transformed_data_.count());
-  ImageDataParameter image_data_param = this->layer_param_.image_data_param();
+  const ImageDataParameter& image_data_param =
+      this->layer_param_.image_data_param();
   const int batch_size = image_data_param.batch_size();
-  const int new_height = image_data_param.new_height();
-  const int new_width = image_data_param.new_width();
-  const bool is_color = image_data_param.is_color();
   string root_folder = image_data_param.root_folder();
 
   // Reshape according to the first image of each batch
   // on single input batches allows for inputs of varying dimension.
-  cv::Mat cv_img = ReadImageToCVMat(root_folder + lines_[lines_id_].first,
-      new_height, new_width, is_color);
-  CHECK(cv_img.data) << "Could not load " << lines_[lines_id_].first;
+  timer.Start();
+  cv::Mat cv_img = ReadCachedImage(cache_.get(),
+      root_folder + lines_[lines_id_].first, image_data_param);
+  read_time += timer.MicroSeconds();
   // Use data_transformer to infer the expected blob shape from a cv_img.
   vector<int> top_shape = this->data_transformer_->InferBlobShape(cv_img);
   this->transformed_data_.Reshape(top_shape);
@@ -127,41 +158,57 @@ void ImageDataLayer<Dtype>::load_batch(Batch<Dtype>* batch) {
   Dtype* prefetch_data = batch->data_.mutable_cpu_data();
   Dtype* prefetch_label = batch->label_.mutable_cpu_data();
 
-  // datum scales
+  // Pick the lines of the batch, copied since shuffling reorders lines_.
+  vector<std::pair<std::string, int> > items(batch_size);
   const int lines_size = lines_.size();
   for (int item_id = 0; item_id < batch_size; ++item_id) {
-    // get a blob
-    timer.Start();
     CHECK_GT(lines_size, lines_id_);
-    cv::Mat cv_img = ReadImageToCVMat(root_folder + lines_[lines_id_].first,
-        new_height, new_width, is_color);
-    CHECK(cv_img.data) << "Could not load " << lines_[lines_id_].first;
-    read_time += timer.MicroSeconds();
-    timer.Start();
-    // Apply transformations (mirror, crop...) to the image
-    int offset = batch->data_.offset(item_id);
-    this->transformed_data_.set_cpu_data(prefetch_data + offset);
-    this->data_transformer_->Transform(cv_img, &(this->transformed_data_));
-    trans_time += timer.MicroSeconds();
-
-    prefetch_label[item_id] = lines_[lines_id_].second;
+    items[item_id] = lines_[lines_id_];
     // go to the next iter
     lines_id_++;
     if (lines_id_ >= lines_size) {
       // We have reached the end. Restart from the first.
       DLOG(INFO) << "Restarting data prefetching from start.";
       lines_id_ = 0;
-      if (this->layer_param_.image_data_param().shuffle()) {
+      if (image_data_param.shuffle()) {
         ShuffleImages();
       }
+      if (cache_) {
+        DLOG(INFO) << "Image cache: " << cache_->size() << " images, "
+            << (cache_->bytes() >> 20) << " MB, " << cache_->hits()
+            << " hits, " << cache_->misses() << " misses.";
+      }
     }
   }
+  timer.Start();
+  this->TransformBatch(batch_size,
+      boost::bind(&ImageDataLayer<Dtype>::LoadItem, this,
+          boost::cref(items), prefetch_data, prefetch_label, _1, _2, _3));
+  trans_time += timer.MicroSeconds();
   batch_timer.Stop();
   DLOG(INFO) << "Prefetch batch: " << batch_timer.MilliSeconds() << " ms.";
   DLOG(INFO) << "     Read time: " << read_time / 1000 << " ms.";
   DLOG(INFO) << "Transform time: " << trans_time / 1000 << " ms.";
 }
 
+// This function is called on the decode threads
+template <typename Dtype>
+void ImageDataLayer<Dtype>::LoadItem(
+    const vector<std::pair<std::string, int> >& items, Dtype* top_data,
+    Dtype* top_label, const int item_id, DataTransformer<Dtype>* transformer,
+    Blob<Dtype>* transformed_data) {
+  const ImageDataParameter& image_data_param =
+      this->layer_param_.image_data_param();
+  cv::Mat cv_img = ReadCachedImage(cache_.get(),
+      image_data_param.root_folder() + items[item_id].first,
+      image_data_param);
+  // Apply transformations (mirror, crop...) to the image
+  transformed_data->set_cpu_data(
+      top_data + item_id * transformed_data->count());
+  transformer->Transform(cv_img, transformed_data);
+  top_label[item_id] = items[item_id].second;
+}
+
 INSTANTIATE_CLASS(ImageDataLayer);
 REGISTER_LAYER_CLASS(ImageData);
 
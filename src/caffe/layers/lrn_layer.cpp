@@ -2,6 +2,7 @@
 
 #include "caffe/layers/lrn_layer.hpp"
 #include "caffe/util/math_functions.hpp"
+#include "caffe/util/workspace.hpp"
 
 namespace caffe {
 
@@ -89,6 +90,23 @@ void LRNLayer<Dtype>::Reshape(const vector<Blob<Dtype>*>& bottom,
   }
 }
 
+template <typename Dtype>
+void LRNLayer<Dtype>::AppendWorkspace(bool forward_only,
+    Workspace* workspace) {
+  // The intermediate results are only kept for Backward.
+  if (!forward_only) { return; }
+  switch (this->layer_param_.lrn_param().norm_region()) {
+  case LRNParameter_NormRegion_ACROSS_CHANNELS:
+    workspace->Add(&scale_);
+    break;
+  case LRNParameter_NormRegion_WITHIN_CHANNEL:
+    workspace->Add(&square_output_);
+    workspace->Add(&pool_output_);
+    workspace->Add(&power_output_);
+    break;
+  }
+}
+
 template <typename Dtype>
 void LRNLayer<Dtype>::Forward_cpu(const vector<Blob<Dtype>*>& bottom,
     const vector<Blob<Dtype>*>& top) {
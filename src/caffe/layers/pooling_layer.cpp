@@ -4,6 +4,7 @@
 
 #include "caffe/layers/pooling_layer.hpp"
 #include "caffe/util/math_functions.hpp"
+#include "caffe/util/workspace.hpp"
 
 namespace caffe {
 
@@ -122,6 +123,16 @@ void PoolingLayer<Dtype>::Reshape(const vector<Blob<Dtype>*>& bottom,
   }
 }
 
+template <typename Dtype>
+void PoolingLayer<Dtype>::AppendWorkspace(bool forward_only,
+    Workspace* workspace) {
+  // The indices are only kept for Backward.
+  if (forward_only) {
+    workspace->Add(&max_idx_);
+    workspace->Add(&rand_idx_);
+  }
+}
+
 // TODO(Yangqing): Is there a faster way to do pooling in the channel-first
 // case?
 template <typename Dtype>
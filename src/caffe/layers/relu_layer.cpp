@@ -1,10 +1,31 @@
+#include <boost/bind.hpp>
 #include <algorithm>
 #include <vector>
 
 #include "caffe/layers/relu_layer.hpp"
+#include "caffe/util/thread_pool.hpp"
 
 namespace caffe {
 
+template <typename Dtype>
+static void relu_forward_range(const Dtype* bottom_data, Dtype* top_data,
+    const Dtype negative_slope, const int begin, const int end) {
+  for (int i = begin; i < end; ++i) {
+    top_data[i] = std::max(bottom_data[i], Dtype(0))
+        + negative_slope * std::min(bottom_data[i], Dtype(0));
+  }
+}
+
+template <typename Dtype>
+static void relu_backward_range(const Dtype* bottom_data,
+    const Dtype* top_diff, Dtype* bottom_diff, const Dtype negative_slope,
+    const int begin, const int end) {
+  for (int i = begin; i < end; ++i) {
+    bottom_diff[i] = top_diff[i] * ((bottom_data[i] > 0)
+        + negative_slope * (bottom_data[i] <= 0));
+  }
+}
+
 template <typename Dtype>
 void ReLULayer<Dtype>::Forward_cpu(const vector<Blob<Dtype>*>& bottom,
     const vector<Blob<Dtype>*>& top) {
@@ -12,10 +33,8 @@ void ReLULayer<Dtype>::Forward_cpu(const vector<Blob<Dtype>*>& bottom,
   Dtype* top_data = top[0]->mutable_cpu_data();
   const int count = bottom[0]->count();
   Dtype negative_slope = this->layer_param_.relu_param().negative_slope();
-  for (int i = 0; i < count; ++i) {
-    top_data[i] = std::max(bottom_data[i], Dtype(0))
-        + negative_slope * std::min(bottom_data[i], Dtype(0));
-  }
+  caffe_cpu_parallel_for(count, boost::bind(&relu_forward_range<Dtype>,
+      bottom_data, top_data, negative_slope, _1, _2));
 }
 
 template <typename Dtype>
@@ -28,10 +47,8 @@ void ReLULayer<Dtype>::Backward_cpu(const vector<Blob<Dtype>*>& top,
     Dtype* bottom_diff = bottom[0]->mutable_cpu_diff();
     const int count = bottom[0]->count();
     Dtype negative_slope = this->layer_param_.relu_param().negative_slope();
-    for (int i = 0; i < count; ++i) {
-      bottom_diff[i] = top_diff[i] * ((bottom_data[i] > 0)
-          + negative_slope * (bottom_data[i] <= 0));
-    }
+    caffe_cpu_parallel_for(count, boost::bind(&relu_backward_range<Dtype>,
+        bottom_data, top_diff, bottom_diff, negative_slope, _1, _2));
   }
 }
 
@@ -1,7 +1,9 @@
+#include <boost/bind.hpp>
 #include <cmath>
 #include <vector>
 
 #include "caffe/layers/sigmoid_layer.hpp"
+#include "caffe/util/thread_pool.hpp"
 
 namespace caffe {
 
@@ -10,15 +12,32 @@ inline Dtype sigmoid(Dtype x) {
   return 1. / (1. + exp(-x));
 }
 
+template <typename Dtype>
+static void sigmoid_forward_range(const Dtype* bottom_data, Dtype* top_data,
+    const int begin, const int end) {
+  for (int i = begin; i < end; ++i) {
+    top_data[i] = sigmoid(bottom_data[i]);
+  }
+}
+
+template <typename Dtype>
+static void sigmoid_backward_range(const Dtype* top_data,
+    const Dtype* top_diff, Dtype* bottom_diff, const int begin,
+    const int end) {
+  for (int i = begin; i < end; ++i) {
+    const Dtype sigmoid_x = top_data[i];
+    bottom_diff[i] = top_diff[i] * sigmoid_x * (1. - sigmoid_x);
+  }
+}
+
 template <typename Dtype>
 void SigmoidLayer<Dtype>::Forward_cpu(const vector<Blob<Dtype>*>& bottom,
     const vector<Blob<Dtype>*>& top) {
   const Dtype* bottom_data = bottom[0]->cpu_data();
   Dtype* top_data = top[0]->mutable_cpu_data();
   const int count = bottom[0]->count();
-  for (int i = 0; i < count; ++i) {
-    top_data[i] = sigmoid(bottom_data[i]);
-  }
+  caffe_cpu_parallel_for(count, boost::bind(&sigmoid_forward_range<Dtype>,
+      bottom_data, top_data, _1, _2));
 }
 
 template <typename Dtype>
@@ -30,10 +49,8 @@ void SigmoidLayer<Dtype>::Backward_cpu(const vector<Blob<Dtype>*>& top,
     const Dtype* top_diff = top[0]->cpu_diff();
     Dtype* bottom_diff = bottom[0]->mutable_cpu_diff();
     const int count = bottom[0]->count();
-    for (int i = 0; i < count; ++i) {
-      const Dtype sigmoid_x = top_data[i];
-      bottom_diff[i] = top_diff[i] * sigmoid_x * (1. - sigmoid_x);
-    }
+    caffe_cpu_parallel_for(count, boost::bind(&sigmoid_backward_range<Dtype>,
+        top_data, top_diff, bottom_diff, _1, _2));
   }
 }
 
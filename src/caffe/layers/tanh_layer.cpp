@@ -1,21 +1,40 @@
 // TanH neuron activation function layer.
 // Adapted from ReLU layer code written by Yangqing Jia
 
+#include <boost/bind.hpp>
 #include <vector>
 
 #include "caffe/layers/tanh_layer.hpp"
+#include "caffe/util/thread_pool.hpp"
 
 namespace caffe {
 
+template <typename Dtype>
+static void tanh_forward_range(const Dtype* bottom_data, Dtype* top_data,
+    const int begin, const int end) {
+  for (int i = begin; i < end; ++i) {
+    top_data[i] = tanh(bottom_data[i]);
+  }
+}
+
+template <typename Dtype>
+static void tanh_backward_range(const Dtype* top_data, const Dtype* top_diff,
+    Dtype* bottom_diff, const int begin, const int end) {
+  Dtype tanhx;
+  for (int i = begin; i < end; ++i) {
+    tanhx = top_data[i];
+    bottom_diff[i] = top_diff[i] * (1 - tanhx * tanhx);
+  }
+}
+
 template <typename Dtype>
 void TanHLayer<Dtype>::Forward_cpu(const vector<Blob<Dtype>*>& bottom,
     const vector<Blob<Dtype>*>& top) {
   const Dtype* bottom_data = bottom[0]->cpu_data();
   Dtype* top_data = top[0]->mutable_cpu_data();
   const int count = bottom[0]->count();
-  for (int i = 0; i < count; ++i) {
-    top_data[i] = tanh(bottom_data[i]);
-  }
+  caffe_cpu_parallel_for(count, boost::bind(&tanh_forward_range<Dtype>,
+      bottom_data, top_data, _1, _2));
 }
 
 template <typename Dtype>
@@ -27,11 +46,8 @@ void TanHLayer<Dtype>::Backward_cpu(const vector<Blob<Dtype>*>& top,
     const Dtype* top_diff = top[0]->cpu_diff();
     Dtype* bottom_diff = bottom[0]->mutable_cpu_diff();
     const int count = bottom[0]->count();
-    Dtype tanhx;
-    for (int i = 0; i < count; ++i) {
-      tanhx = top_data[i];
-      bottom_diff[i] = top_diff[i] * (1 - tanhx * tanhx);
-    }
+    caffe_cpu_parallel_for(count, boost::bind(&tanh_backward_range<Dtype>,
+        top_data, top_diff, bottom_diff, _1, _2));
   }
 }
 
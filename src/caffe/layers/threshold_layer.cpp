@@ -1,9 +1,19 @@
+#include <boost/bind.hpp>
 #include <vector>
 
 #include "caffe/layers/threshold_layer.hpp"
+#include "caffe/util/thread_pool.hpp"
 
 namespace caffe {
 
+template <typename Dtype>
+static void threshold_forward_range(const Dtype* bottom_data, Dtype* top_data,
+    const Dtype threshold, const int begin, const int end) {
+  for (int i = begin; i < end; ++i) {
+    top_data[i] = (bottom_data[i] > threshold) ? Dtype(1) : Dtype(0);
+  }
+}
+
 template <typename Dtype>
 void ThresholdLayer<Dtype>::LayerSetUp(const vector<Blob<Dtype>*>& bottom,
       const vector<Blob<Dtype>*>& top) {
@@ -17,9 +27,8 @@ void ThresholdLayer<Dtype>::Forward_cpu(const vector<Blob<Dtype>*>& bottom,
   const Dtype* bottom_data = bottom[0]->cpu_data();
   Dtype* top_data = top[0]->mutable_cpu_data();
   const int count = bottom[0]->count();
-  for (int i = 0; i < count; ++i) {
-    top_data[i] = (bottom_data[i] > threshold_) ? Dtype(1) : Dtype(0);
-  }
+  caffe_cpu_parallel_for(count, boost::bind(&threshold_forward_range<Dtype>,
+      bottom_data, top_data, threshold_, _1, _2));
 }
 
 #ifdef CPU_ONLY
@@ -0,0 +1,285 @@
+#include <boost/bind.hpp>
+#include <algorithm>
+#include <vector>
+
+#include "caffe/layers/winograd_conv_layer.hpp"
+#include "caffe/util/math_functions.hpp"
+#include "caffe/util/thread_pool.hpp"
+#include "caffe/util/workspace.hpp"
+
+namespace caffe {
+
+// The largest input tile, that of F(4x4, 3x3).
+static const int kMaxWinogradTileDim = 6;
+
+// Filter (G), input (B^T) and output (A^T) transforms of F(2x2, 3x3).
+static const double kWinogradG2[4 * 3] = {
+  1.0,  0.0, 0.0,
+  0.5,  0.5, 0.5,
+  0.5, -0.5, 0.5,
+  0.0,  0.0, 1.0
+};
+static const double kWinogradBT2[4 * 4] = {
+  1.0,  0.0, -1.0,  0.0,
+  0.0,  1.0,  1.0,  0.0,
+  0.0, -1.0,  1.0,  0.0,
+  0.0,  1.0,  0.0, -1.0
+};
+static const double kWinogradAT2[2 * 4] = {
+  1.0, 1.0,  1.0,  0.0,
+  0.0, 1.0, -1.0, -1.0
+};
+
+// Filter (G), input (B^T) and output (A^T) transforms of F(4x4, 3x3).
+static const double kWinogradG4[6 * 3] = {
+  1.0 / 4,    0.0,        0.0,
+  -1.0 / 6,   -1.0 / 6,   -1.0 / 6,
+  -1.0 / 6,   1.0 / 6,    -1.0 / 6,
+  1.0 / 24,   1.0 / 12,   1.0 / 6,
+  1.0 / 24,   -1.0 / 12,  1.0 / 6,
+  0.0,        0.0,        1.0
+};
+static const double kWinogradBT4[6 * 6] = {
+  4.0,  0.0, -5.0,  0.0, 1.0, 0.0,
+  0.0, -4.0, -4.0,  1.0, 1.0, 0.0,
+  0.0,  4.0, -4.0, -1.0, 1.0, 0.0,
+  0.0, -2.0, -1.0,  2.0, 1.0, 0.0,
+  0.0,  2.0, -1.0, -2.0, 1.0, 0.0,
+  0.0,  4.0,  0.0, -5.0, 0.0, 1.0
+};
+static const double kWinogradAT4[4 * 6] = {
+  1.0, 1.0,  1.0, 1.0,  1.0, 0.0,
+  0.0, 1.0, -1.0, 2.0, -2.0, 0.0,
+  0.0, 1.0,  1.0, 4.0,  4.0, 0.0,
+  0.0, 1.0, -1.0, 8.0, -8.0, 1.0
+};
+
+template <typename Dtype>
+void WinogradConvolutionLayer<Dtype>::Reshape(
+    const vector<Blob<Dtype>*>& bottom, const vector<Blob<Dtype>*>& top) {
+  ConvolutionLayer<Dtype>::Reshape(bottom, top);
+  const int* kernel_shape = this->kernel_shape_.cpu_data();
+  const int* stride = this->stride_.cpu_data();
+  const int* dilation = this->dilation_.cpu_data();
+  use_winograd_ = this->num_spatial_axes_ == 2 && !this->force_nd_im2col_ &&
+      kernel_shape[0] == 3 && kernel_shape[1] == 3 &&
+      stride[0] == 1 && stride[1] == 1 &&
+      dilation[0] == 1 && dilation[1] == 1;
+  if (!use_winograd_) {
+    return;
+  }
+  tile_size_ = this->layer_param_.convolution_param().winograd_tile_size();
+  CHECK(tile_size_ == 2 || tile_size_ == 4)
+      << "winograd_tile_size must be 2 or 4.";
+  tile_dim_ = tile_size_ + 2;
+  tiles_h_ = (this->output_shape_[0] + tile_size_ - 1) / tile_size_;
+  tiles_w_ = (this->output_shape_[1] + tile_size_ - 1) / tile_size_;
+  vector<int> shape(3);
+  shape[0] = tile_dim_ * tile_dim_;
+  shape[1] = this->num_output_;
+  shape[2] = this->channels_ / this->group_;
+  if (transformed_weights_.shape() != shape) {
+    transformed_weights_.Reshape(shape);
+    transform_weights();
+  }
+  shape[1] = this->channels_;
+  shape[2] = tiles_h_ * tiles_w_;
+  transformed_input_.Reshape(shape);
+  shape[1] = this->num_output_;
+  transformed_output_.Reshape(shape);
+}
+
+template <typename Dtype>
+void WinogradConvolutionLayer<Dtype>::AppendWorkspace(bool forward_only,
+    Workspace* workspace) {
+  ConvolutionLayer<Dtype>::AppendWorkspace(forward_only, workspace);
+  // The tiles are transformed anew for every image.
+  if (use_winograd_) {
+    workspace->Add(&transformed_input_);
+    workspace->Add(&transformed_output_);
+  }
+}
+
+template <typename Dtype>
+void WinogradConvolutionLayer<Dtype>::transform_weights() {
+  const double* G = tile_size_ == 2 ? kWinogradG2 : kWinogradG4;
+  const int alpha = tile_dim_;
+  const int num_filters = this->blobs_[0]->count(0, 2);
+  const Dtype* weight = this->blobs_[0]->cpu_data();
+  Dtype* transformed = transformed_weights_.mutable_cpu_data();
+  for (int f = 0; f < num_filters; ++f) {
+    const Dtype* g = weight + f * 9;
+    // U = G g G^T
+    double Gg[kMaxWinogradTileDim][3];
+    for (int i = 0; i < alpha; ++i) {
+      for (int j = 0; j < 3; ++j) {
+        Gg[i][j] = G[i * 3] * g[j] + G[i * 3 + 1] * g[3 + j] +
+            G[i * 3 + 2] * g[6 + j];
+      }
+    }
+    for (int i = 0; i < alpha; ++i) {
+      for (int j = 0; j < alpha; ++j) {
+        transformed[(i * alpha + j) * num_filters + f] = Gg[i][0] * G[j * 3] +
+            Gg[i][1] * G[j * 3 + 1] + Gg[i][2] * G[j * 3 + 2];
+      }
+    }
+  }
+  transformed_memory_ = this->blobs_[0]->data();
+  transformed_version_ = transformed_memory_->version();
+}
+
+template <typename Dtype>
+void WinogradConvolutionLayer<Dtype>::transform_input(const Dtype* input,
+    Dtype* transformed_input, const int begin, const int end) {
+  const double* BT = tile_size_ == 2 ? kWinogradBT2 : kWinogradBT4;
+  const int alpha = tile_dim_;
+  const int height = this->input_shape(1);
+  const int width = this->input_shape(2);
+  const int pad_h = this->pad_.cpu_data()[0];
+  const int pad_w = this->pad_.cpu_data()[1];
+  const int num_tiles = tiles_h_ * tiles_w_;
+  const int stride = this->channels_ * num_tiles;
+  for (int c = begin; c < end; ++c) {
+    const Dtype* plane = input + c * height * width;
+    Dtype* V = transformed_input + c * num_tiles;
+    for (int ty = 0; ty < tiles_h_; ++ty) {
+      for (int tx = 0; tx < tiles_w_; ++tx) {
+        // Gather the zero padded tile d.
+        Dtype d[kMaxWinogradTileDim][kMaxWinogradTileDim];
+        for (int i = 0; i < alpha; ++i) {
+          const int y = ty * tile_size_ - pad_h + i;
+          for (int j = 0; j < alpha; ++j) {
+            const int x = tx * tile_size_ - pad_w + j;
+            d[i][j] = (y >= 0 && y < height && x >= 0 && x < width) ?
+                plane[y * width + x] : Dtype(0);
+          }
+        }
+        // V = B^T d B
+        Dtype BTd[kMaxWinogradTileDim][kMaxWinogradTileDim];
+        for (int i = 0; i < alpha; ++i) {
+          for (int j = 0; j < alpha; ++j) {
+            Dtype sum = 0;
+            for (int k = 0; k < alpha; ++k) {
+              sum += BT[i * alpha + k] * d[k][j];
+            }
+            BTd[i][j] = sum;
+          }
+        }
+        const int t = ty * tiles_w_ + tx;
+        for (int i = 0; i < alpha; ++i) {
+          for (int j = 0; j < alpha; ++j) {
+            Dtype sum = 0;
+            for (int k = 0; k < alpha; ++k) {
+              sum += BTd[i][k] * BT[j * alpha + k];
+            }
+            V[(i * alpha + j) * stride + t] = sum;
+          }
+        }
+      }
+    }
+  }
+}
+
+template <typename Dtype>
+void WinogradConvolutionLayer<Dtype>::transform_output(
+    const Dtype* transformed_output, const Dtype* bias, Dtype* output,
+    const int begin, const int end) {
+  const double* AT = tile_size_ == 2 ? kWinogradAT2 : kWinogradAT4;
+  const int alpha = tile_dim_;
+  const int output_h = this->output_shape_[0];
+  const int output_w = this->output_shape_[1];
+  const int num_tiles = tiles_h_ * tiles_w_;
+  const int stride = this->num_output_ * num_tiles;
+  const bool relu = this->fuse_relu();
+  for (int o = begin; o < end; ++o) {
+    const Dtype* M = transformed_output + o * num_tiles;
+    Dtype* plane = output + o * output_h * output_w;
+    const Dtype b = bias ? bias[o] : Dtype(0);
+    for (int ty = 0; ty < tiles_h_; ++ty) {
+      for (int tx = 0; tx < tiles_w_; ++tx) {
+        const int t = ty * tiles_w_ + tx;
+        // Y = A^T M A
+        Dtype ATM[kMaxWinogradTileDim][kMaxWinogradTileDim];
+        for (int i = 0; i < tile_size_; ++i) {
+          for (int j = 0; j < alpha; ++j) {
+            Dtype sum = 0;
+            for (int k = 0; k < alpha; ++k) {
+              sum += AT[i * alpha + k] * M[(k * alpha + j) * stride + t];
+            }
+            ATM[i][j] = sum;
+          }
+        }
+        const int y_end = std::min(tile_size_, output_h - ty * tile_size_);
+        const int x_end = std::min(tile_size_, output_w - tx * tile_size_);
+        for (int i = 0; i < y_end; ++i) {
+          Dtype* row = plane + (ty * tile_size_ + i) * output_w +
+              tx * tile_size_;
+          for (int j = 0; j < x_end; ++j) {
+            Dtype sum = b;
+            for (int k = 0; k < alpha; ++k) {
+              sum += ATM[i][k] * AT[j * alpha + k];
+            }
+            row[j] = (relu && sum < 0) ? Dtype(0) : sum;
+          }
+        }
+      }
+    }
+  }
+}
+
+template <typename Dtype>
+void WinogradConvolutionLayer<Dtype>::Forward_cpu(
+    const vector<Blob<Dtype>*>& bottom, const vector<Blob<Dtype>*>& top) {
+  if (!use_winograd_) {
+    ConvolutionLayer<Dtype>::Forward_cpu(bottom, top);
+    return;
+  }
+  // The cached transforms are stale if the weights were shared with another
+  // blob or written since they were computed, e.g. by loading a model or a
+  // solver step.
+  const shared_ptr<SyncedMemory>& weights = this->blobs_[0]->data();
+  if (weights != transformed_memory_ ||
+      weights->version() != transformed_version_) {
+    transform_weights();
+  }
+  const int tile_count = tile_dim_ * tile_dim_;
+  const int num_tiles = tiles_h_ * tiles_w_;
+  const int channels_per_group = this->channels_ / this->group_;
+  const int outputs_per_group = this->num_output_ / this->group_;
+  const Dtype* U = transformed_weights_.cpu_data();
+  Dtype* V = transformed_input_.mutable_cpu_data();
+  Dtype* M = transformed_output_.mutable_cpu_data();
+  const Dtype* bias = this->bias_term_ ? this->blobs_[1]->cpu_data() : NULL;
+  // Both transforms cost about tile_dim_ multiply-adds per tile value.
+  const int transform_grain = std::max(1, kCPUParallelGrain /
+      std::max(1, tile_count * num_tiles * tile_dim_));
+  for (int i = 0; i < bottom.size(); ++i) {
+    const Dtype* bottom_data = bottom[i]->cpu_data();
+    Dtype* top_data = top[i]->mutable_cpu_data();
+    for (int n = 0; n < this->num_; ++n) {
+      caffe_cpu_parallel_for(this->channels_,
+          boost::bind(&WinogradConvolutionLayer<Dtype>::transform_input, this,
+          bottom_data + n * this->bottom_dim_, V, _1, _2), transform_grain);
+      for (int xi = 0; xi < tile_count; ++xi) {
+        for (int g = 0; g < this->group_; ++g) {
+          caffe_cpu_gemm<Dtype>(CblasNoTrans, CblasNoTrans,
+              outputs_per_group, num_tiles, channels_per_group, (Dtype)1.,
+              U + (xi * this->num_output_ + g * outputs_per_group) *
+              channels_per_group,
+              V + (xi * this->channels_ + g * channels_per_group) * num_tiles,
+              (Dtype)0.,
+              M + (xi * this->num_output_ + g * outputs_per_group) *
+              num_tiles);
+        }
+      }
+      caffe_cpu_parallel_for(this->num_output_,
+          boost::bind(&WinogradConvolutionLayer<Dtype>::transform_output,
+          this, M, bias, top_data + n * this->top_dim_, _1, _2),
+          transform_grain);
+    }
+  }
+}
+
+INSTANTIATE_CLASS(WinogradConvolutionLayer);
+
+}  // namespace caffe
@@ -1,4 +1,9 @@
+#include <boost/bind.hpp>
+#include <boost/function.hpp>
+#include <boost/thread.hpp>
 #include <algorithm>
+#include <cstring>
+#include <deque>
 #include <map>
 #include <set>
 #include <string>
@@ -12,10 +17,13 @@
 #include "caffe/net.hpp"
 #include "caffe/parallel.hpp"
 #include "caffe/proto/caffe.pb.h"
+#include "caffe/util/fuse_layers.hpp"
 #include "caffe/util/hdf5.hpp"
 #include "caffe/util/insert_splits.hpp"
 #include "caffe/util/math_functions.hpp"
+#include "caffe/util/thread_pool.hpp"
 #include "caffe/util/upgrade_proto.hpp"
+#include "caffe/util/workspace.hpp"
 
 #include "caffe/test/test_caffe_main.hpp"
 
@@ -46,6 +54,28 @@ void Net<Dtype>::Init(const NetParameter& in_param) {
   // the current NetState.
   NetParameter filtered_param;
   FilterNet(in_param, &filtered_param);
+  // Folding BatchNorm assumes its global statistics are used.
+  fuse_layers_ = filtered_param.fuse_layers() && phase_ == TEST;
+  folded_param_.Clear();
+  folded_layer_names_.clear();
+  folded_source_data_.clear();
+  if (fuse_layers_) {
+    NetParameter unfused_param;
+    unfused_param.Swap(&filtered_param);
+    vector<string> folded_names;
+    FuseLayers(unfused_param, &filtered_param, &folded_names);
+    folded_layer_names_.insert(folded_names.begin(), folded_names.end());
+    // Only the folded layers are folded again when copying trained layers.
+    for (int i = 0; i < unfused_param.layer_size(); ++i) {
+      if (folded_layer_names_.count(unfused_param.layer(i).name())) {
+        LayerParameter* layer_param = folded_param_.add_layer();
+        layer_param->CopyFrom(unfused_param.layer(i));
+        layer_param->clear_blobs();
+      }
+    }
+  } else if (filtered_param.fuse_layers()) {
+    LOG(WARNING) << "Ignoring fuse_layers: the net is not a TEST net.";
+  }
   LOG_IF(INFO, Caffe::root_solver())
       << "Initializing net from parameters: " << std::endl
       << filtered_param.DebugString();
@@ -270,6 +300,25 @@ void Net<Dtype>::Init(const NetParameter& in_param) {
     layer_names_index_[layer_names_[layer_id]] = layer_id;
   }
   ShareWeights();
+  // Layers running at the same time cannot share scratch or activation memory.
+  concurrent_layers_ = param.concurrent_layers();
+  if (concurrent_layers_) {
+    InitLayerDependencies();
+    LOG_IF(INFO, Caffe::root_solver() && param.share_workspace())
+        << "Ignoring share_workspace: layers may run concurrently.";
+    LOG_IF(WARNING, param.reuse_activations())
+        << "Ignoring reuse_activations: layers may run concurrently.";
+  } else if (param.share_workspace()) {
+    workspace_.reset(new Workspace());
+    ShareWorkspace();
+    LOG_IF(INFO, Caffe::root_solver())
+        << "Memory required for layer workspace: "
+        << workspace_->shared_bytes() << " (" << workspace_->unshared_bytes()
+        << " unshared)";
+  }
+  if (param.reuse_activations() && !concurrent_layers_) {
+    PlanActivations(param);
+  }
   debug_info_ = param.debug_info();
   LOG_IF(INFO, Caffe::root_solver()) << "Network initialization done.";
 }
@@ -531,11 +580,154 @@ void Net<Dtype>::AppendParam(const NetParameter& param, const int layer_id,
   }
 }
 
+namespace {
+
+// Runs the layers of [begin, end] on the CPU pool, each once the layers of
+// the range it depends on are done. Threads pick up ready layers until none
+// are left, so a thread only waits while another one is running a layer.
+// The ordered layers, listed in their sequential order, all run in that
+// order on the calling thread, which keeps the numbers they draw from its
+// generator those of a sequential run.
+class LayerGraphRun {
+ public:
+  LayerGraphRun(const int begin, const int end,
+      const vector<vector<int> >& dependencies,
+      const boost::function<void(int)>& run,
+      const vector<int>& ordered_layers)
+      : begin_(begin), run_(run), num_waiting_(end - begin + 1, 0),
+        dependents_(end - begin + 1), num_remaining_(end - begin + 1),
+        ordered_layers_(ordered_layers), is_ordered_(end - begin + 1, false),
+        next_ordered_(0) {
+    for (int i = 0; i < ordered_layers.size(); ++i) {
+      is_ordered_[ordered_layers[i] - begin] = true;
+    }
+    for (int layer_id = begin; layer_id <= end; ++layer_id) {
+      for (int i = 0; i < dependencies[layer_id].size(); ++i) {
+        const int dependency = dependencies[layer_id][i];
+        if (dependency >= begin && dependency <= end) {
+          ++num_waiting_[layer_id - begin];
+          dependents_[dependency - begin].push_back(layer_id);
+        }
+      }
+      if (num_waiting_[layer_id - begin] == 0) {
+        ready_.push_back(layer_id);
+      }
+    }
+  }
+
+  void Run() {
+    const int num_threads = std::min(Caffe::cpu_threads(), num_remaining_);
+    caffe_cpu_parallel_for(num_threads,
+        boost::bind(&LayerGraphRun::Work, this, _1, _2), 1);
+  }
+
+ protected:
+  // The pool runs the first range on the calling thread.
+  void Work(int begin, int) {
+    const bool calling_thread = begin == 0;
+    boost::mutex::scoped_lock lock(mutex_);
+    while (true) {
+      int layer_id = -1;
+      while (num_remaining_ > 0 &&
+          (layer_id = PopReadyLayer(calling_thread)) < 0) {
+        ready_condition_.wait(lock);
+      }
+      if (num_remaining_ == 0) {
+        return;
+      }
+      lock.unlock();
+      run_(layer_id);
+      lock.lock();
+      const vector<int>& dependents = dependents_[layer_id - begin_];
+      for (int i = 0; i < dependents.size(); ++i) {
+        if (--num_waiting_[dependents[i] - begin_] == 0) {
+          ready_.push_back(dependents[i]);
+        }
+      }
+      --num_remaining_;
+      ready_condition_.notify_all();
+    }
+  }
+
+  // Pops the next ordered layer if it is ready and the thread may run it,
+  // or else a ready layer that is not ordered. Returns -1 if there is none.
+  int PopReadyLayer(const bool calling_thread) {
+    if (calling_thread && next_ordered_ < ordered_layers_.size()) {
+      std::deque<int>::iterator it = std::find(ready_.begin(), ready_.end(),
+          ordered_layers_[next_ordered_]);
+      if (it != ready_.end()) {
+        ready_.erase(it);
+        return ordered_layers_[next_ordered_++];
+      }
+    }
+    for (std::deque<int>::iterator it = ready_.begin(); it != ready_.end();
+        ++it) {
+      const int layer_id = *it;
+      if (!is_ordered_[layer_id - begin_]) {
+        ready_.erase(it);
+        return layer_id;
+      }
+    }
+    return -1;
+  }
+
+  const int begin_;
+  const boost::function<void(int)> run_;
+  vector<int> num_waiting_;
+  vector<vector<int> > dependents_;
+  int num_remaining_;
+  std::deque<int> ready_;
+  const vector<int> ordered_layers_;
+  vector<bool> is_ordered_;
+  int next_ordered_;
+  boost::mutex mutex_;
+  boost::condition_variable ready_condition_;
+};
+
+}  // namespace
+
+template <typename Dtype>
+bool Net<Dtype>::RunsLayersConcurrently() const {
+  return concurrent_layers_ && Caffe::mode() == Caffe::CPU &&
+      Caffe::cpu_threads() > 1;
+}
+
+template <typename Dtype>
+void Net<Dtype>::ForwardLayer(const int layer_id, vector<Dtype>* losses) {
+  (*losses)[layer_id] =
+      layers_[layer_id]->Forward(bottom_vecs_[layer_id], top_vecs_[layer_id]);
+}
+
+template <typename Dtype>
+void Net<Dtype>::BackwardLayer(const int layer_id) {
+  if (layer_need_backward_[layer_id]) {
+    layers_[layer_id]->Backward(top_vecs_[layer_id],
+        bottom_need_backward_[layer_id], bottom_vecs_[layer_id]);
+  }
+}
+
 template <typename Dtype>
 Dtype Net<Dtype>::ForwardFromTo(int start, int end) {
   CHECK_GE(start, 0);
   CHECK_LT(end, layers_.size());
   Dtype loss = 0;
+  if (RunsLayersConcurrently() && start < end) {
+    vector<Dtype> losses(layers_.size(), 0);
+    vector<int> ordered_layers;
+    for (int i = start; i <= end; ++i) {
+      if (layers_[i]->DrawsRandomNumbers()) {
+        ordered_layers.push_back(i);
+      }
+    }
+    LayerGraphRun(start, end, layer_dependencies_, boost::bind(
+        &Net<Dtype>::ForwardLayer, this, _1, &losses), ordered_layers).Run();
+    // Sum and report in layer order, as the sequential pass does.
+    for (int i = start; i <= end; ++i) {
+      loss += losses[i];
+      if (debug_info_) { ForwardDebugInfo(i); }
+    }
+    return loss;
+  }
   for (int i = start; i <= end; ++i) {
     // LOG(ERROR) << "Forwarding " << layer_names_[i];
     Dtype layer_loss = layers_[i]->Forward(bottom_vecs_[i], top_vecs_[i]);
@@ -581,6 +773,15 @@ template <typename Dtype>
 void Net<Dtype>::BackwardFromTo(int start, int end) {
   CHECK_GE(end, 0);
   CHECK_LT(start, layers_.size());
+  if (RunsLayersConcurrently() && end < start) {
+    // Backward draws no random numbers.
+    LayerGraphRun(end, start, layer_backward_dependencies_, boost::bind(
+        &Net<Dtype>::BackwardLayer, this, _1), vector<int>()).Run();
+    for (int i = start; i >= end; --i) {
+      if (debug_info_ && layer_need_backward_[i]) { BackwardDebugInfo(i); }
+    }
+    return;
+  }
   for (int i = start; i >= end; --i) {
     if (layer_need_backward_[i]) {
       layers_[i]->Backward(
@@ -672,9 +873,15 @@ void Net<Dtype>::UpdateDebugInfo(const int param_id) {
 template <typename Dtype>
 void Net<Dtype>::ShareTrainedLayersWith(const Net* other) {
   int num_source_layers = other->layers().size();
+  vector<int> folded_source_ids;
   for (int i = 0; i < num_source_layers; ++i) {
     Layer<Dtype>* source_layer = other->layers()[i].get();
     const string& source_layer_name = other->layer_names()[i];
+    if (folded_layer_names_.count(source_layer_name)) {
+      // The fused layers hold folded copies of these blobs.
+      folded_source_ids.push_back(i);
+      continue;
+    }
     int target_layer_id = 0;
     while (target_layer_id != layer_names_.size() &&
         layer_names_[target_layer_id] != source_layer_name) {
@@ -699,6 +906,35 @@ void Net<Dtype>::ShareTrainedLayersWith(const Net* other) {
       target_blobs[j]->ShareData(*source_blob);
     }
   }
+  if (folded_layer_names_.empty()) {
+    return;
+  }
+  // Fold again only if the source blobs were replaced or written since the
+  // last time, e.g. by a solver step between two tests.
+  vector<pair<shared_ptr<SyncedMemory>, unsigned int> > source_data;
+  for (int i = 0; i < folded_source_ids.size(); ++i) {
+    const vector<shared_ptr<Blob<Dtype> > >& source_blobs =
+        other->layers()[folded_source_ids[i]]->blobs();
+    for (int j = 0; j < source_blobs.size(); ++j) {
+      const shared_ptr<SyncedMemory>& data = source_blobs[j]->data();
+      source_data.push_back(make_pair(data, data->version()));
+    }
+  }
+  if (source_data == folded_source_data_) {
+    return;
+  }
+  NetParameter folded_source;
+  for (int i = 0; i < folded_source_ids.size(); ++i) {
+    LayerParameter* layer_param = folded_source.add_layer();
+    layer_param->set_name(other->layer_names()[folded_source_ids[i]]);
+    const vector<shared_ptr<Blob<Dtype> > >& source_blobs =
+        other->layers()[folded_source_ids[i]]->blobs();
+    for (int j = 0; j < source_blobs.size(); ++j) {
+      source_blobs[j]->ToProto(layer_param->add_blobs());
+    }
+  }
+  CopyFoldedLayersFrom(folded_source);
+  folded_source_data_.swap(source_data);
 }
 
 template <typename Dtype>
@@ -735,6 +971,12 @@ void Net<Dtype>::Reshape() {
   for (int i = 0; i < layers_.size(); ++i) {
     layers_[i]->Reshape(bottom_vecs_[i], top_vecs_[i]);
   }
+  if (workspace_) {
+    ShareWorkspace();
+  }
+  if (!activation_live_ranges_.empty()) {
+    ShareActivations();
+  }
 }
 
 template <typename Dtype>
@@ -743,6 +985,9 @@ void Net<Dtype>::CopyTrainedLayersFrom(const NetParameter& param) {
   for (int i = 0; i < num_source_layers; ++i) {
     const LayerParameter& source_layer = param.layer(i);
     const string& source_layer_name = source_layer.name();
+    if (folded_layer_names_.count(source_layer_name)) {
+      continue;
+    }
     int target_layer_id = 0;
     while (target_layer_id != layer_names_.size() &&
         layer_names_[target_layer_id] != source_layer_name) {
@@ -773,6 +1018,58 @@ void Net<Dtype>::CopyTrainedLayersFrom(const NetParameter& param) {
       target_blobs[j]->FromProto(source_layer.blobs(j), kReshape);
     }
   }
+  if (!folded_layer_names_.empty()) {
+    CopyFoldedLayersFrom(param);
+  }
+}
+
+template <typename Dtype>
+void Net<Dtype>::CopyFoldedLayersFrom(const NetParameter& source) {
+  // Fold following the layers of this net, which need not be those of the
+  // source, e.g. the TRAIN net of a solver.
+  folded_source_data_.clear();
+  map<string, int> source_layer_ids;
+  for (int i = 0; i < source.layer_size(); ++i) {
+    if (folded_layer_names_.count(source.layer(i).name())) {
+      source_layer_ids[source.layer(i).name()] = i;
+    }
+  }
+  NetParameter param(folded_param_);
+  for (int i = 0; i < param.layer_size(); ++i) {
+    LayerParameter* layer_param = param.mutable_layer(i);
+    map<string, int>::const_iterator source_layer_id =
+        source_layer_ids.find(layer_param->name());
+    if (source_layer_id != source_layer_ids.end()) {
+      layer_param->mutable_blobs()->CopyFrom(
+          source.layer(source_layer_id->second).blobs());
+    }
+  }
+  NetParameter fused_param;
+  vector<string> folded_names;
+  FuseLayers(param, &fused_param, &folded_names);
+  // Layers the source has only some of the blobs of are left unfolded.
+  const set<string> folded(folded_names.begin(), folded_names.end());
+  for (int i = 0; i < fused_param.layer_size(); ++i) {
+    const LayerParameter& source_layer = fused_param.layer(i);
+    const string& layer_name = source_layer.name();
+    if (!folded.count(layer_name) ||
+        !layer_names_index_.count(layer_name) ||
+        source_layer.blobs_size() == 0) {
+      continue;
+    }
+    LOG(INFO) << "Copying folded source layer " << layer_name;
+    vector<shared_ptr<Blob<Dtype> > >& target_blobs =
+        layers_[layer_names_index_[layer_name]]->blobs();
+    CHECK_EQ(target_blobs.size(), source_layer.blobs_size())
+        << "Incompatible number of blobs for layer " << layer_name;
+    for (int j = 0; j < target_blobs.size(); ++j) {
+      CHECK(target_blobs[j]->ShapeEquals(source_layer.blobs(j)))
+          << "Cannot copy folded param " << j << " weights into layer '"
+          << layer_name << "'; shape mismatch.";
+      const bool kReshape = false;
+      target_blobs[j]->FromProto(source_layer.blobs(j), kReshape);
+    }
+  }
 }
 
 template <typename Dtype>
@@ -795,14 +1092,36 @@ void Net<Dtype>::CopyTrainedLayersFromBinaryProto(
 
 template <typename Dtype>
 void Net<Dtype>::CopyTrainedLayersFromHDF5(const string trained_filename) {
+  HDF5Lock lock;
   hid_t file_hid = H5Fopen(trained_filename.c_str(), H5F_ACC_RDONLY,
                            H5P_DEFAULT);
   CHECK_GE(file_hid, 0) << "Couldn't open " << trained_filename;
   hid_t data_hid = H5Gopen2(file_hid, "data", H5P_DEFAULT);
   CHECK_GE(data_hid, 0) << "Error reading weights from " << trained_filename;
   int num_layers = hdf5_get_num_links(data_hid);
+  NetParameter folded_source;
   for (int i = 0; i < num_layers; ++i) {
     string source_layer_name = hdf5_get_name_by_idx(data_hid, i);
+    if (folded_layer_names_.count(source_layer_name)) {
+      // Read the blobs to fold into the fused layers.
+      hid_t layer_hid = H5Gopen2(data_hid, source_layer_name.c_str(),
+          H5P_DEFAULT);
+      CHECK_GE(layer_hid, 0)
+          << "Error reading weights from " << trained_filename;
+      LayerParameter* layer_param = folded_source.add_layer();
+      layer_param->set_name(source_layer_name);
+      int num_source_params = hdf5_get_num_links(layer_hid);
+      for (int j = 0; j < num_source_params; ++j) {
+        ostringstream oss;
+        oss << j;
+        Blob<Dtype> source_blob;
+        hdf5_load_nd_dataset(layer_hid, oss.str().c_str(), 0, kMaxBlobAxes,
+            &source_blob);
+        source_blob.ToProto(layer_param->add_blobs());
+      }
+      H5Gclose(layer_hid);
+      continue;
+    }
     if (!layer_names_index_.count(source_layer_name)) {
       LOG(INFO) << "Ignoring source layer " << source_layer_name;
       continue;
@@ -841,6 +1160,9 @@ void Net<Dtype>::CopyTrainedLayersFromHDF5(const string trained_filename) {
   }
   H5Gclose(data_hid);
   H5Fclose(file_hid);
+  if (!folded_layer_names_.empty()) {
+    CopyFoldedLayersFrom(folded_source);
+  }
 }
 
 template <typename Dtype>
@@ -857,6 +1179,7 @@ void Net<Dtype>::ToProto(NetParameter* param, bool write_diff) const {
 
 template <typename Dtype>
 void Net<Dtype>::ToHDF5(const string& filename, bool write_diff) const {
+  HDF5Lock lock;
   hid_t file_hid = H5Fcreate(filename.c_str(), H5F_ACC_TRUNC, H5P_DEFAULT,
       H5P_DEFAULT);
   CHECK_GE(file_hid, 0)
@@ -949,6 +1272,263 @@ void Net<Dtype>::ShareWeights() {
   }
 }
 
+template <typename Dtype>
+void Net<Dtype>::ShareWorkspace() {
+  CHECK(workspace_) << "share_workspace is not set.";
+  for (int i = 0; i < layers_.size(); ++i) {
+    // Layers shared with other nets may run concurrently with this one.
+    if (layers_[i]->IsShared()) { continue; }
+    // Only TEST nets count as forward only: tools such as `caffe time` call
+    // Backward on every layer of a TRAIN net, needed or not.
+    const bool forward_only = phase_ == TEST && !layer_need_backward_[i];
+    workspace_->BeginLayer();
+    layers_[i]->AppendWorkspace(forward_only, workspace_.get());
+  }
+  workspace_->Share();
+}
+
+template <typename Dtype>
+void Net<Dtype>::FindBlobAliases(vector<int>* blob_alias_ids) const {
+  // Blobs sharing their data, e.g. the tops of Flatten or Reshape and their
+  // bottom, alias one another. SplitLayer only shares its data in Forward.
+  blob_alias_ids->assign(blobs_.size(), -1);
+  map<SyncedMemory*, int> memory_alias_ids;
+  for (int i = 0; i < net_input_blob_indices_.size(); ++i) {
+    const int blob_id = net_input_blob_indices_[i];
+    (*blob_alias_ids)[blob_id] = blob_id;
+    if (blobs_[blob_id]->count() > 0) {
+      memory_alias_ids[blobs_[blob_id]->data().get()] = blob_id;
+    }
+  }
+  for (int layer_id = 0; layer_id < layers_.size(); ++layer_id) {
+    const bool is_split = strcmp(layers_[layer_id]->type(), "Split") == 0;
+    for (int top_id = 0; top_id < top_vecs_[layer_id].size(); ++top_id) {
+      const int blob_id = top_id_vecs_[layer_id][top_id];
+      int& alias_id = (*blob_alias_ids)[blob_id];
+      if (alias_id < 0 && is_split) {
+        alias_id = (*blob_alias_ids)[bottom_id_vecs_[layer_id][0]];
+      }
+      // Empty blobs have no memory to alias.
+      if (blobs_[blob_id]->count() == 0) {
+        if (alias_id < 0) { alias_id = blob_id; }
+        continue;
+      }
+      SyncedMemory* memory = blobs_[blob_id]->data().get();
+      if (alias_id < 0 && memory_alias_ids.count(memory)) {
+        alias_id = memory_alias_ids[memory];
+      }
+      if (alias_id < 0) {
+        alias_id = blob_id;
+      }
+      if (!memory_alias_ids.count(memory)) {
+        memory_alias_ids[memory] = alias_id;
+      }
+    }
+  }
+}
+
+template <typename Dtype>
+void Net<Dtype>::InitLayerDependencies() {
+  vector<int> blob_alias_ids;
+  FindBlobAliases(&blob_alias_ids);
+  // A layer runs after the last writer of its bottoms, and after the last
+  // writer and the readers since of its tops.
+  vector<int> last_writers(blobs_.size(), -1);
+  vector<vector<int> > readers(blobs_.size());
+  layer_dependencies_.assign(layers_.size(), vector<int>());
+  for (int layer_id = 0; layer_id < layers_.size(); ++layer_id) {
+    set<int> dependencies;
+    for (int bottom_id = 0; bottom_id < bottom_vecs_[layer_id].size();
+         ++bottom_id) {
+      const int alias_id = blob_alias_ids[bottom_id_vecs_[layer_id][bottom_id]];
+      if (last_writers[alias_id] >= 0) {
+        dependencies.insert(last_writers[alias_id]);
+      }
+    }
+    for (int top_id = 0; top_id < top_vecs_[layer_id].size(); ++top_id) {
+      const int alias_id = blob_alias_ids[top_id_vecs_[layer_id][top_id]];
+      if (last_writers[alias_id] >= 0) {
+        dependencies.insert(last_writers[alias_id]);
+      }
+      dependencies.insert(readers[alias_id].begin(), readers[alias_id].end());
+    }
+    for (int bottom_id = 0; bottom_id < bottom_vecs_[layer_id].size();
+         ++bottom_id) {
+      readers[blob_alias_ids[bottom_id_vecs_[layer_id][bottom_id]]].push_back(
+          layer_id);
+    }
+    for (int top_id = 0; top_id < top_vecs_[layer_id].size(); ++top_id) {
+      const int alias_id = blob_alias_ids[top_id_vecs_[layer_id][top_id]];
+      last_writers[alias_id] = layer_id;
+      readers[alias_id].clear();
+    }
+    layer_dependencies_[layer_id].assign(
+        dependencies.begin(), dependencies.end());
+  }
+  // Backward runs the same edges the other way round. Layers sharing a
+  // parameter also accumulate its diff in the sequential order.
+  layer_backward_dependencies_.assign(layers_.size(), vector<int>());
+  for (int layer_id = 0; layer_id < layers_.size(); ++layer_id) {
+    for (int i = 0; i < layer_dependencies_[layer_id].size(); ++i) {
+      layer_backward_dependencies_[layer_dependencies_[layer_id][i]].push_back(
+          layer_id);
+    }
+  }
+  map<int, int> last_param_layers;
+  for (int layer_id = layers_.size() - 1; layer_id >= 0; --layer_id) {
+    vector<int>& dependencies = layer_backward_dependencies_[layer_id];
+    for (int i = 0; i < param_id_vecs_[layer_id].size(); ++i) {
+      const int learnable_param_id =
+          learnable_param_ids_[param_id_vecs_[layer_id][i]];
+      if (last_param_layers.count(learnable_param_id) &&
+          last_param_layers[learnable_param_id] != layer_id) {
+        dependencies.push_back(last_param_layers[learnable_param_id]);
+      }
+      last_param_layers[learnable_param_id] = layer_id;
+    }
+    sort(dependencies.begin(), dependencies.end());
+    dependencies.erase(unique(dependencies.begin(), dependencies.end()),
+        dependencies.end());
+  }
+}
+
+template <typename Dtype>
+void Net<Dtype>::PlanActivations(const NetParameter& param) {
+  bool forward_only = phase_ == TEST;
+  for (int i = 0; i < layers_.size(); ++i) {
+    forward_only = forward_only && !layer_need_backward_[i];
+  }
+  if (!forward_only) {
+    LOG(WARNING) << "Ignoring reuse_activations: the net is not a TEST net "
+        << "or needs backward.";
+    return;
+  }
+  vector<int> blob_alias_ids;
+  FindBlobAliases(&blob_alias_ids);
+  blob_activation_ids_.assign(blobs_.size(), -1);
+  map<int, int> alias_activation_ids;
+  vector<bool> activation_pinned;
+  activation_live_ranges_.clear();
+  // Net inputs are filled by the caller and keep their memory.
+  for (int i = 0; i < net_input_blob_indices_.size(); ++i) {
+    const int blob_id = net_input_blob_indices_[i];
+    alias_activation_ids[blob_alias_ids[blob_id]] =
+        activation_live_ranges_.size();
+    blob_activation_ids_[blob_id] = activation_live_ranges_.size();
+    activation_live_ranges_.push_back(make_pair(0, 0));
+    activation_pinned.push_back(true);
+  }
+  for (int layer_id = 0; layer_id < layers_.size(); ++layer_id) {
+    for (int top_id = 0; top_id < top_vecs_[layer_id].size(); ++top_id) {
+      const int blob_id = top_id_vecs_[layer_id][top_id];
+      const int alias_id = blob_alias_ids[blob_id];
+      if (!alias_activation_ids.count(alias_id)) {
+        alias_activation_ids[alias_id] = activation_live_ranges_.size();
+        activation_live_ranges_.push_back(make_pair(layer_id, layer_id));
+        // The tops of data layers may point at memory they do not own.
+        activation_pinned.push_back(bottom_vecs_[layer_id].empty());
+      }
+      const int activation_id = alias_activation_ids[alias_id];
+      blob_activation_ids_[blob_id] = activation_id;
+      activation_live_ranges_[activation_id].second = layer_id;
+    }
+    for (int bottom_id = 0; bottom_id < bottom_vecs_[layer_id].size();
+         ++bottom_id) {
+      const int activation_id =
+          blob_activation_ids_[bottom_id_vecs_[layer_id][bottom_id]];
+      if (activation_id >= 0) {
+        activation_live_ranges_[activation_id].second = layer_id;
+      }
+    }
+  }
+  // Outputs and the blobs asked for by name keep their memory too.
+  set<string> keep_blobs(param.keep_blob().begin(), param.keep_blob().end());
+  for (int blob_id = 0; blob_id < blobs_.size(); ++blob_id) {
+    const int activation_id = blob_activation_ids_[blob_id];
+    if (activation_id >= 0 && keep_blobs.count(blob_names_[blob_id])) {
+      activation_pinned[activation_id] = true;
+    }
+  }
+  for (int i = 0; i < net_output_blob_indices_.size(); ++i) {
+    const int activation_id =
+        blob_activation_ids_[net_output_blob_indices_[i]];
+    if (activation_id >= 0) { activation_pinned[activation_id] = true; }
+  }
+  for (int blob_id = 0; blob_id < blobs_.size(); ++blob_id) {
+    int& activation_id = blob_activation_ids_[blob_id];
+    if (activation_id >= 0 && activation_pinned[activation_id]) {
+      activation_id = -1;
+    }
+  }
+  ShareActivations();
+}
+
+template <typename Dtype>
+void Net<Dtype>::ShareActivations() {
+  const int num_activations = activation_live_ranges_.size();
+  vector<size_t> activation_bytes(num_activations, 0);
+  for (int blob_id = 0; blob_id < blobs_.size(); ++blob_id) {
+    const int activation_id = blob_activation_ids_[blob_id];
+    if (activation_id >= 0) {
+      activation_bytes[activation_id] = std::max(
+          activation_bytes[activation_id],
+          blobs_[blob_id]->count() * sizeof(Dtype));
+    }
+  }
+  // Activations are numbered in the order they are first written. Each goes
+  // to the buffer that is free by then and fits it most tightly, or else to
+  // the largest free buffer, which grows.
+  vector<int> activation_buffer_ids(num_activations, -1);
+  vector<size_t> buffer_bytes;
+  vector<int> buffer_last_use;
+  size_t unshared_bytes = 0;
+  for (int i = 0; i < num_activations; ++i) {
+    if (activation_bytes[i] == 0) { continue; }
+    unshared_bytes += activation_bytes[i];
+    int best = -1;
+    for (int j = 0; j < buffer_bytes.size(); ++j) {
+      if (buffer_last_use[j] >= activation_live_ranges_[i].first) { continue; }
+      if (best < 0) {
+        best = j;
+        continue;
+      }
+      const bool fits = buffer_bytes[j] >= activation_bytes[i];
+      const bool best_fits = buffer_bytes[best] >= activation_bytes[i];
+      if (fits ? (!best_fits || buffer_bytes[j] < buffer_bytes[best])
+               : (!best_fits && buffer_bytes[j] > buffer_bytes[best])) {
+        best = j;
+      }
+    }
+    if (best < 0) {
+      best = buffer_bytes.size();
+      buffer_bytes.push_back(0);
+      buffer_last_use.push_back(-1);
+    }
+    buffer_bytes[best] = std::max(buffer_bytes[best], activation_bytes[i]);
+    buffer_last_use[best] = activation_live_ranges_[i].second;
+    activation_buffer_ids[i] = best;
+  }
+  size_t shared_bytes = 0;
+  activation_buffers_.resize(buffer_bytes.size());
+  for (int j = 0; j < buffer_bytes.size(); ++j) {
+    if (!activation_buffers_[j] ||
+        activation_buffers_[j]->size() < buffer_bytes[j]) {
+      activation_buffers_[j].reset(new SyncedMemory(buffer_bytes[j]));
+    }
+    shared_bytes += activation_buffers_[j]->size();
+  }
+  for (int blob_id = 0; blob_id < blobs_.size(); ++blob_id) {
+    const int activation_id = blob_activation_ids_[blob_id];
+    if (activation_id >= 0 && activation_buffer_ids[activation_id] >= 0) {
+      blobs_[blob_id]->ShareWorkspace(
+          activation_buffers_[activation_buffer_ids[activation_id]]);
+    }
+  }
+  LOG_IF(INFO, Caffe::root_solver())
+      << "Reusing activations: " << shared_bytes << " bytes in "
+      << buffer_bytes.size() << " buffers instead of " << unshared_bytes;
+}
+
 template <typename Dtype>
 bool Net<Dtype>::has_blob(const string& blob_name) const {
   return blob_names_index_.find(blob_name) != blob_names_index_.end();
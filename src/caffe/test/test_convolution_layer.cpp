@@ -5,7 +5,10 @@
 #include "caffe/blob.hpp"
 #include "caffe/common.hpp"
 #include "caffe/filler.hpp"
+#include "caffe/layer_factory.hpp"
 #include "caffe/layers/conv_layer.hpp"
+#include "caffe/layers/direct_conv_layer.hpp"
+#include "caffe/layers/winograd_conv_layer.hpp"
 
 #ifdef USE_CUDNN
 #include "caffe/layers/cudnn_conv_layer.hpp"
@@ -495,6 +498,91 @@ TYPED_TEST(ConvolutionLayerTest, TestSimpleConvolutionGroup) {
   }
 }
 
+TYPED_TEST(ConvolutionLayerTest, TestBatchedConvolutionGroup) {
+  typedef typename TypeParam::Dtype Dtype;
+  vector<int> bottom_shape;
+  bottom_shape.push_back(5);
+  bottom_shape.push_back(3);
+  bottom_shape.push_back(6);
+  bottom_shape.push_back(4);
+  this->blob_bottom_->Reshape(bottom_shape);
+  FillerParameter filler_param;
+  GaussianFiller<Dtype> filler(filler_param);
+  filler.Fill(this->blob_bottom_);
+  LayerParameter layer_param;
+  ConvolutionParameter* convolution_param =
+      layer_param.mutable_convolution_param();
+  convolution_param->add_kernel_size(3);
+  convolution_param->add_stride(2);
+  convolution_param->add_pad(1);
+  convolution_param->set_num_output(6);
+  convolution_param->set_group(3);
+  // 5 images in chunks of 2 leave a last chunk of a single image.
+  convolution_param->set_cpu_batch_size(2);
+  convolution_param->mutable_weight_filler()->set_type("gaussian");
+  convolution_param->mutable_bias_filler()->set_type("constant");
+  convolution_param->mutable_bias_filler()->set_value(0.1);
+  shared_ptr<Layer<Dtype> > layer(
+      new ConvolutionLayer<Dtype>(layer_param));
+  layer->SetUp(this->blob_bottom_vec_, this->blob_top_vec_);
+  layer->Forward(this->blob_bottom_vec_, this->blob_top_vec_);
+  // Check against reference convolution.
+  const Dtype* top_data;
+  const Dtype* ref_top_data;
+  caffe_conv(this->blob_bottom_, convolution_param, layer->blobs(),
+      this->MakeReferenceTop(this->blob_top_));
+  top_data = this->blob_top_->cpu_data();
+  ref_top_data = this->ref_blob_top_->cpu_data();
+  for (int i = 0; i < this->blob_top_->count(); ++i) {
+    EXPECT_NEAR(top_data[i], ref_top_data[i], 1e-4);
+  }
+}
+
+TYPED_TEST(ConvolutionLayerTest, TestMultithreadedIm2col) {
+  typedef typename TypeParam::Dtype Dtype;
+  // Large enough for im2col and col2im to split the channels across threads.
+  vector<int> bottom_shape;
+  bottom_shape.push_back(2);
+  bottom_shape.push_back(16);
+  bottom_shape.push_back(24);
+  bottom_shape.push_back(24);
+  this->blob_bottom_->Reshape(bottom_shape);
+  FillerParameter filler_param;
+  GaussianFiller<Dtype> filler(filler_param);
+  filler.Fill(this->blob_bottom_);
+  LayerParameter layer_param;
+  ConvolutionParameter* convolution_param =
+      layer_param.mutable_convolution_param();
+  convolution_param->add_kernel_size(3);
+  convolution_param->add_pad(1);
+  convolution_param->set_num_output(4);
+  convolution_param->mutable_weight_filler()->set_type("gaussian");
+  convolution_param->mutable_bias_filler()->set_type("gaussian");
+  ConvolutionLayer<Dtype> layer(layer_param);
+  layer.SetUp(this->blob_bottom_vec_, this->blob_top_vec_);
+  Blob<Dtype> top_diff;
+  top_diff.ReshapeLike(*this->blob_top_);
+  filler.Fill(&top_diff);
+  caffe_copy(top_diff.count(), top_diff.cpu_data(),
+      this->blob_top_->mutable_cpu_diff());
+  vector<bool> propagate_down(1, true);
+  layer.Forward(this->blob_bottom_vec_, this->blob_top_vec_);
+  layer.Backward(this->blob_top_vec_, propagate_down, this->blob_bottom_vec_);
+  Blob<Dtype> serial_top, serial_bottom;
+  serial_top.CopyFrom(*this->blob_top_, false, true);
+  serial_bottom.CopyFrom(*this->blob_bottom_, true, true);
+  Caffe::set_cpu_threads(4);
+  layer.Forward(this->blob_bottom_vec_, this->blob_top_vec_);
+  layer.Backward(this->blob_top_vec_, propagate_down, this->blob_bottom_vec_);
+  Caffe::set_cpu_threads(1);
+  for (int i = 0; i < this->blob_top_->count(); ++i) {
+    EXPECT_EQ(serial_top.cpu_data()[i], this->blob_top_->cpu_data()[i]);
+  }
+  for (int i = 0; i < this->blob_bottom_->count(); ++i) {
+    EXPECT_EQ(serial_bottom.cpu_diff()[i], this->blob_bottom_->cpu_diff()[i]);
+  }
+}
+
 TYPED_TEST(ConvolutionLayerTest, TestSobelConvolution) {
   // Test separable convolution by computing the Sobel operator
   // as a single filter then comparing the result
@@ -724,6 +812,65 @@ TYPED_TEST(ConvolutionLayerTest, TestGradient) {
       this->blob_top_vec_);
 }
 
+TYPED_TEST(ConvolutionLayerTest, TestFusedReLU) {
+  typedef typename TypeParam::Dtype Dtype;
+  LayerParameter layer_param;
+  layer_param.set_type("Convolution");
+  ConvolutionParameter* convolution_param =
+      layer_param.mutable_convolution_param();
+  convolution_param->add_kernel_size(3);
+  convolution_param->add_pad(1);
+  convolution_param->set_num_output(4);
+  convolution_param->mutable_weight_filler()->set_type("gaussian");
+  convolution_param->mutable_bias_filler()->set_type("gaussian");
+  ConvolutionLayer<Dtype> layer(layer_param);
+  layer.SetUp(this->blob_bottom_vec_, this->blob_top_vec_);
+  layer.Forward(this->blob_bottom_vec_, this->blob_top_vec_);
+  const Dtype* top_data = this->blob_top_->cpu_data();
+  // Every engine must match a ReLU applied to the unfused output.
+  convolution_param->set_fuse_relu(true);
+  const ConvolutionParameter_Engine engines[] = {
+    ConvolutionParameter_Engine_CAFFE, ConvolutionParameter_Engine_DIRECT,
+    ConvolutionParameter_Engine_WINOGRAD };
+  Blob<Dtype> fused_top;
+  vector<Blob<Dtype>*> fused_top_vec(1, &fused_top);
+  shared_ptr<Layer<Dtype> > fused_layer;
+  for (int e = 0; e < 3; ++e) {
+    convolution_param->set_engine(engines[e]);
+    fused_layer = LayerRegistry<Dtype>::CreateLayer(layer_param);
+    fused_layer->SetUp(this->blob_bottom_vec_, fused_top_vec);
+    for (int i = 0; i < layer.blobs().size(); ++i) {
+      fused_layer->blobs()[i]->CopyFrom(*layer.blobs()[i]);
+    }
+    fused_layer->Forward(this->blob_bottom_vec_, fused_top_vec);
+    ASSERT_EQ(this->blob_top_->count(), fused_top.count());
+    for (int i = 0; i < fused_top.count(); ++i) {
+      EXPECT_NEAR(std::max(top_data[i], Dtype(0)), fused_top.cpu_data()[i],
+          1e-4);
+    }
+  }
+  // Backward only passes the diff of the outputs the ReLU kept.
+  FillerParameter filler_param;
+  GaussianFiller<Dtype> filler(filler_param);
+  filler.Fill(&fused_top);
+  caffe_copy(fused_top.count(), fused_top.cpu_data(),
+      fused_top.mutable_cpu_diff());
+  Dtype* top_diff = this->blob_top_->mutable_cpu_diff();
+  for (int i = 0; i < fused_top.count(); ++i) {
+    top_diff[i] = top_data[i] > 0 ? fused_top.cpu_diff()[i] : Dtype(0);
+  }
+  fused_layer->Forward(this->blob_bottom_vec_, fused_top_vec);
+  vector<bool> propagate_down(1, true);
+  layer.Backward(this->blob_top_vec_, propagate_down, this->blob_bottom_vec_);
+  Blob<Dtype> bottom_diff;
+  bottom_diff.CopyFrom(*this->blob_bottom_, true, true);
+  fused_layer->Backward(fused_top_vec, propagate_down, this->blob_bottom_vec_);
+  for (int i = 0; i < bottom_diff.count(); ++i) {
+    EXPECT_NEAR(bottom_diff.cpu_diff()[i],
+        this->blob_bottom_->cpu_diff()[i], 1e-4);
+  }
+}
+
 TYPED_TEST(ConvolutionLayerTest, TestDilatedGradient) {
   typedef typename TypeParam::Dtype Dtype;
   LayerParameter layer_param;
@@ -811,6 +958,295 @@ TYPED_TEST(ConvolutionLayerTest, TestGradientGroup) {
       this->blob_top_vec_);
 }
 
+template <typename Dtype>
+class DirectConvolutionLayerTest : public CPUDeviceTest<Dtype> {
+ protected:
+  DirectConvolutionLayerTest()
+      : blob_bottom_(new Blob<Dtype>(2, 4, 9, 7)),
+        blob_top_(new Blob<Dtype>()) {}
+  virtual void SetUp() {
+    FillerParameter filler_param;
+    GaussianFiller<Dtype> filler(filler_param);
+    filler.Fill(this->blob_bottom_);
+    blob_bottom_vec_.push_back(blob_bottom_);
+    blob_top_vec_.push_back(blob_top_);
+  }
+
+  virtual ~DirectConvolutionLayerTest() {
+    delete blob_bottom_;
+    delete blob_top_;
+  }
+
+  // Checks the DIRECT engine against reference convolution.
+  void TestForward(LayerParameter* layer_param) {
+    ConvolutionParameter* convolution_param =
+        layer_param->mutable_convolution_param();
+    convolution_param->set_engine(ConvolutionParameter_Engine_DIRECT);
+    convolution_param->mutable_weight_filler()->set_type("gaussian");
+    convolution_param->mutable_bias_filler()->set_type("gaussian");
+    DirectConvolutionLayer<Dtype> layer(*layer_param);
+    layer.SetUp(this->blob_bottom_vec_, this->blob_top_vec_);
+    layer.Forward(this->blob_bottom_vec_, this->blob_top_vec_);
+    Blob<Dtype> ref_top;
+    ref_top.ReshapeLike(*this->blob_top_);
+    caffe_conv(this->blob_bottom_, convolution_param, layer.blobs(),
+        &ref_top);
+    const Dtype* top_data = this->blob_top_->cpu_data();
+    const Dtype* ref_top_data = ref_top.cpu_data();
+    for (int i = 0; i < this->blob_top_->count(); ++i) {
+      EXPECT_NEAR(top_data[i], ref_top_data[i], 1e-4);
+    }
+  }
+
+  Blob<Dtype>* const blob_bottom_;
+  Blob<Dtype>* const blob_top_;
+  vector<Blob<Dtype>*> blob_bottom_vec_;
+  vector<Blob<Dtype>*> blob_top_vec_;
+};
+
+TYPED_TEST_CASE(DirectConvolutionLayerTest, TestDtypes);
+
+TYPED_TEST(DirectConvolutionLayerTest, Test3x3Convolution) {
+  LayerParameter layer_param;
+  ConvolutionParameter* convolution_param =
+      layer_param.mutable_convolution_param();
+  convolution_param->add_kernel_size(3);
+  convolution_param->add_pad(1);
+  convolution_param->set_num_output(5);
+  this->TestForward(&layer_param);
+}
+
+TYPED_TEST(DirectConvolutionLayerTest, Test3x3ConvolutionGroup) {
+  LayerParameter layer_param;
+  ConvolutionParameter* convolution_param =
+      layer_param.mutable_convolution_param();
+  convolution_param->add_kernel_size(3);
+  convolution_param->set_num_output(6);
+  convolution_param->set_group(2);
+  this->TestForward(&layer_param);
+}
+
+TYPED_TEST(DirectConvolutionLayerTest, TestDepthwiseConvolution) {
+  LayerParameter layer_param;
+  ConvolutionParameter* convolution_param =
+      layer_param.mutable_convolution_param();
+  convolution_param->add_kernel_size(5);
+  convolution_param->add_stride(2);
+  convolution_param->add_pad(2);
+  convolution_param->add_dilation(2);
+  convolution_param->set_num_output(8);
+  convolution_param->set_group(4);
+  this->TestForward(&layer_param);
+}
+
+TYPED_TEST(DirectConvolutionLayerTest, Test1x1StridedConvolution) {
+  LayerParameter layer_param;
+  ConvolutionParameter* convolution_param =
+      layer_param.mutable_convolution_param();
+  convolution_param->add_kernel_size(1);
+  convolution_param->add_stride(2);
+  convolution_param->add_pad(1);
+  convolution_param->set_num_output(3);
+  this->TestForward(&layer_param);
+}
+
+TYPED_TEST(DirectConvolutionLayerTest, TestFallbackConvolution) {
+  LayerParameter layer_param;
+  ConvolutionParameter* convolution_param =
+      layer_param.mutable_convolution_param();
+  convolution_param->set_kernel_h(3);
+  convolution_param->set_kernel_w(2);
+  convolution_param->set_stride_h(2);
+  convolution_param->set_stride_w(1);
+  convolution_param->set_num_output(3);
+  this->TestForward(&layer_param);
+}
+
+TYPED_TEST(DirectConvolutionLayerTest, TestMultithreadedConvolution) {
+  typedef TypeParam Dtype;
+  vector<int> bottom_shape;
+  bottom_shape.push_back(2);
+  bottom_shape.push_back(4);
+  bottom_shape.push_back(32);
+  bottom_shape.push_back(32);
+  this->blob_bottom_->Reshape(bottom_shape);
+  FillerParameter filler_param;
+  GaussianFiller<Dtype> filler(filler_param);
+  filler.Fill(this->blob_bottom_);
+  LayerParameter layer_param;
+  ConvolutionParameter* convolution_param =
+      layer_param.mutable_convolution_param();
+  convolution_param->add_kernel_size(3);
+  convolution_param->add_pad(1);
+  convolution_param->set_num_output(8);
+  Caffe::set_cpu_threads(4);
+  this->TestForward(&layer_param);
+  Caffe::set_cpu_threads(1);
+}
+
+TYPED_TEST(DirectConvolutionLayerTest, TestGradient) {
+  typedef TypeParam Dtype;
+  LayerParameter layer_param;
+  ConvolutionParameter* convolution_param =
+      layer_param.mutable_convolution_param();
+  convolution_param->add_kernel_size(3);
+  convolution_param->add_pad(1);
+  convolution_param->set_num_output(2);
+  convolution_param->set_engine(ConvolutionParameter_Engine_DIRECT);
+  convolution_param->mutable_weight_filler()->set_type("gaussian");
+  convolution_param->mutable_bias_filler()->set_type("gaussian");
+  DirectConvolutionLayer<Dtype> layer(layer_param);
+  GradientChecker<Dtype> checker(1e-2, 1e-3);
+  checker.CheckGradientExhaustive(&layer, this->blob_bottom_vec_,
+      this->blob_top_vec_);
+}
+
+template <typename Dtype>
+class WinogradConvolutionLayerTest : public CPUDeviceTest<Dtype> {
+ protected:
+  WinogradConvolutionLayerTest()
+      : blob_bottom_(new Blob<Dtype>(2, 4, 11, 10)),
+        blob_top_(new Blob<Dtype>()),
+        blob_top_gemm_(new Blob<Dtype>()) {}
+  virtual void SetUp() {
+    FillerParameter filler_param;
+    GaussianFiller<Dtype> filler(filler_param);
+    filler.Fill(this->blob_bottom_);
+    blob_bottom_vec_.push_back(blob_bottom_);
+    blob_top_vec_.push_back(blob_top_);
+    blob_top_gemm_vec_.push_back(blob_top_gemm_);
+  }
+
+  virtual ~WinogradConvolutionLayerTest() {
+    delete blob_bottom_;
+    delete blob_top_;
+    delete blob_top_gemm_;
+  }
+
+  // Checks the WINOGRAD engine against the im2col + GEMM path of the CAFFE
+  // engine with the same weights.
+  void TestForward(LayerParameter* layer_param, const Dtype tolerance) {
+    ConvolutionParameter* convolution_param =
+        layer_param->mutable_convolution_param();
+    convolution_param->add_kernel_size(3);
+    convolution_param->mutable_weight_filler()->set_type("gaussian");
+    convolution_param->mutable_bias_filler()->set_type("gaussian");
+    convolution_param->set_engine(ConvolutionParameter_Engine_CAFFE);
+    ConvolutionLayer<Dtype> gemm_layer(*layer_param);
+    gemm_layer.SetUp(this->blob_bottom_vec_, this->blob_top_gemm_vec_);
+    gemm_layer.Forward(this->blob_bottom_vec_, this->blob_top_gemm_vec_);
+    convolution_param->set_engine(ConvolutionParameter_Engine_WINOGRAD);
+    WinogradConvolutionLayer<Dtype> layer(*layer_param);
+    layer.blobs() = gemm_layer.blobs();
+    layer.SetUp(this->blob_bottom_vec_, this->blob_top_vec_);
+    layer.Forward(this->blob_bottom_vec_, this->blob_top_vec_);
+    ASSERT_EQ(this->blob_top_gemm_->shape(), this->blob_top_->shape());
+    for (int i = 0; i < this->blob_top_->count(); ++i) {
+      EXPECT_NEAR(this->blob_top_gemm_->cpu_data()[i],
+          this->blob_top_->cpu_data()[i], tolerance);
+    }
+  }
+
+  Blob<Dtype>* const blob_bottom_;
+  Blob<Dtype>* const blob_top_;
+  Blob<Dtype>* const blob_top_gemm_;
+  vector<Blob<Dtype>*> blob_bottom_vec_;
+  vector<Blob<Dtype>*> blob_top_vec_;
+  vector<Blob<Dtype>*> blob_top_gemm_vec_;
+};
+
+TYPED_TEST_CASE(WinogradConvolutionLayerTest, TestDtypes);
+
+TYPED_TEST(WinogradConvolutionLayerTest, TestF2x2Convolution) {
+  LayerParameter layer_param;
+  ConvolutionParameter* convolution_param =
+      layer_param.mutable_convolution_param();
+  convolution_param->add_pad(1);
+  convolution_param->set_num_output(5);
+  this->TestForward(&layer_param, 1e-4);
+}
+
+TYPED_TEST(WinogradConvolutionLayerTest, TestF4x4Convolution) {
+  LayerParameter layer_param;
+  ConvolutionParameter* convolution_param =
+      layer_param.mutable_convolution_param();
+  convolution_param->add_pad(1);
+  convolution_param->set_num_output(5);
+  convolution_param->set_winograd_tile_size(4);
+  this->TestForward(&layer_param, 1e-3);
+}
+
+TYPED_TEST(WinogradConvolutionLayerTest, TestF4x4ConvolutionGroupNoPad) {
+  LayerParameter layer_param;
+  ConvolutionParameter* convolution_param =
+      layer_param.mutable_convolution_param();
+  convolution_param->set_num_output(6);
+  convolution_param->set_group(2);
+  convolution_param->set_winograd_tile_size(4);
+  this->TestForward(&layer_param, 1e-3);
+}
+
+TYPED_TEST(WinogradConvolutionLayerTest, TestMultithreadedConvolution) {
+  LayerParameter layer_param;
+  ConvolutionParameter* convolution_param =
+      layer_param.mutable_convolution_param();
+  convolution_param->add_pad(2);
+  convolution_param->set_num_output(8);
+  Caffe::set_cpu_threads(4);
+  this->TestForward(&layer_param, 1e-4);
+  Caffe::set_cpu_threads(1);
+}
+
+TYPED_TEST(WinogradConvolutionLayerTest, TestWeightUpdate) {
+  typedef TypeParam Dtype;
+  LayerParameter layer_param;
+  ConvolutionParameter* convolution_param =
+      layer_param.mutable_convolution_param();
+  convolution_param->add_kernel_size(3);
+  convolution_param->add_pad(1);
+  convolution_param->set_num_output(3);
+  convolution_param->mutable_weight_filler()->set_type("gaussian");
+  WinogradConvolutionLayer<Dtype> layer(layer_param);
+  layer.SetUp(this->blob_bottom_vec_, this->blob_top_vec_);
+  layer.Forward(this->blob_bottom_vec_, this->blob_top_vec_);
+  // The cached filter transforms must follow changes to the weights.
+  caffe_scal(layer.blobs()[0]->count(), Dtype(2),
+      layer.blobs()[0]->mutable_cpu_data());
+  Blob<Dtype> top_before;
+  top_before.CopyFrom(*this->blob_top_, false, true);
+  layer.Forward(this->blob_bottom_vec_, this->blob_top_vec_);
+  for (int i = 0; i < this->blob_top_->count(); ++i) {
+    EXPECT_NEAR(2 * top_before.cpu_data()[i], this->blob_top_->cpu_data()[i],
+        1e-4);
+  }
+  // And to weights shared from another blob.
+  Blob<Dtype> weights;
+  weights.CopyFrom(*layer.blobs()[0], false, true);
+  caffe_scal(weights.count(), Dtype(0.5), weights.mutable_cpu_data());
+  layer.blobs()[0]->ShareData(weights);
+  layer.Forward(this->blob_bottom_vec_, this->blob_top_vec_);
+  for (int i = 0; i < this->blob_top_->count(); ++i) {
+    EXPECT_NEAR(top_before.cpu_data()[i], this->blob_top_->cpu_data()[i],
+        1e-4);
+  }
+}
+
+TYPED_TEST(WinogradConvolutionLayerTest, TestGradient) {
+  typedef TypeParam Dtype;
+  LayerParameter layer_param;
+  ConvolutionParameter* convolution_param =
+      layer_param.mutable_convolution_param();
+  convolution_param->add_kernel_size(3);
+  convolution_param->add_pad(1);
+  convolution_param->set_num_output(2);
+  convolution_param->mutable_weight_filler()->set_type("gaussian");
+  convolution_param->mutable_bias_filler()->set_type("gaussian");
+  WinogradConvolutionLayer<Dtype> layer(layer_param);
+  GradientChecker<Dtype> checker(1e-2, 1e-3);
+  checker.CheckGradientExhaustive(&layer, this->blob_bottom_vec_,
+      this->blob_top_vec_);
+}
+
 #ifdef USE_CUDNN
 
 template <typename Dtype>
@@ -39,8 +39,10 @@ class DataLayerTest : public MultiDeviceTest<TypeParam> {
 
   // Fill the DB with data: if unique_pixels, each pixel is unique but
   // all images are the same; else each image is unique but all pixels within
-  // an image are the same.
-  void Fill(const bool unique_pixels, DataParameter_DB backend) {
+  // an image are the same. With same_keys, all images share one key, which
+  // only sharded DBs keep apart.
+  void Fill(const bool unique_pixels, DataParameter_DB backend,
+      const bool same_keys = false) {
     backend_ = backend;
     LOG(INFO) << "Using temporary dataset " << *filename_;
     scoped_ptr<db::DB> db(db::GetDB(backend));
@@ -58,7 +60,7 @@ class DataLayerTest : public MultiDeviceTest<TypeParam> {
         data->push_back(static_cast<uint8_t>(datum));
       }
       stringstream ss;
-      ss << i;
+      ss << (same_keys ? 0 : i);
       string out;
       CHECK(datum.SerializeToString(&out));
       txn->Put(ss.str(), out);
@@ -67,7 +69,7 @@ class DataLayerTest : public MultiDeviceTest<TypeParam> {
     db->Close();
   }
 
-  void TestRead() {
+  void TestRead(const int transform_threads = 1) {
     const Dtype scale = 3;
     LayerParameter param;
     param.set_phase(TRAIN);
@@ -75,6 +77,7 @@ class DataLayerTest : public MultiDeviceTest<TypeParam> {
     data_param->set_batch_size(5);
     data_param->set_source(filename_->c_str());
     data_param->set_backend(backend_);
+    data_param->set_transform_threads(transform_threads);
 
     TransformationParameter* transform_param =
         param.mutable_transform_param();
@@ -105,6 +108,84 @@ class DataLayerTest : public MultiDeviceTest<TypeParam> {
     }
   }
 
+  // Each batch is an epoch, so it holds every record in a new order.
+  void TestReadShuffle() {
+    const Dtype scale = 3;
+    LayerParameter param;
+    param.set_phase(TRAIN);
+    DataParameter* data_param = param.mutable_data_param();
+    data_param->set_batch_size(5);
+    data_param->set_source(filename_->c_str());
+    data_param->set_backend(backend_);
+    data_param->set_shuffle(true);
+    // Windows span epochs unevenly.
+    data_param->set_read_ahead(2);
+
+    TransformationParameter* transform_param =
+        param.mutable_transform_param();
+    transform_param->set_scale(scale);
+
+    Caffe::set_random_seed(seed_);
+    DataLayer<Dtype> layer(param);
+    layer.SetUp(blob_bottom_vec_, blob_top_vec_);
+    int num_reordered = 0;
+    for (int iter = 0; iter < 20; ++iter) {
+      layer.Forward(blob_bottom_vec_, blob_top_vec_);
+      vector<bool> seen(5, false);
+      bool reordered = false;
+      for (int i = 0; i < 5; ++i) {
+        const int label = blob_top_label_->cpu_data()[i];
+        ASSERT_GE(label, 0);
+        ASSERT_LT(label, 5);
+        EXPECT_FALSE(seen[label]) << "debug: iter " << iter << " i " << i;
+        seen[label] = true;
+        reordered |= label != i;
+        for (int j = 0; j < 24; ++j) {
+          EXPECT_EQ(scale * label, blob_top_data_->cpu_data()[i * 24 + j])
+              << "debug: iter " << iter << " i " << i << " j " << j;
+        }
+      }
+      num_reordered += reordered;
+    }
+    EXPECT_GT(num_reordered, 0);
+  }
+
+  // The second of two shards holds records 2 to 4, so each batch of 3
+  // holds all of them, in order or not.
+  void TestReadShard(const bool shuffle) {
+    LayerParameter param;
+    param.set_phase(TRAIN);
+    DataParameter* data_param = param.mutable_data_param();
+    data_param->set_batch_size(3);
+    data_param->set_source(filename_->c_str());
+    data_param->set_backend(backend_);
+    data_param->set_shuffle(shuffle);
+    data_param->set_shard_index(1);
+    data_param->set_shard_count(2);
+
+    Caffe::set_random_seed(seed_);
+    DataLayer<Dtype> layer(param);
+    layer.SetUp(blob_bottom_vec_, blob_top_vec_);
+    for (int iter = 0; iter < 10; ++iter) {
+      layer.Forward(blob_bottom_vec_, blob_top_vec_);
+      vector<bool> seen(5, false);
+      for (int i = 0; i < 3; ++i) {
+        const int label = blob_top_label_->cpu_data()[i];
+        ASSERT_GE(label, 2);
+        ASSERT_LT(label, 5);
+        EXPECT_FALSE(seen[label]) << "debug: iter " << iter << " i " << i;
+        seen[label] = true;
+        if (!shuffle) {
+          EXPECT_EQ(i + 2, label);
+        }
+        for (int j = 0; j < 24; ++j) {
+          EXPECT_EQ(label, blob_top_data_->cpu_data()[i * 24 + j])
+              << "debug: iter " << iter << " i " << i << " j " << j;
+        }
+      }
+    }
+  }
+
   void TestReshape(DataParameter_DB backend) {
     const int num_inputs = 5;
     // Save data of varying shapes.
@@ -224,13 +305,14 @@ class DataLayerTest : public MultiDeviceTest<TypeParam> {
     }
   }
 
-  void TestReadCropTrainSequenceSeeded() {
+  void TestReadCropTrainSequenceSeeded(const int transform_threads = 1) {
     LayerParameter param;
     param.set_phase(TRAIN);
     DataParameter* data_param = param.mutable_data_param();
     data_param->set_batch_size(5);
     data_param->set_source(filename_->c_str());
     data_param->set_backend(backend_);
+    data_param->set_transform_threads(transform_threads);
 
     TransformationParameter* transform_param =
         param.mutable_transform_param();
@@ -356,6 +438,25 @@ TYPED_TEST(DataLayerTest, TestReadLevelDB) {
   this->TestRead();
 }
 
+// Test that items transformed in parallel keep their order in the batch.
+TYPED_TEST(DataLayerTest, TestReadThreadsLevelDB) {
+  const bool unique_pixels = false;  // all pixels the same; images different
+  this->Fill(unique_pixels, DataParameter_DB_LEVELDB);
+  this->TestRead(3);
+}
+
+TYPED_TEST(DataLayerTest, TestReadShuffleLevelDB) {
+  const bool unique_pixels = false;  // all pixels the same; images different
+  this->Fill(unique_pixels, DataParameter_DB_LEVELDB);
+  this->TestReadShuffle();
+}
+
+TYPED_TEST(DataLayerTest, TestReadShardLevelDB) {
+  const bool unique_pixels = false;  // all pixels the same; images different
+  this->Fill(unique_pixels, DataParameter_DB_LEVELDB);
+  this->TestReadShard(false);
+}
+
 TYPED_TEST(DataLayerTest, TestReshapeLevelDB) {
   this->TestReshape(DataParameter_DB_LEVELDB);
 }
@@ -374,6 +475,14 @@ TYPED_TEST(DataLayerTest, TestReadCropTrainSequenceSeededLevelDB) {
   this->TestReadCropTrainSequenceSeeded();
 }
 
+// Test that the sequence of random crops is consistent with several
+// transform threads, each drawing from its own generator.
+TYPED_TEST(DataLayerTest, TestReadCropTrainSequenceSeededThreadsLevelDB) {
+  const bool unique_pixels = true;  // all images the same; pixels different
+  this->Fill(unique_pixels, DataParameter_DB_LEVELDB);
+  this->TestReadCropTrainSequenceSeeded(3);
+}
+
 // Test that the sequence of random crops differs across iterations when
 // Caffe::set_random_seed isn't called (and seeds from srand are ignored).
 TYPED_TEST(DataLayerTest, TestReadCropTrainSequenceUnseededLevelDB) {
@@ -396,6 +505,25 @@ TYPED_TEST(DataLayerTest, TestReadLMDB) {
   this->TestRead();
 }
 
+// Test that items transformed in parallel keep their order in the batch.
+TYPED_TEST(DataLayerTest, TestReadThreadsLMDB) {
+  const bool unique_pixels = false;  // all pixels the same; images different
+  this->Fill(unique_pixels, DataParameter_DB_LMDB);
+  this->TestRead(3);
+}
+
+TYPED_TEST(DataLayerTest, TestReadShuffleLMDB) {
+  const bool unique_pixels = false;  // all pixels the same; images different
+  this->Fill(unique_pixels, DataParameter_DB_LMDB);
+  this->TestReadShuffle();
+}
+
+TYPED_TEST(DataLayerTest, TestReadShardLMDB) {
+  const bool unique_pixels = false;  // all pixels the same; images different
+  this->Fill(unique_pixels, DataParameter_DB_LMDB);
+  this->TestReadShard(false);
+}
+
 TYPED_TEST(DataLayerTest, TestReshapeLMDB) {
   this->TestReshape(DataParameter_DB_LMDB);
 }
@@ -414,6 +542,14 @@ TYPED_TEST(DataLayerTest, TestReadCropTrainSequenceSeededLMDB) {
   this->TestReadCropTrainSequenceSeeded();
 }
 
+// Test that the sequence of random crops is consistent with several
+// transform threads, each drawing from its own generator.
+TYPED_TEST(DataLayerTest, TestReadCropTrainSequenceSeededThreadsLMDB) {
+  const bool unique_pixels = true;  // all images the same; pixels different
+  this->Fill(unique_pixels, DataParameter_DB_LMDB);
+  this->TestReadCropTrainSequenceSeeded(3);
+}
+
 // Test that the sequence of random crops differs across iterations when
 // Caffe::set_random_seed isn't called (and seeds from srand are ignored).
 TYPED_TEST(DataLayerTest, TestReadCropTrainSequenceUnseededLMDB) {
@@ -429,5 +565,43 @@ TYPED_TEST(DataLayerTest, TestReadCropTestLMDB) {
 }
 
 #endif  // USE_LMDB
+
+TYPED_TEST(DataLayerTest, TestReadSharded) {
+  const bool unique_pixels = false;  // all pixels the same; images different
+  this->Fill(unique_pixels, DataParameter_DB_SHARDED);
+  this->TestRead();
+}
+
+TYPED_TEST(DataLayerTest, TestReadThreadsSharded) {
+  const bool unique_pixels = false;  // all pixels the same; images different
+  this->Fill(unique_pixels, DataParameter_DB_SHARDED);
+  this->TestRead(3);
+}
+
+TYPED_TEST(DataLayerTest, TestReadShuffleSharded) {
+  const bool unique_pixels = false;  // all pixels the same; images different
+  this->Fill(unique_pixels, DataParameter_DB_SHARDED);
+  this->TestReadShuffle();
+}
+
+TYPED_TEST(DataLayerTest, TestReadShuffleSameKeysSharded) {
+  const bool unique_pixels = false;  // all pixels the same; images different
+  const bool same_keys = true;
+  this->Fill(unique_pixels, DataParameter_DB_SHARDED, same_keys);
+  this->TestReadShuffle();
+}
+
+TYPED_TEST(DataLayerTest, TestReadShardSharded) {
+  const bool unique_pixels = false;  // all pixels the same; images different
+  this->Fill(unique_pixels, DataParameter_DB_SHARDED);
+  this->TestReadShard(false);
+}
+
+TYPED_TEST(DataLayerTest, TestReadShuffleShardSharded) {
+  const bool unique_pixels = false;  // all pixels the same; images different
+  this->Fill(unique_pixels, DataParameter_DB_SHARDED);
+  this->TestReadShard(true);
+}
+
 }  // namespace caffe
 #endif  // USE_OPENCV
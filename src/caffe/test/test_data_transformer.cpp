@@ -10,6 +10,7 @@
 #include "caffe/filler.hpp"
 #include "caffe/proto/caffe.pb.h"
 #include "caffe/util/io.hpp"
+#include "caffe/util/math_functions.hpp"
 
 #include "caffe/test/test_caffe_main.hpp"
 
@@ -258,6 +259,45 @@ TYPED_TEST(DataTransformTest, TestCropMirrorTest) {
 }
 
 
+TYPED_TEST(DataTransformTest, TestDatumView) {
+  TransformationParameter transform_param;
+  const bool unique_pixels = true;  // pixels are consecutive ints [0,size]
+  const int label = 0;
+  const int channels = 3;
+  const int height = 4;
+  const int width = 5;
+  const int crop_size = 2;
+
+  // A view of the serialized datum draws the same crops and mirrors.
+  Datum datum;
+  FillDatum(label, channels, height, width, unique_pixels, &datum);
+  string serialized;
+  datum.SerializeToString(&serialized);
+  DatumView datum_view;
+  ASSERT_TRUE(datum_view.Parse(serialized.data(), serialized.size()));
+  transform_param.set_crop_size(crop_size);
+  transform_param.set_mirror(true);
+  transform_param.set_scale(0.5);
+  DataTransformer<TypeParam> transformer(transform_param, TRAIN);
+  DataTransformer<TypeParam> view_transformer(transform_param, TRAIN);
+  Caffe::set_random_seed(this->seed_);
+  transformer.InitRand();
+  Caffe::set_random_seed(this->seed_);
+  view_transformer.InitRand();
+  EXPECT_EQ(transformer.InferBlobShape(datum),
+      view_transformer.InferBlobShape(datum_view));
+  Blob<TypeParam> blob(1, channels, crop_size, crop_size);
+  Blob<TypeParam> view_blob(1, channels, crop_size, crop_size);
+  for (int iter = 0; iter < this->num_iter_; ++iter) {
+    transformer.Transform(datum, &blob);
+    view_transformer.Transform(datum_view, &view_blob);
+    for (int j = 0; j < blob.count(); ++j) {
+      EXPECT_EQ(blob.cpu_data()[j], view_blob.cpu_data()[j]);
+    }
+  }
+}
+
+
 TYPED_TEST(DataTransformTest, TestMeanValue) {
   TransformationParameter transform_param;
   const bool unique_pixels = false;  // pixels are equal to label
@@ -303,6 +343,45 @@ TYPED_TEST(DataTransformTest, TestMeanValues) {
   }
 }
 
+TYPED_TEST(DataTransformTest, TestStdValues) {
+  TransformationParameter transform_param;
+  const bool unique_pixels = false;  // pixels are equal to label
+  const int label = 8;
+  const int channels = 3;
+  const int height = 4;
+  const int width = 5;
+
+  transform_param.set_scale(2);
+  transform_param.add_mean_value(0);
+  transform_param.add_mean_value(2);
+  transform_param.add_mean_value(4);
+  transform_param.add_std_value(1);
+  transform_param.add_std_value(2);
+  transform_param.add_std_value(4);
+  Datum datum;
+  FillDatum(label, channels, height, width, unique_pixels, &datum);
+  Blob<TypeParam> blob(1, channels, height, width);
+  DataTransformer<TypeParam> transformer(transform_param, TEST);
+  transformer.InitRand();
+  transformer.Transform(datum, &blob);
+  const TypeParam expected[] = {16, 6, 2};
+  for (int c = 0; c < channels; ++c) {
+    for (int j = 0; j < height * width; ++j) {
+      EXPECT_EQ(blob.cpu_data()[blob.offset(0, c) + j], expected[c]);
+    }
+  }
+  // The Blob input is normalized the same way.
+  Blob<TypeParam> input(1, channels, height, width);
+  caffe_set(input.count(), TypeParam(label), input.mutable_cpu_data());
+  Blob<TypeParam> output(1, channels, height, width);
+  transformer.Transform(&input, &output);
+  for (int c = 0; c < channels; ++c) {
+    for (int j = 0; j < height * width; ++j) {
+      EXPECT_EQ(output.cpu_data()[output.offset(0, c) + j], expected[c]);
+    }
+  }
+}
+
 TYPED_TEST(DataTransformTest, TestMeanFile) {
   TransformationParameter transform_param;
   const bool unique_pixels = true;  // pixels are consecutive ints [0,size]
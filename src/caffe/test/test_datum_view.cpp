@@ -0,0 +1,88 @@
+#include <string>
+
+#include "gtest/gtest.h"
+
+#include "caffe/common.hpp"
+#include "caffe/proto/caffe.pb.h"
+#include "caffe/util/datum_view.hpp"
+
+#include "caffe/test/test_caffe_main.hpp"
+
+namespace caffe {
+
+class DatumViewTest : public ::testing::Test {};
+
+TEST_F(DatumViewTest, TestParse) {
+  Datum datum;
+  datum.set_channels(2);
+  datum.set_height(3);
+  datum.set_width(4);
+  datum.set_label(-1);
+  datum.set_data(string("\x00\x01\xff", 3));
+  string serialized;
+  datum.SerializeToString(&serialized);
+  DatumView datum_view;
+  ASSERT_TRUE(datum_view.Parse(serialized.data(), serialized.size()));
+  EXPECT_EQ(2, datum_view.channels());
+  EXPECT_EQ(3, datum_view.height());
+  EXPECT_EQ(4, datum_view.width());
+  EXPECT_EQ(-1, datum_view.label());
+  EXPECT_FALSE(datum_view.encoded());
+  EXPECT_EQ(0, datum_view.float_data_size());
+  // The data field is read where it lies.
+  ASSERT_EQ(3, datum_view.data_size());
+  EXPECT_GE(datum_view.data(), serialized.data());
+  EXPECT_LT(datum_view.data(), serialized.data() + serialized.size());
+  EXPECT_EQ(datum.data(), string(datum_view.data(), datum_view.data_size()));
+  Datum parsed;
+  datum_view.ToDatum(&parsed);
+  EXPECT_EQ(serialized, parsed.SerializeAsString());
+}
+
+TEST_F(DatumViewTest, TestParseFloatDataAndEncoded) {
+  Datum datum;
+  datum.set_channels(1);
+  datum.set_height(1);
+  datum.set_width(3);
+  for (int i = 0; i < 3; ++i) {
+    datum.add_float_data(i + 0.5);
+  }
+  datum.set_encoded(true);
+  string serialized;
+  datum.SerializeToString(&serialized);
+  DatumView datum_view;
+  ASSERT_TRUE(datum_view.Parse(serialized.data(), serialized.size()));
+  EXPECT_EQ(3, datum_view.float_data_size());
+  EXPECT_TRUE(datum_view.encoded());
+  EXPECT_EQ(0, datum_view.data_size());
+  EXPECT_EQ(0, datum_view.label());
+  Datum parsed;
+  datum_view.ToDatum(&parsed);
+  ASSERT_EQ(3, parsed.float_data_size());
+  EXPECT_EQ(2.5, parsed.float_data(2));
+}
+
+TEST_F(DatumViewTest, TestParseCopy) {
+  Datum datum;
+  datum.set_label(7);
+  datum.set_data("abc");
+  string serialized;
+  datum.SerializeToString(&serialized);
+  DatumView datum_view;
+  ASSERT_TRUE(datum_view.ParseCopy(serialized.data(), serialized.size()));
+  // The view no longer depends on the source buffer.
+  serialized.assign(serialized.size(), '\0');
+  EXPECT_EQ(7, datum_view.label());
+  EXPECT_EQ("abc", string(datum_view.data(), datum_view.data_size()));
+}
+
+TEST_F(DatumViewTest, TestParseMalformed) {
+  Datum datum;
+  datum.set_data("abcdef");
+  string serialized;
+  datum.SerializeToString(&serialized);
+  DatumView datum_view;
+  EXPECT_FALSE(datum_view.Parse(serialized.data(), serialized.size() - 2));
+}
+
+}  // namespace caffe
@@ -57,8 +57,13 @@ struct TypeLMDB {
 };
 DataParameter_DB TypeLMDB::backend = DataParameter_DB_LMDB;
 
+struct TypeSharded {
+  static DataParameter_DB backend;
+};
+DataParameter_DB TypeSharded::backend = DataParameter_DB_SHARDED;
+
 // typedef ::testing::Types<TypeLmdb> TestTypes;
-typedef ::testing::Types<TypeLevelDB, TypeLMDB> TestTypes;
+typedef ::testing::Types<TypeLevelDB, TypeLMDB, TypeSharded> TestTypes;
 
 TYPED_TEST_CASE(DBTest, TestTypes);
 
@@ -117,6 +122,21 @@ TYPED_TEST(DBTest, TestKeyValue) {
   EXPECT_FALSE(cursor->valid());
 }
 
+TYPED_TEST(DBTest, TestSizeAndSeekToRecord) {
+  scoped_ptr<db::DB> db(db::GetDB(TypeParam::backend));
+  db->Open(this->source_, db::READ);
+  scoped_ptr<db::Cursor> cursor(db->NewCursor());
+  EXPECT_EQ(2, cursor->size());
+  cursor->SeekToRecord(1);
+  EXPECT_TRUE(cursor->valid());
+  EXPECT_EQ("fish-bike.jpg", cursor->key());
+  cursor->SeekToRecord(0);
+  EXPECT_TRUE(cursor->valid());
+  EXPECT_EQ("cat.jpg", cursor->key());
+  cursor->SeekToRecord(2);
+  EXPECT_FALSE(cursor->valid());
+}
+
 TYPED_TEST(DBTest, TestWrite) {
   scoped_ptr<db::DB> db(db::GetDB(TypeParam::backend));
   db->Open(this->source_, db::WRITE);
@@ -132,5 +152,28 @@ TYPED_TEST(DBTest, TestWrite) {
   txn->Commit();
 }
 
+TYPED_TEST(DBTest, TestAppend) {
+  scoped_ptr<db::DB> db(db::GetDB(TypeParam::backend));
+  db->Open(this->source_, db::WRITE);
+  scoped_ptr<db::Transaction> txn(db->NewTransaction());
+  string keys[] = {"x.jpg", "y.jpg", "z.jpg"};
+  for (int i = 0; i < 3; ++i) {
+    txn->Append(keys[i], keys[i]);
+  }
+  txn->Commit();
+  scoped_ptr<db::Cursor> cursor(db->NewCursor());
+  EXPECT_EQ("cat.jpg", cursor->key());
+  cursor->Next();
+  EXPECT_EQ("fish-bike.jpg", cursor->key());
+  for (int i = 0; i < 3; ++i) {
+    cursor->Next();
+    EXPECT_TRUE(cursor->valid());
+    EXPECT_EQ(keys[i], cursor->key());
+    EXPECT_EQ(keys[i], cursor->value());
+  }
+  cursor->Next();
+  EXPECT_FALSE(cursor->valid());
+}
+
 }  // namespace caffe
 #endif  // USE_LEVELDB, USE_LMDB and USE_OPENCV
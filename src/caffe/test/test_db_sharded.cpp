@@ -0,0 +1,180 @@
+#include <fstream>  // NOLINT(readability/streams)
+#include <string>
+
+#include "boost/scoped_ptr.hpp"
+#include "gtest/gtest.h"
+
+#include "caffe/common.hpp"
+#include "caffe/util/db.hpp"
+#include "caffe/util/db_sharded.hpp"
+#include "caffe/util/format.hpp"
+#include "caffe/util/io.hpp"
+
+#include "caffe/test/test_caffe_main.hpp"
+
+namespace caffe {
+
+using boost::scoped_ptr;
+
+class ShardedDBTest : public ::testing::Test {
+ protected:
+  virtual void SetUp() {
+    MakeTempDir(&source_);
+    source_ += "/db";
+  }
+
+  // Appends records [begin, end) to the database, committing every
+  // batch records.
+  void Write(db::ShardedDB* db, int begin, int end, int batch) {
+    scoped_ptr<db::Transaction> txn(db->NewTransaction());
+    for (int i = begin; i < end; ++i) {
+      txn->Put(Key(i), Value(i));
+      if ((i - begin + 1) % batch == 0) {
+        txn->Commit();
+      }
+    }
+    txn->Commit();
+  }
+
+  static string Key(int i) { return "key_" + format_int(i); }
+  static string Value(int i) { return string(i, 'a' + i % 26); }
+
+  string source_;
+};
+
+TEST_F(ShardedDBTest, TestGetDB) {
+  scoped_ptr<db::DB> db(db::GetDB("sharded"));
+  scoped_ptr<db::DB> db_enum(db::GetDB(DataParameter_DB_SHARDED));
+}
+
+TEST_F(ShardedDBTest, TestReadInOrder) {
+  db::ShardedDB db;
+  db.Open(source_, db::NEW);
+  Write(&db, 0, 10, 3);
+  db.Close();
+  scoped_ptr<db::DB> read_db(db::GetDB("sharded"));
+  read_db->Open(source_, db::READ);
+  scoped_ptr<db::Cursor> cursor(read_db->NewCursor());
+  EXPECT_TRUE(cursor->stable_values());
+  for (int i = 0; i < 10; ++i) {
+    ASSERT_TRUE(cursor->valid());
+    EXPECT_EQ(Key(i), cursor->key());
+    EXPECT_EQ(Value(i), cursor->value());
+    const char* data;
+    size_t size;
+    cursor->value_view(&data, &size);
+    EXPECT_EQ(Value(i), string(data, size));
+    cursor->Next();
+  }
+  EXPECT_FALSE(cursor->valid());
+  cursor->SeekToFirst();
+  EXPECT_TRUE(cursor->valid());
+  EXPECT_EQ(Key(0), cursor->key());
+}
+
+TEST_F(ShardedDBTest, TestShardsAndRandomAccess) {
+  db::ShardedDB db;
+  db.set_shard_size(50);
+  db.Open(source_, db::NEW);
+  Write(&db, 0, 20, 2);
+  EXPECT_GT(db.num_shards(), 1);
+  // Reopening the database appends new shards.
+  db.Close();
+  const int num_shards = db.num_shards();
+  db.Open(source_, db::WRITE);
+  Write(&db, 20, 30, 4);
+  EXPECT_GT(db.num_shards(), num_shards);
+  db.Close();
+  db.Open(source_, db::READ);
+  scoped_ptr<db::ShardedCursor> cursor(db.NewCursor());
+  ASSERT_EQ(30, cursor->size());
+  const int records[] = {29, 0, 17, 3, 20, 19, 8};
+  for (int i = 0; i < sizeof(records) / sizeof(records[0]); ++i) {
+    cursor->SeekToRecord(records[i]);
+    ASSERT_TRUE(cursor->valid());
+    EXPECT_EQ(Key(records[i]), cursor->key());
+    EXPECT_EQ(Value(records[i]), cursor->value());
+  }
+  cursor->SeekToRecord(30);
+  EXPECT_FALSE(cursor->valid());
+}
+
+TEST_F(ShardedDBTest, TestSeekKey) {
+  db::ShardedDB db;
+  db.set_shard_size(50);
+  db.Open(source_, db::NEW);
+  Write(&db, 0, 20, 3);
+  scoped_ptr<db::Cursor> cursor(db.NewCursor());
+  cursor->Seek(Key(13));
+  ASSERT_TRUE(cursor->valid());
+  EXPECT_EQ(Value(13), cursor->value());
+  cursor->Next();
+  EXPECT_EQ(Key(14), cursor->key());
+  cursor->Seek(Key(2));
+  EXPECT_EQ(Value(2), cursor->value());
+  cursor->Seek("missing");
+  EXPECT_FALSE(cursor->valid());
+}
+
+TEST_F(ShardedDBTest, TestSeekDuplicateKey) {
+  db::ShardedDB db;
+  db.Open(source_, db::NEW);
+  Write(&db, 0, 5, 5);
+  db.Close();
+  // A later session writes key 2 again, to a new shard.
+  db.Open(source_, db::WRITE);
+  scoped_ptr<db::Transaction> txn(db.NewTransaction());
+  txn->Put(Key(2), "again");
+  txn->Commit();
+  db.Close();
+  db.Open(source_, db::READ);
+  EXPECT_EQ(2, db.num_shards());
+  scoped_ptr<db::ShardedCursor> cursor(db.NewCursor());
+  ASSERT_EQ(6, cursor->size());
+  cursor->Seek(Key(2));
+  ASSERT_TRUE(cursor->valid());
+  EXPECT_EQ(Value(2), cursor->value());
+  cursor->SeekToRecord(5);
+  EXPECT_EQ(Key(2), cursor->key());
+  EXPECT_EQ("again", cursor->value());
+  cursor->Seek(Key(4));
+  EXPECT_EQ(Value(4), cursor->value());
+}
+
+TEST_F(ShardedDBTest, TestIncompleteIndexEntry) {
+  db::ShardedDB db;
+  db.Open(source_, db::NEW);
+  Write(&db, 0, 5, 5);
+  db.Close();
+  // A writer that has only written part of the index entry of a record.
+  const string index_path = source_ + "/shard_00000.idx";
+  std::ofstream index_file(index_path.c_str(),
+      std::ios::out | std::ios::binary | std::ios::app);
+  index_file.write("\x01\x02\x03", 3);
+  index_file.close();
+  db.Open(source_, db::READ);
+  scoped_ptr<db::ShardedCursor> cursor(db.NewCursor());
+  ASSERT_EQ(5, cursor->size());
+  cursor->SeekToRecord(4);
+  EXPECT_EQ(Key(4), cursor->key());
+  EXPECT_EQ(Value(4), cursor->value());
+}
+
+TEST_F(ShardedDBTest, TestCursorOutlivesDB) {
+  scoped_ptr<db::ShardedCursor> cursor;
+  const char* data;
+  size_t size;
+  {
+    db::ShardedDB db;
+    db.Open(source_, db::NEW);
+    Write(&db, 0, 5, 5);
+    cursor.reset(db.NewCursor());
+    cursor->SeekToRecord(4);
+    cursor->value_view(&data, &size);
+  }
+  // The shards stay mapped while the cursor lives.
+  EXPECT_EQ(Value(4), string(data, size));
+  EXPECT_EQ(5, cursor->size());
+}
+
+}  // namespace caffe
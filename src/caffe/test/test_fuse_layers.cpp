@@ -0,0 +1,289 @@
+#include <string>
+#include <vector>
+
+#include "google/protobuf/text_format.h"
+#include "gtest/gtest.h"
+
+#include "caffe/blob.hpp"
+#include "caffe/common.hpp"
+#include "caffe/filler.hpp"
+#include "caffe/net.hpp"
+#include "caffe/proto/caffe.pb.h"
+#include "caffe/sgd_solvers.hpp"
+#include "caffe/util/fuse_layers.hpp"
+#include "caffe/util/io.hpp"
+#include "caffe/util/math_functions.hpp"
+
+#include "caffe/test/test_caffe_main.hpp"
+
+namespace caffe {
+
+class FuseLayersTest : public ::testing::Test {
+ protected:
+  void RunFusionTest(const string& input_param_string,
+      const string& output_param_string, const int expected_num_folded) {
+    // Test that FuseLayers called on the proto specified by
+    // input_param_string results in the proto specified by
+    // output_param_string.
+    NetParameter input_param;
+    CHECK(google::protobuf::TextFormat::ParseFromString(
+        input_param_string, &input_param));
+    NetParameter expected_output_param;
+    CHECK(google::protobuf::TextFormat::ParseFromString(
+        output_param_string, &expected_output_param));
+    NetParameter actual_output_param;
+    EXPECT_EQ(expected_num_folded,
+        FuseLayers(input_param, &actual_output_param));
+    EXPECT_EQ(expected_output_param.DebugString(),
+        actual_output_param.DebugString());
+    // Also test idempotence.
+    NetParameter double_fused_param;
+    EXPECT_EQ(0, FuseLayers(actual_output_param, &double_fused_param));
+    EXPECT_EQ(actual_output_param.DebugString(),
+        double_fused_param.DebugString());
+  }
+};
+
+TEST_F(FuseLayersTest, TestFuseInPlaceChain) {
+  const string& input_proto =
+      "layer { name: 'data' type: 'Input' top: 'data' } "
+      "layer { name: 'conv1' type: 'Convolution' bottom: 'data' "
+      "  top: 'conv1' convolution_param { num_output: 4 bias_term: false } } "
+      "layer { name: 'bn1' type: 'BatchNorm' bottom: 'conv1' top: 'conv1' } "
+      "layer { name: 'scale1' type: 'Scale' bottom: 'conv1' top: 'conv1' "
+      "  scale_param { bias_term: true } } "
+      "layer { name: 'relu1' type: 'ReLU' bottom: 'conv1' top: 'conv1' } "
+      "layer { name: 'pool1' type: 'Pooling' bottom: 'conv1' top: 'pool1' } ";
+  const string& expected_output_proto =
+      "layer { name: 'data' type: 'Input' top: 'data' } "
+      "layer { name: 'conv1' type: 'Convolution' bottom: 'data' "
+      "  top: 'conv1' convolution_param { num_output: 4 bias_term: true "
+      "  fuse_relu: true } } "
+      "layer { name: 'pool1' type: 'Pooling' bottom: 'conv1' top: 'pool1' } ";
+  this->RunFusionTest(input_proto, expected_output_proto, 3);
+}
+
+TEST_F(FuseLayersTest, TestFuseChainWithOtherReaders) {
+  // bn1 may not be folded as pool1 reads the output of conv1; scale2 may not
+  // be folded into conv2 as pool2 reads the output of bn2.
+  const string& input_proto =
+      "layer { name: 'data' type: 'Input' top: 'data' } "
+      "layer { name: 'conv1' type: 'Convolution' bottom: 'data' "
+      "  top: 'conv1' convolution_param { num_output: 4 } } "
+      "layer { name: 'bn1' type: 'BatchNorm' bottom: 'conv1' top: 'bn1' } "
+      "layer { name: 'pool1' type: 'Pooling' bottom: 'conv1' top: 'pool1' } "
+      "layer { name: 'conv2' type: 'Convolution' bottom: 'bn1' "
+      "  top: 'conv2' convolution_param { num_output: 4 } } "
+      "layer { name: 'bn2' type: 'BatchNorm' bottom: 'conv2' top: 'bn2' } "
+      "layer { name: 'scale2' type: 'Scale' bottom: 'bn2' top: 'scale2' } "
+      "layer { name: 'pool2' type: 'Pooling' bottom: 'bn2' top: 'pool2' } "
+      "layer { name: 'relu2' type: 'ReLU' bottom: 'scale2' top: 'scale2' } ";
+  const string& expected_output_proto =
+      "layer { name: 'data' type: 'Input' top: 'data' } "
+      "layer { name: 'conv1' type: 'Convolution' bottom: 'data' "
+      "  top: 'conv1' convolution_param { num_output: 4 } } "
+      "layer { name: 'bn1' type: 'BatchNorm' bottom: 'conv1' top: 'bn1' } "
+      "layer { name: 'pool1' type: 'Pooling' bottom: 'conv1' top: 'pool1' } "
+      "layer { name: 'conv2' type: 'Convolution' bottom: 'bn1' "
+      "  top: 'bn2' convolution_param { num_output: 4 bias_term: true } } "
+      "layer { name: 'scale2' type: 'Scale' bottom: 'bn2' top: 'scale2' } "
+      "layer { name: 'pool2' type: 'Pooling' bottom: 'bn2' top: 'pool2' } "
+      "layer { name: 'relu2' type: 'ReLU' bottom: 'scale2' top: 'scale2' } ";
+  this->RunFusionTest(input_proto, expected_output_proto, 1);
+}
+
+TEST_F(FuseLayersTest, TestKeepChainWithoutBlobs) {
+  // conv1 comes with weights but bn1 without statistics, e.g. fine-tuned
+  // from a checkpoint without BatchNorm: nothing may be folded.
+  const string& proto =
+      "layer { name: 'data' type: 'Input' top: 'data' } "
+      "layer { name: 'conv1' type: 'Convolution' bottom: 'data' "
+      "  top: 'conv1' convolution_param { num_output: 2 kernel_size: 1 } "
+      "  blobs { shape { dim: 2 dim: 1 dim: 1 dim: 1 } data: 1 data: 2 } "
+      "  blobs { shape { dim: 2 } data: 0 data: 0 } } "
+      "layer { name: 'bn1' type: 'BatchNorm' bottom: 'conv1' top: 'conv1' } "
+      "layer { name: 'relu1' type: 'ReLU' bottom: 'conv1' top: 'conv1' } ";
+  this->RunFusionTest(proto, proto, 0);
+}
+
+template <typename Dtype>
+class FuseLayersNetTest : public CPUDeviceTest<Dtype> {
+ protected:
+  void InitNet(const bool fuse_layers) {
+    NetParameter param;
+    CHECK(google::protobuf::TextFormat::ParseFromString(
+        "state { phase: TEST } "
+        "layer { name: 'data' type: 'Input' top: 'data' "
+        "  input_param { shape { dim: 2 dim: 3 dim: 6 dim: 5 } } } "
+        "layer { name: 'conv1' type: 'Convolution' bottom: 'data' "
+        "  top: 'conv1' convolution_param { num_output: 4 kernel_size: 3 "
+        "  bias_term: false weight_filler { type: 'gaussian' } } } "
+        "layer { name: 'bn1' type: 'BatchNorm' bottom: 'conv1' "
+        "  top: 'conv1' } "
+        "layer { name: 'scale1' type: 'Scale' bottom: 'conv1' top: 'conv1' "
+        "  scale_param { bias_term: true } } "
+        "layer { name: 'relu1' type: 'ReLU' bottom: 'conv1' top: 'conv1' } "
+        "layer { name: 'conv2' type: 'Convolution' bottom: 'conv1' "
+        "  top: 'conv2' convolution_param { num_output: 2 kernel_size: 1 "
+        "  weight_filler { type: 'gaussian' } "
+        "  bias_filler { type: 'gaussian' } } } "
+        "layer { name: 'bn2' type: 'BatchNorm' bottom: 'conv2' "
+        "  top: 'bn2' } ", &param));
+    param.set_fuse_layers(fuse_layers);
+    net_.reset(new Net<Dtype>(param));
+  }
+
+  shared_ptr<Net<Dtype> > net_;
+};
+
+TYPED_TEST_CASE(FuseLayersNetTest, TestDtypes);
+
+TYPED_TEST(FuseLayersNetTest, TestFoldedWeights) {
+  // The net with folded layers must compute what the original one does
+  // from the weights of the original one.
+  this->InitNet(false);
+  FillerParameter filler_param;
+  GaussianFiller<TypeParam> filler(filler_param);
+  const vector<shared_ptr<Layer<TypeParam> > >& layers = this->net_->layers();
+  for (int i = 0; i < layers.size(); ++i) {
+    for (int j = 0; j < layers[i]->blobs().size(); ++j) {
+      filler.Fill(layers[i]->blobs()[j].get());
+    }
+    if (strcmp(layers[i]->type(), "BatchNorm") == 0) {
+      // Variances well away from 0, accumulated with weight 2.
+      Blob<TypeParam>* variance = layers[i]->blobs()[1].get();
+      caffe_abs(variance->count(), variance->cpu_data(),
+          variance->mutable_cpu_data());
+      caffe_add_scalar(variance->count(), TypeParam(2),
+          variance->mutable_cpu_data());
+      layers[i]->blobs()[2]->mutable_cpu_data()[0] = 2;
+    }
+  }
+  Blob<TypeParam>* input = this->net_->input_blobs()[0];
+  filler.Fill(input);
+  Blob<TypeParam> data;
+  data.CopyFrom(*input, false, true);
+  this->net_->Forward();
+  Blob<TypeParam> expected;
+  expected.CopyFrom(*this->net_->output_blobs()[0], false, true);
+  NetParameter weights;
+  this->net_->ToProto(&weights);
+  string hdf5_weights;
+  MakeTempFilename(&hdf5_weights);
+  this->net_->ToHDF5(hdf5_weights);
+
+  // Weights from a binary proto or from HDF5 fold the same way.
+  for (int hdf5 = 0; hdf5 < 2; ++hdf5) {
+    this->InitNet(true);
+    // conv1 absorbed bn1, scale1 and relu1, conv2 absorbed bn2.
+    EXPECT_EQ(3, this->net_->layers().size());
+    if (hdf5) {
+      this->net_->CopyTrainedLayersFromHDF5(hdf5_weights);
+    } else {
+      this->net_->CopyTrainedLayersFrom(weights);
+    }
+    this->net_->input_blobs()[0]->CopyFrom(data);
+    this->net_->Forward();
+    const Blob<TypeParam>* output = this->net_->output_blobs()[0];
+    ASSERT_EQ(expected.count(), output->count());
+    for (int i = 0; i < output->count(); ++i) {
+      EXPECT_NEAR(expected.cpu_data()[i], output->cpu_data()[i], 1e-4);
+    }
+  }
+}
+
+TYPED_TEST(FuseLayersNetTest, TestWeightsWithoutBatchNorm) {
+  // Weights without the statistics of bn1 leave conv1 as it is, and still
+  // fold into conv2.
+  this->InitNet(false);
+  NetParameter weights;
+  this->net_->ToProto(&weights);
+  for (int i = 0; i < weights.layer_size(); ++i) {
+    if (weights.layer(i).name() == "bn1") {
+      weights.mutable_layer(i)->clear_blobs();
+    }
+  }
+  this->InitNet(true);
+  Blob<TypeParam> conv1_weights;
+  conv1_weights.CopyFrom(*this->net_->layer_by_name("conv1")->blobs()[0],
+      false, true);
+  Blob<TypeParam>* conv2_weights =
+      this->net_->layer_by_name("conv2")->blobs()[0].get();
+  caffe_set(conv2_weights->count(), TypeParam(0),
+      conv2_weights->mutable_cpu_data());
+  this->net_->CopyTrainedLayersFrom(weights);
+  const Blob<TypeParam>* copied_weights =
+      this->net_->layer_by_name("conv1")->blobs()[0].get();
+  for (int i = 0; i < conv1_weights.count(); ++i) {
+    EXPECT_EQ(conv1_weights.cpu_data()[i], copied_weights->cpu_data()[i]);
+  }
+  EXPECT_GT(conv2_weights->asum_data(), 0);
+}
+
+TYPED_TEST(FuseLayersNetTest, TestSolverTestNet) {
+  // A solver's fused TEST net must fold the weights it shares with the
+  // TRAIN net, whose layers are not folded, each time it tests.
+  typedef TypeParam Dtype;
+  SolverParameter solver_param;
+  CHECK(google::protobuf::TextFormat::ParseFromString(
+      "base_lr: 0.1 lr_policy: 'fixed' test_iter: 1 test_interval: 1 "
+      "display: 0 solver_mode: CPU "
+      "net_param { fuse_layers: true "
+      "  layer { name: 'data' type: 'DummyData' top: 'data' top: 'label' "
+      "    include { phase: TRAIN } dummy_data_param { "
+      "    shape { dim: 2 dim: 3 dim: 6 dim: 5 } shape { dim: 2 } "
+      "    data_filler { type: 'gaussian' } data_filler { value: 1 } } } "
+      "  layer { name: 'data' type: 'Input' top: 'data' "
+      "    include { phase: TEST } "
+      "    input_param { shape { dim: 2 dim: 3 dim: 6 dim: 5 } } } "
+      "  layer { name: 'conv1' type: 'Convolution' bottom: 'data' "
+      "    top: 'conv1' convolution_param { num_output: 4 kernel_size: 3 "
+      "    bias_term: false weight_filler { type: 'gaussian' } } } "
+      "  layer { name: 'bn1' type: 'BatchNorm' bottom: 'conv1' "
+      "    top: 'conv1' } "
+      "  layer { name: 'scale1' type: 'Scale' bottom: 'conv1' "
+      "    top: 'conv1' scale_param { bias_term: true } } "
+      "  layer { name: 'relu1' type: 'ReLU' bottom: 'conv1' top: 'conv1' } "
+      "  layer { name: 'ip' type: 'InnerProduct' bottom: 'conv1' top: 'ip' "
+      "    inner_product_param { num_output: 3 "
+      "    weight_filler { type: 'gaussian' } } } "
+      "  layer { name: 'loss' type: 'SoftmaxWithLoss' bottom: 'ip' "
+      "    bottom: 'label' top: 'loss' include { phase: TRAIN } } } ",
+      &solver_param));
+  // Steps test before each update, sharing the weights of the TRAIN net.
+  SGDSolver<Dtype> solver(solver_param);
+  solver.Step(3);
+  Net<Dtype>* test_net = solver.test_nets()[0].get();
+  // conv1 absorbed bn1, scale1 and relu1.
+  EXPECT_EQ(3, test_net->layers().size());
+  NetParameter reference_param(solver_param.net_param());
+  reference_param.set_fuse_layers(false);
+  reference_param.mutable_state()->set_phase(TEST);
+  Net<Dtype> reference_net(reference_param);
+  FillerParameter filler_param;
+  GaussianFiller<Dtype> filler(filler_param);
+  for (int step = 0; step < 2; ++step) {
+    test_net->ShareTrainedLayersWith(solver.net().get());
+    reference_net.ShareTrainedLayersWith(solver.net().get());
+    // The folded weights are kept while the shared ones do not change.
+    const shared_ptr<SyncedMemory>& folded =
+        test_net->layer_by_name("conv1")->blobs()[0]->data();
+    const unsigned int folded_version = folded->version();
+    test_net->ShareTrainedLayersWith(solver.net().get());
+    EXPECT_EQ(folded_version, folded->version());
+    filler.Fill(reference_net.input_blobs()[0]);
+    test_net->input_blobs()[0]->CopyFrom(*reference_net.input_blobs()[0]);
+    reference_net.Forward();
+    test_net->Forward();
+    const Blob<Dtype>* expected = reference_net.output_blobs()[0];
+    const Blob<Dtype>* output = test_net->output_blobs()[0];
+    ASSERT_EQ(expected->count(), output->count());
+    for (int i = 0; i < output->count(); ++i) {
+      EXPECT_NEAR(expected->cpu_data()[i], output->cpu_data()[i], 1e-4);
+    }
+    // The fused net must follow the updated weights.
+    solver.Step(2);
+  }
+}
+
+}  // namespace caffe
@@ -118,4 +118,69 @@ TYPED_TEST(HDF5OutputLayerTest, TestForward) {
       this->output_file_name_;
 }
 
+TYPED_TEST(HDF5OutputLayerTest, TestForwardAppend) {
+  typedef typename TypeParam::Dtype Dtype;
+  hid_t file_id = H5Fopen(this->input_file_name_.c_str(), H5F_ACC_RDONLY,
+                          H5P_DEFAULT);
+  ASSERT_GE(file_id, 0)<< "Failed to open HDF5 file" <<
+      this->input_file_name_;
+  hdf5_load_nd_dataset(file_id, HDF5_DATA_DATASET_NAME, 0, 4,
+                       this->blob_data_);
+  hdf5_load_nd_dataset(file_id, HDF5_DATA_LABEL_NAME, 0, 4,
+                       this->blob_label_);
+  herr_t status = H5Fclose(file_id);
+  EXPECT_GE(status, 0)<< "Failed to close HDF5 file " <<
+      this->input_file_name_;
+  this->blob_bottom_vec_.push_back(this->blob_data_);
+  this->blob_bottom_vec_.push_back(this->blob_label_);
+
+  LayerParameter param;
+  HDF5OutputParameter* hdf5_output_param =
+      param.mutable_hdf5_output_param();
+  hdf5_output_param->set_file_name(this->output_file_name_);
+  hdf5_output_param->set_append(true);
+  hdf5_output_param->set_queue_size(2);
+  // Chunks straddle batches.
+  hdf5_output_param->set_chunk_rows(3);
+  hdf5_output_param->set_gzip_level(1);
+  hdf5_output_param->set_shuffle(true);
+  const int num_batches = 5;
+  // The queued batches are written when the layer is destroyed.
+  {
+    HDF5OutputLayer<Dtype> layer(param);
+    layer.SetUp(this->blob_bottom_vec_, this->blob_top_vec_);
+    for (int i = 0; i < num_batches; ++i) {
+      layer.Forward(this->blob_bottom_vec_, this->blob_top_vec_);
+      // Read HDF5 on this thread while the writer thread appends.
+      HDF5Lock lock;
+      hid_t input_id = H5Fopen(this->input_file_name_.c_str(),
+          H5F_ACC_RDONLY, H5P_DEFAULT);
+      ASSERT_GE(input_id, 0);
+      Blob<Dtype> input;
+      hdf5_load_nd_dataset(input_id, HDF5_DATA_DATASET_NAME, 0, 4, &input);
+      EXPECT_EQ(this->blob_data_->count(), input.count());
+      EXPECT_GE(H5Fclose(input_id), 0);
+    }
+  }
+  file_id = H5Fopen(this->output_file_name_.c_str(), H5F_ACC_RDONLY,
+                    H5P_DEFAULT);
+  ASSERT_GE(file_id, 0) << "Failed to open HDF5 file" <<
+      this->output_file_name_;
+  Blob<Dtype>* const bottoms[] = {this->blob_data_, this->blob_label_};
+  const char* names[] = {HDF5_DATA_DATASET_NAME, HDF5_DATA_LABEL_NAME};
+  for (int i = 0; i < 2; ++i) {
+    Blob<Dtype> blob;
+    hdf5_load_nd_dataset(file_id, names[i], 0, 4, &blob);
+    const int count = bottoms[i]->count();
+    ASSERT_EQ(num_batches * bottoms[i]->num(), blob.num());
+    ASSERT_EQ(num_batches * count, blob.count());
+    for (int j = 0; j < blob.count(); ++j) {
+      EXPECT_EQ(bottoms[i]->cpu_data()[j % count], blob.cpu_data()[j]);
+    }
+  }
+  status = H5Fclose(file_id);
+  EXPECT_GE(status, 0) << "Failed to close HDF5 file " <<
+      this->output_file_name_;
+}
+
 }  // namespace caffe
@@ -0,0 +1,61 @@
+#ifdef USE_OPENCV
+#include <opencv2/core/core.hpp>
+
+#include <string>
+
+#include "gtest/gtest.h"
+
+#include "caffe/common.hpp"
+#include "caffe/util/image_cache.hpp"
+
+#include "caffe/test/test_caffe_main.hpp"
+
+namespace caffe {
+
+class ImageCacheTest : public ::testing::Test {
+ protected:
+  // A color image of 100 bytes per row.
+  static cv::Mat Image(const int rows) {
+    return cv::Mat(rows, 100 / 3 + 1, CV_8UC3);
+  }
+};
+
+TEST_F(ImageCacheTest, TestGetPut) {
+  ImageCache cache(0);
+  cv::Mat image = Image(4);
+  cv::Mat cached;
+  EXPECT_FALSE(cache.Get("a", &cached));
+  cache.Put("a", image);
+  EXPECT_TRUE(cache.Get("a", &cached));
+  // The cached image shares its pixels.
+  EXPECT_EQ(image.data, cached.data);
+  EXPECT_EQ(1, cache.size());
+  EXPECT_EQ(image.total() * image.elemSize(), cache.bytes());
+  EXPECT_EQ(1, cache.hits());
+  EXPECT_EQ(1, cache.misses());
+}
+
+TEST_F(ImageCacheTest, TestEvictLeastRecentlyUsed) {
+  const size_t image_bytes = Image(1).total() * Image(1).elemSize();
+  ImageCache cache(3 * image_bytes);
+  cv::Mat cached;
+  cache.Put("a", Image(1));
+  cache.Put("b", Image(1));
+  cache.Put("c", Image(1));
+  EXPECT_TRUE(cache.Get("a", &cached));
+  // b is now the least recently used image.
+  cache.Put("d", Image(1));
+  EXPECT_EQ(3, cache.size());
+  EXPECT_LE(cache.bytes(), cache.capacity());
+  EXPECT_TRUE(cache.Get("a", &cached));
+  EXPECT_FALSE(cache.Get("b", &cached));
+  EXPECT_TRUE(cache.Get("c", &cached));
+  EXPECT_TRUE(cache.Get("d", &cached));
+  // Images larger than the cache are not cached.
+  cache.Put("e", Image(4));
+  EXPECT_FALSE(cache.Get("e", &cached));
+  EXPECT_EQ(3, cache.size());
+}
+
+}  // namespace caffe
+#endif  // USE_OPENCV
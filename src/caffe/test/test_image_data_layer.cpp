@@ -177,5 +177,46 @@ TYPED_TEST(ImageDataLayerTest, TestShuffle) {
   }
 }
 
+TYPED_TEST(ImageDataLayerTest, TestReadCacheAndDecodeThreads) {
+  typedef typename TypeParam::Dtype Dtype;
+  LayerParameter param;
+  ImageDataParameter* image_data_param = param.mutable_image_data_param();
+  image_data_param->set_batch_size(5);
+  image_data_param->set_source(this->filename_.c_str());
+  image_data_param->set_new_height(64);
+  image_data_param->set_new_width(64);
+  image_data_param->set_shuffle(false);
+  ImageDataLayer<Dtype> reference_layer(param);
+  Blob<Dtype> reference_data;
+  vector<Blob<Dtype>*> reference_top_vec;
+  reference_top_vec.push_back(&reference_data);
+  reference_top_vec.push_back(this->blob_top_label_);
+  reference_layer.SetUp(this->blob_bottom_vec_, reference_top_vec);
+  reference_layer.Forward(this->blob_bottom_vec_, reference_top_vec);
+  // Caching whole datasets or the most recent images, decoding on several
+  // threads, must give the same batches.
+  const ImageDataParameter_Cache caches[] = {
+      ImageDataParameter_Cache_ALL, ImageDataParameter_Cache_LRU};
+  for (int c = 0; c < 2; ++c) {
+    image_data_param->set_cache(caches[c]);
+    image_data_param->set_cache_size_mb(1);
+    image_data_param->set_decode_threads(3);
+    ImageDataLayer<Dtype> layer(param);
+    layer.SetUp(this->blob_bottom_vec_, this->blob_top_vec_);
+    // Go through the data twice
+    for (int iter = 0; iter < 2; ++iter) {
+      layer.Forward(this->blob_bottom_vec_, this->blob_top_vec_);
+      for (int i = 0; i < 5; ++i) {
+        EXPECT_EQ(i, this->blob_top_label_->cpu_data()[i]);
+      }
+      ASSERT_EQ(reference_data.count(), this->blob_top_data_->count());
+      for (int i = 0; i < reference_data.count(); ++i) {
+        EXPECT_EQ(reference_data.cpu_data()[i],
+            this->blob_top_data_->cpu_data()[i]);
+      }
+    }
+  }
+}
+
 }  // namespace caffe
 #endif  // USE_OPENCV
@@ -400,6 +400,35 @@ TEST_F(IOTest, TestDecodeDatumToCVMatNativeGray) {
   EXPECT_EQ(cv_img.cols, 480);
 }
 
+TEST_F(IOTest, TestDecodeDatumToCVMatResized) {
+  string filename = EXAMPLES_SOURCE_DIR "images/cat.jpg";
+  Datum datum;
+  EXPECT_TRUE(ReadFileToDatum(filename, &datum));
+  // 1/4 of the size of the image, and a size in between.
+  cv::Mat cv_img = DecodeDatumToCVMat(datum, 90, 120, true);
+  EXPECT_EQ(cv_img.channels(), 3);
+  EXPECT_EQ(cv_img.rows, 90);
+  EXPECT_EQ(cv_img.cols, 120);
+  cv_img = DecodeDatumToCVMat(datum, 100, 200, false);
+  EXPECT_EQ(cv_img.channels(), 1);
+  EXPECT_EQ(cv_img.rows, 100);
+  EXPECT_EQ(cv_img.cols, 200);
+  cv_img = DecodeDatumToCVMatNative(datum, 100, 100);
+  EXPECT_EQ(cv_img.channels(), 3);
+  EXPECT_EQ(cv_img.rows, 100);
+  EXPECT_EQ(cv_img.cols, 100);
+}
+
+TEST_F(IOTest, TestDecodeDatumToCVMatResizedNativeGray) {
+  string filename = EXAMPLES_SOURCE_DIR "images/cat_gray.jpg";
+  Datum datum;
+  EXPECT_TRUE(ReadFileToDatum(filename, &datum));
+  cv::Mat cv_img = DecodeDatumToCVMatNative(datum, 45, 60);
+  EXPECT_EQ(cv_img.channels(), 1);
+  EXPECT_EQ(cv_img.rows, 45);
+  EXPECT_EQ(cv_img.cols, 60);
+}
+
 TEST_F(IOTest, TestDecodeDatumToCVMatContentNative) {
   string filename = EXAMPLES_SOURCE_DIR "images/cat.jpg";
   Datum datum;
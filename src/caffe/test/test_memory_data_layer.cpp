@@ -5,7 +5,11 @@
 #include <string>
 #include <vector>
 
+#include "boost/bind.hpp"
+#include "boost/thread.hpp"
+
 #include "caffe/filler.hpp"
+#include "caffe/layers/async_memory_data_layer.hpp"
 #include "caffe/layers/memory_data_layer.hpp"
 
 #include "caffe/test/test_caffe_main.hpp"
@@ -115,6 +119,96 @@ TYPED_TEST(MemoryDataLayerTest, TestForward) {
   }
 }
 
+// Pushes the batches of data_ and labels_, num_batches times over.
+template <typename Dtype>
+static void PushBatches(AsyncMemoryDataLayer<Dtype>* layer,
+    const Blob<Dtype>* data, const Blob<Dtype>* labels, int num_batches) {
+  const int batches = data->num() / layer->batch_size();
+  for (int i = 0; i < num_batches; ++i) {
+    const int n = i % batches * layer->batch_size();
+    layer->PushArrays(data->cpu_data() + data->offset(n),
+        labels->cpu_data() + n);
+  }
+}
+
+// push batches from another thread while the layer forwards them
+TYPED_TEST(MemoryDataLayerTest, TestAsyncPushArrays) {
+  typedef typename TypeParam::Dtype Dtype;
+
+  LayerParameter layer_param;
+  MemoryDataParameter* md_param = layer_param.mutable_memory_data_param();
+  md_param->set_batch_size(this->batch_size_);
+  md_param->set_channels(this->channels_);
+  md_param->set_height(this->height_);
+  md_param->set_width(this->width_);
+  md_param->set_queue_size(2);
+  AsyncMemoryDataLayer<Dtype> layer(layer_param);
+  layer.SetUp(this->blob_bottom_vec_, this->blob_top_vec_);
+  EXPECT_EQ(this->data_blob_->num(), this->batch_size_);
+  EXPECT_EQ(this->data_blob_->channels(), this->channels_);
+  EXPECT_EQ(this->data_blob_->height(), this->height_);
+  EXPECT_EQ(this->data_blob_->width(), this->width_);
+  EXPECT_EQ(this->label_blob_->num(), this->batch_size_);
+  const int num_batches = this->batches_ * 3;
+  boost::thread producer(boost::bind(&PushBatches<Dtype>, &layer,
+      this->data_, this->labels_, num_batches));
+  for (int i = 0; i < num_batches; ++i) {
+    int batch_num = i % this->batches_;
+    layer.Forward(this->blob_bottom_vec_, this->blob_top_vec_);
+    for (int j = 0; j < this->data_blob_->count(); ++j) {
+      EXPECT_EQ(this->data_blob_->cpu_data()[j],
+          this->data_->cpu_data()[
+              this->data_->offset(1) * this->batch_size_ * batch_num + j]);
+    }
+    for (int j = 0; j < this->label_blob_->count(); ++j) {
+      EXPECT_EQ(this->label_blob_->cpu_data()[j],
+          this->labels_->cpu_data()[this->batch_size_ * batch_num + j]);
+    }
+  }
+  producer.join();
+}
+
+TYPED_TEST(MemoryDataLayerTest, TestAsyncPushDatumVector) {
+  typedef typename TypeParam::Dtype Dtype;
+
+  LayerParameter param;
+  MemoryDataParameter* memory_data_param = param.mutable_memory_data_param();
+  memory_data_param->set_batch_size(this->batch_size_);
+  memory_data_param->set_channels(this->channels_);
+  memory_data_param->set_height(this->height_);
+  memory_data_param->set_width(this->width_);
+  param.mutable_transform_param()->set_scale(2);
+  AsyncMemoryDataLayer<Dtype> layer(param);
+  layer.SetUp(this->blob_bottom_vec_, this->blob_top_vec_);
+  // Fewer batches than the queue holds can be pushed without waiting.
+  const int num_batches = 3;
+  vector<Datum> datum_vector(this->batch_size_);
+  for (int iter = 0; iter < num_batches; ++iter) {
+    for (int i = 0; i < this->batch_size_; ++i) {
+      Datum& datum = datum_vector[i];
+      datum.set_channels(this->channels_);
+      datum.set_height(this->height_);
+      datum.set_width(this->width_);
+      datum.set_label(iter * this->batch_size_ + i);
+      datum.clear_data();
+      datum.mutable_data()->assign(
+          this->channels_ * this->height_ * this->width_, iter + i);
+    }
+    layer.PushDatumVector(datum_vector);
+  }
+  const int count = this->channels_ * this->height_ * this->width_;
+  for (int iter = 0; iter < num_batches; ++iter) {
+    layer.Forward(this->blob_bottom_vec_, this->blob_top_vec_);
+    for (int i = 0; i < this->batch_size_; ++i) {
+      EXPECT_EQ(iter * this->batch_size_ + i,
+          this->label_blob_->cpu_data()[i]);
+      for (int j = 0; j < count; ++j) {
+        EXPECT_EQ(2 * (iter + i), this->data_blob_->cpu_data()[i * count + j]);
+      }
+    }
+  }
+}
+
 #ifdef USE_OPENCV
 TYPED_TEST(MemoryDataLayerTest, AddDatumVectorDefaultTransform) {
   typedef typename TypeParam::Dtype Dtype;
@@ -10,6 +10,7 @@
 #include "caffe/filler.hpp"
 #include "caffe/net.hpp"
 #include "caffe/util/math_functions.hpp"
+#include "caffe/util/workspace.hpp"
 
 #include "caffe/test/test_caffe_main.hpp"
 #include "caffe/test/test_gradient_check_util.hpp"
@@ -617,6 +618,283 @@ class NetTest : public MultiDeviceTest<TypeParam> {
     InitNetFromProtoString(proto);
   }
 
+  virtual void InitWorkspaceNet(const bool share_workspace) {
+    ostringstream proto;
+    proto <<
+        "name: 'WorkspaceNetwork' "
+        "state { phase: TEST } "
+        "share_workspace: " << (share_workspace ? "true " : "false ") <<
+        "layer { "
+        "  name: 'data' "
+        "  type: 'Input' "
+        "  top: 'data' "
+        "  input_param { "
+        "  shape: { dim: 2 dim: 3 dim: 12 dim: 12 } "
+        "  } "
+        "} "
+        "layer { "
+        "  name: 'conv1' "
+        "  type: 'Convolution' "
+        "  bottom: 'data' "
+        "  top: 'conv1' "
+        "  convolution_param { "
+        "    num_output: 4 "
+        "    kernel_size: 3 "
+        "    weight_filler { "
+        "      type: 'gaussian' "
+        "      std: 0.1 "
+        "    } "
+        "  } "
+        "} "
+        "layer { "
+        "  name: 'pool1' "
+        "  type: 'Pooling' "
+        "  bottom: 'conv1' "
+        "  top: 'pool1' "
+        "  pooling_param { "
+        "    pool: MAX "
+        "    kernel_size: 2 "
+        "    stride: 2 "
+        "  } "
+        "} "
+        "layer { "
+        "  name: 'conv2' "
+        "  type: 'Convolution' "
+        "  bottom: 'pool1' "
+        "  top: 'conv2' "
+        "  convolution_param { "
+        "    num_output: 6 "
+        "    kernel_size: 3 "
+        "    pad: 1 "
+        "    weight_filler { "
+        "      type: 'gaussian' "
+        "      std: 0.1 "
+        "    } "
+        "  } "
+        "} "
+        "layer { "
+        "  name: 'norm1' "
+        "  type: 'LRN' "
+        "  bottom: 'conv2' "
+        "  top: 'norm1' "
+        "  lrn_param { "
+        "    local_size: 3 "
+        "    norm_region: WITHIN_CHANNEL "
+        "  } "
+        "} ";
+    InitNetFromProtoString(proto.str());
+  }
+
+  virtual void InitActivationsNet(const bool reuse_activations,
+      const string& keep_blob = "") {
+    ostringstream proto;
+    proto <<
+        "name: 'ActivationsNetwork' "
+        "state { phase: TEST } "
+        "reuse_activations: " << (reuse_activations ? "true " : "false ");
+    if (keep_blob.size()) {
+      proto << "keep_blob: '" << keep_blob << "' ";
+    }
+    proto <<
+        "layer { "
+        "  name: 'data' "
+        "  type: 'Input' "
+        "  top: 'data' "
+        "  input_param { "
+        "  shape: { dim: 2 dim: 3 dim: 6 dim: 6 } "
+        "  } "
+        "} "
+        "layer { "
+        "  name: 'conv1' "
+        "  type: 'Convolution' "
+        "  bottom: 'data' "
+        "  top: 'conv1' "
+        "  convolution_param { "
+        "    num_output: 4 "
+        "    kernel_size: 3 "
+        "    pad: 1 "
+        "    weight_filler { "
+        "      type: 'gaussian' "
+        "      std: 0.1 "
+        "    } "
+        "  } "
+        "} "
+        "layer { "
+        "  name: 'relu1' "
+        "  type: 'ReLU' "
+        "  bottom: 'conv1' "
+        "  top: 'conv1' "
+        "} "
+        "layer { "
+        "  name: 'conv2' "
+        "  type: 'Convolution' "
+        "  bottom: 'conv1' "
+        "  top: 'conv2' "
+        "  convolution_param { "
+        "    num_output: 4 "
+        "    kernel_size: 3 "
+        "    pad: 1 "
+        "    weight_filler { "
+        "      type: 'gaussian' "
+        "      std: 0.1 "
+        "    } "
+        "  } "
+        "} "
+        "layer { "
+        "  name: 'conv3' "
+        "  type: 'Convolution' "
+        "  bottom: 'conv2' "
+        "  top: 'conv3' "
+        "  convolution_param { "
+        "    num_output: 4 "
+        "    kernel_size: 3 "
+        "    pad: 1 "
+        "    weight_filler { "
+        "      type: 'gaussian' "
+        "      std: 0.1 "
+        "    } "
+        "  } "
+        "} "
+        "layer { "
+        "  name: 'sum' "
+        "  type: 'Eltwise' "
+        "  bottom: 'conv2' "
+        "  bottom: 'conv3' "
+        "  top: 'sum' "
+        "} "
+        "layer { "
+        "  name: 'flatten' "
+        "  type: 'Flatten' "
+        "  bottom: 'sum' "
+        "  top: 'flatten' "
+        "} "
+        "layer { "
+        "  name: 'ip' "
+        "  type: 'InnerProduct' "
+        "  bottom: 'flatten' "
+        "  top: 'ip' "
+        "  inner_product_param { "
+        "    num_output: 5 "
+        "    weight_filler { "
+        "      type: 'gaussian' "
+        "      std: 0.1 "
+        "    } "
+        "  } "
+        "} ";
+    InitNetFromProtoString(proto.str());
+  }
+
+  virtual void InitConcurrentNet(const bool concurrent_layers,
+      const bool dropout = false) {
+    const string dropout_a = dropout ?
+        "layer { "
+        "  name: 'drop_a' "
+        "  type: 'Dropout' "
+        "  bottom: 'conv_a' "
+        "  top: 'conv_a' "
+        "} " : "";
+    const string dropout_c = dropout ?
+        "layer { "
+        "  name: 'drop_c' "
+        "  type: 'Dropout' "
+        "  bottom: 'conv_c' "
+        "  top: 'conv_c' "
+        "} " : "";
+    ostringstream proto;
+    proto <<
+        "name: 'ConcurrentNetwork' "
+        "concurrent_layers: " << (concurrent_layers ? "true " : "false ") <<
+        "layer { "
+        "  name: 'data' "
+        "  type: 'Input' "
+        "  top: 'data' "
+        "  top: 'label' "
+        "  input_param { "
+        "  shape: { dim: 2 dim: 3 dim: 6 dim: 6 } "
+        "  shape: { dim: 2 } "
+        "  } "
+        "} "
+        "layer { "
+        "  name: 'conv_a' "
+        "  type: 'Convolution' "
+        "  bottom: 'data' "
+        "  top: 'conv_a' "
+        "  param { name: 'shared_weights' } "
+        "  param { name: 'shared_bias' } "
+        "  convolution_param { "
+        "    num_output: 4 "
+        "    kernel_size: 3 "
+        "    pad: 1 "
+        "    weight_filler { "
+        "      type: 'gaussian' "
+        "      std: 0.1 "
+        "    } "
+        "  } "
+        "} "
+        "layer { "
+        "  name: 'relu_a' "
+        "  type: 'ReLU' "
+        "  bottom: 'conv_a' "
+        "  top: 'conv_a' "
+        "} " << dropout_a <<
+        "layer { "
+        "  name: 'conv_b' "
+        "  type: 'Convolution' "
+        "  bottom: 'data' "
+        "  top: 'conv_b' "
+        "  param { name: 'shared_weights' } "
+        "  param { name: 'shared_bias' } "
+        "  convolution_param { "
+        "    num_output: 4 "
+        "    kernel_size: 3 "
+        "    pad: 1 "
+        "  } "
+        "} "
+        "layer { "
+        "  name: 'conv_c' "
+        "  type: 'Convolution' "
+        "  bottom: 'conv_b' "
+        "  top: 'conv_c' "
+        "  convolution_param { "
+        "    num_output: 4 "
+        "    kernel_size: 3 "
+        "    pad: 1 "
+        "    weight_filler { "
+        "      type: 'gaussian' "
+        "      std: 0.1 "
+        "    } "
+        "  } "
+        "} " << dropout_c <<
+        "layer { "
+        "  name: 'concat' "
+        "  type: 'Concat' "
+        "  bottom: 'conv_a' "
+        "  bottom: 'conv_c' "
+        "  top: 'concat' "
+        "} "
+        "layer { "
+        "  name: 'ip' "
+        "  type: 'InnerProduct' "
+        "  bottom: 'concat' "
+        "  top: 'ip' "
+        "  inner_product_param { "
+        "    num_output: 5 "
+        "    weight_filler { "
+        "      type: 'gaussian' "
+        "      std: 0.1 "
+        "    } "
+        "  } "
+        "} "
+        "layer { "
+        "  name: 'loss' "
+        "  type: 'SoftmaxWithLoss' "
+        "  bottom: 'ip' "
+        "  bottom: 'label' "
+        "  top: 'loss' "
+        "} ";
+    InitNetFromProtoString(proto.str());
+  }
+
   virtual void InitSkipPropNet(bool test_skip_true) {
     string proto =
       "name: 'SkipPropTestNetwork' "
@@ -2473,4 +2751,206 @@ TYPED_TEST(NetTest, TestForcePropagateDown) {
   }
 }
 
+TYPED_TEST(NetTest, TestSharedWorkspace) {
+  typedef typename TypeParam::Dtype Dtype;
+  // The outputs of a net whose layers share their scratch buffers must match
+  // those of the same net without sharing, before and after a reshape.
+  FillerParameter filler_param;
+  filler_param.set_std(1);
+  GaussianFiller<Dtype> filler(filler_param);
+  Blob<Dtype> blob1(2, 3, 12, 12);
+  Blob<Dtype> blob2(3, 3, 16, 14);
+  filler.Fill(&blob1);
+  filler.Fill(&blob2);
+  Caffe::set_random_seed(this->seed_);
+  this->InitWorkspaceNet(false);
+  shared_ptr<Net<Dtype> > unshared_net = this->net_;
+  EXPECT_TRUE(unshared_net->workspace() == NULL);
+  Caffe::set_random_seed(this->seed_);
+  this->InitWorkspaceNet(true);
+  shared_ptr<Net<Dtype> > shared_net = this->net_;
+  ASSERT_TRUE(shared_net->workspace() != NULL);
+  EXPECT_LT(shared_net->workspace()->shared_bytes(),
+      shared_net->workspace()->unshared_bytes());
+  const Blob<Dtype>* blobs[] = { &blob1, &blob2 };
+  for (int i = 0; i < 2; ++i) {
+    Net<Dtype>* nets[] = { unshared_net.get(), shared_net.get() };
+    for (int j = 0; j < 2; ++j) {
+      Blob<Dtype>* input_blob = nets[j]->input_blobs()[0];
+      input_blob->ReshapeLike(*blobs[i]);
+      caffe_copy(blobs[i]->count(), blobs[i]->cpu_data(),
+          input_blob->mutable_cpu_data());
+      nets[j]->Reshape();
+      nets[j]->Forward();
+    }
+    const Blob<Dtype>* unshared_output = unshared_net->output_blobs()[0];
+    const Blob<Dtype>* shared_output = shared_net->output_blobs()[0];
+    ASSERT_EQ(unshared_output->shape(), shared_output->shape());
+    for (int k = 0; k < shared_output->count(); ++k) {
+      EXPECT_EQ(unshared_output->cpu_data()[k], shared_output->cpu_data()[k]);
+    }
+  }
+}
+
+TYPED_TEST(NetTest, TestReuseActivations) {
+  typedef typename TypeParam::Dtype Dtype;
+  FillerParameter filler_param;
+  filler_param.set_std(1);
+  GaussianFiller<Dtype> filler(filler_param);
+  Blob<Dtype> input(2, 3, 6, 6);
+  filler.Fill(&input);
+  // The reference net, one that reuses activations, and one that reuses
+  // them but keeps conv1.
+  vector<shared_ptr<Net<Dtype> > > nets;
+  for (int i = 0; i < 3; ++i) {
+    Caffe::set_random_seed(this->seed_);
+    this->InitActivationsNet(i > 0, i == 2 ? "conv1" : "");
+    nets.push_back(this->net_);
+    Blob<Dtype>* input_blob = this->net_->input_blobs()[0];
+    caffe_copy(input.count(), input.cpu_data(),
+        input_blob->mutable_cpu_data());
+    this->net_->Forward();
+  }
+  // conv1 is dead once conv2 is computed, so conv3 can take its memory.
+  EXPECT_EQ(nets[1]->blob_by_name("conv1")->data(),
+      nets[1]->blob_by_name("conv3")->data());
+  EXPECT_NE(nets[2]->blob_by_name("conv1")->data(),
+      nets[2]->blob_by_name("conv3")->data());
+  for (int i = 1; i < 3; ++i) {
+    const Blob<Dtype>* expected = nets[0]->output_blobs()[0];
+    const Blob<Dtype>* output = nets[i]->output_blobs()[0];
+    ASSERT_EQ(expected->count(), output->count());
+    for (int k = 0; k < output->count(); ++k) {
+      EXPECT_EQ(expected->cpu_data()[k], output->cpu_data()[k]);
+    }
+  }
+  const shared_ptr<Blob<Dtype> > expected = nets[0]->blob_by_name("conv1");
+  const shared_ptr<Blob<Dtype> > kept = nets[2]->blob_by_name("conv1");
+  for (int k = 0; k < kept->count(); ++k) {
+    EXPECT_EQ(expected->cpu_data()[k], kept->cpu_data()[k]);
+  }
+}
+
+TYPED_TEST(NetTest, TestReuseActivationsEmptyBlob) {
+  typedef typename TypeParam::Dtype Dtype;
+  // Empty blobs have no memory, and are planned like any other.
+  const string proto =
+      "name: 'EmptyBlobNetwork' "
+      "state { phase: TEST } "
+      "reuse_activations: true "
+      "layer { "
+      "  name: 'data' "
+      "  type: 'Input' "
+      "  top: 'data' "
+      "  top: 'empty' "
+      "  input_param { "
+      "    shape: { dim: 2 dim: 3 } "
+      "    shape: { dim: 3 dim: 0 } "
+      "  } "
+      "} "
+      "layer { "
+      "  name: 'power1' "
+      "  type: 'Power' "
+      "  bottom: 'data' "
+      "  top: 'power1' "
+      "} "
+      "layer { "
+      "  name: 'power2' "
+      "  type: 'Power' "
+      "  bottom: 'power1' "
+      "  top: 'power2' "
+      "} ";
+  this->InitNetFromProtoString(proto);
+  EXPECT_EQ(0, this->net_->blob_by_name("empty")->count());
+  caffe_set(6, Dtype(2), this->net_->blob_by_name("data")->mutable_cpu_data());
+  this->net_->Forward();
+  const Blob<Dtype>* output = this->net_->blob_by_name("power2").get();
+  ASSERT_EQ(6, output->count());
+  for (int k = 0; k < output->count(); ++k) {
+    EXPECT_EQ(2, output->cpu_data()[k]);
+  }
+}
+
+TYPED_TEST(NetTest, TestConcurrentLayers) {
+  typedef typename TypeParam::Dtype Dtype;
+  // Running the branches of a net concurrently, with a parameter shared
+  // across them, must give the results of the sequential order.
+  FillerParameter filler_param;
+  filler_param.set_std(1);
+  GaussianFiller<Dtype> filler(filler_param);
+  Blob<Dtype> data(2, 3, 6, 6);
+  filler.Fill(&data);
+  Caffe::set_cpu_threads(4);
+  vector<shared_ptr<Net<Dtype> > > nets;
+  vector<Dtype> losses;
+  for (int i = 0; i < 2; ++i) {
+    Caffe::set_random_seed(this->seed_);
+    this->InitConcurrentNet(i > 0);
+    nets.push_back(this->net_);
+    caffe_copy(data.count(), data.cpu_data(),
+        this->net_->input_blobs()[0]->mutable_cpu_data());
+    Dtype* label = this->net_->input_blobs()[1]->mutable_cpu_data();
+    label[0] = 1;
+    label[1] = 3;
+    this->net_->ClearParamDiffs();
+    losses.push_back(this->net_->ForwardBackward());
+  }
+  Caffe::set_cpu_threads(1);
+  EXPECT_EQ(losses[0], losses[1]);
+  const vector<Blob<Dtype>*>& expected_params = nets[0]->learnable_params();
+  const vector<Blob<Dtype>*>& params = nets[1]->learnable_params();
+  ASSERT_EQ(expected_params.size(), params.size());
+  for (int i = 0; i < params.size(); ++i) {
+    ASSERT_EQ(expected_params[i]->count(), params[i]->count());
+    for (int k = 0; k < params[i]->count(); ++k) {
+      EXPECT_EQ(expected_params[i]->cpu_diff()[k], params[i]->cpu_diff()[k]);
+    }
+  }
+}
+
+TYPED_TEST(NetTest, TestConcurrentLayersDropout) {
+  typedef typename TypeParam::Dtype Dtype;
+  // Dropout layers in concurrent branches must draw the masks of the
+  // sequential order from the seeded generator, run after run.
+  FillerParameter filler_param;
+  filler_param.set_std(1);
+  GaussianFiller<Dtype> filler(filler_param);
+  Blob<Dtype> data(2, 3, 6, 6);
+  filler.Fill(&data);
+  Caffe::set_cpu_threads(4);
+  vector<shared_ptr<Net<Dtype> > > nets;
+  vector<Dtype> losses;
+  for (int i = 0; i < 3; ++i) {
+    Caffe::set_random_seed(this->seed_);
+    this->InitConcurrentNet(i > 0, true);
+    nets.push_back(this->net_);
+    caffe_copy(data.count(), data.cpu_data(),
+        this->net_->input_blobs()[0]->mutable_cpu_data());
+    Dtype* label = this->net_->input_blobs()[1]->mutable_cpu_data();
+    label[0] = 1;
+    label[1] = 3;
+    // Several passes, for the branches to overlap on the pool at least once.
+    Dtype loss = 0;
+    this->net_->ClearParamDiffs();
+    for (int iter = 0; iter < 10; ++iter) {
+      loss += this->net_->ForwardBackward();
+    }
+    losses.push_back(loss);
+  }
+  Caffe::set_cpu_threads(1);
+  const vector<Blob<Dtype>*>& expected_params = nets[0]->learnable_params();
+  for (int j = 1; j < nets.size(); ++j) {
+    EXPECT_EQ(losses[0], losses[j]);
+    const vector<Blob<Dtype>*>& params = nets[j]->learnable_params();
+    ASSERT_EQ(expected_params.size(), params.size());
+    for (int i = 0; i < params.size(); ++i) {
+      ASSERT_EQ(expected_params[i]->count(), params[i]->count());
+      for (int k = 0; k < params[i]->count(); ++k) {
+        EXPECT_EQ(expected_params[i]->cpu_diff()[k],
+            params[i]->cpu_diff()[k]);
+      }
+    }
+  }
+}
+
 }  // namespace caffe
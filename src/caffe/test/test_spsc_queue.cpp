@@ -0,0 +1,77 @@
+#include <boost/bind.hpp>
+#include <boost/thread.hpp>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+#include "caffe/proto/caffe.pb.h"
+#include "caffe/util/spsc_queue.hpp"
+
+#include "caffe/test/test_caffe_main.hpp"
+
+namespace caffe {
+
+static void PushAll(SPSCQueue<Datum*>* queue, vector<Datum>* datums) {
+  for (int i = 0; i < datums->size(); ++i) {
+    queue->push(&(*datums)[i]);
+  }
+}
+
+static void PopInterrupted(SPSCQueue<Datum*>* queue, bool* interrupted) {
+  try {
+    queue->pop();
+  } catch (boost::thread_interrupted&) {
+    *interrupted = true;
+  }
+}
+
+class SPSCQueueTest : public ::testing::Test {};
+
+TEST_F(SPSCQueueTest, TestTryPopAndPeek) {
+  SPSCQueue<Datum*> queue(2);
+  EXPECT_EQ(2, queue.capacity());
+  Datum a, b;
+  Datum* datum = NULL;
+  EXPECT_FALSE(queue.try_pop(&datum));
+  EXPECT_FALSE(queue.try_peek(&datum));
+  queue.push(&a);
+  queue.push(&b);
+  EXPECT_EQ(2, queue.size());
+  EXPECT_TRUE(queue.try_peek(&datum));
+  EXPECT_EQ(&a, datum);
+  EXPECT_EQ(&a, queue.peek());
+  EXPECT_EQ(&a, queue.pop());
+  // The freed slot can be written again while b is still queued.
+  queue.push(&a);
+  EXPECT_TRUE(queue.try_pop(&datum));
+  EXPECT_EQ(&b, datum);
+  EXPECT_EQ(&a, queue.pop());
+  EXPECT_EQ(0, queue.size());
+  EXPECT_FALSE(queue.try_pop(&datum));
+}
+
+TEST_F(SPSCQueueTest, TestProducerAndConsumerThreads) {
+  // A small queue makes both sides wait on each other many times.
+  SPSCQueue<Datum*> queue(3);
+  vector<Datum> datums(10000);
+  boost::thread producer(boost::bind(&PushAll, &queue, &datums));
+  for (int i = 0; i < datums.size(); ++i) {
+    if (i % 2 == 0) {
+      EXPECT_EQ(&datums[i], queue.peek());
+    }
+    EXPECT_EQ(&datums[i], queue.pop());
+  }
+  producer.join();
+  EXPECT_EQ(0, queue.size());
+}
+
+TEST_F(SPSCQueueTest, TestInterruptBlockedPop) {
+  SPSCQueue<Datum*> queue(1);
+  bool interrupted = false;
+  boost::thread consumer(boost::bind(&PopInterrupted, &queue, &interrupted));
+  consumer.interrupt();
+  consumer.join();
+  EXPECT_TRUE(interrupted);
+}
+
+}  // namespace caffe
@@ -50,6 +50,21 @@ TEST_F(SyncedMemoryTest, TestAllocationGPU) {
 
 #endif
 
+TEST_F(SyncedMemoryTest, TestVersion) {
+  SyncedMemory mem(10);
+  const unsigned int version = mem.version();
+  mem.cpu_data();
+  EXPECT_EQ(mem.version(), version);
+  mem.mutable_cpu_data();
+  EXPECT_NE(mem.version(), version);
+  const unsigned int written_version = mem.version();
+  mem.cpu_data();
+  EXPECT_EQ(mem.version(), written_version);
+  char data[10];
+  mem.set_cpu_data(data);
+  EXPECT_NE(mem.version(), written_version);
+}
+
 TEST_F(SyncedMemoryTest, TestCPUWrite) {
   SyncedMemory mem(10);
   void* cpu_data = mem.mutable_cpu_data();
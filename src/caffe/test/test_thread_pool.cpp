@@ -0,0 +1,97 @@
+#include <boost/bind.hpp>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+#include "caffe/blob.hpp"
+#include "caffe/common.hpp"
+#include "caffe/filler.hpp"
+#include "caffe/util/math_functions.hpp"
+#include "caffe/util/thread_pool.hpp"
+
+#include "caffe/test/test_caffe_main.hpp"
+
+namespace caffe {
+
+static void MarkRange(vector<int>* visits, const int begin, const int end) {
+  for (int i = begin; i < end; ++i) {
+    ++(*visits)[i];
+  }
+}
+
+static void NestedRange(ThreadPool* pool, vector<vector<int> >* visits,
+    const int begin, const int end) {
+  for (int i = begin; i < end; ++i) {
+    pool->ParallelFor((*visits)[i].size(), 1,
+        boost::bind(&MarkRange, &(*visits)[i], _1, _2));
+  }
+}
+
+class ThreadPoolTest : public ::testing::Test {
+ protected:
+  virtual void TearDown() {
+    Caffe::set_cpu_threads(1);
+  }
+};
+
+TEST_F(ThreadPoolTest, TestParallelForVisitsEachIndexOnce) {
+  ThreadPool pool(4);
+  EXPECT_EQ(4, pool.num_threads());
+  const int sizes[] = { 0, 1, 3, 4, 17, 1000 };
+  for (int s = 0; s < sizeof(sizes) / sizeof(sizes[0]); ++s) {
+    vector<int> visits(sizes[s], 0);
+    pool.ParallelFor(sizes[s], 1, boost::bind(&MarkRange, &visits, _1, _2));
+    for (int i = 0; i < sizes[s]; ++i) {
+      EXPECT_EQ(1, visits[i]);
+    }
+  }
+}
+
+TEST_F(ThreadPoolTest, TestNestedParallelFor) {
+  ThreadPool pool(3);
+  vector<vector<int> > visits(8, vector<int>(100, 0));
+  pool.ParallelFor(visits.size(), 1,
+      boost::bind(&NestedRange, &pool, &visits, _1, _2));
+  for (int i = 0; i < visits.size(); ++i) {
+    for (int j = 0; j < visits[i].size(); ++j) {
+      EXPECT_EQ(1, visits[i][j]);
+    }
+  }
+}
+
+TEST_F(ThreadPoolTest, TestSetCPUThreads) {
+  EXPECT_EQ(1, Caffe::cpu_threads());
+  EXPECT_TRUE(Caffe::cpu_thread_pool().get() == NULL);
+  Caffe::set_cpu_threads(4);
+  EXPECT_EQ(4, Caffe::cpu_threads());
+  ASSERT_TRUE(Caffe::cpu_thread_pool().get() != NULL);
+  EXPECT_EQ(4, Caffe::cpu_thread_pool()->num_threads());
+  Caffe::set_cpu_threads(1);
+  EXPECT_EQ(1, Caffe::cpu_threads());
+  EXPECT_TRUE(Caffe::cpu_thread_pool().get() == NULL);
+}
+
+TEST_F(ThreadPoolTest, TestParallelMathMatchesSerial) {
+  Caffe::set_random_seed(1701);
+  const int n = 4 * kCPUParallelGrain + 7;
+  vector<int> shape(1, n);
+  Blob<float> a(shape), b(shape), serial(shape), parallel(shape);
+  FillerParameter filler_param;
+  filler_param.set_min(0.5);
+  filler_param.set_max(2);
+  UniformFiller<float> filler(filler_param);
+  filler.Fill(&a);
+  filler.Fill(&b);
+  caffe_mul(n, a.cpu_data(), b.cpu_data(), serial.mutable_cpu_data());
+  caffe_powx(n, serial.cpu_data(), 0.75f, serial.mutable_cpu_data());
+  caffe_axpy(n, 2.f, a.cpu_data(), serial.mutable_cpu_data());
+  Caffe::set_cpu_threads(4);
+  caffe_mul(n, a.cpu_data(), b.cpu_data(), parallel.mutable_cpu_data());
+  caffe_powx(n, parallel.cpu_data(), 0.75f, parallel.mutable_cpu_data());
+  caffe_axpy(n, 2.f, a.cpu_data(), parallel.mutable_cpu_data());
+  for (int i = 0; i < n; ++i) {
+    EXPECT_EQ(serial.cpu_data()[i], parallel.cpu_data()[i]);
+  }
+}
+
+}  // namespace caffe
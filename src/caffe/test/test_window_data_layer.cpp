@@ -0,0 +1,191 @@
+#ifdef USE_OPENCV
+#include <cstring>
+#include <fstream>  // NOLINT(readability/streams)
+#include <iterator>
+#include <string>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+#include "caffe/blob.hpp"
+#include "caffe/common.hpp"
+#include "caffe/layers/window_data_layer.hpp"
+#include "caffe/proto/caffe.pb.h"
+#include "caffe/util/image_cache.hpp"
+#include "caffe/util/io.hpp"
+
+#include "caffe/test/test_caffe_main.hpp"
+
+namespace caffe {
+
+// The number of copies of the test image in the window file.
+static const int kNumImages = 10;
+
+// Exposes the image cache of the layer.
+template <typename Dtype>
+class CachedWindowDataLayer : public WindowDataLayer<Dtype> {
+ public:
+  explicit CachedWindowDataLayer(const LayerParameter& param)
+      : WindowDataLayer<Dtype>(param) {}
+  ImageCache* cache() const { return this->cache_.get(); }
+};
+
+template <typename Dtype>
+class WindowDataLayerTest : public CPUDeviceTest<Dtype> {
+ protected:
+  WindowDataLayerTest()
+      : seed_(1701),
+        blob_top_data_(new Blob<Dtype>()),
+        blob_top_label_(new Blob<Dtype>()) {}
+  virtual void SetUp() {
+    blob_top_vec_.push_back(blob_top_data_);
+    blob_top_vec_.push_back(blob_top_label_);
+    Caffe::set_random_seed(seed_);
+    // Copy the image under distinct names, so that the cache holds every
+    // copy apart.
+    std::ifstream image_file(EXAMPLES_SOURCE_DIR "images/cat.jpg",
+        std::ios::in | std::ios::binary);
+    const string image((std::istreambuf_iterator<char>(image_file)),
+        std::istreambuf_iterator<char>());
+    image_bytes_ = image.size();
+    // Create test window file, with a foreground and a background window
+    // per image.
+    MakeTempFilename(&filename_);
+    std::ofstream outfile(filename_.c_str(), std::ofstream::out);
+    LOG(INFO) << "Using temporary file " << filename_;
+    for (int i = 0; i < kNumImages; ++i) {
+      string image_filename;
+      MakeTempFilename(&image_filename);
+      std::ofstream copy(image_filename.c_str(),
+          std::ios::out | std::ios::binary);
+      copy << image;
+      copy.close();
+      outfile << "# " << i << "\n" << image_filename << "\n3 360 480\n2\n"
+          << 1 + i % 3 << " 1.0 " << 10 * i << " 20 " << 200 + 10 * i
+          << " 300\n0 0.1 300 100 470 350\n";
+    }
+    outfile.close();
+  }
+
+  virtual ~WindowDataLayerTest() {
+    delete blob_top_data_;
+    delete blob_top_label_;
+  }
+
+  void FillParameter(const int decode_threads, const bool cache_images,
+      LayerParameter* param) {
+    WindowDataParameter* window_data_param =
+        param->mutable_window_data_param();
+    window_data_param->set_source(filename_);
+    window_data_param->set_batch_size(8);
+    window_data_param->set_context_pad(4);
+    window_data_param->set_decode_threads(decode_threads);
+    window_data_param->set_cache_images(cache_images);
+    window_data_param->set_cache_size_mb(1);
+    TransformationParameter* transform_param =
+        param->mutable_transform_param();
+    transform_param->set_crop_size(24);
+    transform_param->set_mirror(true);
+  }
+
+  // Forwards num_batches batches of a layer seeded with seed_ into data.
+  void ReadBatches(const int decode_threads, const int num_batches,
+      vector<Dtype>* data) {
+    LayerParameter param;
+    FillParameter(decode_threads, false, &param);
+    Caffe::set_random_seed(seed_);
+    WindowDataLayer<Dtype> layer(param);
+    layer.SetUp(blob_bottom_vec_, blob_top_vec_);
+    data->clear();
+    for (int iter = 0; iter < num_batches; ++iter) {
+      layer.Forward(blob_bottom_vec_, blob_top_vec_);
+      data->insert(data->end(), blob_top_data_->cpu_data(),
+          blob_top_data_->cpu_data() + blob_top_data_->count());
+      data->insert(data->end(), blob_top_label_->cpu_data(),
+          blob_top_label_->cpu_data() + blob_top_label_->count());
+    }
+  }
+
+  int seed_;
+  size_t image_bytes_;
+  string filename_;
+  Blob<Dtype>* const blob_top_data_;
+  Blob<Dtype>* const blob_top_label_;
+  vector<Blob<Dtype>*> blob_bottom_vec_;
+  vector<Blob<Dtype>*> blob_top_vec_;
+};
+
+TYPED_TEST_CASE(WindowDataLayerTest, TestDtypes);
+
+TYPED_TEST(WindowDataLayerTest, TestRead) {
+  LayerParameter param;
+  this->FillParameter(1, false, &param);
+  WindowDataLayer<TypeParam> layer(param);
+  layer.SetUp(this->blob_bottom_vec_, this->blob_top_vec_);
+  EXPECT_EQ(this->blob_top_data_->num(), 8);
+  EXPECT_EQ(this->blob_top_data_->channels(), 3);
+  EXPECT_EQ(this->blob_top_data_->height(), 24);
+  EXPECT_EQ(this->blob_top_data_->width(), 24);
+  EXPECT_EQ(this->blob_top_label_->num(), 8);
+  layer.Forward(this->blob_bottom_vec_, this->blob_top_vec_);
+  // The background windows come first.
+  for (int i = 0; i < 6; ++i) {
+    EXPECT_EQ(0, this->blob_top_label_->cpu_data()[i]);
+  }
+  for (int i = 6; i < 8; ++i) {
+    EXPECT_GE(this->blob_top_label_->cpu_data()[i], 1);
+    EXPECT_LE(this->blob_top_label_->cpu_data()[i], 3);
+  }
+}
+
+TYPED_TEST(WindowDataLayerTest, TestDecodeThreads) {
+  vector<TypeParam> data;
+  this->ReadBatches(1, 4, &data);
+  vector<TypeParam> threaded_data;
+  this->ReadBatches(4, 4, &threaded_data);
+  ASSERT_EQ(data.size(), threaded_data.size());
+  EXPECT_EQ(0, memcmp(&data[0], &threaded_data[0],
+      data.size() * sizeof(TypeParam)));
+}
+
+TYPED_TEST(WindowDataLayerTest, TestSharedCache) {
+  LayerParameter param;
+  this->FillParameter(2, true, &param);
+  CachedWindowDataLayer<TypeParam> layer(param);
+  layer.SetUp(this->blob_bottom_vec_, this->blob_top_vec_);
+  Blob<TypeParam> other_data;
+  Blob<TypeParam> other_label;
+  vector<Blob<TypeParam>*> other_top_vec;
+  other_top_vec.push_back(&other_data);
+  other_top_vec.push_back(&other_label);
+  CachedWindowDataLayer<TypeParam> other_layer(param);
+  other_layer.SetUp(this->blob_bottom_vec_, other_top_vec);
+  ASSERT_TRUE(layer.cache() != NULL);
+  EXPECT_EQ(layer.cache(), other_layer.cache());
+  for (int iter = 0; iter < 4; ++iter) {
+    layer.Forward(this->blob_bottom_vec_, this->blob_top_vec_);
+    other_layer.Forward(this->blob_bottom_vec_, other_top_vec);
+  }
+  // Both layers read through the cache.
+  EXPECT_GT(layer.cache()->hits(), 0);
+}
+
+TYPED_TEST(WindowDataLayerTest, TestCacheBound) {
+  LayerParameter param;
+  this->FillParameter(2, true, &param);
+  CachedWindowDataLayer<TypeParam> layer(param);
+  layer.SetUp(this->blob_bottom_vec_, this->blob_top_vec_);
+  ASSERT_TRUE(layer.cache() != NULL);
+  EXPECT_EQ(1 << 20, layer.cache()->capacity());
+  // The images do not all fit in the cache.
+  ASSERT_GT(kNumImages * this->image_bytes_, 1 << 20);
+  for (int iter = 0; iter < 8; ++iter) {
+    layer.Forward(this->blob_bottom_vec_, this->blob_top_vec_);
+    EXPECT_LE(layer.cache()->bytes(), layer.cache()->capacity());
+  }
+  EXPECT_GT(layer.cache()->size(), 0);
+  EXPECT_LT(layer.cache()->size(), kNumImages);
+}
+
+}  // namespace caffe
+#endif  // USE_OPENCV
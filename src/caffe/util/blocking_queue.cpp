@@ -2,7 +2,7 @@
 #include <string>
 
 #include "caffe/data_reader.hpp"
-#include "caffe/layers/base_data_layer.hpp"
+#include "caffe/layers/async_memory_data_layer.hpp"
 #include "caffe/parallel.hpp"
 #include "caffe/util/blocking_queue.hpp"
 
@@ -86,11 +86,11 @@ size_t BlockingQueue<T>::size() const {
   return queue_.size();
 }
 
-template class BlockingQueue<Batch<float>*>;
-template class BlockingQueue<Batch<double>*>;
 template class BlockingQueue<Datum*>;
 template class BlockingQueue<shared_ptr<DataReader::QueuePair> >;
 template class BlockingQueue<P2PSync<float>*>;
 template class BlockingQueue<P2PSync<double>*>;
+template class BlockingQueue<AsyncMemoryDataLayer<float>::Input*>;
+template class BlockingQueue<AsyncMemoryDataLayer<double>::Input*>;
 
 }  // namespace caffe
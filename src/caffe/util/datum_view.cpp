@@ -0,0 +1,85 @@
+#include <google/protobuf/io/coded_stream.h>
+#include <google/protobuf/wire_format_lite.h>
+#include <stdint.h>
+
+#include <string>
+
+#include "caffe/util/datum_view.hpp"
+
+namespace caffe {
+
+using google::protobuf::io::CodedInputStream;
+using google::protobuf::internal::WireFormatLite;
+
+void DatumView::Clear() {
+  bytes_ = NULL;
+  size_ = 0;
+  channels_ = 0;
+  height_ = 0;
+  width_ = 0;
+  label_ = 0;
+  encoded_ = false;
+  data_ = NULL;
+  data_size_ = 0;
+  float_data_size_ = 0;
+}
+
+bool DatumView::Parse(const char* bytes, size_t size) {
+  Clear();
+  bytes_ = bytes;
+  size_ = size;
+  CodedInputStream input(reinterpret_cast<const uint8_t*>(bytes), size);
+  uint64_t value;
+  uint32_t length;
+  while (uint32_t tag = input.ReadTag()) {
+    const int field = WireFormatLite::GetTagFieldNumber(tag);
+    const WireFormatLite::WireType wire_type =
+        WireFormatLite::GetTagWireType(tag);
+    if (field == Datum::kDataFieldNumber &&
+        wire_type == WireFormatLite::WIRETYPE_LENGTH_DELIMITED) {
+      if (!input.ReadVarint32(&length)) { return false; }
+      data_ = bytes + input.CurrentPosition();
+      data_size_ = length;
+      if (!input.Skip(length)) { return false; }
+    } else if (field == Datum::kFloatDataFieldNumber &&
+        wire_type == WireFormatLite::WIRETYPE_LENGTH_DELIMITED) {
+      // Packed floats.
+      if (!input.ReadVarint32(&length)) { return false; }
+      float_data_size_ += length / sizeof(float);
+      if (!input.Skip(length)) { return false; }
+    } else if (wire_type == WireFormatLite::WIRETYPE_VARINT &&
+        (field == Datum::kChannelsFieldNumber ||
+         field == Datum::kHeightFieldNumber ||
+         field == Datum::kWidthFieldNumber ||
+         field == Datum::kLabelFieldNumber ||
+         field == Datum::kEncodedFieldNumber)) {
+      // Negative int32 values take all 64 bits.
+      if (!input.ReadVarint64(&value)) { return false; }
+      const int32_t int_value = static_cast<int32_t>(value);
+      switch (field) {
+      case Datum::kChannelsFieldNumber: channels_ = int_value; break;
+      case Datum::kHeightFieldNumber: height_ = int_value; break;
+      case Datum::kWidthFieldNumber: width_ = int_value; break;
+      case Datum::kLabelFieldNumber: label_ = int_value; break;
+      default: encoded_ = value != 0;
+      }
+    } else {
+      if (field == Datum::kFloatDataFieldNumber) {
+        ++float_data_size_;
+      }
+      if (!WireFormatLite::SkipField(&input, tag)) { return false; }
+    }
+  }
+  return input.ConsumedEntireMessage();
+}
+
+bool DatumView::ParseCopy(const char* bytes, size_t size) {
+  buffer_.assign(bytes, size);
+  return Parse(buffer_.data(), buffer_.size());
+}
+
+void DatumView::ToDatum(Datum* datum) const {
+  CHECK(datum->ParseFromArray(bytes_, size_)) << "Could not parse datum";
+}
+
+}  // namespace caffe
@@ -1,11 +1,27 @@
 #include "caffe/util/db.hpp"
 #include "caffe/util/db_leveldb.hpp"
 #include "caffe/util/db_lmdb.hpp"
+#include "caffe/util/db_sharded.hpp"
 
 #include <string>
 
 namespace caffe { namespace db {
 
+size_t Cursor::size() {
+  size_t count = 0;
+  for (SeekToFirst(); valid(); Next()) {
+    ++count;
+  }
+  return count;
+}
+
+void Cursor::SeekToRecord(size_t record) {
+  SeekToFirst();
+  for (size_t i = 0; i < record && valid(); ++i) {
+    Next();
+  }
+}
+
 DB* GetDB(DataParameter::DB backend) {
   switch (backend) {
 #ifdef USE_LEVELDB
@@ -16,6 +32,8 @@ DB* GetDB(DataParameter::DB backend) {
   case DataParameter_DB_LMDB:
     return new LMDB();
 #endif  // USE_LMDB
+  case DataParameter_DB_SHARDED:
+    return new ShardedDB();
   default:
     LOG(FATAL) << "Unknown database backend";
     return NULL;
@@ -33,6 +51,9 @@ DB* GetDB(const string& backend) {
     return new LMDB();
   }
 #endif  // USE_LMDB
+  if (backend == "sharded") {
+    return new ShardedDB();
+  }
   LOG(FATAL) << "Unknown database backend";
   return NULL;
 }
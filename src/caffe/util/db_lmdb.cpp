@@ -69,13 +69,14 @@ LMDBTransaction* LMDB::NewTransaction() {
   return new LMDBTransaction(&mdb_dbi_, mdb_txn);
 }
 
-void LMDBTransaction::Put(const string& key, const string& value) {
+void LMDBTransaction::Put(const string& key, const string& value,
+    unsigned int flags) {
   MDB_val mdb_key, mdb_value;
   mdb_key.mv_data = const_cast<char*>(key.data());
   mdb_key.mv_size = key.size();
   mdb_value.mv_data = const_cast<char*>(value.data());
   mdb_value.mv_size = value.size();
-  MDB_CHECK(mdb_put(mdb_txn_, *mdb_dbi_, &mdb_key, &mdb_value, 0));
+  MDB_CHECK(mdb_put(mdb_txn_, *mdb_dbi_, &mdb_key, &mdb_value, flags));
 }
 
 }  // namespace db
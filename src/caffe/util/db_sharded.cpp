@@ -0,0 +1,207 @@
+#include <boost/filesystem.hpp>
+#include <boost/interprocess/file_mapping.hpp>
+#include <boost/interprocess/mapped_region.hpp>
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
+#include "caffe/util/db_sharded.hpp"
+#include "caffe/util/format.hpp"
+
+namespace caffe { namespace db {
+
+namespace bfs = boost::filesystem;
+namespace bip = boost::interprocess;
+
+const uint64_t ShardedDB::kDefaultShardSize;
+
+static string ShardPath(const string& source, int shard, const char* ext) {
+  return source + "/shard_" + format_int(shard, 5) + ext;
+}
+
+static int CountShards(const string& source) {
+  int shards = 0;
+  while (bfs::exists(ShardPath(source, shards, ".idx"))) {
+    ++shards;
+  }
+  return shards;
+}
+
+class ShardedReader {
+ public:
+  ShardedReader(const string& source, int num_shards);
+
+  size_t size() const { return first_record_.back(); }
+  void Get(size_t record, const char** key, size_t* key_size,
+      const char** value, size_t* value_size) const;
+
+ private:
+  // Maps the file at path, or returns NULL if it is empty, as empty files
+  // cannot be mapped.
+  static bip::mapped_region* Map(const string& path);
+
+  vector<shared_ptr<bip::mapped_region> > indices_;
+  vector<shared_ptr<bip::mapped_region> > records_;
+  // The number of the first record of each shard, and the total number of
+  // records last.
+  vector<size_t> first_record_;
+
+  DISABLE_COPY_AND_ASSIGN(ShardedReader);
+};
+
+bip::mapped_region* ShardedReader::Map(const string& path) {
+  if (bfs::file_size(path) == 0) {
+    return NULL;
+  }
+  bip::file_mapping file(path.c_str(), bip::read_only);
+  return new bip::mapped_region(file, bip::read_only);
+}
+
+ShardedReader::ShardedReader(const string& source, int num_shards) {
+  first_record_.push_back(0);
+  for (int i = 0; i < num_shards; ++i) {
+    const string index_path = ShardPath(source, i, ".idx");
+    const string records_path = ShardPath(source, i, ".dat");
+    indices_.push_back(shared_ptr<bip::mapped_region>(Map(index_path)));
+    records_.push_back(shared_ptr<bip::mapped_region>(Map(records_path)));
+    const size_t index_size = indices_[i] ? indices_[i]->get_size() : 0;
+    const size_t records_size = records_[i] ? records_[i]->get_size() : 0;
+    // A writer may still be appending the last entry; it is not committed.
+    if (index_size % sizeof(ShardedRecord) != 0) {
+      LOG(WARNING) << "Ignoring the incomplete last entry of " << index_path;
+    }
+    const size_t count = index_size / sizeof(ShardedRecord);
+    if (count > 0) {
+      const ShardedRecord& last = static_cast<const ShardedRecord*>(
+          indices_[i]->get_address())[count - 1];
+      CHECK_LE(last.offset + last.key_size + last.value_size, records_size)
+          << "Truncated records " << records_path;
+    }
+    first_record_.push_back(first_record_.back() + count);
+  }
+}
+
+void ShardedReader::Get(size_t record, const char** key, size_t* key_size,
+    const char** value, size_t* value_size) const {
+  DCHECK_LT(record, size());
+  // The last shard whose first record is not after record.
+  const int shard = std::upper_bound(first_record_.begin(),
+      first_record_.end(), record) - first_record_.begin() - 1;
+  const ShardedRecord& entry = static_cast<const ShardedRecord*>(
+      indices_[shard]->get_address())[record - first_record_[shard]];
+  // Records are appended in order, so no entry points past the last one.
+  const char* records = records_[shard] ?
+      static_cast<const char*>(records_[shard]->get_address()) : NULL;
+  *key = records + entry.offset;
+  *key_size = entry.key_size;
+  *value = *key + entry.key_size;
+  *value_size = entry.value_size;
+}
+
+ShardedCursor::ShardedCursor(const shared_ptr<const ShardedReader>& reader)
+    : reader_(reader), size_(reader->size()) {
+  SeekToFirst();
+}
+
+void ShardedCursor::Seek(const string& key) {
+  for (SeekToFirst(); valid(); Next()) {
+    if (key.compare(0, key.size(), key_, key_size_) == 0) {
+      return;
+    }
+  }
+}
+
+void ShardedCursor::SeekToRecord(size_t record) {
+  record_ = std::min(record, size_);
+  if (record_ < size_) {
+    reader_->Get(record_, &key_, &key_size_, &value_, &value_size_);
+  } else {
+    key_ = value_ = NULL;
+    key_size_ = value_size_ = 0;
+  }
+}
+
+void ShardedTransaction::Put(const string& key, const string& value) {
+  ShardedRecord entry;
+  entry.offset = records_.size();
+  entry.key_size = key.size();
+  entry.value_size = value.size();
+  index_.push_back(entry);
+  records_ += key;
+  records_ += value;
+}
+
+void ShardedTransaction::Commit() {
+  db_->Append(records_, index_);
+  records_.clear();
+  index_.clear();
+}
+
+void ShardedDB::Open(const string& source, Mode mode) {
+  if (mode == NEW) {
+    CHECK(bfs::create_directory(source)) << "mkdir " << source << " failed";
+  } else {
+    CHECK(bfs::is_directory(source)) << "Failed to open sharded db " << source;
+  }
+  source_ = source;
+  mode_ = mode;
+  num_shards_ = CountShards(source);
+  LOG(INFO) << "Opened sharded db " << source << " with " << num_shards_
+      << " shards";
+}
+
+void ShardedDB::Close() {
+  if (records_file_.is_open()) {
+    records_file_.close();
+    index_file_.close();
+  }
+}
+
+ShardedCursor* ShardedDB::NewCursor() {
+  // Records appended since the database was opened are visible too.
+  if (records_file_.is_open()) {
+    records_file_.flush();
+    index_file_.flush();
+  }
+  num_shards_ = std::max(num_shards_, CountShards(source_));
+  return new ShardedCursor(shared_ptr<const ShardedReader>(
+      new ShardedReader(source_, num_shards_)));
+}
+
+void ShardedDB::Append(const string& records,
+    const vector<ShardedRecord>& index) {
+  CHECK_NE(mode_, READ) << "Sharded db " << source_ << " is read only";
+  if (index.empty()) {
+    return;
+  }
+  // Shards written by earlier sessions are never reopened for writing.
+  if (!records_file_.is_open() ||
+      (shard_bytes_ > 0 && shard_bytes_ + records.size() > shard_size_)) {
+    Close();
+    const int shard = std::max(num_shards_, CountShards(source_));
+    const std::ios::openmode mode = std::ios::out | std::ios::binary;
+    records_file_.open(ShardPath(source_, shard, ".dat").c_str(), mode);
+    index_file_.open(ShardPath(source_, shard, ".idx").c_str(), mode);
+    CHECK(records_file_ && index_file_) << "Failed to create shard " << shard
+        << " of " << source_;
+    num_shards_ = shard + 1;
+    shard_bytes_ = 0;
+  }
+  vector<ShardedRecord> shard_index(index);
+  for (int i = 0; i < shard_index.size(); ++i) {
+    shard_index[i].offset += shard_bytes_;
+  }
+  // The records go first, so that readers never see an index entry
+  // pointing past the end of its records.
+  records_file_.write(records.data(), records.size());
+  records_file_.flush();
+  index_file_.write(reinterpret_cast<const char*>(&shard_index[0]),
+      shard_index.size() * sizeof(ShardedRecord));
+  index_file_.flush();
+  CHECK(records_file_ && index_file_) << "Failed to write to " << source_;
+  shard_bytes_ += records.size();
+}
+
+}  // namespace db
+}  // namespace caffe
@@ -0,0 +1,212 @@
+#include <cmath>
+#include <string>
+#include <vector>
+
+#include "caffe/common.hpp"
+#include "caffe/util/fuse_layers.hpp"
+
+namespace caffe {
+
+// Whether layer layer_id is the only one to read the top that layer top_id
+// produces.
+static bool IsOnlyReader(const NetParameter& param, const int top_id,
+    const int layer_id) {
+  const string& blob_name = param.layer(top_id).top(0);
+  for (int i = top_id + 1; i < param.layer_size(); ++i) {
+    const LayerParameter& layer_param = param.layer(i);
+    for (int j = 0; j < layer_param.bottom_size(); ++j) {
+      if (layer_param.bottom(j) == blob_name && i != layer_id) {
+        return false;
+      }
+    }
+    for (int j = 0; j < layer_param.top_size(); ++j) {
+      if (layer_param.top(j) == blob_name) { return true; }
+    }
+  }
+  return true;
+}
+
+// Whether layer layer_id exists and reads only the top of layer top_id.
+static bool FollowsAlone(const NetParameter& param, const int top_id,
+    const int layer_id, const string& type) {
+  if (layer_id >= param.layer_size()) { return false; }
+  const LayerParameter& layer_param = param.layer(layer_id);
+  return layer_param.type() == type && layer_param.bottom_size() == 1 &&
+      layer_param.top_size() == 1 &&
+      layer_param.bottom(0) == param.layer(top_id).top(0) &&
+      IsOnlyReader(param, top_id, layer_id);
+}
+
+static void ReadBlobProto(const BlobProto& proto, vector<double>* data) {
+  if (proto.double_data_size() > 0) {
+    data->assign(proto.double_data().begin(), proto.double_data().end());
+  } else {
+    data->assign(proto.data().begin(), proto.data().end());
+  }
+}
+
+static void WriteBlobProto(const vector<double>& data, BlobProto* proto) {
+  if (proto->double_data_size() > 0) {
+    proto->clear_double_data();
+    for (int i = 0; i < data.size(); ++i) {
+      proto->add_double_data(data[i]);
+    }
+  } else {
+    proto->clear_data();
+    for (int i = 0; i < data.size(); ++i) {
+      proto->add_data(data[i]);
+    }
+  }
+}
+
+// Scales the filters of conv by scale and sets its bias to
+// scale * bias + shift, per output channel.
+static void FoldBlobs(const vector<double>& scale, const vector<double>& shift,
+    LayerParameter* conv) {
+  const int num_output = scale.size();
+  vector<double> weight;
+  ReadBlobProto(conv->blobs(0), &weight);
+  CHECK_EQ(weight.size() % num_output, 0)
+      << "Cannot fold into layer " << conv->name();
+  const int filter_count = weight.size() / num_output;
+  for (int i = 0; i < weight.size(); ++i) {
+    weight[i] *= scale[i / filter_count];
+  }
+  WriteBlobProto(weight, conv->mutable_blobs(0));
+  vector<double> bias(num_output, 0);
+  if (conv->blobs_size() > 1) {
+    ReadBlobProto(conv->blobs(1), &bias);
+  } else {
+    BlobProto* bias_proto = conv->add_blobs();
+    bias_proto->mutable_shape()->add_dim(num_output);
+    if (conv->blobs(0).double_data_size() > 0) {
+      bias_proto->add_double_data(0);
+    }
+  }
+  CHECK_EQ(bias.size(), num_output)
+      << "Cannot fold into layer " << conv->name();
+  for (int i = 0; i < num_output; ++i) {
+    bias[i] = scale[i] * bias[i] + shift[i];
+  }
+  WriteBlobProto(bias, conv->mutable_blobs(1));
+}
+
+// Folds y = (x - mean) / sqrt(var + eps) into scale and shift.
+static void FoldBatchNorm(const LayerParameter& bn, vector<double>* scale,
+    vector<double>* shift) {
+  CHECK_EQ(bn.blobs_size(), 3) << "Cannot fold layer " << bn.name();
+  vector<double> mean, variance, scale_factor;
+  ReadBlobProto(bn.blobs(0), &mean);
+  ReadBlobProto(bn.blobs(1), &variance);
+  ReadBlobProto(bn.blobs(2), &scale_factor);
+  CHECK_EQ(mean.size(), scale->size()) << "Cannot fold layer " << bn.name();
+  CHECK_EQ(variance.size(), scale->size())
+      << "Cannot fold layer " << bn.name();
+  // BatchNormLayer keeps running sums along with their weight.
+  const double factor = scale_factor[0] == 0 ? 0 : 1 / scale_factor[0];
+  const double eps = bn.batch_norm_param().eps();
+  for (int i = 0; i < scale->size(); ++i) {
+    const double inv_std = 1 / std::sqrt(variance[i] * factor + eps);
+    (*shift)[i] = ((*shift)[i] - mean[i] * factor) * inv_std;
+    (*scale)[i] *= inv_std;
+  }
+}
+
+// Folds y = gamma * x + beta into scale and shift.
+static void FoldScale(const LayerParameter& scale_layer,
+    vector<double>* scale, vector<double>* shift) {
+  CHECK_GE(scale_layer.blobs_size(), 1)
+      << "Cannot fold layer " << scale_layer.name();
+  vector<double> gamma, beta(scale->size(), 0);
+  ReadBlobProto(scale_layer.blobs(0), &gamma);
+  if (scale_layer.blobs_size() > 1) {
+    ReadBlobProto(scale_layer.blobs(1), &beta);
+  }
+  CHECK_EQ(gamma.size(), scale->size())
+      << "Cannot fold layer " << scale_layer.name();
+  CHECK_EQ(beta.size(), scale->size())
+      << "Cannot fold layer " << scale_layer.name();
+  for (int i = 0; i < scale->size(); ++i) {
+    (*scale)[i] *= gamma[i];
+    (*shift)[i] = gamma[i] * (*shift)[i] + beta[i];
+  }
+}
+
+int FuseLayers(const NetParameter& param, NetParameter* param_fused,
+    vector<string>* folded_names) {
+  param_fused->CopyFrom(param);
+  param_fused->clear_layer();
+  int num_folded = 0;
+  for (int i = 0; i < param.layer_size(); ++i) {
+    const LayerParameter& layer_param = param.layer(i);
+    LayerParameter* fused = param_fused->add_layer();
+    fused->CopyFrom(layer_param);
+    if (layer_param.type() != "Convolution" ||
+        layer_param.bottom_size() != 1 || layer_param.top_size() != 1 ||
+        layer_param.convolution_param().axis() != 1 ||
+        layer_param.convolution_param().fuse_relu()) {
+      continue;
+    }
+    int last = i;
+    int batch_norm_id = -1;
+    int scale_id = -1;
+    // BatchNorm folds with its global statistics, whatever use_global_stats
+    // says: a .caffemodel usually carries the settings of the TRAIN net.
+    if (FollowsAlone(param, last, last + 1, "BatchNorm")) {
+      batch_norm_id = ++last;
+    }
+    if (FollowsAlone(param, last, last + 1, "Scale") &&
+        param.layer(last + 1).scale_param().axis() == 1 &&
+        param.layer(last + 1).scale_param().num_axes() == 1) {
+      scale_id = ++last;
+    }
+    const bool folds_affine = last > i;
+    // Folding blobs takes those of every folded layer; a model fine-tuned
+    // from a checkpoint without BatchNorm, say, is left unfolded.
+    bool has_blobs = false;
+    int missing_id = -1;
+    for (int j = i; j <= last; ++j) {
+      if (param.layer(j).blobs_size() > 0) {
+        has_blobs = true;
+      } else if (missing_id < 0) {
+        missing_id = j;
+      }
+    }
+    if (has_blobs && missing_id >= 0) {
+      LOG(WARNING) << "Not folding layers into layer " << layer_param.name()
+          << ": layer " << param.layer(missing_id).name() << " has no blobs.";
+      continue;
+    }
+    const int num_output = layer_param.convolution_param().num_output();
+    vector<double> scale(num_output, 1), shift(num_output, 0);
+    if (has_blobs && batch_norm_id >= 0) {
+      FoldBatchNorm(param.layer(batch_norm_id), &scale, &shift);
+    }
+    if (has_blobs && scale_id >= 0) {
+      FoldScale(param.layer(scale_id), &scale, &shift);
+    }
+    if (FollowsAlone(param, last, last + 1, "ReLU") &&
+        param.layer(last + 1).relu_param().negative_slope() == 0) {
+      ++last;
+      fused->mutable_convolution_param()->set_fuse_relu(true);
+    }
+    if (last == i) { continue; }
+    LOG(INFO) << "Folding " << last - i << " layer(s) into layer "
+        << layer_param.name();
+    fused->set_top(0, param.layer(last).top(0));
+    if (folds_affine) {
+      fused->mutable_convolution_param()->set_bias_term(true);
+      if (has_blobs) { FoldBlobs(scale, shift, fused); }
+      for (int j = i; folded_names && j <= last; ++j) {
+        if (param.layer(j).type() != "ReLU") {
+          folded_names->push_back(param.layer(j).name());
+        }
+      }
+    }
+    num_folded += last - i;
+    i = last;
+  }
+  return num_folded;
+}
+
+}  // namespace caffe
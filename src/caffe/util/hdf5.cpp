@@ -1,15 +1,27 @@
 #include "caffe/util/hdf5.hpp"
 
+#include <boost/thread.hpp>
 #include <string>
 #include <vector>
 
 namespace caffe {
 
+static boost::recursive_mutex hdf5_mutex;
+
+HDF5Lock::HDF5Lock() {
+  hdf5_mutex.lock();
+}
+
+HDF5Lock::~HDF5Lock() {
+  hdf5_mutex.unlock();
+}
+
 // Verifies format of data stored in HDF5 file and reshapes blob accordingly.
 template <typename Dtype>
 void hdf5_load_nd_dataset_helper(
     hid_t file_id, const char* dataset_name_, int min_dim, int max_dim,
     Blob<Dtype>* blob) {
+  HDF5Lock lock;
   // Verify that the dataset exists.
   CHECK(H5LTfind_dataset(file_id, dataset_name_))
       << "Failed to find HDF5 dataset " << dataset_name_;
@@ -68,6 +80,7 @@ void hdf5_load_nd_dataset_helper(
 template <>
 void hdf5_load_nd_dataset<float>(hid_t file_id, const char* dataset_name_,
         int min_dim, int max_dim, Blob<float>* blob) {
+  HDF5Lock lock;
   hdf5_load_nd_dataset_helper(file_id, dataset_name_, min_dim, max_dim, blob);
   herr_t status = H5LTread_dataset_float(
     file_id, dataset_name_, blob->mutable_cpu_data());
@@ -77,6 +90,7 @@ void hdf5_load_nd_dataset<float>(hid_t file_id, const char* dataset_name_,
 template <>
 void hdf5_load_nd_dataset<double>(hid_t file_id, const char* dataset_name_,
         int min_dim, int max_dim, Blob<double>* blob) {
+  HDF5Lock lock;
   hdf5_load_nd_dataset_helper(file_id, dataset_name_, min_dim, max_dim, blob);
   herr_t status = H5LTread_dataset_double(
     file_id, dataset_name_, blob->mutable_cpu_data());
@@ -87,6 +101,7 @@ template <>
 void hdf5_save_nd_dataset<float>(
     const hid_t file_id, const string& dataset_name, const Blob<float>& blob,
     bool write_diff) {
+  HDF5Lock lock;
   int num_axes = blob.num_axes();
   hsize_t *dims = new hsize_t[num_axes];
   for (int i = 0; i < num_axes; ++i) {
@@ -108,6 +123,7 @@ template <>
 void hdf5_save_nd_dataset<double>(
     hid_t file_id, const string& dataset_name, const Blob<double>& blob,
     bool write_diff) {
+  HDF5Lock lock;
   int num_axes = blob.num_axes();
   hsize_t *dims = new hsize_t[num_axes];
   for (int i = 0; i < num_axes; ++i) {
@@ -125,7 +141,72 @@ void hdf5_save_nd_dataset<double>(
   delete[] dims;
 }
 
+template <> hid_t hdf5_native_type<float>() { return H5T_NATIVE_FLOAT; }
+template <> hid_t hdf5_native_type<double>() { return H5T_NATIVE_DOUBLE; }
+
+hid_t hdf5_create_extendable_dataset(hid_t file_id,
+    const string& dataset_name, hid_t type, const vector<int>& row_shape,
+    hsize_t chunk_rows, int gzip_level, bool shuffle) {
+  HDF5Lock lock;
+  CHECK_GT(chunk_rows, 0);
+  const int num_axes = row_shape.size() + 1;
+  vector<hsize_t> dims(num_axes, 0);
+  vector<hsize_t> max_dims(num_axes, H5S_UNLIMITED);
+  vector<hsize_t> chunk_dims(num_axes, chunk_rows);
+  for (int i = 1; i < num_axes; ++i) {
+    dims[i] = max_dims[i] = chunk_dims[i] = row_shape[i - 1];
+  }
+  hid_t space = H5Screate_simple(num_axes, &dims[0], &max_dims[0]);
+  hid_t properties = H5Pcreate(H5P_DATASET_CREATE);
+  herr_t status = H5Pset_chunk(properties, num_axes, &chunk_dims[0]);
+  CHECK_GE(status, 0) << "Failed to set chunks of " << dataset_name;
+  if (shuffle) {
+    status = H5Pset_shuffle(properties);
+    CHECK_GE(status, 0) << "Failed to set shuffle filter of " << dataset_name;
+  }
+  if (gzip_level > 0) {
+    CHECK_LE(gzip_level, 9);
+    status = H5Pset_deflate(properties, gzip_level);
+    CHECK_GE(status, 0) << "Failed to set gzip filter of " << dataset_name;
+  }
+  hid_t dataset = H5Dcreate2(file_id, dataset_name.c_str(), type, space,
+      H5P_DEFAULT, properties, H5P_DEFAULT);
+  CHECK_GE(dataset, 0) << "Failed to make dataset " << dataset_name;
+  H5Pclose(properties);
+  H5Sclose(space);
+  return dataset;
+}
+
+void hdf5_append_rows(hid_t dataset, hid_t type, hsize_t rows,
+    const void* data) {
+  HDF5Lock lock;
+  hid_t file_space = H5Dget_space(dataset);
+  const int num_axes = H5Sget_simple_extent_ndims(file_space);
+  vector<hsize_t> dims(num_axes);
+  H5Sget_simple_extent_dims(file_space, &dims[0], NULL);
+  H5Sclose(file_space);
+  vector<hsize_t> start(num_axes, 0);
+  start[0] = dims[0];
+  dims[0] += rows;
+  herr_t status = H5Dset_extent(dataset, &dims[0]);
+  CHECK_GE(status, 0) << "Failed to extend dataset to " << dims[0] << " rows";
+  file_space = H5Dget_space(dataset);
+  vector<hsize_t> count(dims);
+  count[0] = rows;
+  status = H5Sselect_hyperslab(file_space, H5S_SELECT_SET, &start[0], NULL,
+      &count[0], NULL);
+  CHECK_GE(status, 0) << "Failed to select rows " << start[0] << " to "
+      << dims[0];
+  hid_t mem_space = H5Screate_simple(num_axes, &count[0], NULL);
+  status = H5Dwrite(dataset, type, mem_space, file_space, H5P_DEFAULT, data);
+  CHECK_GE(status, 0) << "Failed to write rows " << start[0] << " to "
+      << dims[0];
+  H5Sclose(mem_space);
+  H5Sclose(file_space);
+}
+
 string hdf5_load_string(hid_t loc_id, const string& dataset_name) {
+  HDF5Lock lock;
   // Get size of dataset
   size_t size;
   H5T_class_t class_;
@@ -143,6 +224,7 @@ string hdf5_load_string(hid_t loc_id, const string& dataset_name) {
 
 void hdf5_save_string(hid_t loc_id, const string& dataset_name,
                       const string& s) {
+  HDF5Lock lock;
   herr_t status = \
     H5LTmake_dataset_string(loc_id, dataset_name.c_str(), s.c_str());
   CHECK_GE(status, 0)
@@ -150,6 +232,7 @@ void hdf5_save_string(hid_t loc_id, const string& dataset_name,
 }
 
 int hdf5_load_int(hid_t loc_id, const string& dataset_name) {
+  HDF5Lock lock;
   int val;
   herr_t status = H5LTread_dataset_int(loc_id, dataset_name.c_str(), &val);
   CHECK_GE(status, 0)
@@ -158,6 +241,7 @@ int hdf5_load_int(hid_t loc_id, const string& dataset_name) {
 }
 
 void hdf5_save_int(hid_t loc_id, const string& dataset_name, int i) {
+  HDF5Lock lock;
   hsize_t one = 1;
   herr_t status = \
     H5LTmake_dataset_int(loc_id, dataset_name.c_str(), 1, &one, &i);
@@ -166,6 +250,7 @@ void hdf5_save_int(hid_t loc_id, const string& dataset_name, int i) {
 }
 
 int hdf5_get_num_links(hid_t loc_id) {
+  HDF5Lock lock;
   H5G_info_t info;
   herr_t status = H5Gget_info(loc_id, &info);
   CHECK_GE(status, 0) << "Error while counting HDF5 links.";
@@ -173,6 +258,7 @@ int hdf5_get_num_links(hid_t loc_id) {
 }
 
 string hdf5_get_name_by_idx(hid_t loc_id, int idx) {
+  HDF5Lock lock;
   ssize_t str_size = H5Lget_name_by_idx(
       loc_id, ".", H5_INDEX_NAME, H5_ITER_NATIVE, idx, NULL, 0, H5P_DEFAULT);
   CHECK_GE(str_size, 0) << "Error retrieving HDF5 dataset at index " << idx;
@@ -1,7 +1,10 @@
+#include <boost/bind.hpp>
+#include <algorithm>
 #include <vector>
 
 #include "caffe/util/im2col.hpp"
 #include "caffe/util/math_functions.hpp"
+#include "caffe/util/thread_pool.hpp"
 
 namespace caffe {
 
@@ -15,43 +18,127 @@ inline bool is_a_ge_zero_and_a_lt_b(int a, int b) {
   return static_cast<unsigned>(a) < static_cast<unsigned>(b);
 }
 
+// Splits the 2D im2col and col2im over the (image, channel) planes of the
+// input. Each plane is written by a single thread, and its kernel_h * kernel_w
+// passes over the input run back to back so the plane stays in cache.
 template <typename Dtype>
-void im2col_cpu(const Dtype* data_im, const int channels,
-    const int height, const int width, const int kernel_h, const int kernel_w,
-    const int pad_h, const int pad_w,
-    const int stride_h, const int stride_w,
-    const int dilation_h, const int dilation_w,
-    Dtype* data_col) {
-  const int output_h = (height + 2 * pad_h -
-    (dilation_h * (kernel_h - 1) + 1)) / stride_h + 1;
-  const int output_w = (width + 2 * pad_w -
-    (dilation_w * (kernel_w - 1) + 1)) / stride_w + 1;
-  const int channel_size = height * width;
-  for (int channel = channels; channel--; data_im += channel_size) {
-    for (int kernel_row = 0; kernel_row < kernel_h; kernel_row++) {
-      for (int kernel_col = 0; kernel_col < kernel_w; kernel_col++) {
-        int input_row = -pad_h + kernel_row * dilation_h;
-        for (int output_rows = output_h; output_rows; output_rows--) {
-          if (!is_a_ge_zero_and_a_lt_b(input_row, height)) {
-            for (int output_cols = output_w; output_cols; output_cols--) {
-              *(data_col++) = 0;
+struct Im2colTask {
+  Im2colTask(const int channels, const int height, const int width,
+      const int kernel_h, const int kernel_w, const int pad_h,
+      const int pad_w, const int stride_h, const int stride_w,
+      const int dilation_h, const int dilation_w, const int num)
+      : channels(channels), height(height), width(width),
+        kernel_h(kernel_h), kernel_w(kernel_w), pad_h(pad_h), pad_w(pad_w),
+        stride_h(stride_h), stride_w(stride_w), dilation_h(dilation_h),
+        dilation_w(dilation_w),
+        output_h((height + 2 * pad_h -
+            (dilation_h * (kernel_h - 1) + 1)) / stride_h + 1),
+        output_w((width + 2 * pad_w -
+            (dilation_w * (kernel_w - 1) + 1)) / stride_w + 1),
+        col_pitch(num * output_h * output_w) {}
+
+  // Number of planes that together produce kCPUParallelGrain column values.
+  int grain() const {
+    return std::max(1, kCPUParallelGrain / std::max(1,
+        kernel_h * kernel_w * output_h * output_w));
+  }
+
+  // Unrolls planes [begin, end) of data_im into data_col.
+  void Im2col(const Dtype* data_im, Dtype* data_col, const int begin,
+      const int end) const {
+    const int channel_size = height * width;
+    const int output_size = output_h * output_w;
+    for (int plane = begin; plane < end; ++plane) {
+      const Dtype* plane_im = data_im + plane * channel_size;
+      // Image n of the batch owns columns [n * output_size, (n + 1) *
+      // output_size) of every row.
+      Dtype* plane_col = data_col
+          + (plane % channels) * kernel_h * kernel_w * col_pitch
+          + (plane / channels) * output_size;
+      for (int kernel_row = 0; kernel_row < kernel_h; kernel_row++) {
+        for (int kernel_col = 0; kernel_col < kernel_w; kernel_col++) {
+          Dtype* col = plane_col;
+          plane_col += col_pitch;
+          int input_row = -pad_h + kernel_row * dilation_h;
+          for (int output_rows = output_h; output_rows; output_rows--) {
+            if (!is_a_ge_zero_and_a_lt_b(input_row, height)) {
+              for (int output_cols = output_w; output_cols; output_cols--) {
+                *(col++) = 0;
+              }
+            } else {
+              int input_col = -pad_w + kernel_col * dilation_w;
+              for (int output_col = output_w; output_col; output_col--) {
+                if (is_a_ge_zero_and_a_lt_b(input_col, width)) {
+                  *(col++) = plane_im[input_row * width + input_col];
+                } else {
+                  *(col++) = 0;
+                }
+                input_col += stride_w;
+              }
             }
-          } else {
-            int input_col = -pad_w + kernel_col * dilation_w;
-            for (int output_col = output_w; output_col; output_col--) {
-              if (is_a_ge_zero_and_a_lt_b(input_col, width)) {
-                *(data_col++) = data_im[input_row * width + input_col];
-              } else {
-                *(data_col++) = 0;
+            input_row += stride_h;
+          }
+        }
+      }
+    }
+  }
+
+  // Accumulates the columns of planes [begin, end) back into data_im.
+  void Col2im(const Dtype* data_col, Dtype* data_im, const int begin,
+      const int end) const {
+    const int channel_size = height * width;
+    const int output_size = output_h * output_w;
+    caffe_set((end - begin) * channel_size, Dtype(0),
+        data_im + begin * channel_size);
+    for (int plane = begin; plane < end; ++plane) {
+      Dtype* plane_im = data_im + plane * channel_size;
+      const Dtype* plane_col = data_col
+          + (plane % channels) * kernel_h * kernel_w * col_pitch
+          + (plane / channels) * output_size;
+      for (int kernel_row = 0; kernel_row < kernel_h; kernel_row++) {
+        for (int kernel_col = 0; kernel_col < kernel_w; kernel_col++) {
+          const Dtype* col = plane_col;
+          plane_col += col_pitch;
+          int input_row = -pad_h + kernel_row * dilation_h;
+          for (int output_rows = output_h; output_rows; output_rows--) {
+            if (!is_a_ge_zero_and_a_lt_b(input_row, height)) {
+              col += output_w;
+            } else {
+              int input_col = -pad_w + kernel_col * dilation_w;
+              for (int output_col = output_w; output_col; output_col--) {
+                if (is_a_ge_zero_and_a_lt_b(input_col, width)) {
+                  plane_im[input_row * width + input_col] += *col;
+                }
+                col++;
+                input_col += stride_w;
               }
-              input_col += stride_w;
             }
+            input_row += stride_h;
           }
-          input_row += stride_h;
         }
       }
     }
   }
+
+  const int channels, height, width;
+  const int kernel_h, kernel_w;
+  const int pad_h, pad_w;
+  const int stride_h, stride_w;
+  const int dilation_h, dilation_w;
+  const int output_h, output_w;
+  // Distance between consecutive rows of the column buffer.
+  const int col_pitch;
+};
+
+template <typename Dtype>
+void im2col_cpu(const Dtype* data_im, const int channels,
+    const int height, const int width, const int kernel_h, const int kernel_w,
+    const int pad_h, const int pad_w,
+    const int stride_h, const int stride_w,
+    const int dilation_h, const int dilation_w,
+    Dtype* data_col) {
+  im2col_batch_cpu(data_im, 1, channels, height, width, kernel_h, kernel_w,
+      pad_h, pad_w, stride_h, stride_w, dilation_h, dilation_w, data_col);
 }
 
 // Explicit instantiation
@@ -66,26 +153,56 @@ template void im2col_cpu<double>(const double* data_im, const int channels,
     const int stride_w, const int dilation_h, const int dilation_w,
     double* data_col);
 
+template <typename Dtype>
+void im2col_batch_cpu(const Dtype* data_im, const int num,
+    const int channels, const int height, const int width,
+    const int kernel_h, const int kernel_w, const int pad_h, const int pad_w,
+    const int stride_h, const int stride_w,
+    const int dilation_h, const int dilation_w,
+    Dtype* data_col) {
+  const Im2colTask<Dtype> task(channels, height, width, kernel_h, kernel_w,
+      pad_h, pad_w, stride_h, stride_w, dilation_h, dilation_w, num);
+  caffe_cpu_parallel_for(num * channels,
+      boost::bind(&Im2colTask<Dtype>::Im2col, &task, data_im, data_col,
+      _1, _2), task.grain());
+}
+
+// Explicit instantiation
+template void im2col_batch_cpu<float>(const float* data_im, const int num,
+    const int channels, const int height, const int width,
+    const int kernel_h, const int kernel_w, const int pad_h, const int pad_w,
+    const int stride_h, const int stride_w,
+    const int dilation_h, const int dilation_w, float* data_col);
+template void im2col_batch_cpu<double>(const double* data_im, const int num,
+    const int channels, const int height, const int width,
+    const int kernel_h, const int kernel_w, const int pad_h, const int pad_w,
+    const int stride_h, const int stride_w,
+    const int dilation_h, const int dilation_w, double* data_col);
+
+// Processes the image channels [channel_begin, channel_end), which own the
+// column channels [channel_begin * kernel_size, channel_end * kernel_size).
 template <typename Dtype>
 inline void im2col_nd_core_cpu(const Dtype* data_input, const bool im2col,
     const int num_spatial_axes, const int* im_shape, const int* col_shape,
     const int* kernel_shape, const int* pad, const int* stride,
-    const int* dilation, Dtype* data_output) {
+    const int* dilation, Dtype* data_output, const int channel_begin,
+    const int channel_end) {
   if (!im2col) {
-    int im_size = im_shape[0];
+    int channel_size = 1;
     for (int i = 0; i < num_spatial_axes; ++i) {
-      im_size *= im_shape[1 + i];
+      channel_size *= im_shape[1 + i];
     }
-    caffe_set(im_size, Dtype(0), data_output);
+    caffe_set((channel_end - channel_begin) * channel_size, Dtype(0),
+        data_output + channel_begin * channel_size);
   }
   int kernel_size = 1;
   for (int i = 0; i < num_spatial_axes; ++i) {
     kernel_size *= kernel_shape[i];
   }
-  const int channels_col = col_shape[0];
   vector<int> d_offset(num_spatial_axes, 0);
   vector<int> d_iter(num_spatial_axes, 0);
-  for (int c_col = 0; c_col < channels_col; ++c_col) {
+  for (int c_col = channel_begin * kernel_size;
+       c_col < channel_end * kernel_size; ++c_col) {
     // Loop over spatial axes in reverse order to compute a per-axis offset.
     int offset = c_col;
     for (int d_i = num_spatial_axes - 1; d_i >= 0; --d_i) {
@@ -137,14 +254,57 @@ inline void im2col_nd_core_cpu(const Dtype* data_input, const bool im2col,
   }  // for (int c = 0; c < channels_col; ++c) {
 }
 
+// Binds the arguments of im2col_nd_core_cpu so that the image channels can be
+// split across the CPU thread pool. Distinct channels never touch the same
+// image or column values.
+template <typename Dtype>
+struct Im2colNdTask {
+  Im2colNdTask(const Dtype* data_input, const bool im2col,
+      const int num_spatial_axes, const int* im_shape, const int* col_shape,
+      const int* kernel_shape, const int* pad, const int* stride,
+      const int* dilation, Dtype* data_output)
+      : data_input(data_input), im2col(im2col),
+        num_spatial_axes(num_spatial_axes), im_shape(im_shape),
+        col_shape(col_shape), kernel_shape(kernel_shape), pad(pad),
+        stride(stride), dilation(dilation), data_output(data_output) {}
+
+  void Run(const int channel_begin, const int channel_end) const {
+    im2col_nd_core_cpu(data_input, im2col, num_spatial_axes, im_shape,
+        col_shape, kernel_shape, pad, stride, dilation, data_output,
+        channel_begin, channel_end);
+  }
+
+  // Runs every channel, on the thread pool if the columns are large enough.
+  void RunAll() const {
+    int col_channel_size = 1;
+    for (int i = 0; i < num_spatial_axes; ++i) {
+      col_channel_size *= kernel_shape[i] * col_shape[1 + i];
+    }
+    caffe_cpu_parallel_for(im_shape[0],
+        boost::bind(&Im2colNdTask<Dtype>::Run, this, _1, _2),
+        std::max(1, kCPUParallelGrain / std::max(1, col_channel_size)));
+  }
+
+  const Dtype* data_input;
+  const bool im2col;
+  const int num_spatial_axes;
+  const int* im_shape;
+  const int* col_shape;
+  const int* kernel_shape;
+  const int* pad;
+  const int* stride;
+  const int* dilation;
+  Dtype* data_output;
+};
+
 template <typename Dtype>
 void im2col_nd_cpu(const Dtype* data_im, const int num_spatial_axes,
     const int* im_shape, const int* col_shape,
     const int* kernel_shape, const int* pad, const int* stride,
     const int* dilation, Dtype* data_col) {
   const bool kIm2Col = true;
-  im2col_nd_core_cpu(data_im, kIm2Col, num_spatial_axes, im_shape, col_shape,
-                  kernel_shape, pad, stride, dilation, data_col);
+  Im2colNdTask<Dtype>(data_im, kIm2Col, num_spatial_axes, im_shape, col_shape,
+      kernel_shape, pad, stride, dilation, data_col).RunAll();
 }
 
 // Explicit instantiation
@@ -166,34 +326,11 @@ void col2im_cpu(const Dtype* data_col, const int channels,
     const int stride_h, const int stride_w,
     const int dilation_h, const int dilation_w,
     Dtype* data_im) {
-  caffe_set(height * width * channels, Dtype(0), data_im);
-  const int output_h = (height + 2 * pad_h -
-    (dilation_h * (kernel_h - 1) + 1)) / stride_h + 1;
-  const int output_w = (width + 2 * pad_w -
-    (dilation_w * (kernel_w - 1) + 1)) / stride_w + 1;
-  const int channel_size = height * width;
-  for (int channel = channels; channel--; data_im += channel_size) {
-    for (int kernel_row = 0; kernel_row < kernel_h; kernel_row++) {
-      for (int kernel_col = 0; kernel_col < kernel_w; kernel_col++) {
-        int input_row = -pad_h + kernel_row * dilation_h;
-        for (int output_rows = output_h; output_rows; output_rows--) {
-          if (!is_a_ge_zero_and_a_lt_b(input_row, height)) {
-            data_col += output_w;
-          } else {
-            int input_col = -pad_w + kernel_col * dilation_w;
-            for (int output_col = output_w; output_col; output_col--) {
-              if (is_a_ge_zero_and_a_lt_b(input_col, width)) {
-                data_im[input_row * width + input_col] += *data_col;
-              }
-              data_col++;
-              input_col += stride_w;
-            }
-          }
-          input_row += stride_h;
-        }
-      }
-    }
-  }
+  const Im2colTask<Dtype> task(channels, height, width, kernel_h, kernel_w,
+      pad_h, pad_w, stride_h, stride_w, dilation_h, dilation_w, 1);
+  caffe_cpu_parallel_for(channels,
+      boost::bind(&Im2colTask<Dtype>::Col2im, &task, data_col, data_im,
+      _1, _2), task.grain());
 }
 
 // Explicit instantiation
@@ -214,8 +351,8 @@ void col2im_nd_cpu(const Dtype* data_col, const int num_spatial_axes,
     const int* kernel_shape, const int* pad, const int* stride,
     const int* dilation, Dtype* data_im) {
   const bool kIm2Col = false;
-  im2col_nd_core_cpu(data_col, kIm2Col, num_spatial_axes, im_shape, col_shape,
-                     kernel_shape, pad, stride, dilation, data_im);
+  Im2colNdTask<Dtype>(data_col, kIm2Col, num_spatial_axes, im_shape, col_shape,
+      kernel_shape, pad, stride, dilation, data_im).RunAll();
 }
 
 // Explicit instantiation
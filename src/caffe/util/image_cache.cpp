@@ -0,0 +1,80 @@
+#ifdef USE_OPENCV
+#include <boost/thread.hpp>
+#include <opencv2/core/core.hpp>
+
+#include <string>
+
+#include "caffe/util/image_cache.hpp"
+
+namespace caffe {
+
+class ImageCache::sync {
+ public:
+  mutable boost::mutex mutex_;
+};
+
+ImageCache::ImageCache(size_t capacity)
+    : capacity_(capacity), bytes_(0), hits_(0), misses_(0),
+      sync_(new sync()) {
+}
+
+bool ImageCache::Get(const string& key, cv::Mat* image) {
+  boost::mutex::scoped_lock lock(sync_->mutex_);
+  std::map<string, ImageList::iterator>::iterator it = index_.find(key);
+  if (it == index_.end()) {
+    ++misses_;
+    return false;
+  }
+  ++hits_;
+  images_.splice(images_.begin(), images_, it->second);
+  *image = it->second->second;
+  return true;
+}
+
+void ImageCache::Put(const string& key, const cv::Mat& image) {
+  const size_t image_bytes = image.total() * image.elemSize();
+  if (capacity_ > 0 && image_bytes > capacity_) {
+    return;
+  }
+  boost::mutex::scoped_lock lock(sync_->mutex_);
+  // Another thread may have decoded the same image meanwhile.
+  if (index_.find(key) != index_.end()) {
+    return;
+  }
+  images_.push_front(std::make_pair(key, image));
+  index_[key] = images_.begin();
+  bytes_ += image_bytes;
+  Evict();
+}
+
+void ImageCache::Evict() {
+  while (capacity_ > 0 && bytes_ > capacity_) {
+    const cv::Mat& image = images_.back().second;
+    bytes_ -= image.total() * image.elemSize();
+    index_.erase(images_.back().first);
+    images_.pop_back();
+  }
+}
+
+size_t ImageCache::bytes() const {
+  boost::mutex::scoped_lock lock(sync_->mutex_);
+  return bytes_;
+}
+
+size_t ImageCache::size() const {
+  boost::mutex::scoped_lock lock(sync_->mutex_);
+  return images_.size();
+}
+
+size_t ImageCache::hits() const {
+  boost::mutex::scoped_lock lock(sync_->mutex_);
+  return hits_;
+}
+
+size_t ImageCache::misses() const {
+  boost::mutex::scoped_lock lock(sync_->mutex_);
+  return misses_;
+}
+
+}  // namespace caffe
+#endif  // USE_OPENCV
@@ -12,6 +12,7 @@
 
 #include <algorithm>
 #include <fstream>  // NOLINT(readability/streams)
+#include <iterator>
 #include <string>
 #include <vector>
 
@@ -27,6 +28,15 @@
 
 const int kProtoReadBytesLimit = INT_MAX;  // Max size of 2 GB minus 1 byte.
 
+#ifdef USE_OPENCV
+// OpenCV 3.2 can decode JPEG images at 1/2, 1/4 or 1/8 of their size. 2.4
+// defines CV_VERSION_EPOCH 2 and CV_VERSION_MAJOR 4.
+#if !defined(CV_VERSION_EPOCH) && (CV_VERSION_MAJOR > 3 || \
+    (CV_VERSION_MAJOR == 3 && CV_VERSION_MINOR >= 2))
+#define CAFFE_JPEG_REDUCED_DECODING
+#endif
+#endif  // USE_OPENCV
+
 namespace caffe {
 
 using google::protobuf::io::FileInputStream;
@@ -96,20 +106,110 @@ void WriteProtoToBinaryFile(const Message& proto, const char* filename) {
 }
 
 #ifdef USE_OPENCV
+#ifdef CAFFE_JPEG_REDUCED_DECODING
+// Gets the size and number of components of a JPEG image from its frame
+// header, without decoding it. Returns false if data is not a JPEG image.
+static bool ReadJPEGHeader(const unsigned char* data, size_t size,
+    int* height, int* width, int* components) {
+  if (size < 4 || data[0] != 0xFF || data[1] != 0xD8) {
+    return false;
+  }
+  size_t i = 2;
+  while (i + 4 <= size && data[i] == 0xFF) {
+    const unsigned char marker = data[i + 1];
+    if (marker == 0xFF) {
+      // Fill byte
+      ++i;
+      continue;
+    }
+    if (marker == 0xDA || marker == 0xD9) {
+      // Start of scan or end of image before any frame header
+      return false;
+    }
+    // Start of frame, except for the DHT, JPG and DAC markers
+    if (marker >= 0xC0 && marker <= 0xCF && marker != 0xC4 &&
+        marker != 0xC8 && marker != 0xCC) {
+      if (i + 10 > size) {
+        return false;
+      }
+      *height = (data[i + 5] << 8) | data[i + 6];
+      *width = (data[i + 7] << 8) | data[i + 8];
+      *components = data[i + 9];
+      return true;
+    }
+    i += 2 + ((data[i + 2] << 8) | data[i + 3]);
+  }
+  return false;
+}
+#endif  // CAFFE_JPEG_REDUCED_DECODING
+
+// Decodes the image in [data, data + size) without copying it first, and
+// resizes it to height x width if both are positive. JPEG images are then
+// decoded at the smallest of 1/2, 1/4 or 1/8 of their size still covering
+// height x width, if any, which skips most of the work of the decoder.
+static cv::Mat DecodeImage(const char* data, size_t size, int cv_read_flag,
+    const int height, const int width) {
+  const cv::Mat buffer(1, size, CV_8UC1, const_cast<char*>(data));
+  const bool resize = height > 0 && width > 0;
+#ifdef CAFFE_JPEG_REDUCED_DECODING
+  int image_height, image_width, components;
+  if (resize && ReadJPEGHeader(reinterpret_cast<const unsigned char*>(data),
+      size, &image_height, &image_width, &components)) {
+    int scale = 1;
+    while (scale < 8 && image_height / (2 * scale) >= height &&
+        image_width / (2 * scale) >= width) {
+      scale *= 2;
+    }
+    // The reduced modes decode in color or gray, so native decoding keeps
+    // the components of the image.
+    const bool is_color = cv_read_flag == CV_LOAD_IMAGE_COLOR ||
+        (cv_read_flag < 0 && components == 3);
+    if (scale > 1 && (cv_read_flag >= 0 || components == 1 ||
+        components == 3)) {
+      switch (scale) {
+      case 2:
+        cv_read_flag = is_color ? cv::IMREAD_REDUCED_COLOR_2 :
+            cv::IMREAD_REDUCED_GRAYSCALE_2;
+        break;
+      case 4:
+        cv_read_flag = is_color ? cv::IMREAD_REDUCED_COLOR_4 :
+            cv::IMREAD_REDUCED_GRAYSCALE_4;
+        break;
+      default:
+        cv_read_flag = is_color ? cv::IMREAD_REDUCED_COLOR_8 :
+            cv::IMREAD_REDUCED_GRAYSCALE_8;
+      }
+    }
+  }
+#endif  // CAFFE_JPEG_REDUCED_DECODING
+  cv::Mat cv_img = cv::imdecode(buffer, cv_read_flag);
+  if (cv_img.data && resize &&
+      (cv_img.rows != height || cv_img.cols != width)) {
+    cv::resize(cv_img, cv_img, cv::Size(width, height));
+  }
+  return cv_img;
+}
+
 cv::Mat ReadImageToCVMat(const string& filename,
     const int height, const int width, const bool is_color) {
   cv::Mat cv_img;
   int cv_read_flag = (is_color ? CV_LOAD_IMAGE_COLOR :
     CV_LOAD_IMAGE_GRAYSCALE);
-  cv::Mat cv_img_origin = cv::imread(filename, cv_read_flag);
-  if (!cv_img_origin.data) {
-    LOG(ERROR) << "Could not open or find file " << filename;
-    return cv_img_origin;
-  }
   if (height > 0 && width > 0) {
-    cv::resize(cv_img_origin, cv_img, cv::Size(width, height));
+    // Read the file first, so that JPEG images can be decoded at a reduced
+    // size.
+    std::ifstream file(filename.c_str(), std::ios::in | std::ios::binary);
+    const string buffer((std::istreambuf_iterator<char>(file)),
+        std::istreambuf_iterator<char>());
+    if (file.good() || file.eof()) {
+      cv_img = DecodeImage(buffer.data(), buffer.size(), cv_read_flag,
+          height, width);
+    }
   } else {
-    cv_img = cv_img_origin;
+    cv_img = cv::imread(filename, cv_read_flag);
+  }
+  if (!cv_img.data) {
+    LOG(ERROR) << "Could not open or find file " << filename;
   }
   return cv_img;
 }
@@ -189,29 +289,54 @@ bool ReadFileToDatum(const string& filename, const int label,
 }
 
 #ifdef USE_OPENCV
-cv::Mat DecodeDatumToCVMatNative(const Datum& datum) {
-  cv::Mat cv_img;
-  CHECK(datum.encoded()) << "Datum not encoded";
-  const string& data = datum.data();
-  std::vector<char> vec_data(data.c_str(), data.c_str() + data.size());
-  cv_img = cv::imdecode(vec_data, -1);
+static cv::Mat DecodeBytesToCVMat(const char* data, size_t size,
+    int cv_read_flag, const int height, const int width) {
+  cv::Mat cv_img = DecodeImage(data, size, cv_read_flag, height, width);
   if (!cv_img.data) {
     LOG(ERROR) << "Could not decode datum ";
   }
   return cv_img;
 }
+cv::Mat DecodeDatumToCVMatNative(const Datum& datum) {
+  return DecodeDatumToCVMatNative(datum, 0, 0);
+}
+cv::Mat DecodeDatumToCVMatNative(const Datum& datum, const int height,
+    const int width) {
+  CHECK(datum.encoded()) << "Datum not encoded";
+  const string& data = datum.data();
+  return DecodeBytesToCVMat(data.data(), data.size(), -1, height, width);
+}
 cv::Mat DecodeDatumToCVMat(const Datum& datum, bool is_color) {
-  cv::Mat cv_img;
+  return DecodeDatumToCVMat(datum, 0, 0, is_color);
+}
+cv::Mat DecodeDatumToCVMat(const Datum& datum, const int height,
+    const int width, bool is_color) {
   CHECK(datum.encoded()) << "Datum not encoded";
   const string& data = datum.data();
-  std::vector<char> vec_data(data.c_str(), data.c_str() + data.size());
   int cv_read_flag = (is_color ? CV_LOAD_IMAGE_COLOR :
     CV_LOAD_IMAGE_GRAYSCALE);
-  cv_img = cv::imdecode(vec_data, cv_read_flag);
-  if (!cv_img.data) {
-    LOG(ERROR) << "Could not decode datum ";
-  }
-  return cv_img;
+  return DecodeBytesToCVMat(data.data(), data.size(), cv_read_flag, height,
+      width);
+}
+cv::Mat DecodeDatumToCVMatNative(const DatumView& datum) {
+  return DecodeDatumToCVMatNative(datum, 0, 0);
+}
+cv::Mat DecodeDatumToCVMatNative(const DatumView& datum, const int height,
+    const int width) {
+  CHECK(datum.encoded()) << "Datum not encoded";
+  return DecodeBytesToCVMat(datum.data(), datum.data_size(), -1, height,
+      width);
+}
+cv::Mat DecodeDatumToCVMat(const DatumView& datum, bool is_color) {
+  return DecodeDatumToCVMat(datum, 0, 0, is_color);
+}
+cv::Mat DecodeDatumToCVMat(const DatumView& datum, const int height,
+    const int width, bool is_color) {
+  CHECK(datum.encoded()) << "Datum not encoded";
+  int cv_read_flag = (is_color ? CV_LOAD_IMAGE_COLOR :
+    CV_LOAD_IMAGE_GRAYSCALE);
+  return DecodeBytesToCVMat(datum.data(), datum.data_size(), cv_read_flag,
+      height, width);
 }
 
 // If Datum is encoded will decoded using DecodeDatumToCVMat and CVMatToDatum
@@ -1,3 +1,4 @@
+#include <boost/bind.hpp>
 #include <boost/math/special_functions/next.hpp>
 #include <boost/random.hpp>
 
@@ -6,9 +7,55 @@
 #include "caffe/common.hpp"
 #include "caffe/util/math_functions.hpp"
 #include "caffe/util/rng.hpp"
+#include "caffe/util/thread_pool.hpp"
 
 namespace caffe {
 
+// The element-wise functions below are split across the CPU thread pool
+// (see Caffe::set_cpu_threads). These adaptors run a vsl routine on the
+// [begin, end) slice of its arguments.
+#define DEFINE_VSL_UNARY_RANGE_FUNC(name) \
+  static void vs##name##_range(const float* a, float* y, \
+      const int begin, const int end) { \
+    vs##name(end - begin, a + begin, y + begin); \
+  } \
+  static void vd##name##_range(const double* a, double* y, \
+      const int begin, const int end) { \
+    vd##name(end - begin, a + begin, y + begin); \
+  }
+
+DEFINE_VSL_UNARY_RANGE_FUNC(Sqr);
+DEFINE_VSL_UNARY_RANGE_FUNC(Exp);
+DEFINE_VSL_UNARY_RANGE_FUNC(Ln);
+DEFINE_VSL_UNARY_RANGE_FUNC(Abs);
+
+#define DEFINE_VSL_UNARY_RANGE_FUNC_WITH_PARAM(name) \
+  static void vs##name##_range(const float* a, const float b, float* y, \
+      const int begin, const int end) { \
+    vs##name(end - begin, a + begin, b, y + begin); \
+  } \
+  static void vd##name##_range(const double* a, const double b, double* y, \
+      const int begin, const int end) { \
+    vd##name(end - begin, a + begin, b, y + begin); \
+  }
+
+DEFINE_VSL_UNARY_RANGE_FUNC_WITH_PARAM(Powx);
+
+#define DEFINE_VSL_BINARY_RANGE_FUNC(name) \
+  static void vs##name##_range(const float* a, const float* b, float* y, \
+      const int begin, const int end) { \
+    vs##name(end - begin, a + begin, b + begin, y + begin); \
+  } \
+  static void vd##name##_range(const double* a, const double* b, double* y, \
+      const int begin, const int end) { \
+    vd##name(end - begin, a + begin, b + begin, y + begin); \
+  }
+
+DEFINE_VSL_BINARY_RANGE_FUNC(Add);
+DEFINE_VSL_BINARY_RANGE_FUNC(Sub);
+DEFINE_VSL_BINARY_RANGE_FUNC(Mul);
+DEFINE_VSL_BINARY_RANGE_FUNC(Div);
+
 template<>
 void caffe_cpu_gemm<float>(const CBLAS_TRANSPOSE TransA,
     const CBLAS_TRANSPOSE TransB, const int M, const int N, const int K,
@@ -45,13 +92,37 @@ void caffe_cpu_gemv<double>(const CBLAS_TRANSPOSE TransA, const int M,
   cblas_dgemv(CblasRowMajor, TransA, M, N, alpha, A, N, x, 1, beta, y, 1);
 }
 
+static void cblas_saxpy_range(const float alpha, const float* X, float* Y,
+    const int begin, const int end) {
+  cblas_saxpy(end - begin, alpha, X + begin, 1, Y + begin, 1);
+}
+
+static void cblas_daxpy_range(const double alpha, const double* X, double* Y,
+    const int begin, const int end) {
+  cblas_daxpy(end - begin, alpha, X + begin, 1, Y + begin, 1);
+}
+
 template <>
 void caffe_axpy<float>(const int N, const float alpha, const float* X,
-    float* Y) { cblas_saxpy(N, alpha, X, 1, Y, 1); }
+    float* Y) {
+  caffe_cpu_parallel_for(N,
+      boost::bind(&cblas_saxpy_range, alpha, X, Y, _1, _2));
+}
 
 template <>
 void caffe_axpy<double>(const int N, const double alpha, const double* X,
-    double* Y) { cblas_daxpy(N, alpha, X, 1, Y, 1); }
+    double* Y) {
+  caffe_cpu_parallel_for(N,
+      boost::bind(&cblas_daxpy_range, alpha, X, Y, _1, _2));
+}
+
+template <typename Dtype>
+static void set_range(const Dtype alpha, Dtype* Y,
+    const int begin, const int end) {
+  for (int i = begin; i < end; ++i) {
+    Y[i] = alpha;
+  }
+}
 
 template <typename Dtype>
 void caffe_set(const int N, const Dtype alpha, Dtype* Y) {
@@ -59,27 +130,32 @@ void caffe_set(const int N, const Dtype alpha, Dtype* Y) {
     memset(Y, 0, sizeof(Dtype) * N);  // NOLINT(caffe/alt_fn)
     return;
   }
-  for (int i = 0; i < N; ++i) {
-    Y[i] = alpha;
-  }
+  caffe_cpu_parallel_for(N,
+      boost::bind(&set_range<Dtype>, alpha, Y, _1, _2));
 }
 
 template void caffe_set<int>(const int N, const int alpha, int* Y);
 template void caffe_set<float>(const int N, const float alpha, float* Y);
 template void caffe_set<double>(const int N, const double alpha, double* Y);
 
-template <>
-void caffe_add_scalar(const int N, const float alpha, float* Y) {
-  for (int i = 0; i < N; ++i) {
+template <typename Dtype>
+static void add_scalar_range(const Dtype alpha, Dtype* Y,
+    const int begin, const int end) {
+  for (int i = begin; i < end; ++i) {
     Y[i] += alpha;
   }
 }
 
+template <>
+void caffe_add_scalar(const int N, const float alpha, float* Y) {
+  caffe_cpu_parallel_for(N,
+      boost::bind(&add_scalar_range<float>, alpha, Y, _1, _2));
+}
+
 template <>
 void caffe_add_scalar(const int N, const double alpha, double* Y) {
-  for (int i = 0; i < N; ++i) {
-    Y[i] += alpha;
-  }
+  caffe_cpu_parallel_for(N,
+      boost::bind(&add_scalar_range<double>, alpha, Y, _1, _2));
 }
 
 template <typename Dtype>
@@ -104,126 +180,160 @@ template void caffe_copy<unsigned int>(const int N, const unsigned int* X,
 template void caffe_copy<float>(const int N, const float* X, float* Y);
 template void caffe_copy<double>(const int N, const double* X, double* Y);
 
+static void cblas_sscal_range(const float alpha, float* X,
+    const int begin, const int end) {
+  cblas_sscal(end - begin, alpha, X + begin, 1);
+}
+
+static void cblas_dscal_range(const double alpha, double* X,
+    const int begin, const int end) {
+  cblas_dscal(end - begin, alpha, X + begin, 1);
+}
+
 template <>
 void caffe_scal<float>(const int N, const float alpha, float *X) {
-  cblas_sscal(N, alpha, X, 1);
+  caffe_cpu_parallel_for(N,
+      boost::bind(&cblas_sscal_range, alpha, X, _1, _2));
 }
 
 template <>
 void caffe_scal<double>(const int N, const double alpha, double *X) {
-  cblas_dscal(N, alpha, X, 1);
+  caffe_cpu_parallel_for(N,
+      boost::bind(&cblas_dscal_range, alpha, X, _1, _2));
+}
+
+static void cblas_saxpby_range(const float alpha, const float* X,
+    const float beta, float* Y, const int begin, const int end) {
+  cblas_saxpby(end - begin, alpha, X + begin, 1, beta, Y + begin, 1);
+}
+
+static void cblas_daxpby_range(const double alpha, const double* X,
+    const double beta, double* Y, const int begin, const int end) {
+  cblas_daxpby(end - begin, alpha, X + begin, 1, beta, Y + begin, 1);
 }
 
 template <>
 void caffe_cpu_axpby<float>(const int N, const float alpha, const float* X,
                             const float beta, float* Y) {
-  cblas_saxpby(N, alpha, X, 1, beta, Y, 1);
+  caffe_cpu_parallel_for(N,
+      boost::bind(&cblas_saxpby_range, alpha, X, beta, Y, _1, _2));
 }
 
 template <>
 void caffe_cpu_axpby<double>(const int N, const double alpha, const double* X,
                              const double beta, double* Y) {
-  cblas_daxpby(N, alpha, X, 1, beta, Y, 1);
+  caffe_cpu_parallel_for(N,
+      boost::bind(&cblas_daxpby_range, alpha, X, beta, Y, _1, _2));
 }
 
 template <>
 void caffe_add<float>(const int n, const float* a, const float* b,
     float* y) {
-  vsAdd(n, a, b, y);
+  caffe_cpu_parallel_for(n,
+      boost::bind(&vsAdd_range, a, b, y, _1, _2));
 }
 
 template <>
 void caffe_add<double>(const int n, const double* a, const double* b,
     double* y) {
-  vdAdd(n, a, b, y);
+  caffe_cpu_parallel_for(n,
+      boost::bind(&vdAdd_range, a, b, y, _1, _2));
 }
 
 template <>
 void caffe_sub<float>(const int n, const float* a, const float* b,
     float* y) {
-  vsSub(n, a, b, y);
+  caffe_cpu_parallel_for(n,
+      boost::bind(&vsSub_range, a, b, y, _1, _2));
 }
 
 template <>
 void caffe_sub<double>(const int n, const double* a, const double* b,
     double* y) {
-  vdSub(n, a, b, y);
+  caffe_cpu_parallel_for(n,
+      boost::bind(&vdSub_range, a, b, y, _1, _2));
 }
 
 template <>
 void caffe_mul<float>(const int n, const float* a, const float* b,
     float* y) {
-  vsMul(n, a, b, y);
+  caffe_cpu_parallel_for(n,
+      boost::bind(&vsMul_range, a, b, y, _1, _2));
 }
 
 template <>
 void caffe_mul<double>(const int n, const double* a, const double* b,
     double* y) {
-  vdMul(n, a, b, y);
+  caffe_cpu_parallel_for(n,
+      boost::bind(&vdMul_range, a, b, y, _1, _2));
 }
 
 template <>
 void caffe_div<float>(const int n, const float* a, const float* b,
     float* y) {
-  vsDiv(n, a, b, y);
+  caffe_cpu_parallel_for(n,
+      boost::bind(&vsDiv_range, a, b, y, _1, _2));
 }
 
 template <>
 void caffe_div<double>(const int n, const double* a, const double* b,
     double* y) {
-  vdDiv(n, a, b, y);
+  caffe_cpu_parallel_for(n,
+      boost::bind(&vdDiv_range, a, b, y, _1, _2));
 }
 
 template <>
 void caffe_powx<float>(const int n, const float* a, const float b,
     float* y) {
-  vsPowx(n, a, b, y);
+  caffe_cpu_parallel_for(n,
+      boost::bind(&vsPowx_range, a, b, y, _1, _2));
 }
 
 template <>
 void caffe_powx<double>(const int n, const double* a, const double b,
     double* y) {
-  vdPowx(n, a, b, y);
+  caffe_cpu_parallel_for(n,
+      boost::bind(&vdPowx_range, a, b, y, _1, _2));
 }
 
 template <>
 void caffe_sqr<float>(const int n, const float* a, float* y) {
-  vsSqr(n, a, y);
+  caffe_cpu_parallel_for(n, boost::bind(&vsSqr_range, a, y, _1, _2));
 }
 
 template <>
 void caffe_sqr<double>(const int n, const double* a, double* y) {
-  vdSqr(n, a, y);
+  caffe_cpu_parallel_for(n, boost::bind(&vdSqr_range, a, y, _1, _2));
 }
 
 template <>
 void caffe_exp<float>(const int n, const float* a, float* y) {
-  vsExp(n, a, y);
+  caffe_cpu_parallel_for(n, boost::bind(&vsExp_range, a, y, _1, _2));
 }
 
 template <>
 void caffe_exp<double>(const int n, const double* a, double* y) {
-  vdExp(n, a, y);
+  caffe_cpu_parallel_for(n, boost::bind(&vdExp_range, a, y, _1, _2));
 }
 
 template <>
 void caffe_log<float>(const int n, const float* a, float* y) {
-  vsLn(n, a, y);
+  caffe_cpu_parallel_for(n, boost::bind(&vsLn_range, a, y, _1, _2));
 }
 
 template <>
 void caffe_log<double>(const int n, const double* a, double* y) {
-  vdLn(n, a, y);
+  caffe_cpu_parallel_for(n, boost::bind(&vdLn_range, a, y, _1, _2));
 }
 
 template <>
 void caffe_abs<float>(const int n, const float* a, float* y) {
-    vsAbs(n, a, y);
+  caffe_cpu_parallel_for(n, boost::bind(&vsAbs_range, a, y, _1, _2));
 }
 
 template <>
 void caffe_abs<double>(const int n, const double* a, double* y) {
-    vdAbs(n, a, y);
+  caffe_cpu_parallel_for(n, boost::bind(&vdAbs_range, a, y, _1, _2));
 }
 
 unsigned int caffe_rng_rand() {
@@ -467,18 +577,30 @@ double caffe_cpu_asum<double>(const int n, const double* x) {
   return cblas_dasum(n, x, 1);
 }
 
+static void cblas_sscale_range(const float alpha, const float* x, float* y,
+    const int begin, const int end) {
+  cblas_scopy(end - begin, x + begin, 1, y + begin, 1);
+  cblas_sscal(end - begin, alpha, y + begin, 1);
+}
+
+static void cblas_dscale_range(const double alpha, const double* x, double* y,
+    const int begin, const int end) {
+  cblas_dcopy(end - begin, x + begin, 1, y + begin, 1);
+  cblas_dscal(end - begin, alpha, y + begin, 1);
+}
+
 template <>
 void caffe_cpu_scale<float>(const int n, const float alpha, const float *x,
                             float* y) {
-  cblas_scopy(n, x, 1, y, 1);
-  cblas_sscal(n, alpha, y, 1);
+  caffe_cpu_parallel_for(n,
+      boost::bind(&cblas_sscale_range, alpha, x, y, _1, _2));
 }
 
 template <>
 void caffe_cpu_scale<double>(const int n, const double alpha, const double *x,
                              double* y) {
-  cblas_dcopy(n, x, 1, y, 1);
-  cblas_dscal(n, alpha, y, 1);
+  caffe_cpu_parallel_for(n,
+      boost::bind(&cblas_dscale_range, alpha, x, y, _1, _2));
 }
 
 }  // namespace caffe
@@ -0,0 +1,167 @@
+#include <boost/atomic.hpp>
+#include <boost/thread.hpp>
+#include <algorithm>
+#include <string>
+
+#include "caffe/data_reader.hpp"
+#include "caffe/layers/base_data_layer.hpp"
+#include "caffe/util/spsc_queue.hpp"
+
+namespace caffe {
+
+// Bounds on how many times a waiting side polls before it blocks.
+static const int kMinSpins = 16;
+static const int kMaxSpins = 4096;
+
+template<typename T>
+class SPSCQueue<T>::sync {
+ public:
+  sync() : head_(0), tail_(0), num_blocked_(0),
+      push_spins_(kMinSpins), pop_spins_(kMinSpins) {}
+
+  // The queue holds the items [head_, tail_), at index % capacity. The
+  // consumer only writes head_ and the producer tail_, each on its own
+  // cache line.
+  boost::atomic<size_t> head_;
+  char head_padding_[64];
+  boost::atomic<size_t> tail_;
+  char tail_padding_[64];
+
+  struct NotEmpty {
+    NotEmpty(const sync* s, size_t head) : s(s), head(head) {}
+    bool operator()() const {
+      return s->tail_.load(boost::memory_order_acquire) != head;
+    }
+    const sync* s;
+    const size_t head;
+  };
+  struct NotFull {
+    NotFull(const sync* s, size_t tail, size_t capacity)
+        : s(s), tail(tail), capacity(capacity) {}
+    bool operator()() const {
+      return tail - s->head_.load(boost::memory_order_acquire) < capacity;
+    }
+    const sync* s;
+    const size_t tail;
+    const size_t capacity;
+  };
+
+  // Polls ready up to *spins times, then blocks until it holds. The spin
+  // budget doubles when polling was enough and halves when it was not.
+  template<typename Ready>
+  void Wait(const Ready& ready, int* spins, const string& log_on_wait) {
+    for (int i = 0; i < *spins; ++i) {
+      if (ready()) {
+        *spins = std::min(*spins * 2, kMaxSpins);
+        return;
+      }
+    }
+    *spins = std::max(*spins / 2, kMinSpins);
+    boost::mutex::scoped_lock lock(mutex_);
+    num_blocked_.fetch_add(1);
+    // Either Notify sees the blocked thread, or ready sees the new index.
+    boost::atomic_thread_fence(boost::memory_order_seq_cst);
+    while (!ready()) {
+      if (!log_on_wait.empty()) {
+        LOG_EVERY_N(INFO, 1000)<< log_on_wait;
+      }
+      condition_.wait(lock);
+    }
+    num_blocked_.fetch_sub(1);
+  }
+
+  // Wakes the other side if it blocked, after head_ or tail_ moved.
+  void Notify() {
+    boost::atomic_thread_fence(boost::memory_order_seq_cst);
+    if (num_blocked_.load(boost::memory_order_relaxed) > 0) {
+      boost::mutex::scoped_lock lock(mutex_);
+      lock.unlock();
+      condition_.notify_all();
+    }
+  }
+
+  boost::atomic<int> num_blocked_;
+  boost::mutex mutex_;
+  boost::condition_variable condition_;
+  // Only used by the producer and the consumer respectively.
+  int push_spins_;
+  int pop_spins_;
+};
+
+template<typename T>
+SPSCQueue<T>::SPSCQueue(const int capacity)
+    : buffer_(capacity), sync_(new sync()) {
+  CHECK_GT(capacity, 0) << "SPSCQueue needs a positive capacity.";
+}
+
+template<typename T>
+void SPSCQueue<T>::push(const T& t) {
+  const size_t tail = sync_->tail_.load(boost::memory_order_relaxed);
+  const typename sync::NotFull not_full(sync_.get(), tail, buffer_.size());
+  if (!not_full()) {
+    sync_->Wait(not_full, &sync_->push_spins_, "");
+  }
+  buffer_[tail % buffer_.size()] = t;
+  sync_->tail_.store(tail + 1, boost::memory_order_release);
+  sync_->Notify();
+}
+
+template<typename T>
+bool SPSCQueue<T>::try_pop(T* t) {
+  const size_t head = sync_->head_.load(boost::memory_order_relaxed);
+  const typename sync::NotEmpty not_empty(sync_.get(), head);
+  if (!not_empty()) {
+    return false;
+  }
+  *t = buffer_[head % buffer_.size()];
+  sync_->head_.store(head + 1, boost::memory_order_release);
+  sync_->Notify();
+  return true;
+}
+
+template<typename T>
+T SPSCQueue<T>::pop(const string& log_on_wait) {
+  const size_t head = sync_->head_.load(boost::memory_order_relaxed);
+  const typename sync::NotEmpty not_empty(sync_.get(), head);
+  if (!not_empty()) {
+    sync_->Wait(not_empty, &sync_->pop_spins_, log_on_wait);
+  }
+  T t = buffer_[head % buffer_.size()];
+  sync_->head_.store(head + 1, boost::memory_order_release);
+  sync_->Notify();
+  return t;
+}
+
+template<typename T>
+bool SPSCQueue<T>::try_peek(T* t) {
+  const size_t head = sync_->head_.load(boost::memory_order_relaxed);
+  const typename sync::NotEmpty not_empty(sync_.get(), head);
+  if (!not_empty()) {
+    return false;
+  }
+  *t = buffer_[head % buffer_.size()];
+  return true;
+}
+
+template<typename T>
+T SPSCQueue<T>::peek() {
+  const size_t head = sync_->head_.load(boost::memory_order_relaxed);
+  const typename sync::NotEmpty not_empty(sync_.get(), head);
+  if (!not_empty()) {
+    sync_->Wait(not_empty, &sync_->pop_spins_, "");
+  }
+  return buffer_[head % buffer_.size()];
+}
+
+template<typename T>
+size_t SPSCQueue<T>::size() const {
+  const size_t head = sync_->head_.load(boost::memory_order_acquire);
+  return sync_->tail_.load(boost::memory_order_acquire) - head;
+}
+
+template class SPSCQueue<Batch<float>*>;
+template class SPSCQueue<Batch<double>*>;
+template class SPSCQueue<Datum*>;
+template class SPSCQueue<DatumView*>;
+
+}  // namespace caffe
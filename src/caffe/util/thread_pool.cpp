@@ -0,0 +1,149 @@
+#include <boost/bind.hpp>
+#include <boost/thread.hpp>
+#include <stdint.h>
+#include <algorithm>
+#include <deque>
+
+#include "caffe/util/thread_pool.hpp"
+
+namespace caffe {
+
+// A single ParallelFor call. Ranges are claimed under the pool mutex, so
+// next and done are only touched with it held. The first range is left to
+// the calling thread.
+struct ThreadPool::Job {
+  Job(const RangeFunction& fn, const int n, const int num_chunks)
+      : fn(fn), n(n), num_chunks(num_chunks), next(1), done(0) {}
+
+  // Chunk i covers [i * n / num_chunks, (i + 1) * n / num_chunks).
+  void Run(const int chunk) const {
+    const int begin = static_cast<int>(
+        static_cast<int64_t>(chunk) * n / num_chunks);
+    const int end = static_cast<int>(
+        static_cast<int64_t>(chunk + 1) * n / num_chunks);
+    fn(begin, end);
+  }
+
+  const RangeFunction& fn;
+  const int n;
+  const int num_chunks;
+  int next;
+  int done;
+};
+
+class ThreadPool::sync {
+ public:
+  sync() : stop_(false) {}
+
+  boost::mutex mutex_;
+  boost::condition_variable work_condition_;
+  boost::condition_variable done_condition_;
+  // Jobs that still have unclaimed ranges, oldest first.
+  std::deque<Job*> jobs_;
+  bool stop_;
+  boost::thread_group threads_;
+};
+
+ThreadPool::ThreadPool(const int num_threads)
+    : num_threads_(num_threads), sync_(new sync()) {
+  CHECK_GE(num_threads, 1) << "ThreadPool needs at least one thread.";
+  try {
+    // The thread calling ParallelFor is the last one.
+    for (int i = 1; i < num_threads_; ++i) {
+      sync_->threads_.create_thread(
+          boost::bind(&ThreadPool::WorkerEntry, this));
+    }
+  } catch (std::exception& e) {
+    LOG(FATAL) << "Thread exception: " << e.what();
+  }
+}
+
+ThreadPool::~ThreadPool() {
+  {
+    boost::mutex::scoped_lock lock(sync_->mutex_);
+    sync_->stop_ = true;
+  }
+  sync_->work_condition_.notify_all();
+  sync_->threads_.join_all();
+}
+
+void ThreadPool::WorkerEntry() {
+  boost::mutex::scoped_lock lock(sync_->mutex_);
+  while (true) {
+    while (!sync_->stop_ && sync_->jobs_.empty()) {
+      sync_->work_condition_.wait(lock);
+    }
+    if (sync_->stop_) {
+      return;
+    }
+    Job* job = sync_->jobs_.front();
+    const int chunk = job->next++;
+    if (job->next == job->num_chunks) {
+      sync_->jobs_.pop_front();
+    }
+    lock.unlock();
+    job->Run(chunk);
+    lock.lock();
+    if (++job->done == job->num_chunks) {
+      sync_->done_condition_.notify_all();
+    }
+  }
+}
+
+void ThreadPool::RunJob(Job* job) {
+  // The workers use the job on this stack, so a thread interrupted while
+  // waiting for them, e.g. a prefetch thread, has to wait anyway.
+  boost::this_thread::disable_interruption no_interruption;
+  job->Run(0);
+  boost::mutex::scoped_lock lock(sync_->mutex_);
+  ++job->done;
+  while (job->next < job->num_chunks) {
+    const int chunk = job->next++;
+    if (job->next == job->num_chunks) {
+      sync_->jobs_.erase(
+          std::find(sync_->jobs_.begin(), sync_->jobs_.end(), job));
+    }
+    lock.unlock();
+    job->Run(chunk);
+    lock.lock();
+    ++job->done;
+  }
+  // The remaining ranges are already running on the workers.
+  while (job->done < job->num_chunks) {
+    sync_->done_condition_.wait(lock);
+  }
+}
+
+void ThreadPool::ParallelFor(const int n, const int grain,
+    const RangeFunction& fn) {
+  CHECK_GT(grain, 0);
+  const int num_chunks = std::min<int64_t>(num_threads_,
+      (static_cast<int64_t>(n) + grain - 1) / grain);
+  if (num_chunks <= 1) {
+    fn(0, n);
+    return;
+  }
+  Job job(fn, n, num_chunks);
+  {
+    boost::mutex::scoped_lock lock(sync_->mutex_);
+    sync_->jobs_.push_back(&job);
+  }
+  for (int i = 1; i < num_chunks; ++i) {
+    sync_->work_condition_.notify_one();
+  }
+  RunJob(&job);
+}
+
+void caffe_cpu_parallel_for(const int n, const ThreadPool::RangeFunction& fn,
+    const int grain) {
+  if (n >= 2 * grain) {
+    shared_ptr<ThreadPool> pool = Caffe::cpu_thread_pool();
+    if (pool) {
+      pool->ParallelFor(n, grain, fn);
+      return;
+    }
+  }
+  fn(0, n);
+}
+
+}  // namespace caffe
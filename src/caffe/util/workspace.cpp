@@ -0,0 +1,45 @@
+#include <algorithm>
+#include <vector>
+
+#include "caffe/util/workspace.hpp"
+
+namespace caffe {
+
+void Workspace::Share() {
+  // Slot i holds the i-th largest buffer of each layer; buffers of the same
+  // layer are live at the same time and so never share a slot.
+  vector<size_t> slot_bytes;
+  unshared_bytes_ = 0;
+  for (int i = 0; i < layers_.size(); ++i) {
+    std::sort(layers_[i].begin(), layers_[i].end());
+    if (layers_[i].size() > slot_bytes.size()) {
+      slot_bytes.resize(layers_[i].size(), 0);
+    }
+    for (int j = 0; j < layers_[i].size(); ++j) {
+      slot_bytes[j] = std::max(slot_bytes[j], layers_[i][j].bytes);
+      unshared_bytes_ += layers_[i][j].bytes;
+    }
+  }
+  slots_.resize(std::max(slots_.size(), slot_bytes.size()));
+  for (int j = 0; j < slot_bytes.size(); ++j) {
+    if (!slots_[j] || slots_[j]->size() < slot_bytes[j]) {
+      slots_[j].reset(new SyncedMemory(slot_bytes[j]));
+    }
+  }
+  for (int i = 0; i < layers_.size(); ++i) {
+    for (int j = 0; j < layers_[i].size(); ++j) {
+      layers_[i][j].share(slots_[j]);
+    }
+  }
+  layers_.clear();
+}
+
+size_t Workspace::shared_bytes() const {
+  size_t bytes = 0;
+  for (int j = 0; j < slots_.size(); ++j) {
+    bytes += slots_[j]->size();
+  }
+  return bytes;
+}
+
+}  // namespace caffe
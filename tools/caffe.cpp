@@ -15,6 +15,7 @@ namespace bp = boost::python;
 #include "caffe/caffe.hpp"
 #include "caffe/util/signal_handler.h"
 #include "caffe/util/math_functions.hpp"
+#include "caffe/util/workspace.hpp"
 
 using caffe::Blob;
 using caffe::Caffe;
@@ -42,6 +43,16 @@ DEFINE_string(weights, "",
     "separated by ','. Cannot be set simultaneously with snapshot.");
 DEFINE_int32(iterations, 50,
     "The number of iterations to run.");
+DEFINE_string(conv_engine, "",
+    "Optional; with the time command, also time the model with every "
+    "Convolution layer set to this engine (CAFFE, DIRECT or WINOGRAD) and "
+    "report the forward speedup of each of those layers.");
+DEFINE_bool(fuse_layers, false,
+    "Optional; with the time command, also time the forward pass of the TEST "
+    "net with and without NetParameter.fuse_layers.");
+DEFINE_int32(cpu_threads, 1,
+    "Optional; the number of threads the CPU layers and math functions "
+    "may use for a single operation.");
 DEFINE_string(sigint_effect, "stop",
              "Optional; action to take when a SIGINT signal is received: "
               "snapshot, stop or none.");
@@ -306,6 +317,77 @@ RegisterBrewFunction(test);
 
 
 // Time: benchmark the execution time of a model.
+// Times the forward pass of the model with every Convolution layer set to
+// FLAGS_conv_engine, and reports the speedup of each of those layers over
+// their forward_time_per_layer in net.
+void time_conv_engine(const Net<float>& net,
+    const vector<double>& forward_time_per_layer) {
+  caffe::ConvolutionParameter_Engine engine;
+  CHECK(caffe::ConvolutionParameter_Engine_Parse(FLAGS_conv_engine, &engine))
+      << "Unknown convolution engine " << FLAGS_conv_engine;
+  caffe::NetParameter param;
+  caffe::ReadNetParamsFromTextFileOrDie(FLAGS_model, &param);
+  param.mutable_state()->set_phase(caffe::TRAIN);
+  for (int i = 0; i < param.layer_size(); ++i) {
+    if (param.layer(i).type() == "Convolution") {
+      param.mutable_layer(i)->mutable_convolution_param()->set_engine(engine);
+    }
+  }
+  Net<float> engine_net(param);
+  engine_net.Forward();
+  const vector<shared_ptr<Layer<float> > >& layers = engine_net.layers();
+  CHECK_EQ(layers.size(), net.layers().size());
+  const vector<vector<Blob<float>*> >& bottom_vecs = engine_net.bottom_vecs();
+  const vector<vector<Blob<float>*> >& top_vecs = engine_net.top_vecs();
+  LOG(INFO) << "*** Timing Convolution layers with engine "
+      << FLAGS_conv_engine << " ***";
+  Timer timer;
+  std::vector<double> engine_time_per_layer(layers.size(), 0.0);
+  for (int j = 0; j < FLAGS_iterations; ++j) {
+    for (int i = 0; i < layers.size(); ++i) {
+      timer.Start();
+      layers[i]->Forward(bottom_vecs[i], top_vecs[i]);
+      engine_time_per_layer[i] += timer.MicroSeconds();
+    }
+  }
+  for (int i = 0; i < layers.size(); ++i) {
+    if (strcmp(layers[i]->type(), "Convolution") != 0) {
+      continue;
+    }
+    LOG(INFO) << std::setfill(' ') << std::setw(10)
+      << layers[i]->layer_param().name() << "\t" << FLAGS_conv_engine
+      << " forward: " << engine_time_per_layer[i] / 1000 / FLAGS_iterations
+      << " ms, speedup " << forward_time_per_layer[i] /
+      engine_time_per_layer[i] << "x.";
+  }
+}
+
+// Times the forward pass of the TEST net with and without folding BatchNorm,
+// Scale and ReLU layers into the convolutions they follow.
+void time_fused_layers() {
+  caffe::NetParameter param;
+  caffe::ReadNetParamsFromTextFileOrDie(FLAGS_model, &param);
+  param.mutable_state()->set_phase(caffe::TEST);
+  LOG(INFO) << "*** Timing the TEST net with and without fuse_layers ***";
+  double forward_time[2];
+  for (int fuse = 0; fuse < 2; ++fuse) {
+    param.set_fuse_layers(fuse);
+    Net<float> net(param);
+    net.Forward();
+    Timer timer;
+    timer.Start();
+    for (int j = 0; j < FLAGS_iterations; ++j) {
+      net.Forward();
+    }
+    forward_time[fuse] = timer.MilliSeconds() / FLAGS_iterations;
+    LOG(INFO) << (fuse ? "Fused" : "Unfused") << " forward pass: "
+      << forward_time[fuse] << " ms with " << net.layers().size()
+      << " layers.";
+  }
+  LOG(INFO) << "Layer fusion speedup: " << forward_time[0] / forward_time[1]
+    << "x.";
+}
+
 int time() {
   CHECK_GT(FLAGS_model.size(), 0) << "Need a model definition to time.";
 
@@ -389,7 +471,21 @@ int time() {
   LOG(INFO) << "Average Forward-Backward: " << total_timer.MilliSeconds() /
     FLAGS_iterations << " ms.";
   LOG(INFO) << "Total Time: " << total_timer.MilliSeconds() << " ms.";
+  const caffe::Workspace* workspace = caffe_net.workspace();
+  if (workspace) {
+    const double shared_mb = workspace->shared_bytes() / 1048576.0;
+    const double unshared_mb = workspace->unshared_bytes() / 1048576.0;
+    LOG(INFO) << "Layer workspace: " << shared_mb << " MB shared, "
+      << unshared_mb << " MB unshared, saved " << unshared_mb - shared_mb
+      << " MB.";
+  }
   LOG(INFO) << "*** Benchmark ends ***";
+  if (FLAGS_conv_engine.size()) {
+    time_conv_engine(caffe_net, forward_time_per_layer);
+  }
+  if (FLAGS_fuse_layers) {
+    time_fused_layers();
+  }
   return 0;
 }
 RegisterBrewFunction(time);
@@ -417,6 +513,7 @@ int main(int argc, char** argv) {
       "  time            benchmark model execution time");
   // Run tool or show usage.
   caffe::GlobalInit(&argc, &argv);
+  Caffe::set_cpu_threads(FLAGS_cpu_threads);
   if (argc == 2) {
 #ifdef WITH_PYTHON_LAYER
     try {
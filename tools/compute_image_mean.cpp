@@ -1,16 +1,27 @@
+// This program computes the mean image of a set of images stored in a
+// leveldb/lmdb, along with the mean and standard deviation of each channel.
+// The records are read in chunks on the main thread and accumulated into
+// partial sums by a pool of threads, which are reduced at the end.
+// Usage:
+//   compute_image_mean [FLAGS] INPUT_DB [OUTPUT_FILE]
+
 #include <stdint.h>
 #include <algorithm>
+#include <cmath>
 #include <string>
 #include <utility>
 #include <vector>
 
+#include "boost/bind.hpp"
 #include "boost/scoped_ptr.hpp"
+#include "boost/thread.hpp"
 #include "gflags/gflags.h"
 #include "glog/logging.h"
 
 #include "caffe/proto/caffe.pb.h"
 #include "caffe/util/db.hpp"
 #include "caffe/util/io.hpp"
+#include "caffe/util/thread_pool.hpp"
 
 using namespace caffe;  // NOLINT(build/namespaces)
 
@@ -19,7 +30,52 @@ using std::pair;
 using boost::scoped_ptr;
 
 DEFINE_string(backend, "lmdb",
-        "The backend {leveldb, lmdb} containing the images");
+        "The backend {leveldb, lmdb, sharded} containing the images");
+DEFINE_int32(threads, 0,
+    "Number of threads decoding and summing the images, or 0 for one per "
+    "core");
+DEFINE_string(channel_stats, "",
+    "Optional: write the mean_value and std_value of each channel to this "
+    "file, as a TransformationParameter text proto");
+
+#ifdef USE_OPENCV
+// The sums of the images seen by one thread.
+struct Sums {
+  // Of each value of the images, and of the squares of each channel.
+  vector<double> values;
+  vector<double> channel_squares;
+  int count;
+};
+
+// Sums the records i, i + sums->size(), ... of the chunk for each thread i
+// of [begin, end).
+static void SumRecords(const vector<string>& records, int data_size,
+    vector<Sums>* sums, int begin, int end) {
+  Datum datum;
+  for (int i = begin; i < end; ++i) {
+    Sums& thread_sums = (*sums)[i];
+    for (int r = i; r < records.size(); r += sums->size()) {
+      datum.ParseFromString(records[r]);
+      DecodeDatumNative(&datum);
+
+      const std::string& data = datum.data();
+      const int size_in_datum = std::max<int>(datum.data().size(),
+          datum.float_data_size());
+      CHECK_EQ(size_in_datum, data_size) << "Incorrect data field size " <<
+          size_in_datum;
+      const int dim = data_size / datum.channels();
+      for (int j = 0; j < size_in_datum; ++j) {
+        const double value = data.size() != 0 ?
+            static_cast<double>(static_cast<uint8_t>(data[j])) :
+            static_cast<double>(datum.float_data(j));
+        thread_sums.values[j] += value;
+        thread_sums.channel_squares[j / dim] += value * value;
+      }
+      ++thread_sums.count;
+    }
+  }
+}
+#endif  // USE_OPENCV
 
 int main(int argc, char** argv) {
   ::google::InitGoogleLogging(argv[0]);
@@ -60,61 +116,78 @@ int main(int argc, char** argv) {
   sum_blob.set_height(datum.height());
   sum_blob.set_width(datum.width());
   const int data_size = datum.channels() * datum.height() * datum.width();
-  int size_in_datum = std::max<int>(datum.data().size(),
-                                    datum.float_data_size());
-  for (int i = 0; i < size_in_datum; ++i) {
-    sum_blob.add_data(0.);
+  const int channels = sum_blob.channels();
+  const int dim = sum_blob.height() * sum_blob.width();
+
+  const int threads = FLAGS_threads > 0 ? FLAGS_threads :
+      std::max<int>(1, boost::thread::hardware_concurrency());
+  ThreadPool pool(threads);
+  vector<Sums> sums(threads);
+  for (int i = 0; i < threads; ++i) {
+    sums[i].values.resize(data_size);
+    sums[i].channel_squares.resize(channels);
+    sums[i].count = 0;
   }
-  LOG(INFO) << "Starting Iteration";
+  const int chunk_size = 64 * threads;
+  vector<string> records;
+  records.reserve(chunk_size);
+  LOG(INFO) << "Starting Iteration with " << threads << " threads";
   while (cursor->valid()) {
-    Datum datum;
-    datum.ParseFromString(cursor->value());
-    DecodeDatumNative(&datum);
-
-    const std::string& data = datum.data();
-    size_in_datum = std::max<int>(datum.data().size(),
-        datum.float_data_size());
-    CHECK_EQ(size_in_datum, data_size) << "Incorrect data field size " <<
-        size_in_datum;
-    if (data.size() != 0) {
-      CHECK_EQ(data.size(), size_in_datum);
-      for (int i = 0; i < size_in_datum; ++i) {
-        sum_blob.set_data(i, sum_blob.data(i) + (uint8_t)data[i]);
-      }
-    } else {
-      CHECK_EQ(datum.float_data_size(), size_in_datum);
-      for (int i = 0; i < size_in_datum; ++i) {
-        sum_blob.set_data(i, sum_blob.data(i) +
-            static_cast<float>(datum.float_data(i)));
+    records.push_back(cursor->value());
+    cursor->Next();
+    if (records.size() == chunk_size || !cursor->valid()) {
+      pool.ParallelFor(threads, 1, boost::bind(&SumRecords,
+          boost::cref(records), data_size, &sums, _1, _2));
+      for (int i = 0; i < records.size(); ++i) {
+        if (++count % 10000 == 0) {
+          LOG(INFO) << "Processed " << count << " files.";
+        }
       }
+      records.clear();
     }
-    ++count;
-    if (count % 10000 == 0) {
-      LOG(INFO) << "Processed " << count << " files.";
-    }
-    cursor->Next();
   }
 
   if (count % 10000 != 0) {
     LOG(INFO) << "Processed " << count << " files.";
   }
-  for (int i = 0; i < sum_blob.data_size(); ++i) {
-    sum_blob.set_data(i, sum_blob.data(i) / count);
+  // Reduce the sums of the threads
+  vector<double> sum(data_size, 0.);
+  vector<double> channel_squares(channels, 0.);
+  for (int i = 0; i < threads; ++i) {
+    for (int j = 0; j < data_size; ++j) {
+      sum[j] += sums[i].values[j];
+    }
+    for (int c = 0; c < channels; ++c) {
+      channel_squares[c] += sums[i].channel_squares[c];
+    }
+  }
+  for (int i = 0; i < data_size; ++i) {
+    sum_blob.add_data(sum[i] / count);
   }
   // Write to disk
   if (argc == 3) {
     LOG(INFO) << "Write to " << argv[2];
     WriteProtoToBinaryFile(sum_blob, argv[2]);
   }
-  const int channels = sum_blob.channels();
-  const int dim = sum_blob.height() * sum_blob.width();
-  std::vector<float> mean_values(channels, 0.0);
+  TransformationParameter channel_stats;
   LOG(INFO) << "Number of channels: " << channels;
   for (int c = 0; c < channels; ++c) {
+    double mean_value = 0;
     for (int i = 0; i < dim; ++i) {
-      mean_values[c] += sum_blob.data(dim * c + i);
+      mean_value += sum[dim * c + i];
     }
-    LOG(INFO) << "mean_value channel [" << c << "]:" << mean_values[c] / dim;
+    mean_value /= static_cast<double>(count) * dim;
+    const double variance = std::max(0.,
+        channel_squares[c] / (static_cast<double>(count) * dim)
+        - mean_value * mean_value);
+    channel_stats.add_mean_value(mean_value);
+    channel_stats.add_std_value(std::sqrt(variance));
+    LOG(INFO) << "mean_value channel [" << c << "]:" << mean_value;
+    LOG(INFO) << "std_value channel [" << c << "]:" << std::sqrt(variance);
+  }
+  if (FLAGS_channel_stats.size()) {
+    LOG(INFO) << "Write channel stats to " << FLAGS_channel_stats;
+    WriteProtoToTextFile(channel_stats, FLAGS_channel_stats);
   }
 #else
   LOG(FATAL) << "This tool requires OpenCV; compile with USE_OPENCV.";
@@ -7,6 +7,10 @@
 // should be a list of files as well as their labels, in the format as
 //   subfolder1/file1.JPEG 7
 //   ....
+//
+// The images are read, resized and encoded by a pool of threads, one chunk
+// of commit_size images at a time, while a writer thread stores the previous
+// chunk in order. The records are thus the same for any number of threads.
 
 #include <algorithm>
 #include <fstream>  // NOLINT(readability/streams)
@@ -14,7 +18,10 @@
 #include <utility>
 #include <vector>
 
+#include "boost/bind.hpp"
+#include "boost/date_time/posix_time/posix_time.hpp"
 #include "boost/scoped_ptr.hpp"
+#include "boost/thread.hpp"
 #include "gflags/gflags.h"
 #include "glog/logging.h"
 
@@ -23,17 +30,21 @@
 #include "caffe/util/format.hpp"
 #include "caffe/util/io.hpp"
 #include "caffe/util/rng.hpp"
+#include "caffe/util/thread_pool.hpp"
 
 using namespace caffe;  // NOLINT(build/namespaces)
 using std::pair;
+using boost::posix_time::microsec_clock;
+using boost::posix_time::ptime;
 using boost::scoped_ptr;
+using boost::shared_ptr;
 
 DEFINE_bool(gray, false,
     "When this option is on, treat images as grayscale ones");
 DEFINE_bool(shuffle, false,
     "Randomly shuffle the order of images and their labels");
 DEFINE_string(backend, "lmdb",
-        "The backend {lmdb, leveldb} for storing the result");
+        "The backend {lmdb, leveldb, sharded} for storing the result");
 DEFINE_int32(resize_width, 0, "Width images are resized to");
 DEFINE_int32(resize_height, 0, "Height images are resized to");
 DEFINE_bool(check_size, false,
@@ -42,6 +53,107 @@ DEFINE_bool(encoded, false,
     "When this option is on, the encoded image will be save in datum");
 DEFINE_string(encode_type, "",
     "Optional: What type should we encode the image as ('png','jpg',...).");
+DEFINE_int32(threads, 0,
+    "Number of threads reading, resizing and encoding the images, "
+    "or 0 for one per core");
+DEFINE_int32(commit_size, 1000,
+    "Number of images stored per transaction");
+DEFINE_int32(shards, 1,
+    "Number of dbs DB_NAME_00000, DB_NAME_00001, ... the images are spread "
+    "over in turn, or 1 to write to DB_NAME");
+
+#ifdef USE_OPENCV
+// The records of a chunk of images, with an empty value for the images that
+// could not be read.
+struct Chunk {
+  int begin;
+  vector<string> keys;
+  vector<string> values;
+  // The data sizes expected from the dimensions of each image, and actual.
+  vector<int> dims_sizes;
+  vector<int> data_sizes;
+};
+
+// How to read the images of the list.
+struct ReadOptions {
+  string root_folder;
+  int resize_height;
+  int resize_width;
+  bool is_color;
+  bool encoded;
+  string encode_type;
+};
+
+// Reads, resizes and encodes images [begin, end) of the chunk.
+static void ReadChunk(const vector<pair<string, int> >& lines,
+    const ReadOptions& options, Chunk* chunk, int begin, int end) {
+  Datum datum;
+  for (int i = begin; i < end; ++i) {
+    const int line_id = chunk->begin + i;
+    std::string enc = options.encode_type;
+    if (options.encoded && !enc.size()) {
+      // Guess the encoding type from the file name
+      string fn = lines[line_id].first;
+      size_t p = fn.rfind('.');
+      if ( p == fn.npos )
+        LOG(WARNING) << "Failed to guess the encoding of '" << fn << "'";
+      enc = fn.substr(p);
+      std::transform(enc.begin(), enc.end(), enc.begin(), ::tolower);
+    }
+    chunk->values[i].clear();
+    bool status = ReadImageToDatum(
+        options.root_folder + lines[line_id].first, lines[line_id].second,
+        options.resize_height, options.resize_width, options.is_color,
+        enc, &datum);
+    if (status == false) continue;
+    chunk->dims_sizes[i] = datum.channels() * datum.height() * datum.width();
+    chunk->data_sizes[i] = datum.data().size();
+    // sequential
+    chunk->keys[i] = caffe::format_int(line_id, 8) + "_" +
+        lines[line_id].first;
+    CHECK(datum.SerializeToString(&chunk->values[i]));
+  }
+}
+
+// Stores the records of the chunk in the dbs and commits them.
+static void WriteChunk(const Chunk* chunk, bool check_size, bool append,
+    const vector<shared_ptr<db::DB> >* dbs, int* count, int* data_size) {
+  vector<shared_ptr<db::Transaction> > txns;
+  for (int i = 0; i < dbs->size(); ++i) {
+    txns.push_back(shared_ptr<db::Transaction>((*dbs)[i]->NewTransaction()));
+  }
+  for (int i = 0; i < chunk->values.size(); ++i) {
+    if (chunk->values[i].empty()) continue;
+    if (check_size) {
+      if (*data_size < 0) {
+        *data_size = chunk->dims_sizes[i];
+      } else {
+        CHECK_EQ(chunk->data_sizes[i], *data_size)
+            << "Incorrect data field size " << chunk->data_sizes[i];
+      }
+    }
+    // Put in db
+    db::Transaction* txn = txns[(chunk->begin + i) % txns.size()].get();
+    if (append) {
+      txn->Append(chunk->keys[i], chunk->values[i]);
+    } else {
+      txn->Put(chunk->keys[i], chunk->values[i]);
+    }
+    ++*count;
+  }
+  // Commit db
+  for (int i = 0; i < txns.size(); ++i) {
+    txns[i]->Commit();
+  }
+}
+
+// Returns the rate at which count files were converted since start.
+static double FilesPerSecond(int count, const ptime& start) {
+  const double seconds =
+      (microsec_clock::universal_time() - start).total_milliseconds() / 1000.;
+  return seconds > 0 ? count / seconds : 0;
+}
+#endif  // USE_OPENCV
 
 int main(int argc, char** argv) {
 #ifdef USE_OPENCV
@@ -91,63 +203,64 @@ int main(int argc, char** argv) {
   int resize_height = std::max<int>(0, FLAGS_resize_height);
   int resize_width = std::max<int>(0, FLAGS_resize_width);
 
+  const int threads = FLAGS_threads > 0 ? FLAGS_threads :
+      std::max<int>(1, boost::thread::hardware_concurrency());
+  const int commit_size = FLAGS_commit_size;
+  CHECK_GT(commit_size, 0);
+  CHECK_GT(FLAGS_shards, 0);
+  LOG(INFO) << "Converting with " << threads << " threads.";
+
   // Create new DB
-  scoped_ptr<db::DB> db(db::GetDB(FLAGS_backend));
-  db->Open(argv[3], db::NEW);
-  scoped_ptr<db::Transaction> txn(db->NewTransaction());
+  vector<shared_ptr<db::DB> > dbs;
+  for (int i = 0; i < FLAGS_shards; ++i) {
+    dbs.push_back(shared_ptr<db::DB>(db::GetDB(FLAGS_backend)));
+    dbs.back()->Open(FLAGS_shards == 1 ? string(argv[3]) :
+        string(argv[3]) + "_" + caffe::format_int(i, 5), db::NEW);
+  }
+  // The keys start with the zero-padded line number, so they come in order
+  // unless it overflows.
+  const bool append = lines.size() <= 100000000;
 
   // Storing to db
-  std::string root_folder(argv[1]);
-  Datum datum;
+  ReadOptions options;
+  options.root_folder = argv[1];
+  options.resize_height = resize_height;
+  options.resize_width = resize_width;
+  options.is_color = is_color;
+  options.encoded = encoded;
+  options.encode_type = encode_type;
+  ThreadPool pool(threads);
+  Chunk chunks[2];
+  scoped_ptr<boost::thread> writer;
   int count = 0;
-  int data_size = 0;
-  bool data_size_initialized = false;
-
-  for (int line_id = 0; line_id < lines.size(); ++line_id) {
-    bool status;
-    std::string enc = encode_type;
-    if (encoded && !enc.size()) {
-      // Guess the encoding type from the file name
-      string fn = lines[line_id].first;
-      size_t p = fn.rfind('.');
-      if ( p == fn.npos )
-        LOG(WARNING) << "Failed to guess the encoding of '" << fn << "'";
-      enc = fn.substr(p);
-      std::transform(enc.begin(), enc.end(), enc.begin(), ::tolower);
-    }
-    status = ReadImageToDatum(root_folder + lines[line_id].first,
-        lines[line_id].second, resize_height, resize_width, is_color,
-        enc, &datum);
-    if (status == false) continue;
-    if (check_size) {
-      if (!data_size_initialized) {
-        data_size = datum.channels() * datum.height() * datum.width();
-        data_size_initialized = true;
-      } else {
-        const std::string& data = datum.data();
-        CHECK_EQ(data.size(), data_size) << "Incorrect data field size "
-            << data.size();
-      }
-    }
-    // sequential
-    string key_str = caffe::format_int(line_id, 8) + "_" + lines[line_id].first;
+  int data_size = -1;
+  const ptime start = microsec_clock::universal_time();
 
-    // Put in db
-    string out;
-    CHECK(datum.SerializeToString(&out));
-    txn->Put(key_str, out);
-
-    if (++count % 1000 == 0) {
-      // Commit db
-      txn->Commit();
-      txn.reset(db->NewTransaction());
-      LOG(INFO) << "Processed " << count << " files.";
+  for (int begin = 0, c = 0; begin < lines.size();
+       begin += commit_size, c = 1 - c) {
+    // Read the next chunk while the previous one is written.
+    Chunk* chunk = &chunks[c];
+    const int size = std::min<int>(commit_size, lines.size() - begin);
+    chunk->begin = begin;
+    chunk->keys.resize(size);
+    chunk->values.resize(size);
+    chunk->dims_sizes.resize(size);
+    chunk->data_sizes.resize(size);
+    pool.ParallelFor(size, 1, boost::bind(&ReadChunk, boost::cref(lines),
+        boost::cref(options), chunk, _1, _2));
+    if (writer) {
+      writer->join();
+      LOG(INFO) << "Processed " << count << " files, "
+          << FilesPerSecond(count, start) << " files/s.";
     }
+    writer.reset(new boost::thread(&WriteChunk, chunk, check_size, append,
+        &dbs, &count, &data_size));
   }
   // write the last batch
-  if (count % 1000 != 0) {
-    txn->Commit();
-    LOG(INFO) << "Processed " << count << " files.";
+  if (writer) {
+    writer->join();
+    LOG(INFO) << "Processed " << count << " files, "
+        << FilesPerSecond(count, start) << " files/s.";
   }
 #else
   LOG(FATAL) << "This tool requires OpenCV; compile with USE_OPENCV.";
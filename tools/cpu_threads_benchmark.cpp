@@ -0,0 +1,127 @@
+// Measures how the element-wise CPU math functions and neuron layers scale
+// with the size of the CPU thread pool (Caffe::set_cpu_threads).
+// Usage:
+//    cpu_threads_benchmark [--count=N] [--iterations=N] [--max_threads=N]
+
+#include <algorithm>
+#include <iomanip>
+#include <string>
+#include <vector>
+
+#include "boost/thread.hpp"
+#include "gflags/gflags.h"
+#include "glog/logging.h"
+
+#include "caffe/blob.hpp"
+#include "caffe/common.hpp"
+#include "caffe/filler.hpp"
+#include "caffe/layers/relu_layer.hpp"
+#include "caffe/layers/sigmoid_layer.hpp"
+#include "caffe/layers/tanh_layer.hpp"
+#include "caffe/util/benchmark.hpp"
+#include "caffe/util/math_functions.hpp"
+
+using namespace caffe;  // NOLINT(build/namespaces)
+
+DEFINE_int32(count, 32 * 64 * 56 * 56,
+    "Number of elements in each benchmarked blob.");
+DEFINE_int32(iterations, 20,
+    "Number of times each operation is run per thread count.");
+DEFINE_int32(max_threads, 0,
+    "Largest thread count to try; 0 uses the number of hardware threads.");
+
+enum Op { ADD, MUL, EXP, POWX, SCAL, RELU, SIGMOID, TANH, NUM_OPS };
+
+static const char* op_names[NUM_OPS] = { "caffe_add", "caffe_mul",
+    "caffe_exp", "caffe_powx", "caffe_scal", "ReLU", "Sigmoid", "TanH" };
+
+// Returns the average time of one run of op in milliseconds.
+static double TimeOp(const Op op, Blob<float>* a, Blob<float>* b,
+    Blob<float>* y) {
+  const int n = a->count();
+  LayerParameter layer_param;
+  shared_ptr<Layer<float> > layer;
+  if (op == RELU) {
+    layer.reset(new ReLULayer<float>(layer_param));
+  } else if (op == SIGMOID) {
+    layer.reset(new SigmoidLayer<float>(layer_param));
+  } else if (op == TANH) {
+    layer.reset(new TanHLayer<float>(layer_param));
+  }
+  vector<Blob<float>*> bottom(1, a);
+  vector<Blob<float>*> top(1, y);
+  if (layer) {
+    layer->SetUp(bottom, top);
+  }
+  CPUTimer timer;
+  double total = 0;
+  for (int i = 0; i < FLAGS_iterations; ++i) {
+    timer.Start();
+    switch (op) {
+    case ADD:
+      caffe_add(n, a->cpu_data(), b->cpu_data(), y->mutable_cpu_data());
+      break;
+    case MUL:
+      caffe_mul(n, a->cpu_data(), b->cpu_data(), y->mutable_cpu_data());
+      break;
+    case EXP:
+      caffe_exp(n, a->cpu_data(), y->mutable_cpu_data());
+      break;
+    case POWX:
+      caffe_powx(n, b->cpu_data(), 0.75f, y->mutable_cpu_data());
+      break;
+    case SCAL:
+      caffe_scal(n, 1.0001f, y->mutable_cpu_data());
+      break;
+    default:
+      layer->Forward(bottom, top);
+    }
+    total += timer.MilliSeconds();
+  }
+  return total / FLAGS_iterations;
+}
+
+int main(int argc, char** argv) {
+  FLAGS_alsologtostderr = 1;
+  gflags::SetUsageMessage("Benchmark the CPU thread pool.\n"
+      "Usage:\n"
+      "    cpu_threads_benchmark [FLAGS]\n");
+  caffe::GlobalInit(&argc, &argv);
+  Caffe::set_mode(Caffe::CPU);
+  int max_threads = FLAGS_max_threads;
+  if (max_threads <= 0) {
+    max_threads = std::max<int>(1, boost::thread::hardware_concurrency());
+  }
+
+  vector<int> shape(1, FLAGS_count);
+  Blob<float> a(shape), b(shape), y(shape);
+  FillerParameter filler_param;
+  filler_param.set_min(0.1);
+  filler_param.set_max(2);
+  UniformFiller<float> filler(filler_param);
+  filler.Fill(&a);
+  filler.Fill(&b);
+
+  vector<int> thread_counts;
+  for (int t = 1; t < max_threads; t *= 2) {
+    thread_counts.push_back(t);
+  }
+  thread_counts.push_back(max_threads);
+
+  LOG(INFO) << "Benchmarking " << FLAGS_count << " elements, "
+      << FLAGS_iterations << " iterations per thread count.";
+  vector<double> baseline(NUM_OPS);
+  for (int t = 0; t < thread_counts.size(); ++t) {
+    Caffe::set_cpu_threads(thread_counts[t]);
+    for (int op = 0; op < NUM_OPS; ++op) {
+      const double ms = TimeOp(static_cast<Op>(op), &a, &b, &y);
+      if (t == 0) {
+        baseline[op] = ms;
+      }
+      LOG(INFO) << std::setw(3) << thread_counts[t] << " threads  "
+          << std::setw(10) << op_names[op] << ": " << ms << " ms, speedup "
+          << baseline[op] / ms << "x";
+    }
+  }
+  return 0;
+}
@@ -0,0 +1,94 @@
+// Compares the throughput of reading and transforming the records of a
+// database by copying each one into a Datum, as DataReader used to, with
+// reading them in place through a DatumView.
+// Usage:
+//    data_read_benchmark [FLAGS] DB_PATH
+
+#include <string>
+#include <vector>
+
+#include "gflags/gflags.h"
+#include "glog/logging.h"
+
+#include "caffe/blob.hpp"
+#include "caffe/common.hpp"
+#include "caffe/data_transformer.hpp"
+#include "caffe/proto/caffe.pb.h"
+#include "caffe/util/benchmark.hpp"
+#include "caffe/util/datum_view.hpp"
+#include "caffe/util/db.hpp"
+
+using namespace caffe;  // NOLINT(build/namespaces)
+using std::string;
+
+DEFINE_string(backend, "lmdb",
+    "The backend {leveldb, lmdb, sharded} containing the records.");
+DEFINE_int32(records, 10000,
+    "Number of records read by each method, wrapping around the database.");
+DEFINE_bool(transform, true,
+    "Also transform each record into a blob, as DataLayer does.");
+
+// Returns the records per second read, and optionally transformed, through
+// a DatumView when in_place is true, or through a copied Datum otherwise.
+static double TimeRead(db::Cursor* cursor, const bool in_place) {
+  TransformationParameter transform_param;
+  DataTransformer<float> transformer(transform_param, TEST);
+  Datum datum;
+  DatumView datum_view;
+  Blob<float> transformed;
+  cursor->SeekToFirst();
+  CPUTimer timer;
+  timer.Start();
+  for (int i = 0; i < FLAGS_records; ++i) {
+    if (in_place) {
+      const char* data;
+      size_t size;
+      cursor->value_view(&data, &size);
+      CHECK(datum_view.Parse(data, size)) << "Could not parse datum";
+      if (FLAGS_transform) {
+        transformed.Reshape(transformer.InferBlobShape(datum_view));
+        transformer.Transform(datum_view, &transformed);
+      }
+    } else {
+      CHECK(datum.ParseFromString(cursor->value())) << "Could not parse datum";
+      if (FLAGS_transform) {
+        transformed.Reshape(transformer.InferBlobShape(datum));
+        transformer.Transform(datum, &transformed);
+      }
+    }
+    cursor->Next();
+    if (!cursor->valid()) {
+      cursor->SeekToFirst();
+    }
+  }
+  timer.Stop();
+  return FLAGS_records / (timer.MilliSeconds() / 1000.);
+}
+
+int main(int argc, char** argv) {
+  FLAGS_alsologtostderr = 1;
+  gflags::SetUsageMessage("Benchmark reading records in place.\n"
+      "Usage:\n"
+      "    data_read_benchmark [FLAGS] DB_PATH\n");
+  caffe::GlobalInit(&argc, &argv);
+  if (argc != 2) {
+    gflags::ShowUsageWithFlagsRestrict(argv[0],
+        "tools/data_read_benchmark");
+    return 1;
+  }
+  CHECK_GT(FLAGS_records, 0);
+
+  shared_ptr<db::DB> db(db::GetDB(FLAGS_backend));
+  db->Open(argv[1], db::READ);
+  shared_ptr<db::Cursor> cursor(db->NewCursor());
+  CHECK(cursor->valid()) << "The database is empty.";
+
+  LOG(INFO) << "Reading " << FLAGS_records << " records"
+      << (FLAGS_transform ? " and transforming them." : ".");
+  const double copy_rate = TimeRead(cursor.get(), false);
+  LOG(INFO) << "Datum:     " << copy_rate << " records/s";
+  const double view_rate = TimeRead(cursor.get(), true);
+  LOG(INFO) << "DatumView: " << view_rate << " records/s, speedup "
+      << view_rate / copy_rate << "x";
+  return 0;
+}
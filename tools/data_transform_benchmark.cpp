@@ -0,0 +1,116 @@
+// Compares the throughput of transforming uint8 Datums the way
+// DataTransformer used to, branching on the mean and mirroring for every
+// pixel, with its current row kernels.
+// Usage:
+//    data_transform_benchmark [FLAGS]
+
+#include <stdint.h>
+
+#include <string>
+#include <vector>
+
+#include "gflags/gflags.h"
+#include "glog/logging.h"
+
+#include "caffe/blob.hpp"
+#include "caffe/common.hpp"
+#include "caffe/data_transformer.hpp"
+#include "caffe/proto/caffe.pb.h"
+#include "caffe/util/benchmark.hpp"
+#include "caffe/util/math_functions.hpp"
+
+using namespace caffe;  // NOLINT(build/namespaces)
+using std::string;
+using std::vector;
+
+DEFINE_int32(images, 2000, "Number of images transformed by each method.");
+DEFINE_int32(channels, 3, "Channels of the images.");
+DEFINE_int32(size, 256, "Height and width of the images.");
+DEFINE_int32(crop_size, 227, "Size of the crops, or 0 for no crop.");
+DEFINE_bool(mirror, true, "Mirror the images at random.");
+DEFINE_bool(mean_values, true, "Subtract a mean value from each channel.");
+
+// The former per-pixel loop of DataTransformer, as a reference.
+static void TransformScalar(const Datum& datum, const bool do_mirror,
+    const vector<float>& mean_values, const float scale, const int h_off,
+    const int w_off, const int height, const int width, float* top) {
+  const string& data = datum.data();
+  for (int c = 0; c < datum.channels(); ++c) {
+    for (int h = 0; h < height; ++h) {
+      for (int w = 0; w < width; ++w) {
+        const int data_index =
+            (c * datum.height() + h_off + h) * datum.width() + w_off + w;
+        int top_index;
+        if (do_mirror) {
+          top_index = (c * height + h) * width + (width - 1 - w);
+        } else {
+          top_index = (c * height + h) * width + w;
+        }
+        const float element =
+            static_cast<float>(static_cast<uint8_t>(data[data_index]));
+        if (mean_values.size() > 0) {
+          top[top_index] = (element - mean_values[c]) * scale;
+        } else {
+          top[top_index] = element * scale;
+        }
+      }
+    }
+  }
+}
+
+int main(int argc, char** argv) {
+  FLAGS_alsologtostderr = 1;
+  gflags::SetUsageMessage("Benchmark the DataTransformer kernels.\n"
+      "Usage:\n"
+      "    data_transform_benchmark [FLAGS]\n");
+  caffe::GlobalInit(&argc, &argv);
+  CHECK_GT(FLAGS_images, 0);
+  CHECK_LE(FLAGS_crop_size, FLAGS_size);
+
+  Datum datum;
+  datum.set_channels(FLAGS_channels);
+  datum.set_height(FLAGS_size);
+  datum.set_width(FLAGS_size);
+  string* data = datum.mutable_data();
+  data->resize(FLAGS_channels * FLAGS_size * FLAGS_size);
+  for (int i = 0; i < data->size(); ++i) {
+    (*data)[i] = static_cast<char>(caffe_rng_rand());
+  }
+  TransformationParameter transform_param;
+  transform_param.set_crop_size(FLAGS_crop_size);
+  transform_param.set_mirror(FLAGS_mirror);
+  transform_param.set_scale(0.017);
+  vector<float> mean_values;
+  for (int c = 0; FLAGS_mean_values && c < FLAGS_channels; ++c) {
+    mean_values.push_back(100 + c);
+    transform_param.add_mean_value(mean_values.back());
+  }
+  DataTransformer<float> transformer(transform_param, TRAIN);
+  transformer.InitRand();
+  Blob<float> transformed(transformer.InferBlobShape(datum));
+  const int crop = FLAGS_crop_size ? FLAGS_crop_size : FLAGS_size;
+  const int max_off = FLAGS_size - crop + 1;
+
+  LOG(INFO) << "Transforming " << FLAGS_images << " images of "
+      << datum.channels() << "x" << datum.height() << "x" << datum.width();
+  CPUTimer timer;
+  timer.Start();
+  for (int i = 0; i < FLAGS_images; ++i) {
+    TransformScalar(datum, FLAGS_mirror && caffe_rng_rand() % 2, mean_values,
+        transform_param.scale(), caffe_rng_rand() % max_off,
+        caffe_rng_rand() % max_off, crop, crop,
+        transformed.mutable_cpu_data());
+  }
+  timer.Stop();
+  const double scalar_rate = FLAGS_images / (timer.MilliSeconds() / 1000.);
+  LOG(INFO) << "Per pixel: " << scalar_rate << " images/s";
+  timer.Start();
+  for (int i = 0; i < FLAGS_images; ++i) {
+    transformer.Transform(datum, &transformed);
+  }
+  timer.Stop();
+  const double kernel_rate = FLAGS_images / (timer.MilliSeconds() / 1000.);
+  LOG(INFO) << "Per row:   " << kernel_rate << " images/s, speedup "
+      << kernel_rate / scalar_rate << "x";
+  return 0;
+}
@@ -1,7 +1,12 @@
+#include <stdint.h>
+
+#include <cstdio>
 #include <string>
 #include <vector>
 
 #include "boost/algorithm/string.hpp"
+#include "boost/scoped_ptr.hpp"
+#include "boost/thread.hpp"
 #include "google/protobuf/text_format.h"
 
 #include "caffe/blob.hpp"
@@ -11,14 +16,146 @@
 #include "caffe/util/db.hpp"
 #include "caffe/util/format.hpp"
 #include "caffe/util/io.hpp"
+#include "caffe/util/upgrade_proto.hpp"
 
 using caffe::Blob;
 using caffe::Caffe;
 using caffe::Datum;
 using caffe::Net;
 using std::string;
+using std::vector;
 namespace db = caffe::db;
 
+// Writes the rows of a feature blob to a .npy file, which numpy can load
+// or memory-map, e.g. numpy.load(path, mmap_mode='r'). The rows are stored
+// back to back after the header, so row i is at a fixed offset, and the
+// header is rewritten with the number of rows on Close.
+template <typename Dtype>
+class NpyWriter {
+ public:
+  NpyWriter(const string& path, const vector<int>& row_shape)
+      : path_(path), row_shape_(row_shape), rows_(0) {
+    file_ = fopen(path.c_str(), "wb");
+    CHECK(file_) << "Failed to open " << path;
+    WriteHeader();
+  }
+  ~NpyWriter() { Close(); }
+
+  void Write(const Dtype* data, int rows, int row_count) {
+    CHECK_EQ(fwrite(data, sizeof(Dtype) * row_count, rows, file_), rows)
+        << "Failed to write to " << path_;
+    rows_ += rows;
+  }
+  void Close() {
+    if (file_) {
+      CHECK_EQ(fseek(file_, 0, SEEK_SET), 0) << "Failed to seek " << path_;
+      WriteHeader();
+      CHECK_EQ(fclose(file_), 0) << "Failed to close " << path_;
+      file_ = NULL;
+    }
+  }
+  inline const vector<int>& row_shape() const { return row_shape_; }
+
+ private:
+  // Writes a version 1.0 header, padded so that the rows are aligned to 64
+  // bytes. The number of rows takes a fixed width, so that the header keeps
+  // its size when rewritten.
+  void WriteHeader() {
+    const uint16_t one = 1;
+    const bool little_endian = *reinterpret_cast<const char*>(&one) == 1;
+    string header = string("{'descr': '") + (little_endian ? '<' : '>') +
+        (sizeof(Dtype) == 4 ? "f4" : "f8") +
+        "', 'fortran_order': False, 'shape': (";
+    char rows[32];
+    snprintf(rows, sizeof(rows), "%20lld,", static_cast<long long>(rows_));
+    header += rows;
+    for (int i = 0; i < row_shape_.size(); ++i) {
+      header += (i ? ", " : " ") + caffe::format_int(row_shape_[i]);
+    }
+    header += "), }";
+    const size_t prefix = 10;  // magic, version and header length
+    header.append(63 - (prefix + header.size()) % 64, ' ');
+    header += '\n';
+    const uint16_t length = header.size();
+    const char magic[] = "\x93NUMPY\x01\x00";
+    CHECK(fwrite(magic, 1, 8, file_) == 8 &&
+        fputc(length & 0xFF, file_) != EOF &&
+        fputc(length >> 8, file_) != EOF &&
+        fwrite(header.data(), 1, header.size(), file_) == header.size())
+        << "Failed to write to " << path_;
+  }
+
+  const string path_;
+  const vector<int> row_shape_;
+  int64_t rows_;
+  FILE* file_;
+};
+
+// The feature blobs of a mini-batch, copied so that they can be written
+// while the net computes the next one.
+template <typename Dtype>
+struct Features {
+  vector<vector<int> > shapes;
+  vector<vector<Dtype> > data;
+};
+
+// Where the features go: one database per feature blob, or one .npy file.
+template <typename Dtype>
+struct FeatureOutputs {
+  vector<boost::shared_ptr<db::DB> > dbs;
+  vector<boost::shared_ptr<db::Transaction> > txns;
+  vector<boost::shared_ptr<NpyWriter<Dtype> > > npys;
+  vector<int> image_indices;
+};
+
+// Writes a mini-batch of features, on the writer thread.
+template <typename Dtype>
+void WriteFeatures(const Features<Dtype>* features,
+    const vector<string>* blob_names, FeatureOutputs<Dtype>* outputs) {
+  Datum datum;
+  for (int i = 0; i < features->data.size(); ++i) {
+    const vector<int>& shape = features->shapes[i];
+    const int batch_size = shape[0];
+    const int dim_features = features->data[i].size() / batch_size;
+    int& image_index = outputs->image_indices[i];
+    if (!outputs->npys.empty()) {
+      // The rows are written as they are, without a record per row.
+      CHECK(vector<int>(shape.begin() + 1, shape.end()) ==
+          outputs->npys[i]->row_shape())
+          << "Feature blob " << (*blob_names)[i] << " changed shape";
+      outputs->npys[i]->Write(&features->data[i][0], batch_size,
+          dim_features);
+      image_index += batch_size;
+      continue;
+    }
+    CHECK_LE(shape.size(), 4) << "Datums hold up to 4 axes, use npy";
+    for (int n = 0; n < batch_size; ++n) {
+      datum.set_height(shape.size() > 2 ? shape[2] : 1);
+      datum.set_width(shape.size() > 3 ? shape[3] : 1);
+      datum.set_channels(shape.size() > 1 ? shape[1] : 1);
+      datum.clear_data();
+      datum.clear_float_data();
+      const Dtype* feature_blob_data =
+          &features->data[i][0] + n * dim_features;
+      for (int d = 0; d < dim_features; ++d) {
+        datum.add_float_data(feature_blob_data[d]);
+      }
+      string key_str = caffe::format_int(image_index, 10);
+
+      string out;
+      CHECK(datum.SerializeToString(&out));
+      outputs->txns.at(i)->Put(key_str, out);
+      ++image_index;
+      if (image_index % 1000 == 0) {
+        outputs->txns.at(i)->Commit();
+        outputs->txns.at(i).reset(outputs->dbs.at(i)->NewTransaction());
+        LOG(ERROR)<< "Extracted features of " << image_index <<
+            " query images for feature blob " << (*blob_names)[i];
+      }
+    }  // for (int n = 0; n < batch_size; ++n)
+  }  // for (int i = 0; i < num_features; ++i)
+}
+
 template<typename Dtype>
 int feature_extraction_pipeline(int argc, char** argv);
 
@@ -38,11 +175,14 @@ int feature_extraction_pipeline(int argc, char** argv) {
     "Usage: extract_features  pretrained_net_param"
     "  feature_extraction_proto_file  extract_feature_blob_name1[,name2,...]"
     "  save_feature_dataset_name1[,name2,...]  num_mini_batches  db_type"
+    "  (leveldb, lmdb, sharded or npy)"
     "  [CPU/GPU] [DEVICE_ID=0]\n"
     "Note: you can extract multiple features in one pass by specifying"
     " multiple feature blob names and dataset names separated by ','."
     " The names cannot contain white space characters and the number of blobs"
-    " and datasets must be equal.";
+    " and datasets must be equal.\n"
+    "With db_type npy, each dataset is a .npy file holding one row per"
+    " input, which numpy can load or memory-map.";
     return 1;
   }
   int arg_pos = num_required_args;
@@ -94,14 +234,21 @@ int feature_extraction_pipeline(int argc, char** argv) {
    }
    */
   std::string feature_extraction_proto(argv[++arg_pos]);
-  boost::shared_ptr<Net<Dtype> > feature_extraction_net(
-      new Net<Dtype>(feature_extraction_proto, caffe::TEST));
-  feature_extraction_net->CopyTrainedLayersFrom(pretrained_binary_proto);
-
   std::string extract_feature_blob_names(argv[++arg_pos]);
   std::vector<std::string> blob_names;
   boost::split(blob_names, extract_feature_blob_names, boost::is_any_of(","));
 
+  caffe::NetParameter net_param;
+  caffe::ReadNetParamsFromTextFileOrDie(feature_extraction_proto, &net_param);
+  net_param.mutable_state()->set_phase(caffe::TEST);
+  // The features must survive the forward pass if the net reuses activations.
+  for (size_t i = 0; i < blob_names.size(); ++i) {
+    net_param.add_keep_blob(blob_names[i]);
+  }
+  boost::shared_ptr<Net<Dtype> > feature_extraction_net(
+      new Net<Dtype>(net_param));
+  feature_extraction_net->CopyTrainedLayersFrom(pretrained_binary_proto);
+
   std::string save_feature_dataset_names(argv[++arg_pos]);
   std::vector<std::string> dataset_names;
   boost::split(dataset_names, save_feature_dataset_names,
@@ -118,64 +265,68 @@ int feature_extraction_pipeline(int argc, char** argv) {
 
   int num_mini_batches = atoi(argv[++arg_pos]);
 
-  std::vector<boost::shared_ptr<db::DB> > feature_dbs;
-  std::vector<boost::shared_ptr<db::Transaction> > txns;
-  const char* db_type = argv[++arg_pos];
-  for (size_t i = 0; i < num_features; ++i) {
+  FeatureOutputs<Dtype> outputs;
+  outputs.image_indices.resize(num_features, 0);
+  const string db_type = argv[++arg_pos];
+  const bool npy = db_type == "npy";
+  for (size_t i = 0; i < num_features && !npy; ++i) {
     LOG(INFO)<< "Opening dataset " << dataset_names[i];
     boost::shared_ptr<db::DB> db(db::GetDB(db_type));
     db->Open(dataset_names.at(i), db::NEW);
-    feature_dbs.push_back(db);
+    outputs.dbs.push_back(db);
     boost::shared_ptr<db::Transaction> txn(db->NewTransaction());
-    txns.push_back(txn);
+    outputs.txns.push_back(txn);
   }
 
   LOG(ERROR)<< "Extacting Features";
 
-  Datum datum;
-  std::vector<int> image_indices(num_features, 0);
-  for (int batch_index = 0; batch_index < num_mini_batches; ++batch_index) {
+  // Each mini-batch is written by a writer thread while the net computes
+  // the next one.
+  Features<Dtype> features[2];
+  boost::scoped_ptr<boost::thread> writer;
+  for (int batch_index = 0, f = 0; batch_index < num_mini_batches;
+       ++batch_index, f = 1 - f) {
     feature_extraction_net->Forward();
+    Features<Dtype>* batch = &features[f];
+    batch->shapes.resize(num_features);
+    batch->data.resize(num_features);
     for (int i = 0; i < num_features; ++i) {
       const boost::shared_ptr<Blob<Dtype> > feature_blob =
         feature_extraction_net->blob_by_name(blob_names[i]);
-      int batch_size = feature_blob->num();
-      int dim_features = feature_blob->count() / batch_size;
-      const Dtype* feature_blob_data;
-      for (int n = 0; n < batch_size; ++n) {
-        datum.set_height(feature_blob->height());
-        datum.set_width(feature_blob->width());
-        datum.set_channels(feature_blob->channels());
-        datum.clear_data();
-        datum.clear_float_data();
-        feature_blob_data = feature_blob->cpu_data() +
-            feature_blob->offset(n);
-        for (int d = 0; d < dim_features; ++d) {
-          datum.add_float_data(feature_blob_data[d]);
-        }
-        string key_str = caffe::format_int(image_indices[i], 10);
-
-        string out;
-        CHECK(datum.SerializeToString(&out));
-        txns.at(i)->Put(key_str, out);
-        ++image_indices[i];
-        if (image_indices[i] % 1000 == 0) {
-          txns.at(i)->Commit();
-          txns.at(i).reset(feature_dbs.at(i)->NewTransaction());
-          LOG(ERROR)<< "Extracted features of " << image_indices[i] <<
-              " query images for feature blob " << blob_names[i];
-        }
-      }  // for (int n = 0; n < batch_size; ++n)
-    }  // for (int i = 0; i < num_features; ++i)
+      CHECK_GE(feature_blob->num_axes(), 1);
+      batch->shapes[i] = feature_blob->shape();
+      batch->data[i].assign(feature_blob->cpu_data(),
+          feature_blob->cpu_data() + feature_blob->count());
+      if (npy && batch_index == 0) {
+        LOG(INFO)<< "Opening dataset " << dataset_names[i];
+        outputs.npys.push_back(boost::shared_ptr<NpyWriter<Dtype> >(
+            new NpyWriter<Dtype>(dataset_names[i], vector<int>(
+            feature_blob->shape().begin() + 1, feature_blob->shape().end()))));
+      }
+    }
+    if (writer) {
+      writer->join();
+    }
+    writer.reset(new boost::thread(&WriteFeatures<Dtype>, batch, &blob_names,
+        &outputs));
   }  // for (int batch_index = 0; batch_index < num_mini_batches; ++batch_index)
+  if (writer) {
+    writer->join();
+  }
   // write the last batch
   for (int i = 0; i < num_features; ++i) {
-    if (image_indices[i] % 1000 != 0) {
-      txns.at(i)->Commit();
+    if (npy) {
+      if (!outputs.npys.empty()) {
+        outputs.npys[i]->Close();
+      }
+    } else {
+      if (outputs.image_indices[i] % 1000 != 0) {
+        outputs.txns.at(i)->Commit();
+      }
+      outputs.dbs.at(i)->Close();
     }
-    LOG(ERROR)<< "Extracted features of " << image_indices[i] <<
+    LOG(ERROR)<< "Extracted features of " << outputs.image_indices[i] <<
         " query images for feature blob " << blob_names[i];
-    feature_dbs.at(i)->Close();
   }
 
   LOG(ERROR)<< "Successfully extracted the features!";
@@ -0,0 +1,49 @@
+// This is a script to fold the BatchNorm, Scale and ReLU layers that follow
+// convolutions into them, for deployment.
+// Usage:
+//    fuse_net_layers net_proto_file_in weights_file_in
+//        net_proto_file_out weights_file_out
+
+#include <string>
+#include <vector>
+
+#include "caffe/caffe.hpp"
+#include "caffe/util/fuse_layers.hpp"
+#include "caffe/util/io.hpp"
+#include "caffe/util/upgrade_proto.hpp"
+
+using namespace caffe;  // NOLINT(build/namespaces)
+
+int main(int argc, char** argv) {
+  FLAGS_alsologtostderr = 1;  // Print output to stderr (while still logging)
+  ::google::InitGoogleLogging(argv[0]);
+  if (argc != 5) {
+    LOG(ERROR) << "Usage: fuse_net_layers net_proto_file_in weights_file_in "
+        << "net_proto_file_out weights_file_out";
+    return 1;
+  }
+
+  NetParameter net_param;
+  ReadNetParamsFromTextFileOrDie(string(argv[1]), &net_param);
+  NetParameter weights_param;
+  ReadNetParamsFromBinaryFileOrDie(string(argv[2]), &weights_param);
+
+  NetParameter fused_net_param;
+  vector<string> folded_names;
+  const int num_folded =
+      FuseLayers(net_param, &fused_net_param, &folded_names);
+  // The fused net is already folded; it must not fold its weights again.
+  fused_net_param.clear_fuse_layers();
+  NetParameter fused_weights_param;
+  vector<string> folded_weight_names;
+  FuseLayers(weights_param, &fused_weights_param, &folded_weight_names);
+  // Weights missing some of the layers to fold are left unfolded.
+  CHECK(folded_names == folded_weight_names)
+      << "The weights do not fold like the net; are blobs missing?";
+
+  WriteProtoToTextFile(fused_net_param, argv[3]);
+  WriteProtoToBinaryFile(fused_weights_param, argv[4]);
+  LOG(INFO) << "Folded " << num_folded << " layers; wrote " << argv[3]
+      << " and " << argv[4];
+  return 0;
+}
@@ -0,0 +1,392 @@
+// Serves a net over a local UNIX domain socket, running the requests of
+// concurrent clients in batches.
+// Usage:
+//    inference_server --model=deploy.prototxt --weights=net.caffemodel
+//        [--socket=/tmp/caffe_inference.sock] [FLAGS]
+//
+// Each request holds one input item: its length in bytes, as a 4-byte
+// integer in host byte order, followed by the floats of the item, shaped
+// like the input blob without its first axis. The reply to a request is
+// framed the same way and holds the item's row of the output blob. A
+// request of length 0 is answered with the latency and batch statistics
+// as text. Clients may send requests one after the other on a connection,
+// and concurrent requests come from concurrent connections.
+//
+// Requests wait until max_batch_size of them are pending or the oldest has
+// waited max_latency_us, and then run in a single forward pass. Batches
+// are padded to the next power of 2, so the net is only reshaped when the
+// batch size moves to another of these buckets.
+
+#include <signal.h>
+#include <stdint.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <deque>
+#include <iomanip>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "boost/bind.hpp"
+#include "boost/date_time/posix_time/posix_time.hpp"
+#include "boost/thread.hpp"
+#include "gflags/gflags.h"
+#include "glog/logging.h"
+
+#include "caffe/blob.hpp"
+#include "caffe/common.hpp"
+#include "caffe/net.hpp"
+#include "caffe/util/math_functions.hpp"
+
+using namespace caffe;  // NOLINT(build/namespaces)
+using boost::posix_time::microsec_clock;
+using boost::posix_time::ptime;
+using std::string;
+using std::vector;
+
+DEFINE_string(model, "", "The model definition protocol buffer text file.");
+DEFINE_string(weights, "",
+    "The trained weights to load, if any.");
+DEFINE_string(socket, "/tmp/caffe_inference.sock",
+    "Path of the UNIX domain socket to listen on.");
+DEFINE_string(output, "",
+    "Name of the blob to reply with; the first output blob by default.");
+DEFINE_int32(max_batch_size, 32, "Largest number of requests per batch.");
+DEFINE_int32(max_latency_us, 2000,
+    "Longest time a request waits for its batch to fill, in microseconds.");
+DEFINE_int32(gpu, -1, "GPU device to run on, or -1 to run on the CPU.");
+DEFINE_int32(stats_interval, 60,
+    "Seconds between logs of the statistics, or 0 not to log them.");
+
+// Reads or writes exactly size bytes, returning false if the connection
+// is closed or fails first.
+static bool ReadAll(int fd, void* data, size_t size) {
+  char* bytes = static_cast<char*>(data);
+  while (size > 0) {
+    const ssize_t n = read(fd, bytes, size);
+    if (n < 0 && errno == EINTR) {
+      continue;
+    }
+    if (n <= 0) {
+      return false;
+    }
+    bytes += n;
+    size -= n;
+  }
+  return true;
+}
+
+static bool WriteAll(int fd, const void* data, size_t size) {
+  const char* bytes = static_cast<const char*>(data);
+  while (size > 0) {
+    const ssize_t n = write(fd, bytes, size);
+    if (n < 0 && errno == EINTR) {
+      continue;
+    }
+    if (n <= 0) {
+      return false;
+    }
+    bytes += n;
+    size -= n;
+  }
+  return true;
+}
+
+static bool WriteFrame(int fd, const void* data, uint32_t size) {
+  return WriteAll(fd, &size, sizeof(size)) && WriteAll(fd, data, size);
+}
+
+// An input item waiting for its output.
+struct Request {
+  vector<float> input;
+  vector<float> output;
+  ptime arrival;
+  bool done;
+};
+
+// Histograms of the request latencies, in power of 2 buckets of
+// microseconds, and of the batch sizes.
+class Stats {
+ public:
+  explicit Stats(int max_batch_size)
+      : latencies_(kLatencyBuckets, 0), batch_sizes_(max_batch_size + 1, 0),
+        requests_(0), batches_(0), padded_items_(0), latency_sum_us_(0) {}
+
+  void AddRequest(int64_t latency_us) {
+    int bucket = 0;
+    while (bucket + 1 < kLatencyBuckets && (2LL << bucket) <= latency_us) {
+      ++bucket;
+    }
+    ++latencies_[bucket];
+    ++requests_;
+    latency_sum_us_ += latency_us;
+  }
+  void AddBatch(int size, int padded_size) {
+    ++batch_sizes_[size];
+    ++batches_;
+    padded_items_ += padded_size;
+  }
+
+  string Report() const {
+    std::ostringstream report;
+    report << std::fixed << std::setprecision(3);
+    report << requests_ << " requests in " << batches_ << " batches\n";
+    if (batches_ == 0) {
+      return report.str();
+    }
+    const int max_batch_size = batch_sizes_.size() - 1;
+    const double mean_size = static_cast<double>(requests_) / batches_;
+    report << "Mean batch size " << mean_size << ", "
+        << 100 * mean_size / max_batch_size << "% of the maximum, "
+        << 100. * requests_ / padded_items_ << "% of the padded size\n";
+    report << "Mean latency " << latency_sum_us_ / requests_ / 1000.
+        << " ms, 50% under " << Percentile(0.5) / 1000. << " ms, 90% under "
+        << Percentile(0.9) / 1000. << " ms, 99% under "
+        << Percentile(0.99) / 1000. << " ms\n";
+    report << "Latencies:\n";
+    for (int i = 0; i < kLatencyBuckets; ++i) {
+      if (latencies_[i] > 0) {
+        report << "  [" << (i ? 1LL << i : 0) << ", " << (2LL << i)
+            << ") us: " << latencies_[i] << "\n";
+      }
+    }
+    report << "Batch sizes:\n";
+    for (int i = 1; i <= max_batch_size; ++i) {
+      if (batch_sizes_[i] > 0) {
+        report << "  " << i << ": " << batch_sizes_[i] << "\n";
+      }
+    }
+    return report.str();
+  }
+
+ private:
+  // The upper bound of the bucket holding the given fraction of latencies.
+  int64_t Percentile(double fraction) const {
+    int64_t count = 0;
+    for (int i = 0; i < kLatencyBuckets; ++i) {
+      count += latencies_[i];
+      if (count >= fraction * requests_) {
+        return 2LL << i;
+      }
+    }
+    return 2LL << (kLatencyBuckets - 1);
+  }
+
+  static const int kLatencyBuckets = 32;
+  vector<int64_t> latencies_;
+  vector<int64_t> batch_sizes_;
+  int64_t requests_;
+  int64_t batches_;
+  int64_t padded_items_;
+  int64_t latency_sum_us_;
+};
+
+class Server {
+ public:
+  Server(Net<float>* net, Blob<float>* output, int max_batch_size)
+      : net_(net), input_(net->input_blobs()[0]), output_(output),
+        input_count_(input_->count(1)), max_batch_size_(max_batch_size),
+        stats_(max_batch_size) {}
+
+  // Serves the requests of a client until it disconnects, on a thread of
+  // its own.
+  void ServeClient(int fd) {
+    uint32_t size;
+    while (ReadAll(fd, &size, sizeof(size))) {
+      if (size == 0) {
+        string report;
+        {
+          boost::mutex::scoped_lock lock(mutex_);
+          report = stats_.Report();
+        }
+        if (!WriteFrame(fd, report.data(), report.size())) {
+          break;
+        }
+        continue;
+      }
+      if (size != input_count_ * sizeof(float)) {
+        LOG(ERROR) << "Closing connection after a request of " << size
+            << " bytes instead of " << input_count_ * sizeof(float);
+        break;
+      }
+      Request request;
+      request.input.resize(input_count_);
+      if (!ReadAll(fd, &request.input[0], size)) {
+        break;
+      }
+      request.arrival = microsec_clock::universal_time();
+      request.done = false;
+      {
+        boost::mutex::scoped_lock lock(mutex_);
+        pending_.push_back(&request);
+        pending_cond_.notify_one();
+        while (!request.done) {
+          done_cond_.wait(lock);
+        }
+      }
+      if (!WriteFrame(fd, &request.output[0],
+          request.output.size() * sizeof(float))) {
+        break;
+      }
+    }
+    close(fd);
+  }
+
+  // Runs the pending requests in batches, on the thread of the net.
+  void RunBatches() {
+    ptime last_report = microsec_clock::universal_time();
+    while (true) {
+      vector<Request*> batch;
+      {
+        boost::mutex::scoped_lock lock(mutex_);
+        while (pending_.empty()) {
+          pending_cond_.wait(lock);
+        }
+        const ptime deadline = pending_.front()->arrival +
+            boost::posix_time::microseconds(FLAGS_max_latency_us);
+        while (pending_.size() < max_batch_size_ &&
+            microsec_clock::universal_time() < deadline) {
+          pending_cond_.timed_wait(lock, deadline);
+        }
+        const int size = std::min<int>(pending_.size(), max_batch_size_);
+        batch.assign(pending_.begin(), pending_.begin() + size);
+        pending_.erase(pending_.begin(), pending_.begin() + size);
+      }
+      const int padded_size = RunBatch(batch);
+      const ptime now = microsec_clock::universal_time();
+      {
+        boost::mutex::scoped_lock lock(mutex_);
+        for (int i = 0; i < batch.size(); ++i) {
+          stats_.AddRequest((now - batch[i]->arrival).total_microseconds());
+          batch[i]->done = true;
+        }
+        stats_.AddBatch(batch.size(), padded_size);
+        done_cond_.notify_all();
+        if (FLAGS_stats_interval > 0 &&
+            (now - last_report).total_seconds() >= FLAGS_stats_interval) {
+          LOG(INFO) << "Statistics:\n" << stats_.Report();
+          last_report = now;
+        }
+      }
+    }
+  }
+
+ private:
+  // Runs a batch padded to the next power of 2, reshaping the net if it
+  // was last run for another padded size, and returns the padded size.
+  int RunBatch(const vector<Request*>& batch) {
+    int padded_size = 1;
+    while (padded_size < batch.size()) {
+      padded_size *= 2;
+    }
+    padded_size = std::min(padded_size, max_batch_size_);
+    if (input_->shape(0) != padded_size) {
+      vector<int> shape = input_->shape();
+      shape[0] = padded_size;
+      input_->Reshape(shape);
+      net_->Reshape();
+      LOG(INFO) << "Reshaped the net for batches of " << padded_size;
+    }
+    float* input_data = input_->mutable_cpu_data();
+    for (int i = 0; i < batch.size(); ++i) {
+      caffe_copy(input_count_, &batch[i]->input[0],
+          input_data + i * input_count_);
+    }
+    caffe_set((padded_size - batch.size()) * input_count_, 0.f,
+        input_data + batch.size() * input_count_);
+    net_->Forward();
+    const int output_count = output_->count(1);
+    const float* output_data = output_->cpu_data();
+    for (int i = 0; i < batch.size(); ++i) {
+      batch[i]->output.assign(output_data + i * output_count,
+          output_data + (i + 1) * output_count);
+    }
+    return padded_size;
+  }
+
+  Net<float>* net_;
+  Blob<float>* input_;
+  Blob<float>* output_;
+  const int input_count_;
+  const int max_batch_size_;
+  // Guards the pending requests, their done flags and the statistics.
+  boost::mutex mutex_;
+  boost::condition_variable pending_cond_;
+  boost::condition_variable done_cond_;
+  std::deque<Request*> pending_;
+  Stats stats_;
+};
+
+// Accepts connections, serving each client on a new thread.
+static void AcceptClients(int listen_fd, Server* server) {
+  while (true) {
+    const int fd = accept(listen_fd, NULL, NULL);
+    if (fd < 0) {
+      if (errno != EINTR) {
+        LOG(ERROR) << "Failed to accept a connection: " << strerror(errno);
+      }
+      continue;
+    }
+    boost::thread(boost::bind(&Server::ServeClient, server, fd)).detach();
+  }
+}
+
+int main(int argc, char** argv) {
+  FLAGS_alsologtostderr = 1;
+  gflags::SetUsageMessage("Serve a net over a UNIX domain socket, running "
+      "concurrent requests in batches.\n"
+      "Usage:\n"
+      "    inference_server --model=deploy.prototxt "
+      "--weights=net.caffemodel [FLAGS]\n");
+  caffe::GlobalInit(&argc, &argv);
+  CHECK_GT(FLAGS_model.size(), 0) << "Need a model definition to serve.";
+  CHECK_GT(FLAGS_max_batch_size, 0);
+  CHECK_GE(FLAGS_max_latency_us, 0);
+  if (FLAGS_gpu >= 0) {
+    Caffe::SetDevice(FLAGS_gpu);
+    Caffe::set_mode(Caffe::GPU);
+  } else {
+    Caffe::set_mode(Caffe::CPU);
+  }
+
+  Net<float> net(FLAGS_model, TEST);
+  if (FLAGS_weights.size()) {
+    net.CopyTrainedLayersFrom(FLAGS_weights);
+  }
+  CHECK_EQ(net.num_inputs(), 1) << "The net should have exactly one input.";
+  CHECK_GE(net.input_blobs()[0]->num_axes(), 1);
+  Blob<float>* output = FLAGS_output.size() ?
+      net.blob_by_name(FLAGS_output).get() : net.output_blobs()[0];
+  CHECK(output) << "Unknown output blob " << FLAGS_output;
+  Server server(&net, output, FLAGS_max_batch_size);
+
+  sockaddr_un address;
+  memset(&address, 0, sizeof(address));
+  address.sun_family = AF_UNIX;
+  CHECK_LT(FLAGS_socket.size(), sizeof(address.sun_path))
+      << "Socket path too long: " << FLAGS_socket;
+  strncpy(address.sun_path, FLAGS_socket.c_str(),
+      sizeof(address.sun_path) - 1);
+  const int listen_fd = socket(AF_UNIX, SOCK_STREAM, 0);
+  CHECK_GE(listen_fd, 0) << "Failed to create a socket: " << strerror(errno);
+  unlink(FLAGS_socket.c_str());
+  CHECK_EQ(bind(listen_fd, reinterpret_cast<sockaddr*>(&address),
+      sizeof(address)), 0)
+      << "Failed to bind " << FLAGS_socket << ": " << strerror(errno);
+  CHECK_EQ(listen(listen_fd, SOMAXCONN), 0)
+      << "Failed to listen on " << FLAGS_socket << ": " << strerror(errno);
+  // Clients that disconnect before their reply must not end the server.
+  signal(SIGPIPE, SIG_IGN);
+  LOG(INFO) << "Serving " << FLAGS_model << " on " << FLAGS_socket
+      << " in batches of up to " << FLAGS_max_batch_size << " items of "
+      << net.input_blobs()[0]->count(1) << " floats.";
+
+  boost::thread acceptor(&AcceptClients, listen_fd, &server);
+  server.RunBatches();
+  return 0;
+}
@@ -0,0 +1,81 @@
+// Compares the throughput of BlockingQueue and SPSCQueue when a producer
+// thread and a consumer thread pass records back and forth through a free
+// and a full queue, as DataReader does.
+// Usage:
+//    queue_benchmark [--items=N] [--capacity=N]
+
+#include <string>
+#include <vector>
+
+#include "boost/bind.hpp"
+#include "boost/thread.hpp"
+#include "gflags/gflags.h"
+#include "glog/logging.h"
+
+#include "caffe/common.hpp"
+#include "caffe/proto/caffe.pb.h"
+#include "caffe/util/benchmark.hpp"
+#include "caffe/util/blocking_queue.hpp"
+#include "caffe/util/spsc_queue.hpp"
+
+using namespace caffe;  // NOLINT(build/namespaces)
+
+DEFINE_int32(items, 10000000,
+    "Number of records passed from the producer to the consumer.");
+DEFINE_int32(capacity, 64,
+    "Number of records in flight, e.g. prefetch * batch_size.");
+
+// Moves items records from free to full, as DataReader::Body::read_one.
+template <typename Queue>
+static void Produce(Queue* free, Queue* full, const int items) {
+  for (int i = 0; i < items; ++i) {
+    Datum* datum = free->pop();
+    datum->set_label(i);
+    full->push(datum);
+  }
+}
+
+// Returns the number of records per second passed through free and full.
+template <typename Queue>
+static double TimeQueues(Queue* free, Queue* full) {
+  vector<Datum> datums(FLAGS_capacity);
+  for (int i = 0; i < datums.size(); ++i) {
+    free->push(&datums[i]);
+  }
+  CPUTimer timer;
+  timer.Start();
+  boost::thread producer(boost::bind(&Produce<Queue>, free, full,
+      FLAGS_items));
+  for (int i = 0; i < FLAGS_items; ++i) {
+    Datum* datum = full->pop();
+    CHECK_EQ(datum->label(), i);
+    free->push(datum);
+  }
+  producer.join();
+  timer.Stop();
+  Datum* datum;
+  while (free->try_pop(&datum)) {}
+  return FLAGS_items / (timer.MilliSeconds() / 1000.);
+}
+
+int main(int argc, char** argv) {
+  FLAGS_alsologtostderr = 1;
+  gflags::SetUsageMessage("Benchmark the data prefetching queues.\n"
+      "Usage:\n"
+      "    queue_benchmark [FLAGS]\n");
+  caffe::GlobalInit(&argc, &argv);
+  CHECK_GT(FLAGS_items, 0);
+  CHECK_GT(FLAGS_capacity, 0);
+
+  LOG(INFO) << "Passing " << FLAGS_items << " records, "
+      << FLAGS_capacity << " in flight.";
+  BlockingQueue<Datum*> blocking_free, blocking_full;
+  const double blocking_rate = TimeQueues(&blocking_free, &blocking_full);
+  LOG(INFO) << "BlockingQueue: " << blocking_rate
+      << " records/s";
+  SPSCQueue<Datum*> spsc_free(FLAGS_capacity), spsc_full(FLAGS_capacity);
+  const double spsc_rate = TimeQueues(&spsc_free, &spsc_full);
+  LOG(INFO) << "SPSCQueue:     " << spsc_rate
+      << " records/s, speedup " << spsc_rate / blocking_rate << "x";
+  return 0;
+}